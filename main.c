@@ -1,9 +1,40 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 // O_DIRECT
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <wchar.h>
 #include <locale.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stddef.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(FAT16_ZLIB)
+#include <zlib.h>                   // Defined by the build when zlib is found
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#define FAT16_IO_URING
+#endif
+#endif
 
 /// +--------------------------------------------------------------------------------------------------+
 /// |                                                                                                  |
@@ -34,6 +65,44 @@
 /// |                                                                                                  |
 /// +--------------------------------------------------------------------------------------------------+
 
+/*
+ * All output goes through the output stream of the current thread. This is stdout unless a worker thread has
+ * redirected it to capture the results of an image before they are written out.
+ */
+
+static __thread FILE *threadOutputStream = NULL;
+
+/**
+ * Gets the stream output is written to on this thread
+ * @return - The output stream, stdout if none has been set
+ */
+FILE *getOutputStream() {
+    if(threadOutputStream == NULL) {
+        return stdout;
+    }
+    return threadOutputStream;
+}
+
+/**
+ * Sets the stream output is written to on this thread
+ * @param paramStream - The stream to write to, NULL to return to stdout
+ */
+void setOutputStream(FILE *paramStream) {
+    threadOutputStream = paramStream;
+}
+
+/**
+ * Prints formatted output to the output stream of this thread
+ * @param paramFormat - printf style format string
+ * @param ...         - The values being formatted
+ */
+void printOutput(const char *paramFormat, ...) {
+    va_list arguments;
+    va_start(arguments, paramFormat);
+    vfprintf(getOutputStream(), paramFormat, arguments);
+    va_end(arguments);
+}
+
 /**
  * Prints a number of spaces in the console
  * @param paramIndentSize
@@ -41,135 +110,341 @@
 void printIndent(int paramIndentSize) {
 
     for(int index = 0; index < paramIndentSize; index++) {
-        printf(" ");
+        printOutput(" ");
     }
 }
 
+/**
+ * Checks whether bytes are all 0
+ * @param paramBytes  - The bytes
+ * @param paramLength - The number of bytes
+ * @return            - 1 if every byte is 0
+ */
+uint8_t isZeroBytes(const unsigned char *paramBytes, long paramLength) {
+    return paramLength == 0 || (paramBytes[0] == 0 && memcmp(paramBytes, paramBytes + 1, paramLength - 1) == 0);
+}
+
 
 /// +--------------------------------------------------------------------------------------------------+
 /// |                                                                                                  |
-/// |                                          Exceptions                                              |
+/// |                                         Text Encoding                                            |
 /// |                                                                                                  |
 /// +--------------------------------------------------------------------------------------------------+
 
 /*
- * Exceptions are created then attached to a return stack, when a return stack is returned it may contain
- * an exception which can be checked.
+ * Names are held as wchar_t arrays of UTF-16 code units, the way long file name entries store them, with characters
+ * outside the basic multilingual plane kept as surrogate pairs. Every name printed is transcoded to UTF-8 and every
+ * path from the command line or host is transcoded from UTF-8, so a path typed in matches the UCS-2 on disk.
+ * Runs of ASCII are converted 8 or 16 characters at a time with SSE2 when it is available.
  */
 
-#define EXCEPTION_UNABLE_TO_OPEN_FILE 1
-#define EXCEPTION_CLUSTER_OUT_OF_RANGE 2
-#define EXCEPTION_FILE_DOES_NOT_EXIST 3
-#define EXCEPTION_PROGRAM_ARGUMENTS 4
+#define UTF8_MAXIMUM_CHARACTER_BYTES 4
+#define UTF8_CHUNK_CHARACTERS 256
 
 /**
- * Stores the id of a singular exception
+ * Encodes the character at the start of some UTF-16 code units as UTF-8, joining a surrogate pair into one
+ * character and replacing a surrogate on its own with U+FFFD
+ * @param paramCharacters     - The code units
+ * @param paramLength         - The number of code units, at least 1
+ * @param paramBytes          - Where the UTF-8 is written, room for UTF8_MAXIMUM_CHARACTER_BYTES
+ * @param paramNumberOfBytes  - Set to the number of bytes written
+ * @return                    - The number of code units used, 1 or 2
  */
-struct Exception {
-    int exception;              // The exception id
-}; typedef struct Exception Exception;
+int encodeUtf8Character(const wchar_t *paramCharacters, int paramLength, unsigned char *paramBytes, int *paramNumberOfBytes) {
+
+    uint32_t character = (uint32_t) paramCharacters[0];
+    int numberOfCharacters = 1;
+
+    if(character >= 0xD800 && character <= 0xDBFF && paramLength > 1 &&
+       (uint32_t) paramCharacters[1] >= 0xDC00 && (uint32_t) paramCharacters[1] <= 0xDFFF) {
+        character = 0x10000 + ((character - 0xD800) << 10) + ((uint32_t) paramCharacters[1] - 0xDC00);
+        numberOfCharacters = 2;
+    } else if((character >= 0xD800 && character <= 0xDFFF) || character > 0x10FFFF) {
+        character = 0xFFFD;                                                     // Not a character on its own
+    }
+
+    if(character < 0x80) {
+        paramBytes[0] = (unsigned char) character;
+        *paramNumberOfBytes = 1;
+    } else if(character < 0x800) {
+        paramBytes[0] = 0xC0 | (character >> 6);
+        paramBytes[1] = 0x80 | (character & 0x3F);
+        *paramNumberOfBytes = 2;
+    } else if(character < 0x10000) {
+        paramBytes[0] = 0xE0 | (character >> 12);
+        paramBytes[1] = 0x80 | ((character >> 6) & 0x3F);
+        paramBytes[2] = 0x80 | (character & 0x3F);
+        *paramNumberOfBytes = 3;
+    } else {
+        paramBytes[0] = 0xF0 | (character >> 18);
+        paramBytes[1] = 0x80 | ((character >> 12) & 0x3F);
+        paramBytes[2] = 0x80 | ((character >> 6) & 0x3F);
+        paramBytes[3] = 0x80 | (character & 0x3F);
+        *paramNumberOfBytes = 4;
+    }
+
+    return numberOfCharacters;
+}
 
 /**
- * Create an exception
- * @param paramException - int value of the exception.
- * @return               - the created exception
+ * Transcodes UTF-16 code units to UTF-8
+ * @param paramCharacters - The code units
+ * @param paramLength     - The number of code units
+ * @param paramBytes      - Where the UTF-8 is written, room for UTF8_MAXIMUM_CHARACTER_BYTES per code unit
+ * @return                - The number of bytes written
  */
-Exception *createException(int paramException) {
-    Exception *exception = (Exception *) malloc(sizeof(Exception));
-    exception->exception = paramException;
+int encodeUtf8(const wchar_t *paramCharacters, int paramLength, unsigned char *paramBytes) {
 
-    return exception;
-}
+    int index = 0;
+    int numberOfBytes = 0;
 
+    while(index < paramLength) {
 
-/// +--------------------------------------------------------------------------------------------------+
-/// |                                                                                                  |
-/// |                                       Return Stacks                                              |
-/// |                                                                                                  |
-/// +--------------------------------------------------------------------------------------------------+
+#if defined(__SSE2__) && WCHAR_MAX > 0xFFFF
+        // Eight ASCII characters at a time, the 32 bit characters are narrowed to bytes with two packs
+        const __m128i notASCII = _mm_set1_epi32(~0x7F);
+        while(index + 8 <= paramLength) {
+            __m128i first = _mm_loadu_si128((const __m128i *) (paramCharacters + index));
+            __m128i second = _mm_loadu_si128((const __m128i *) (paramCharacters + index + 4));
 
-/*
- * Return stacks bundle up the value to be returned in a pointer and any exceptions that occurred.
- */
+            __m128i outside = _mm_and_si128(_mm_or_si128(first, second), notASCII);
+            if(_mm_movemask_epi8(_mm_cmpeq_epi32(outside, _mm_setzero_si128())) != 0xFFFF) {
+                break;
+            }
 
-/**
- * The return stack stores a value to be returned and any exceptions that have occurred
- */
-struct ReturnStack {
-    int *returnedValue;                 // The returned value
-    Exception exceptions[64];           // Exceptions within the return stack
-    int numberOfExceptions;             // Total number of exceptions
+            __m128i words = _mm_packs_epi32(first, second);
+            _mm_storel_epi64((__m128i *) (paramBytes + numberOfBytes), _mm_packus_epi16(words, words));
+            index += 8;
+            numberOfBytes += 8;
+        }
+#endif
 
-}; typedef struct ReturnStack ReturnStack;
+        // One character at a time through a block holding a character outside ASCII
+        int blockEnd = index + 8 < paramLength ? index + 8 : paramLength;
+        while(index < blockEnd) {
+            if((uint32_t) paramCharacters[index] < 0x80) {
+                paramBytes[numberOfBytes++] = (unsigned char) paramCharacters[index++];
+            } else {
+                int characterBytes;
+                index += encodeUtf8Character(paramCharacters + index, paramLength - index, paramBytes + numberOfBytes, &characterBytes);
+                numberOfBytes += characterBytes;
+            }
+        }
+    }
+
+    return numberOfBytes;
+}
 
 /**
- *  Prints the errors contained within a return stack
- * @param paramReturnStack  - the return stack in which the errors are
+ * Transcodes UTF-8 to UTF-16 code units, characters outside the basic multilingual plane become surrogate pairs.
+ * A byte that does not start a valid sequence is widened on its own.
+ * @param paramBytes      - The UTF-8 bytes
+ * @param paramLength     - The number of bytes
+ * @param paramCharacters - Where the code units are written, room for one per byte
+ * @return                - The number of code units written
  */
-void printExceptionsOnReturnStack(ReturnStack *paramReturnStack) {
-
-    if(paramReturnStack->numberOfExceptions == 0) {
-        return;
-    }
+int decodeUtf8(const unsigned char *paramBytes, int paramLength, wchar_t *paramCharacters) {
 
-    for(int index = 0; index < paramReturnStack->numberOfExceptions; index++) {
+    int index = 0;
+    int numberOfCharacters = 0;
 
-        switch ((int) ((paramReturnStack->exceptions)+index)->exception) {
+    while(index < paramLength) {
 
-            case EXCEPTION_UNABLE_TO_OPEN_FILE:
-                printf("Unable to open file.\n");
-                break;
-            case EXCEPTION_CLUSTER_OUT_OF_RANGE:
-                printf("Cluster index out of range for cluster.\n");
-                break;
-            case EXCEPTION_FILE_DOES_NOT_EXIST:
-                printf("The file does not exist.\n");
-                break;
-            case EXCEPTION_PROGRAM_ARGUMENTS:
-                printf("Usage: <FAT16.img> <File Location> <-bs : -e>\n");
-                break;
-            default:
-                printf("Unknown exception occurred.\n");
+#if defined(__SSE2__) && WCHAR_MAX > 0xFFFF
+        // Sixteen ASCII bytes at a time, widened to 32 bit characters with two unpacks
+        while(index + 16 <= paramLength) {
+            __m128i bytes = _mm_loadu_si128((const __m128i *) (paramBytes + index));
+            if(_mm_movemask_epi8(bytes) != 0) {
                 break;
+            }
+
+            __m128i zero = _mm_setzero_si128();
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            __m128i *characters = (__m128i *) (paramCharacters + numberOfCharacters);
+            _mm_storeu_si128(characters, _mm_unpacklo_epi16(low, zero));
+            _mm_storeu_si128(characters + 1, _mm_unpackhi_epi16(low, zero));
+            _mm_storeu_si128(characters + 2, _mm_unpacklo_epi16(high, zero));
+            _mm_storeu_si128(characters + 3, _mm_unpackhi_epi16(high, zero));
+            index += 16;
+            numberOfCharacters += 16;
+        }
+#endif
+
+        // One sequence at a time through a block holding a byte outside ASCII
+        int blockEnd = index + 16 < paramLength ? index + 16 : paramLength;
+        while(index < blockEnd) {
+
+            uint32_t byte = paramBytes[index];
+            int sequenceLength = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : 2;
+            uint8_t is_valid = byte >= 0xC2 && byte <= 0xF4 && index + sequenceLength <= paramLength;
+
+            uint32_t character = byte & (0x7F >> sequenceLength);
+            for(int continuation = 1; is_valid && continuation < sequenceLength; continuation++) {
+                uint32_t nextByte = paramBytes[index + continuation];
+                is_valid = (nextByte & 0xC0) == 0x80;
+                character = (character << 6) | (nextByte & 0x3F);
+            }
+
+            // Overlong, surrogate and out of range sequences are not characters
+            if(is_valid && sequenceLength == 3 && (character < 0x800 || (character >= 0xD800 && character <= 0xDFFF))) {
+                is_valid = 0;
+            }
+            if(is_valid && sequenceLength == 4 && (character < 0x10000 || character > 0x10FFFF)) {
+                is_valid = 0;
+            }
+
+            if(!is_valid) {
+                paramCharacters[numberOfCharacters++] = (wchar_t) byte;
+                index++;
+            } else if(character >= 0x10000) {
+                character -= 0x10000;
+                paramCharacters[numberOfCharacters++] = (wchar_t) (0xD800 + (character >> 10));
+                paramCharacters[numberOfCharacters++] = (wchar_t) (0xDC00 + (character & 0x3FF));
+                index += sequenceLength;
+            } else {
+                paramCharacters[numberOfCharacters++] = (wchar_t) character;
+                index += sequenceLength;
+            }
         }
     }
+
+    return numberOfCharacters;
 }
 
 /**
- * Create a return stack
- * @return - The newly instantiated Return Stack
+ * Converts a string from the command line or host file system into a wide string of UTF-16 code units
+ * @param paramString - The UTF-8 string
+ * @param paramLength - Set to the length of the wide string
+ * @return            - The wide string
  */
-ReturnStack *createReturnStack() {
-    ReturnStack *returnStack = (ReturnStack *) malloc(sizeof(ReturnStack));
-    returnStack->numberOfExceptions = 0;
+wchar_t *createWideString(const char *paramString, int *paramLength) {
+
+    int stringLength = (int) strlen(paramString);
+    wchar_t *wideString = (wchar_t *) malloc(sizeof(wchar_t) * (stringLength + 1));
 
-    return returnStack;
+    *paramLength = decodeUtf8((const unsigned char *) paramString, stringLength, wideString);
+    return wideString;
 }
 
 /**
- * Sets the value of a Return Stack
- * @param paramReturnStack - the return stack that's value is being set
- * @param returnValue      - the value which is being set
+ * Prints a path or name to the output stream as UTF-8
+ * @param paramPath       - The path
+ * @param paramPathLength - The length of the path
  */
-void setReturnValueToReturnStack(ReturnStack *paramReturnStack, int *returnValue) {
-    paramReturnStack->returnedValue = returnValue;
+void printPath(const wchar_t *paramPath, int paramPathLength) {
+
+    unsigned char bytes[UTF8_CHUNK_CHARACTERS * UTF8_MAXIMUM_CHARACTER_BYTES];
+
+    int index = 0;
+    while(index < paramPathLength) {
+        int numberOfCharacters = paramPathLength - index < UTF8_CHUNK_CHARACTERS ? paramPathLength - index : UTF8_CHUNK_CHARACTERS;
+
+        uint32_t lastCharacter = (uint32_t) paramPath[index + numberOfCharacters - 1];
+        if(index + numberOfCharacters < paramPathLength && lastCharacter >= 0xD800 && lastCharacter <= 0xDBFF) {
+            numberOfCharacters--;                                               // Keep a surrogate pair in one chunk
+        }
+
+        fwrite(bytes, 1, encodeUtf8(paramPath + index, numberOfCharacters, bytes), getOutputStream());
+        index += numberOfCharacters;
+    }
 }
 
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                          Exceptions                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Functions that can fail return the id of the exception that occurred, or EXCEPTION_NONE, and hand back anything
+ * else they produce through out-parameters. Nothing is allocated to report an exception so the loops that parse
+ * entries and follow chains pay nothing for it. The id is printed once it reaches the command line.
+ */
+
+#define EXCEPTION_NONE 0
+#define EXCEPTION_UNABLE_TO_OPEN_FILE 1
+#define EXCEPTION_CLUSTER_OUT_OF_RANGE 2
+#define EXCEPTION_FILE_DOES_NOT_EXIST 3
+#define EXCEPTION_PROGRAM_ARGUMENTS 4
+#define EXCEPTION_NO_IMAGES_FOUND 5
+#define EXCEPTION_UNABLE_TO_CREATE_THREAD 6
+#define EXCEPTION_EMPTY_PATTERN 7
+#define EXCEPTION_UNABLE_TO_WRITE_FILE 8
+#define EXCEPTION_VOLUME_FULL 9
+#define EXCEPTION_DIRECTORY_FULL 10
+#define EXCEPTION_FILE_ALREADY_EXISTS 11
+#define EXCEPTION_INVALID_GEOMETRY 12
+#define EXCEPTION_INVALID_SCAN_STATE 13
+#define EXCEPTION_IMAGE_TOO_LARGE 14
+
 /**
- * Adds an exception to the return stack
- * @param paramReturnStack - the return stack that's exception is being added
- * @param paramException   - the exception which is being added
+ * Prints the message of an exception, nothing for EXCEPTION_NONE
+ * @param paramException - The id of the exception
  */
-void addExceptionToReturnStack(ReturnStack *paramReturnStack, Exception *paramException) {
-    paramReturnStack->exceptions[paramReturnStack->numberOfExceptions] = *paramException;
-    paramReturnStack->numberOfExceptions++;
-}
+void printException(int paramException) {
 
-uint8_t isExceptionOnReturnStack(ReturnStack *paramReturnStack) {
-    if(paramReturnStack->numberOfExceptions == 0) {
-        return 0;
+    switch (paramException) {
+
+        case EXCEPTION_NONE:
+            break;
+        case EXCEPTION_UNABLE_TO_OPEN_FILE:
+            printOutput("Unable to open file.\n");
+            break;
+        case EXCEPTION_CLUSTER_OUT_OF_RANGE:
+            printOutput("Cluster index out of range for cluster.\n");
+            break;
+        case EXCEPTION_FILE_DOES_NOT_EXIST:
+            printOutput("The file does not exist.\n");
+            break;
+        case EXCEPTION_PROGRAM_ARGUMENTS:
+            printOutput("Usage: <FAT16.img : Directory : @List> <File Location : // : -u : --undelete : --grep Pattern : --manifest> <-bs : -e : -j Threads : --cache-mb Megabytes : --io pread|uring : --queue-depth N : --direct : --format ndjson|csv>\n");
+            printOutput("       <FAT16.img : Directory : @List> --add <Image Directory> <Host File>...\n");
+            printOutput("       <FAT16.img> <--defrag : --defrag-to Copy.img> [--dry-run]\n");
+            printOutput("       <FAT16.img> <--sparse-to Copy.img : --punch-holes> [--zero-slack]\n");
+            printOutput("       <FAT16.img : Directory : @List> --long <Directory> [--sort name|size|created|written] [--reverse] [--recursive]\n");
+            printOutput("       diff <Old FAT16.img> <New FAT16.img>\n");
+            printOutput("       create <New FAT16.img> <Host Directory> [--size-mb Megabytes] [--cluster-kb Kilobytes] [--label Label]\n");
+            printOutput("       compress <FAT16.img> <Compressed.fatz> [--chunk-kb Kilobytes]\n");
+            printOutput("       ls <FAT16.img : Directory : @List> <Path> [-l] [--sort name|size|created|written] [--reverse] [--recursive]\n");
+            printOutput("       du <FAT16.img : Directory : @List> <Path> [--max-depth Depth] [--top Count]\n");
+            printOutput("       scan <FAT16.img> <State File>\n");
+            break;
+        case EXCEPTION_NO_IMAGES_FOUND:
+            printOutput("No images were found.\n");
+            break;
+        case EXCEPTION_UNABLE_TO_CREATE_THREAD:
+            printOutput("Unable to create thread.\n");
+            break;
+        case EXCEPTION_EMPTY_PATTERN:
+            printOutput("The grep pattern is empty.\n");
+            break;
+        case EXCEPTION_UNABLE_TO_WRITE_FILE:
+            printOutput("Unable to write file.\n");
+            break;
+        case EXCEPTION_VOLUME_FULL:
+            printOutput("There are not enough free clusters.\n");
+            break;
+        case EXCEPTION_DIRECTORY_FULL:
+            printOutput("The directory is full.\n");
+            break;
+        case EXCEPTION_FILE_ALREADY_EXISTS:
+            printOutput("The file already exists.\n");
+            break;
+        case EXCEPTION_INVALID_GEOMETRY:
+            printOutput("The size and cluster size do not make a FAT16 volume.\n");
+            break;
+        case EXCEPTION_INVALID_SCAN_STATE:
+            printOutput("The scan state is damaged or not a scan state.\n");
+            break;
+        case EXCEPTION_IMAGE_TOO_LARGE:
+            printOutput("The image is too large to be held in memory.\n");
+            break;
+        default:
+            printOutput("Unknown exception occurred.\n");
+            break;
     }
-    return 1;
 }
 
 
@@ -187,7 +462,7 @@ uint8_t isExceptionOnReturnStack(ReturnStack *paramReturnStack) {
  * Buffer stores a buffer pointer which points to the first element in the buffer and the total size of the buffer
  */
 struct Buffer {
-    int size;
+    long size;
     unsigned char *bufferPtr;
 }; typedef struct Buffer Buffer;
 
@@ -198,25 +473,25 @@ struct Buffer {
  */
 __attribute__((unused)) void printBuffer(Buffer *paramBuffer, int paramValuesPerRow) {
 
-    printf("Buffer Pointer: %s\nBuffer Size: %d\n\n          ", paramBuffer->bufferPtr, paramBuffer->size);
+    printOutput("Buffer Pointer: %s\nBuffer Size: %ld\n\n          ", paramBuffer->bufferPtr, paramBuffer->size);
 
     for(int index = 0; index < paramValuesPerRow; index++) {
-        printf("%02x ", index);
+        printOutput("%02x ", index);
     }
 
-    printf("\n");
+    printOutput("\n");
 
-    for(int index = 0; index < paramBuffer->size; index++) {
+    for(long index = 0; index < paramBuffer->size; index++) {
 
         if(index % paramValuesPerRow == 0) {
-            printf("\n%8x  ", index);
+            printOutput("\n%8lx  ", index);
         }
 
-        printf("%02x ", *(paramBuffer->bufferPtr + index));
+        printOutput("%02x ", *(paramBuffer->bufferPtr + index));
 
     }
 
-    printf("\n");
+    printOutput("\n");
 }
 
 /**
@@ -228,8 +503,8 @@ void printBufferAsASCII(Buffer *paramBuffer, int paramIndentSize) {
 
     printIndent(paramIndentSize);
 
-    for(int index = 0; index < paramBuffer->size; index++) {
-        printf("%c", *(paramBuffer->bufferPtr + index));
+    for(long index = 0; index < paramBuffer->size; index++) {
+        printOutput("%c", *(paramBuffer->bufferPtr + index));
 
         if( (char) *(paramBuffer->bufferPtr + index) == '\n') {
             printIndent(paramIndentSize);
@@ -241,58 +516,58 @@ void printBufferAsASCII(Buffer *paramBuffer, int paramIndentSize) {
 /**
  * Used to create a Buffer
  * @param paramSize - Number of bytes a buffer holds
- * @return          - The created buffer
+ * @return          - The created buffer, NULL when its bytes could not be allocated
  */
-Buffer *createBuffer(int paramSize) {
+Buffer *createBuffer(long paramSize) {
 
     Buffer *buffer = (Buffer *) malloc(sizeof(Buffer));
     buffer->size = paramSize;
     buffer->bufferPtr = (unsigned char *)calloc(buffer->size, sizeof(unsigned char)); // Enough memory for the file
 
+    if(buffer->bufferPtr == NULL && buffer->size > 0) {
+        free(buffer);
+        return NULL;
+    }
     return buffer;
 }
 
-/**
- * Sub buffers another buffer
- * @param paramBuffer - Buffer to sub-buffered
- * @param paramStart  - Where the new buffer starts
- * @param paramReadLength - The length of the new buffer in bytes
- * @return
- */
-ReturnStack *getBytesFromByteStream(Buffer *paramBuffer, int paramStart, int paramReadLength) {
-
-    ReturnStack *returnStack = createReturnStack();
-
-    Buffer *buffer = createBuffer(paramReadLength);
-
-    memcpy(buffer->bufferPtr, (paramBuffer->bufferPtr + paramStart),buffer->size);
-
-    setReturnValueToReturnStack(returnStack, buffer);
-
-    return returnStack;
-}
-
 /**
  * Converts a file into a buffer
  * @param paramFile - File to be turned into a buffer
- * @return          - The new buffer containing the binary of the file
+ * @return          - The new buffer containing the binary of the file, NULL when it could not be read or held
  */
-ReturnStack *convertFileToBuffer(FILE *paramFile) {
-
-    ReturnStack *returnStack = createReturnStack();
+Buffer *convertFileToBuffer(FILE *paramFile) {
 
     fseek(paramFile, 0, SEEK_END);
     long length = ftell(paramFile);
+    if(length < 0) {
+        return NULL;
+    }
 
     fseek(paramFile, 0L, SEEK_SET);
 
     Buffer *buffer = createBuffer(length);
+    if(buffer == NULL) {
+        return NULL;
+    }
+
+    if(fread(buffer->bufferPtr, sizeof(char), length, paramFile) != (size_t) length) {
+        free(buffer->bufferPtr);
+        free(buffer);
+        return NULL;
+    }
 
-    fread(buffer->bufferPtr, sizeof(char), length, paramFile);
+    return buffer;
+}
 
-    setReturnValueToReturnStack(returnStack, buffer);
 
-    return returnStack;
+/**
+ * Frees a buffer and the bytes it holds
+ * @param paramBuffer - The buffer being freed
+ */
+void freeBuffer(Buffer *paramBuffer) {
+    free(paramBuffer->bufferPtr);
+    free(paramBuffer);
 }
 
 
@@ -368,27 +643,22 @@ void freeLinkedList(LinkedList *paramLinkedList) {
  */
 
 /**
- * Opens and returns a file from the file name
+ * Opens a file from the file name
  * @param paramFileName - the name / directory of the file to be opened
- * @return              - returns the file
+ * @param paramFile     - set to the opened file
+ * @return              - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
  */
-ReturnStack *openFile(char *paramFileName) {
-
-    ReturnStack *returnStack = createReturnStack();
+int openFile(char *paramFileName, FILE **paramFile) {
 
     // OPEN FILE
-    FILE *file;
-    file = fopen(paramFileName, "r");
+    *paramFile = fopen(paramFileName, "r");
 
-    if (file == NULL)
+    if (*paramFile == NULL)
     {
-        addExceptionToReturnStack(returnStack, createException(EXCEPTION_UNABLE_TO_OPEN_FILE));
-        return returnStack;
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
     }
 
-    setReturnValueToReturnStack(returnStack, (int *) file);
-
-    return returnStack;
+    return EXCEPTION_NONE;
 }
 
 /**
@@ -445,36 +715,36 @@ struct __attribute__((__packed__)) BootSector {
  * @param paramBootSector - The boot sector to be printed
  */
 void printBootSector(BootSector *paramBootSector) {
-    printf("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+    printOutput("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
     for(int index=0; index<3; index++) {
-        printf("BS_jmpBoot[%d]= %d | %08x\n", index, paramBootSector->BS_jmpBoot[index], paramBootSector->BS_jmpBoot[index]);
+        printOutput("BS_jmpBoot[%d]= %d | %08x\n", index, paramBootSector->BS_jmpBoot[index], paramBootSector->BS_jmpBoot[index]);
     }
     for(int index=0; index<8; index++) {
-        printf("BS_OEMName[%d]= %d | %08x\n", index, paramBootSector->BS_OEMName[index], paramBootSector->BS_OEMName[index]);
-    }
-    printf("BPB_BytsPerSec= %d | %08x\n", paramBootSector->BPB_BytsPerSec, paramBootSector->BPB_BytsPerSec);
-    printf("BPB_SecPerClus= %d | %08x\n", paramBootSector->BPB_SecPerClus, paramBootSector->BPB_SecPerClus);
-    printf("BPB_RsvdSecCnt= %d | %08x\n", paramBootSector->BPB_RsvdSecCnt, paramBootSector->BPB_RsvdSecCnt);
-    printf("BPB_NumFATs= %d | %08x\n", paramBootSector->BPB_NumFATs, paramBootSector->BPB_NumFATs);
-    printf("BPB_RootEntCnt= %d | %08x\n", paramBootSector->BPB_RootEntCnt, paramBootSector->BPB_RootEntCnt);
-    printf("BPB_TotSec16= %d | %08x\n", paramBootSector->BPB_TotSec16, paramBootSector->BPB_TotSec16);
-    printf("BPB_Media= %d | %08x\n", paramBootSector->BPB_Media, paramBootSector->BPB_Media);
-    printf("BPB_FATSz16= %d | %08x\n", paramBootSector->BPB_FATSz16, paramBootSector->BPB_FATSz16);
-    printf("BPB_SecPerTrk= %d | %08x\n", paramBootSector->BPB_SecPerTrk, paramBootSector->BPB_SecPerTrk);
-    printf("BPB_NumHeads= %d | %08x\n", paramBootSector->BPB_NumHeads, paramBootSector->BPB_NumHeads);
-    printf("BPB_HiddSec= %d | %08x\n", paramBootSector->BPB_HiddSec, paramBootSector->BPB_HiddSec);
-    printf("BPB_TotSec32= %d | %08x\n", paramBootSector->BPB_TotSec32, paramBootSector->BPB_TotSec32);
-    printf("BS_DrvNum= %d | %08x\n", paramBootSector->BS_DrvNum, paramBootSector->BS_DrvNum);
-    printf("BS_Reserved1= %d | %08x\n", paramBootSector->BS_Reserved1, paramBootSector->BS_Reserved1);
-    printf("BS_BootSig= %d | %08x\n", paramBootSector->BS_BootSig, paramBootSector->BS_BootSig);
-    printf("BS_VolID= %d | %08x\n", paramBootSector->BS_VolID, paramBootSector->BS_VolID);
+        printOutput("BS_OEMName[%d]= %d | %08x\n", index, paramBootSector->BS_OEMName[index], paramBootSector->BS_OEMName[index]);
+    }
+    printOutput("BPB_BytsPerSec= %d | %08x\n", paramBootSector->BPB_BytsPerSec, paramBootSector->BPB_BytsPerSec);
+    printOutput("BPB_SecPerClus= %d | %08x\n", paramBootSector->BPB_SecPerClus, paramBootSector->BPB_SecPerClus);
+    printOutput("BPB_RsvdSecCnt= %d | %08x\n", paramBootSector->BPB_RsvdSecCnt, paramBootSector->BPB_RsvdSecCnt);
+    printOutput("BPB_NumFATs= %d | %08x\n", paramBootSector->BPB_NumFATs, paramBootSector->BPB_NumFATs);
+    printOutput("BPB_RootEntCnt= %d | %08x\n", paramBootSector->BPB_RootEntCnt, paramBootSector->BPB_RootEntCnt);
+    printOutput("BPB_TotSec16= %d | %08x\n", paramBootSector->BPB_TotSec16, paramBootSector->BPB_TotSec16);
+    printOutput("BPB_Media= %d | %08x\n", paramBootSector->BPB_Media, paramBootSector->BPB_Media);
+    printOutput("BPB_FATSz16= %d | %08x\n", paramBootSector->BPB_FATSz16, paramBootSector->BPB_FATSz16);
+    printOutput("BPB_SecPerTrk= %d | %08x\n", paramBootSector->BPB_SecPerTrk, paramBootSector->BPB_SecPerTrk);
+    printOutput("BPB_NumHeads= %d | %08x\n", paramBootSector->BPB_NumHeads, paramBootSector->BPB_NumHeads);
+    printOutput("BPB_HiddSec= %d | %08x\n", paramBootSector->BPB_HiddSec, paramBootSector->BPB_HiddSec);
+    printOutput("BPB_TotSec32= %d | %08x\n", paramBootSector->BPB_TotSec32, paramBootSector->BPB_TotSec32);
+    printOutput("BS_DrvNum= %d | %08x\n", paramBootSector->BS_DrvNum, paramBootSector->BS_DrvNum);
+    printOutput("BS_Reserved1= %d | %08x\n", paramBootSector->BS_Reserved1, paramBootSector->BS_Reserved1);
+    printOutput("BS_BootSig= %d | %08x\n", paramBootSector->BS_BootSig, paramBootSector->BS_BootSig);
+    printOutput("BS_VolID= %d | %08x\n", paramBootSector->BS_VolID, paramBootSector->BS_VolID);
     for(int index=0; index<11; index++) {
-        printf("BS_VolLab[%d]= %d | %08x\n", index, paramBootSector->BS_VolLab[index], paramBootSector->BS_VolLab[index]);
+        printOutput("BS_VolLab[%d]= %d | %08x\n", index, paramBootSector->BS_VolLab[index], paramBootSector->BS_VolLab[index]);
     }
     for(int index=0; index<8; index++) {
-        printf("BS_FilSysType[%d]= %d | %08x\n", index, paramBootSector->BS_FilSysType[index], paramBootSector->BS_FilSysType[index]);
+        printOutput("BS_FilSysType[%d]= %d | %08x\n", index, paramBootSector->BS_FilSysType[index], paramBootSector->BS_FilSysType[index]);
     }
-    printf("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+    printOutput("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
 }
 
 /**
@@ -482,944 +752,11447 @@ void printBootSector(BootSector *paramBootSector) {
  * @param paramBuffer
  * @return
  */
-ReturnStack *createBootSector(Buffer *paramBuffer) {
-
-    ReturnStack *returnStack = createReturnStack();
-
-    ReturnStack *selectedElements = getBytesFromByteStream(paramBuffer, 0,  sizeof(BootSector));
+BootSector *createBootSector(Buffer *paramBuffer) {
 
     BootSector *bootSector = (BootSector *) malloc(sizeof(BootSector));
-    memcpy(bootSector, ((Buffer *) selectedElements->returnedValue)->bufferPtr, sizeof(BootSector));
-
-    returnStack->returnedValue = bootSector;
+    memcpy(bootSector, paramBuffer->bufferPtr, sizeof(BootSector));
 
-    return returnStack;
+    return bootSector;
 }
 
-/// +--------------------------------------------------------------------------------------------------+
-/// |                                                                                                  |
-/// |                                                FATS                                              |
-/// |                                                                                                  |
-/// +--------------------------------------------------------------------------------------------------+
-
 /*
- * The File allocation tables are stored after the reserved sector, there are usually 2.
- * This reads the first FAT table and ignores the second as it is redundant
- *
- * Starts after the reserved sectors and carries on for the length of the fat table
+ * A FAT32 boot sector shares the first 36 bytes with FAT12 and FAT16, after which it holds the size of the FAT as
+ * 32 bits, the first cluster of the root directory and the sector of the FSInfo structure. The volume label and
+ * file system type move down to make room for them.
  */
 
 /**
- * Returns the next cluster in the list of linked clusters from the FAT
- * @param paramBootSector    - Boot sector of the FAT16 image
- * @param paramBuffer        - Buffer containing the file
- * @param paramClusterNumber - The cluster entry number
- * @return
+ * The FAT32 properties of a boot sector, starting at byte 36
  */
-ReturnStack *getNextClusterFromFat(BootSector *paramBootSector, Buffer *paramBuffer, int paramClusterNumber) {
-
-    const int FAT_ENTRY_SIZE = 2;
-    const int FAT_TABLE_START = paramBootSector->BPB_RsvdSecCnt;
-
-    ReturnStack *returnStack = createReturnStack();
-
-    int numberOfClustersInFat = ((paramBootSector->BPB_FATSz16 * paramBootSector->BPB_BytsPerSec) / FAT_ENTRY_SIZE);
-
-    if(paramClusterNumber > numberOfClustersInFat) {
-        addExceptionToReturnStack(returnStack, EXCEPTION_CLUSTER_OUT_OF_RANGE);
-        return returnStack;
-    }
-
-    Buffer *buffer = getBytesFromByteStream(paramBuffer, (FAT_TABLE_START * paramBootSector->BPB_BytsPerSec) + ((FAT_ENTRY_SIZE) * paramClusterNumber), FAT_ENTRY_SIZE)->returnedValue;
-
-    uint16_t clusterNumber = (256 * (buffer->bufferPtr[1])) + *buffer->bufferPtr;
-
-    setReturnValueToReturnStack(returnStack, clusterNumber);
+struct __attribute__((__packed__)) Fat32BootSector {
+    uint32_t	BPB_FATSz32;			// Sectors in each FAT                      36-39
+    uint16_t	BPB_ExtFlags;			// Bit 7 set when only one FAT is active    40-41
+    uint16_t	BPB_FSVer;			    // Version, should = 0                      42-43
+    uint32_t	BPB_RootClus;			// First cluster of the root directory      44-47
+    uint16_t	BPB_FSInfo;			    // Sector of the FSInfo structure           48-49
+    uint16_t	BPB_BkBootSec;			// Sector of the backup boot sector         50-51
+    uint8_t		BPB_Reserved[ 12 ];		// Should = 0                               52-63
+    uint8_t		BS_DrvNum;			    // 0 = floppy, 0x80 = hard disk             64
+    uint8_t		BS_Reserved1;			//                                          65
+    uint8_t		BS_BootSig;			    // Should = 0x29                            66
+    uint32_t	BS_VolID;			    // 'Unique' ID for volume                   67-70
+    uint8_t		BS_VolLab[ 11 ];		// Non zero terminated string               71-81
+    uint8_t		BS_FilSysType[ 8 ];		// e.g. 'FAT32 ' (Not 0 term.)              82-89
+}; typedef struct Fat32BootSector Fat32BootSector;
+
+#define FAT32_BOOT_SECTOR_START 36
 
-    return returnStack;
+/**
+ * Prints the FAT32 properties of a boot sector
+ * @param paramFat32BootSector - The FAT32 boot sector to be printed
+ */
+void printFat32BootSector(Fat32BootSector *paramFat32BootSector) {
+    printOutput("BPB_FATSz32= %d | %08x\n", paramFat32BootSector->BPB_FATSz32, paramFat32BootSector->BPB_FATSz32);
+    printOutput("BPB_ExtFlags= %d | %08x\n", paramFat32BootSector->BPB_ExtFlags, paramFat32BootSector->BPB_ExtFlags);
+    printOutput("BPB_FSVer= %d | %08x\n", paramFat32BootSector->BPB_FSVer, paramFat32BootSector->BPB_FSVer);
+    printOutput("BPB_RootClus= %d | %08x\n", paramFat32BootSector->BPB_RootClus, paramFat32BootSector->BPB_RootClus);
+    printOutput("BPB_FSInfo= %d | %08x\n", paramFat32BootSector->BPB_FSInfo, paramFat32BootSector->BPB_FSInfo);
+    printOutput("BPB_BkBootSec= %d | %08x\n", paramFat32BootSector->BPB_BkBootSec, paramFat32BootSector->BPB_BkBootSec);
+    printOutput("BS_BootSig= %d | %08x\n", paramFat32BootSector->BS_BootSig, paramFat32BootSector->BS_BootSig);
+    printOutput("BS_VolID= %d | %08x\n", paramFat32BootSector->BS_VolID, paramFat32BootSector->BS_VolID);
+    printOutput("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
 }
 
 /**
- * Gets the number of clusters in the linked list before reaching 0xFF
- * @param paramBootSector    - Boot sector of the FAT16 image
- * @param paramBuffer        - Buffer containing the file
- * @param paramStartCluster  - The first cluster being search
- * @return                   - The number of clusters in the sequence (Will always be 1 or larger)
+ * Copies the FAT32 properties out of the first sector of an image. Only meaningful when BPB_FATSz16 is 0.
+ * @param paramBuffer - A buffer holding at least the first 90 bytes of the image
+ * @return            - The FAT32 boot sector
  */
-ReturnStack *getNumberOfClustersInSequence(BootSector *paramBootSector, Buffer *paramBuffer, int paramStartCluster) {
-
-    ReturnStack *returnStack = createReturnStack();
+Fat32BootSector *createFat32BootSector(Buffer *paramBuffer) {
+    Fat32BootSector *fat32BootSector = (Fat32BootSector *) malloc(sizeof(Fat32BootSector));
+    memcpy(fat32BootSector, paramBuffer->bufferPtr + FAT32_BOOT_SECTOR_START, sizeof(Fat32BootSector));
+    return fat32BootSector;
+}
 
-    int currentCluster = paramStartCluster;
-    int numberOfClusters = 0;
+/**
+ * The FSInfo sector of a FAT32 image, holding hints for the number of free clusters and where to look for one
+ */
+struct __attribute__((__packed__)) FsInfo {
+    uint32_t	FSI_LeadSig;			// Should = 0x41615252                      0-3
+    uint8_t		FSI_Reserved1[ 480 ];	//                                          4-483
+    uint32_t	FSI_StrucSig;			// Should = 0x61417272                      484-487
+    uint32_t	FSI_Free_Count;			// Free clusters, 0xFFFFFFFF when unknown   488-491
+    uint32_t	FSI_Nxt_Free;			// Where to start looking for a free one    492-495
+    uint8_t		FSI_Reserved2[ 12 ];	//                                          496-507
+    uint32_t	FSI_TrailSig;			// Should = 0xAA550000                      508-511
+}; typedef struct FsInfo FsInfo;
+
+#define FSINFO_LEAD_SIGNATURE 0x41615252
+#define FSINFO_STRUCTURE_SIGNATURE 0x61417272
+#define FSINFO_UNKNOWN 0xFFFFFFFF
 
-    while(currentCluster != 0xFFFF) {
-        numberOfClusters++;
-        currentCluster = getNextClusterFromFat(paramBootSector, paramBuffer, currentCluster)->returnedValue;
+/**
+ * Gets the number of sectors in each FAT
+ * @param paramBootSector      - The boot sector of the image
+ * @param paramFat32BootSector - The FAT32 properties of the boot sector, NULL when BPB_FATSz16 is not 0
+ * @return                     - BPB_FATSz16 or BPB_FATSz32 when that is 0
+ */
+long getSectorsPerFat(BootSector *paramBootSector, Fat32BootSector *paramFat32BootSector) {
+    if(paramBootSector->BPB_FATSz16 != 0 || paramFat32BootSector == NULL) {
+        return paramBootSector->BPB_FATSz16;
     }
-
-    setReturnValueToReturnStack(returnStack, numberOfClusters);
-
-    return returnStack;
+    return paramFat32BootSector->BPB_FATSz32;
 }
 
 /// +--------------------------------------------------------------------------------------------------+
 /// |                                                                                                  |
-/// |                                           Directory                                              |
+/// |                                        Compressed Images                                         |
 /// |                                                                                                  |
 /// +--------------------------------------------------------------------------------------------------+
 
 /*
- * Directories are the folders within fat image.
- * Each entry is either a folder or file within the directory
+ * A compressed image is a container holding an image as fixed size chunks, each compressed with zlib on its own,
+ * followed by an index giving where each chunk starts. Any byte of the image can be reached by inflating the one
+ * chunk holding it, so an archived image can be listed or searched without inflating the whole of it. Chunks that
+ * are all zeros, such as free clusters, are only marked in the index and take no space.
+ *
+ * A compressed image is always read through a block cache. The cache fills each block it misses from a small cache
+ * of inflated chunks instead of from the file, and only ever asks for a chunk while it holds its own lock, so the
+ * chunk cache needs no lock of its own.
  */
 
+#define CHUNKED_IMAGE_MAGIC "FAT16CZ1"
+#define CHUNKED_IMAGE_DEFAULT_CHUNK_SIZE (64 * 1024)
+#define CHUNKED_IMAGE_MAXIMUM_CHUNK_SIZE (16 * 1024 * 1024)
+#define CHUNKED_IMAGE_CACHE_CHUNKS 16
+#define CHUNKED_IMAGE_DEFAULT_CACHE_BYTES (16L * 1024 * 1024)      // Budget of the block cache for a compressed image
+
 /**
- * An entry is a 32 byte entry from a directory, this holds all of the standard values but not longer names
+ * The header at the start of a compressed image
  */
-struct __attribute__((__packed__)) Entry {
-    uint8_t         DIR_Name[ 11 ];         // Non zero terminated string
-    uint8_t         DIR_Attr;               // File attributes
-    uint8_t         DIR_NTRes;              // Used by Windows NT, ignore
-    uint8_t         DIR_CrtTimeTenth;       // Tenths of sec. 0...199
-    uint16_t        DIR_CrtTime;            // Creation Time in 2s intervals
-    uint16_t        DIR_CrtDate;            // Date file created
-    uint16_t        DIR_LstAccDate;         // Date of last read or write
-    uint16_t        DIR_FstClusHI;          // Top 16 bits file's 1st cluster
-    uint16_t        DIR_WrtTime;            // Time of last write
-    uint16_t        DIR_WrtDate;            // Date of last write
-    uint16_t        DIR_FstClusLO;          // Lower 16 bits file's 1st cluster
-    uint32_t        DIR_FileSize;           // File size in bytes
-}; typedef struct Entry Entry;
+struct __attribute__((__packed__)) ChunkedImageHeader {
+    uint8_t     magic[ 8 ];             // CHUNKED_IMAGE_MAGIC
+    uint32_t    chunkSize;              // Bytes of the image in each chunk, the last chunk may hold fewer
+    uint32_t    numberOfChunks;
+    uint64_t    imageSize;              // Bytes in the image once inflated
+    uint64_t    indexOffset;            // Where the index starts, after the last chunk
+
+}; typedef struct ChunkedImageHeader ChunkedImageHeader;
 
 /**
- * Print values stored within an entry
- * @param paramEntry
+ * An entry of the index of a compressed image, one for each chunk
  */
-void printEntry(Entry *paramEntry) {
-    printf("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
-    for(int index=0; index<11; index++) {
-        printf("DIR_Name[%d]= %d | %08x\n", index, paramEntry->DIR_Name[index], paramEntry->DIR_Name[index]);
-    }
-    printf("DIR_Attr= %d | %08x\n", paramEntry->DIR_Attr, paramEntry->DIR_Attr);
-    printf("DIR_NTRes= %d | %08x\n", paramEntry->DIR_NTRes, paramEntry->DIR_NTRes);
-    printf("DIR_CrtTimeTenth= %d | %08x\n", paramEntry->DIR_CrtTimeTenth, paramEntry->DIR_CrtTimeTenth);
-    printf("DIR_CrtTime= %d | %08x\n", paramEntry->DIR_CrtTime, paramEntry->DIR_CrtTime);
-    printf("DIR_CrtDate= %d | %08x\n", paramEntry->DIR_CrtDate, paramEntry->DIR_CrtDate);
-    printf("DIR_LstAccDate= %d | %08x\n", paramEntry->DIR_LstAccDate, paramEntry->DIR_LstAccDate);
-    printf("DIR_FstClusHI= %d | %08x\n", paramEntry->DIR_FstClusHI, paramEntry->DIR_FstClusHI);
-    printf("DIR_WrtTime= %d | %08x\n", paramEntry->DIR_WrtTime, paramEntry->DIR_WrtTime);
-    printf("DIR_WrtDate= %d | %08x\n", paramEntry->DIR_WrtDate, paramEntry->DIR_WrtDate);
-    printf("DIR_FstClusLO= %d | %08x\n", paramEntry->DIR_FstClusLO, paramEntry->DIR_FstClusLO);
-    printf("DIR_FileSize= %d | %08x\n", paramEntry->DIR_FileSize, paramEntry->DIR_FileSize);
-    printf("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
-}
+struct __attribute__((__packed__)) ChunkIndexEntry {
+    uint64_t    offset;                 // Where the compressed chunk starts in the container
+    uint32_t    compressedLength;       // 0 when every byte of the chunk is 0 and nothing is stored
+
+}; typedef struct ChunkIndexEntry ChunkIndexEntry;
 
 /**
- * Creates an entry from a buffer and a start location
- * @param paramBuffer       - The buffer for the entry to be copied from
- * @param paramEntryStart   - The first byte of the entry in the buffer
- * @return
+ * A chunk slot holds one inflated chunk of a compressed image
  */
-ReturnStack *createEntry(Buffer *paramBuffer, int paramEntryStart) {
+struct ChunkSlot {
+    long chunkNumber;                   // -1 when unused
+    long lastUsed;                      // The use counter of the image when the chunk was last asked for
+    unsigned char *bytes;
 
-    ReturnStack *returnStack = createReturnStack();
+}; typedef struct ChunkSlot ChunkSlot;
 
-    ReturnStack *selectedElements = getBytesFromByteStream(paramBuffer, paramEntryStart,  sizeof(Entry));
+/**
+ * A chunked image reads a compressed image through its index and a cache of inflated chunks
+ */
+struct ChunkedImage {
+    int fileDescriptor;                 // The container, owned by the block cache reading it
+    long chunkSize;
+    int numberOfChunks;
+    long imageSize;
+    ChunkIndexEntry *index;
+    unsigned char *compressedBytes;     // Holds the largest compressed chunk
 
-    Entry *entry = (Entry *) malloc(sizeof(Entry));
-    memcpy(entry, ((Buffer *) selectedElements->returnedValue)->bufferPtr, sizeof(Entry));
+    ChunkSlot slots[CHUNKED_IMAGE_CACHE_CHUNKS];
+    long useCounter;
 
-    returnStack->returnedValue = entry;
+    long chunkHits;
+    long chunksInflated;
+    long chunksZero;                    // Chunks asked for that were all zeros and had nothing to inflate
+    long chunksCorrupt;                 // Chunks that failed to inflate, read as zeros
 
-    return returnStack;
-}
+}; typedef struct ChunkedImage ChunkedImage;
 
 /**
- * Entry attributes makes the values within the Entry-Attribute value accessible
+ * Checks whether a file is a compressed image
+ * @param paramFileDescriptor - The file opened for reading
+ * @return                    - 1 if the file starts with CHUNKED_IMAGE_MAGIC
  */
-struct __attribute__((__packed__)) EntryAttributes {
-    uint8_t archive;
-    uint8_t directory;
-    uint8_t volume_name;
-    uint8_t system;
-    uint8_t hidden;
-    uint8_t read_only;
-
-    uint8_t is_file;
+uint8_t isChunkedImage(int paramFileDescriptor) {
+    uint8_t magic[8];
+    return pread(paramFileDescriptor, magic, sizeof(magic), 0) == sizeof(magic) && memcmp(magic, CHUNKED_IMAGE_MAGIC, sizeof(magic)) == 0;
+}
 
-}; typedef struct EntryAttributes EntryAttributes;
+/**
+ * Checks whether the file at a location is a compressed image
+ * @param paramImageLocation - The location of the file
+ * @return                   - 1 if the file exists and is a compressed image
+ */
+uint8_t isChunkedImageLocation(char *paramImageLocation) {
+    int fileDescriptor = open(paramImageLocation, O_RDONLY);
+    if(fileDescriptor < 0) {
+        return 0;
+    }
+    uint8_t is_chunked = isChunkedImage(fileDescriptor);
+    close(fileDescriptor);
+    return is_chunked;
+}
 
 /**
- * Prints the entries attribute
- * @param paramEntryAttributes - Attributes to be printed
+ * Frees a chunked image, leaving its container open
+ * @param paramChunkedImage - The chunked image being freed
  */
-void printEntryAttributes(EntryAttributes *paramEntryAttributes) {
-    printf("archive= %d\n", paramEntryAttributes->archive);
-    printf("directory= %d\n", paramEntryAttributes->directory);
-    printf("volume_name= %d\n", paramEntryAttributes->volume_name);
-    printf("system= %d\n", paramEntryAttributes->system);
-    printf("hidden= %d\n", paramEntryAttributes->hidden);
-    printf("read_only= %d\n", paramEntryAttributes->read_only);
-    printf("is_file= %d\n", paramEntryAttributes->is_file);
+void freeChunkedImage(ChunkedImage *paramChunkedImage) {
+    for(int slot = 0; slot < CHUNKED_IMAGE_CACHE_CHUNKS; slot++) {
+        free(paramChunkedImage->slots[slot].bytes);
+    }
+    free(paramChunkedImage->index);
+    free(paramChunkedImage->compressedBytes);
+    free(paramChunkedImage);
 }
 
 /**
- * Creates the entries attributes
- * @param paramEntry - Entry for the entry attributes to be based off
- * @return           - Returns the entry attributes
+ * Reads the header and index of a compressed image, checking every chunk lies inside the container
+ * @param paramFileDescriptor - The container opened for reading
+ * @param paramChunkedImage   - Set to the chunked image
+ * @return                    - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
  */
-ReturnStack *createEntryAttributes(Entry *paramEntry) {
+int openChunkedImage(int paramFileDescriptor, ChunkedImage **paramChunkedImage) {
+
+#if defined(FAT16_ZLIB)
+    ChunkedImageHeader header;
+    struct stat fileStatus;
+    if(pread(paramFileDescriptor, &header, sizeof(header), 0) != sizeof(header) || fstat(paramFileDescriptor, &fileStatus) != 0 ||
+       memcmp(header.magic, CHUNKED_IMAGE_MAGIC, sizeof(header.magic)) != 0 || header.chunkSize == 0 || header.chunkSize > CHUNKED_IMAGE_MAXIMUM_CHUNK_SIZE ||
+       header.numberOfChunks != (header.imageSize + header.chunkSize - 1) / header.chunkSize ||
+       header.indexOffset + (uint64_t) header.numberOfChunks * sizeof(ChunkIndexEntry) > (uint64_t) fileStatus.st_size) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    ChunkedImage *chunkedImage = (ChunkedImage *) calloc(1, sizeof(ChunkedImage));
+    chunkedImage->fileDescriptor = paramFileDescriptor;
+    chunkedImage->chunkSize = header.chunkSize;
+    chunkedImage->numberOfChunks = (int) header.numberOfChunks;
+    chunkedImage->imageSize = (long) header.imageSize;
+
+    size_t indexLength = sizeof(ChunkIndexEntry) * header.numberOfChunks;
+    chunkedImage->index = (ChunkIndexEntry *) malloc(indexLength + 1);
+    uint8_t is_valid = pread(paramFileDescriptor, chunkedImage->index, indexLength, (off_t) header.indexOffset) == (ssize_t) indexLength;
+
+    long maximumCompressedLength = 0;
+    for(int chunk = 0; chunk < chunkedImage->numberOfChunks && is_valid; chunk++) {
+        ChunkIndexEntry *entry = chunkedImage->index + chunk;
+        is_valid = entry->offset + entry->compressedLength <= header.indexOffset;
+        maximumCompressedLength = entry->compressedLength > maximumCompressedLength ? entry->compressedLength : maximumCompressedLength;
+    }
+    if(!is_valid) {
+        freeChunkedImage(chunkedImage);
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
 
-    ReturnStack *returnStack = createReturnStack();
+    chunkedImage->compressedBytes = (unsigned char *) malloc(maximumCompressedLength + 1);
+    for(int slot = 0; slot < CHUNKED_IMAGE_CACHE_CHUNKS; slot++) {
+        chunkedImage->slots[slot].chunkNumber = -1;
+    }
 
-    EntryAttributes *entryAttributes = (EntryAttributes *) malloc(sizeof(EntryAttributes));
+    *paramChunkedImage = chunkedImage;
+    return EXCEPTION_NONE;
+#else
+    (void) paramFileDescriptor;
+    (void) paramChunkedImage;
+    return EXCEPTION_UNABLE_TO_OPEN_FILE;                   // Built without zlib
+#endif
+}
 
-    entryAttributes->read_only = ((int)paramEntry->DIR_Attr & 0x01);
-    entryAttributes->hidden =  ((int)paramEntry->DIR_Attr & 0x02) >> 1;
-    entryAttributes->system =  ((int)paramEntry->DIR_Attr & 0x04) >> 2;
-    entryAttributes->volume_name =  ((int)paramEntry->DIR_Attr & 0x08) >> 3;
-    entryAttributes->directory =  ((int)paramEntry->DIR_Attr & 0x10) >> 4;
-    entryAttributes->archive =  ((int)paramEntry->DIR_Attr & 0x20) >> 5;
+/**
+ * Gets the inflated bytes of a chunk, inflating it into the least recently used slot when it is not held. A chunk
+ * that cannot be read or fails to inflate is read as zeros.
+ * @param paramChunkedImage - The chunked image
+ * @param paramChunkNumber  - The chunk
+ * @return                  - chunkSize bytes, valid until another chunk is asked for
+ */
+const unsigned char *getChunk(ChunkedImage *paramChunkedImage, long paramChunkNumber) {
 
-    entryAttributes->is_file = (!entryAttributes->directory & !entryAttributes->volume_name);
+    paramChunkedImage->useCounter++;
+
+    int leastRecentSlot = 0;
+    for(int slot = 0; slot < CHUNKED_IMAGE_CACHE_CHUNKS; slot++) {
+        ChunkSlot *chunkSlot = paramChunkedImage->slots + slot;
+        if(chunkSlot->chunkNumber == paramChunkNumber) {
+            chunkSlot->lastUsed = paramChunkedImage->useCounter;
+            paramChunkedImage->chunkHits++;
+            return chunkSlot->bytes;
+        }
+        if(chunkSlot->lastUsed < paramChunkedImage->slots[leastRecentSlot].lastUsed) {
+            leastRecentSlot = slot;
+        }
+    }
 
-    setReturnValueToReturnStack(returnStack, entryAttributes);
+    ChunkSlot *chunkSlot = paramChunkedImage->slots + leastRecentSlot;
+    if(chunkSlot->bytes == NULL) {
+        chunkSlot->bytes = (unsigned char *) malloc(paramChunkedImage->chunkSize);
+    }
+    chunkSlot->chunkNumber = paramChunkNumber;
+    chunkSlot->lastUsed = paramChunkedImage->useCounter;
+
+    ChunkIndexEntry *entry = paramChunkedImage->index + paramChunkNumber;
+    if(entry->compressedLength == 0) {
+        memset(chunkSlot->bytes, 0, paramChunkedImage->chunkSize);
+        paramChunkedImage->chunksZero++;
+        return chunkSlot->bytes;
+    }
 
-    return returnStack;
+    uint8_t is_inflated = 0;
+#if defined(FAT16_ZLIB)
+    uLongf inflatedLength = (uLongf) paramChunkedImage->chunkSize;
+    is_inflated = pread(paramChunkedImage->fileDescriptor, paramChunkedImage->compressedBytes, entry->compressedLength, (off_t) entry->offset) == (ssize_t) entry->compressedLength &&
+                  uncompress(chunkSlot->bytes, &inflatedLength, paramChunkedImage->compressedBytes, entry->compressedLength) == Z_OK;
+    memset(chunkSlot->bytes + (is_inflated ? inflatedLength : 0), 0, paramChunkedImage->chunkSize - (is_inflated ? inflatedLength : 0));
+#endif
+
+    paramChunkedImage->chunksInflated += is_inflated;
+    paramChunkedImage->chunksCorrupt += !is_inflated;
+    return chunkSlot->bytes;
 }
 
 /**
- * A Long File Name is a 32 byte array that contains values used in a Long File Name entry in the directory
+ * Copies bytes of the image held in a compressed image
+ * @param paramChunkedImage - The chunked image
+ * @param paramOffset       - The first byte of the image being copied
+ * @param paramBytes        - Where the bytes are copied to
+ * @param paramLength       - The number of bytes
+ * @return                  - The number of bytes copied, fewer than asked for past the end of the image
  */
-struct __attribute__((__packed__)) LongFileNameEntry {
-    uint8_t         LDIR_Ord;               // Order/ position in sequence/ set
-    uint8_t         LDIR_Name1[ 10 ];       // First 5 UNICODE characters
-    uint8_t         LDIR_Attr;              // = ATTR_LONG_NAME (xx001111)
-    uint8_t         LDIR_Type;              // Should = 0
-    uint8_t         LDIR_Chksum;            // Checksum of short name
-    uint8_t         LDIR_Name2[ 12 ];       // Middle 6 UNICODE characters
-    uint16_t        LDIR_FstClusLO;         // MUST be zero
-    uint8_t         LDIR_Name3[ 4 ];        // Last 2 UNICODE characters
-}; typedef struct LongFileNameEntry LongFileNameEntry;
+long readChunkedBytes(ChunkedImage *paramChunkedImage, long paramOffset, unsigned char *paramBytes, long paramLength) {
+
+    long bytesCopied = 0;
+    while(bytesCopied < paramLength && paramOffset + bytesCopied < paramChunkedImage->imageSize) {
+        long offset = paramOffset + bytesCopied;
+        long chunkOffset = offset % paramChunkedImage->chunkSize;
+        long length = paramChunkedImage->chunkSize - chunkOffset;
+        length = length < paramLength - bytesCopied ? length : paramLength - bytesCopied;
+        length = length < paramChunkedImage->imageSize - offset ? length : paramChunkedImage->imageSize - offset;
+
+        memcpy(paramBytes + bytesCopied, getChunk(paramChunkedImage, offset / paramChunkedImage->chunkSize) + chunkOffset, length);
+        bytesCopied += length;
+    }
+    return bytesCopied;
+}
 
 /**
- * Creates a long file name entry from a buffer
- * @param paramBuffer       - Buffer holding the binary entry of the long file name
- * @param paramEntryStart   - The first byte of the long file name entry
- * @return
+ * Prints the chunk counters of a compressed image to standard error so they do not mix with the output
+ * @param paramChunkedImage - The chunked image
  */
-ReturnStack *createLongFileNameEntry(Buffer *paramBuffer, int paramEntryStart) {
+void printChunkedImageStatistics(ChunkedImage *paramChunkedImage) {
+    fprintf(stderr, "Chunks: %d of %ld bytes, %ld inflated, %ld zero, %ld hits, %ld corrupt\n", paramChunkedImage->numberOfChunks,
+            paramChunkedImage->chunkSize, paramChunkedImage->chunksInflated, paramChunkedImage->chunksZero, paramChunkedImage->chunkHits,
+            paramChunkedImage->chunksCorrupt);
+}
 
-    ReturnStack *returnStack = createReturnStack();
+/**
+ * Writes a compressed image of a raw image, compressing each chunk on its own and leaving out the chunks that are all
+ * zeros. The header is written last so a container cut short is never mistaken for a whole one.
+ * @param paramImageLocation     - The raw image
+ * @param paramContainerLocation - Where the compressed image is written, replacing any file there
+ * @param paramChunkSize         - Bytes of the image in each chunk, 0 for CHUNKED_IMAGE_DEFAULT_CHUNK_SIZE
+ * @return                       - EXCEPTION_NONE, EXCEPTION_UNABLE_TO_OPEN_FILE or EXCEPTION_UNABLE_TO_WRITE_FILE
+ */
+int compressImage(char *paramImageLocation, char *paramContainerLocation, long paramChunkSize) {
 
-    ReturnStack *selectedElements = getBytesFromByteStream(paramBuffer, paramEntryStart,  sizeof(LongFileNameEntry));
+#if defined(FAT16_ZLIB)
+    long chunkSize = paramChunkSize > 0 ? paramChunkSize : CHUNKED_IMAGE_DEFAULT_CHUNK_SIZE;
+    if(chunkSize > CHUNKED_IMAGE_MAXIMUM_CHUNK_SIZE) {
+        return EXCEPTION_PROGRAM_ARGUMENTS;
+    }
 
-    LongFileNameEntry *longFileNameEntry = (LongFileNameEntry *) malloc(sizeof(LongFileNameEntry));
-    memcpy(longFileNameEntry, ((Buffer *) selectedElements->returnedValue)->bufferPtr, sizeof(LongFileNameEntry));
+    int source = open(paramImageLocation, O_RDONLY);
+    if(source < 0) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+    struct stat fileStatus;
+    fstat(source, &fileStatus);
+    posix_fadvise(source, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    int destination = open(paramContainerLocation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(destination < 0) {
+        close(source);
+        return EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
 
-    returnStack->returnedValue = longFileNameEntry;
+    ChunkedImageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.chunkSize = (uint32_t) chunkSize;
+    header.imageSize = (uint64_t) fileStatus.st_size;
+    header.numberOfChunks = (uint32_t) ((header.imageSize + chunkSize - 1) / chunkSize);
 
-    return returnStack;
-}
+    ChunkIndexEntry *index = (ChunkIndexEntry *) calloc(header.numberOfChunks + 1, sizeof(ChunkIndexEntry));
+    unsigned char *chunkBytes = (unsigned char *) malloc(chunkSize);
+    uLong compressedCapacity = compressBound((uLong) chunkSize);
+    unsigned char *compressedBytes = (unsigned char *) malloc(compressedCapacity);
 
-/**
- * A directory entry stores the filename long or short of the file / directory and the entry
- */
-struct __attribute__((__packed__)) DirectoryEntry {
-    Entry *entry;
-    EntryAttributes *entryAttributes;
-    wchar_t *longFileName;
-    int fileNameSize;
+    int exception = EXCEPTION_NONE;
+    long containerOffset = sizeof(ChunkedImageHeader);
+    int numberOfZeroChunks = 0;
 
-}; typedef struct DirectoryEntry DirectoryEntry;
+    for(uint32_t chunk = 0; chunk < header.numberOfChunks && exception == EXCEPTION_NONE; chunk++) {
+        long offset = (long) chunk * chunkSize;
+        long length = (long) header.imageSize - offset < chunkSize ? (long) header.imageSize - offset : chunkSize;
 
-/**
- * Prints the long file name from the directory entry
- * @param paramDirectoryEntry - The entry containing the file name to be printed
- * @param paramIndentSize     - The ident size
- */
-void printLongFileName(DirectoryEntry *paramDirectoryEntry, int paramIndentSize) {
+        if(pread(source, chunkBytes, length, offset) != length) {
+            exception = EXCEPTION_UNABLE_TO_OPEN_FILE;
+            break;
+        }
+        if(isZeroBytes(chunkBytes, length)) {
+            numberOfZeroChunks++;
+            continue;
+        }
 
-    printIndent(paramIndentSize);
+        uLongf compressedLength = compressedCapacity;
+        if(compress2(compressedBytes, &compressedLength, chunkBytes, (uLong) length, Z_DEFAULT_COMPRESSION) != Z_OK ||
+           pwrite(destination, compressedBytes, compressedLength, containerOffset) != (ssize_t) compressedLength) {
+            exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+            break;
+        }
 
-    for(int index = 0; index < paramDirectoryEntry->fileNameSize; index++) {
-        printf("%c", paramDirectoryEntry->longFileName[index]);
+        index[chunk].offset = (uint64_t) containerOffset;
+        index[chunk].compressedLength = (uint32_t) compressedLength;
+        containerOffset += (long) compressedLength;
     }
-    printf("\n");
-}
 
-/**
- * Prints the date to console
- * @param paramDate         - date value from directory entry
- * @param paramIndentSize   - number of spaces before printed
- */
-void print16BitDate(uint16_t paramDate, int paramIndentSize) {
+    header.indexOffset = (uint64_t) containerOffset;
+    size_t indexLength = sizeof(ChunkIndexEntry) * header.numberOfChunks;
+    memcpy(header.magic, CHUNKED_IMAGE_MAGIC, sizeof(header.magic));
 
-    int year = 1980;
+    if(exception == EXCEPTION_NONE && (pwrite(destination, index, indexLength, containerOffset) != (ssize_t) indexLength || fdatasync(destination) != 0 ||
+                                       pwrite(destination, &header, sizeof(header), 0) != sizeof(header) || fdatasync(destination) != 0)) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
 
-    year += (((long) paramDate & 0x0200) >> 9);
-    year += (((long) paramDate & 0x0400) >> 10) * 2;
-    year += (((long) paramDate & 0x0800) >> 11) * 4;
-    year += (((long) paramDate & 0x1000) >> 12) * 8;
-    year += (((long) paramDate & 0x2000) >> 13) * 16;
-    year += (((long) paramDate & 0x4000) >> 14) * 32;
-    year += (((long) paramDate & 0x8000) >> 15) * 64;
+    if(exception == EXCEPTION_NONE) {
+        long containerSize = containerOffset + (long) indexLength;
+        printOutput("Compressed %ld bytes into %ld bytes (%.2f%%), %u chunks of %ld bytes, %d all zeros\n", (long) header.imageSize, containerSize,
+                    header.imageSize == 0 ? 0.0 : (100.0 * containerSize) / header.imageSize, header.numberOfChunks, chunkSize, numberOfZeroChunks);
+    }
 
-    int month = 0;
+    free(index);
+    free(chunkBytes);
+    free(compressedBytes);
+    close(source);
+    if(close(destination) != 0 && exception == EXCEPTION_NONE) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+    return exception;
+#else
+    (void) paramImageLocation;
+    (void) paramContainerLocation;
+    (void) paramChunkSize;
+    return EXCEPTION_UNABLE_TO_WRITE_FILE;                  // Built without zlib
+#endif
+}
 
-    month += (((long) paramDate & 0x0020) >> 5);
-    month += (((long) paramDate & 0x0040) >> 6) * 2;
-    month += (((long) paramDate & 0x0080) >> 7) * 4;
-    month += (((long) paramDate & 0x0100) >> 8) * 8;
 
-    int day = 0;
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                           Block Cache                                            |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
 
-    day += (((long) paramDate & 0x0001));
-    day += (((long) paramDate & 0x0002) >> 1) * 2;
-    day += (((long) paramDate & 0x0004) >> 2) * 4;
-    day += (((long) paramDate & 0x0008) >> 3) * 8;
-    day += (((long) paramDate & 0x0010) >> 4) * 16;
+/*
+ * A volume opened with a memory budget does not read its image into memory. Instead the image is read in blocks
+ * that are kept in a least recently used cache of a fixed size. Blocks holding the FAT are kept on their own list
+ * and are only evicted once no data blocks are left, as every step along a chain needs them again.
+ */
 
+#define CACHE_BLOCK_SIZE 4096
+#define CACHE_MINIMUM_BLOCKS 16
+#define CACHE_MAXIMUM_READ (256 * 1024)
 
-    printIndent(paramIndentSize);
-    printf("%2d/%2d/%d\n", day, month, year);
+#define CACHE_PRIORITY_DATA 0
+#define CACHE_PRIORITY_FAT 1
 
-}
+/**
+ * A cache block holds one block of the image, linked into the list of its priority and a hash bucket
+ */
+struct CacheBlock {
+    long blockNumber;           // The block of the image held, -1 when unused
+    uint8_t priority;           // CACHE_PRIORITY_DATA or CACHE_PRIORITY_FAT
+    int previous;               // The more recently used block of the same priority, -1 at the head
+    int next;                   // The less recently used block of the same priority, -1 at the tail
+    int hashNext;               // The next block in the same hash bucket, -1 at the end
+    unsigned char *bytes;       // The bytes of the block
+
+}; typedef struct CacheBlock CacheBlock;
 
 /**
- * Prints the time hour to console
- * @param paramTime         - time value from directory entry
- * @param paramIndentSize   - number of spaces before printed
+ * The block cache holds the blocks of an image most recently read
  */
-void print16BitTimeHour(uint16_t paramTime, int paramIndentSize) {
+struct BlockCache {
+    int fileDescriptor;                 // The image being read
+    int blockSize;                      // Bytes in each block, a multiple of the sector size
+    int numberOfBlocks;                 // Number of blocks the budget allows
+    int numberOfUsedBlocks;             // Number of blocks that have held part of the image
 
-    int hours = 0;
+    CacheBlock *blocks;
+    unsigned char *blockBytes;          // The bytes of every block in one allocation
+    int *hashBuckets;                   // First block in each bucket, -1 when empty
+    int numberOfHashBuckets;            // A power of 2
 
-    hours += (((long) paramTime & 0x0800) >> 11);
-    hours += (((long) paramTime & 0x1000) >> 12) * 2;
-    hours += (((long) paramTime & 0x2000) >> 13) * 4;
-    hours += (((long) paramTime & 0x4000) >> 14) * 8;
-    hours += (((long) paramTime & 0x8000) >> 15) * 16;
+    int head[2];                        // Most recently used block of each priority
+    int tail[2];                        // Least recently used block of each priority
+    long fatStartBlock;                 // First block holding part of a FAT
+    long fatEndBlock;                   // Last block holding part of a FAT
 
-    printIndent(paramIndentSize);
-    printf("%d\n", hours);
+    long hits;
+    long misses;
+    long evictions;
+    long fatEvictions;
 
-}
+    pthread_mutex_t lock;               // Held while a block is found, read or copied
+    ChunkedImage *chunkedImage;         // Where blocks are read from when the image is compressed, NULL otherwise
+
+}; typedef struct BlockCache BlockCache;
 
 /**
- * Prints the time minutes to console
- * @param paramTime         - time value from directory entry
- * @param paramIndentSize   - number of spaces before printed
+ * Creates a block cache for an image
+ * @param paramFileDescriptor - The image opened for reading
+ * @param paramBootSector     - The boot sector of the image
+ * @param paramSectorsPerFat  - The number of sectors in each FAT
+ * @param paramCacheBytes     - The number of bytes the blocks may use
+ * @return                    - The block cache with no blocks read
  */
-void print16BitTimeMinute(uint16_t paramTime, int paramIndentSize) {
+BlockCache *createBlockCache(int paramFileDescriptor, BootSector *paramBootSector, long paramSectorsPerFat, long paramCacheBytes) {
 
-    int minutes = 0;
+    BlockCache *blockCache = (BlockCache *) calloc(1, sizeof(BlockCache));
+    blockCache->fileDescriptor = paramFileDescriptor;
 
-    minutes += (((long) paramTime & 0x0020) >> 5);
-    minutes += (((long) paramTime & 0x0040) >> 6) * 2;
-    minutes += (((long) paramTime & 0x0080) >> 7) * 4;
-    minutes += (((long) paramTime & 0x0100) >> 8) * 8;
-    minutes += (((long) paramTime & 0x0200) >> 9) * 16;
-    minutes += (((long) paramTime & 0x0400) >> 10) * 32;
+    int bytesPerSector = paramBootSector->BPB_BytsPerSec;
+    blockCache->blockSize = CACHE_BLOCK_SIZE < bytesPerSector ? bytesPerSector : CACHE_BLOCK_SIZE - (CACHE_BLOCK_SIZE % bytesPerSector);
 
-    printIndent(paramIndentSize);
-    printf("%d\n", minutes);
+    long numberOfBlocks = paramCacheBytes / blockCache->blockSize;
+    blockCache->numberOfBlocks = numberOfBlocks < CACHE_MINIMUM_BLOCKS ? CACHE_MINIMUM_BLOCKS : (int) numberOfBlocks;
 
-}
+    blockCache->numberOfHashBuckets = 1;
+    while(blockCache->numberOfHashBuckets < blockCache->numberOfBlocks * 2) {
+        blockCache->numberOfHashBuckets *= 2;
+    }
 
-/**
- * Prints the time within 2 seconds to the console
- * @param paramTime         - time value from directory entry
- * @param paramIndentSize   - number of spaces before printed
- */
-void print16BitTime2Seconds(uint16_t paramTime, int paramIndentSize) {
+    blockCache->blocks = (CacheBlock *) malloc(sizeof(CacheBlock) * blockCache->numberOfBlocks);
+    blockCache->blockBytes = (unsigned char *) malloc((size_t) blockCache->numberOfBlocks * blockCache->blockSize);
+    blockCache->hashBuckets = (int *) malloc(sizeof(int) * blockCache->numberOfHashBuckets);
 
-    int seconds = 0;
+    for(int index = 0; index < blockCache->numberOfBlocks; index++) {
+        blockCache->blocks[index].blockNumber = -1;
+        blockCache->blocks[index].bytes = blockCache->blockBytes + (size_t) index * blockCache->blockSize;
+    }
+    for(int index = 0; index < blockCache->numberOfHashBuckets; index++) {
+        blockCache->hashBuckets[index] = -1;
+    }
+    for(int priority = 0; priority < 2; priority++) {
+        blockCache->head[priority] = -1;
+        blockCache->tail[priority] = -1;
+    }
 
-    seconds += (((long) paramTime & 0x0001));
-    seconds += (((long) paramTime & 0x0002) >> 1) * 2;
-    seconds += (((long) paramTime & 0x0004) >> 2) * 4;
-    seconds += (((long) paramTime & 0x0008) >> 3) * 8;
-    seconds += (((long) paramTime & 0x0010) >> 4) * 16;
+    long fatStart = (long) paramBootSector->BPB_RsvdSecCnt * bytesPerSector;
+    long fatEnd = fatStart + (long) paramBootSector->BPB_NumFATs * paramSectorsPerFat * bytesPerSector - 1;
+    blockCache->fatStartBlock = fatStart / blockCache->blockSize;
+    blockCache->fatEndBlock = fatEnd / blockCache->blockSize;
 
-    printIndent(paramIndentSize);
-    printf("%d\n", seconds * 2);
+    pthread_mutex_init(&blockCache->lock, NULL);
 
+    return blockCache;
 }
 
 /**
- * Prints the seconds to 2dp
- * @param paramTime         - time value from directory entry
- * @param paramTenths       - numbers of tenths of seconds
- * @param paramIndentSize   - number of spaces before printed
+ * Frees a block cache and closes its image
+ * @param paramBlockCache - The block cache being freed
  */
-void printTimeTenthSeconds(uint16_t paramTime, uint8_t paramTenths, int paramIndentSize) {
-
-    double seconds = 0;
+void freeBlockCache(BlockCache *paramBlockCache) {
+    pthread_mutex_destroy(&paramBlockCache->lock);
+    if(paramBlockCache->chunkedImage != NULL) {
+        freeChunkedImage(paramBlockCache->chunkedImage);
+    }
+    close(paramBlockCache->fileDescriptor);
+    free(paramBlockCache->blocks);
+    free(paramBlockCache->blockBytes);
+    free(paramBlockCache->hashBuckets);
+    free(paramBlockCache);
+}
 
-    seconds += (((long) paramTime & 0x0001));
-    seconds += (((long) paramTime & 0x0002) >> 1) * 2;
-    seconds += (((long) paramTime & 0x0004) >> 2) * 4;
-    seconds += (((long) paramTime & 0x0008) >> 3) * 8;
-    seconds += (((long) paramTime & 0x0010) >> 4) * 16;
+/**
+ * Removes a block from the list of its priority
+ * @param paramBlockCache - The block cache
+ * @param paramIndex      - The index of the block
+ */
+void unlinkCacheBlock(BlockCache *paramBlockCache, int paramIndex) {
 
-    seconds *= 2; seconds--;
+    CacheBlock *block = paramBlockCache->blocks + paramIndex;
 
-    seconds += (int) paramTenths / 100;
+    if(block->previous >= 0) {
+        paramBlockCache->blocks[block->previous].next = block->next;
+    } else {
+        paramBlockCache->head[block->priority] = block->next;
+    }
+    if(block->next >= 0) {
+        paramBlockCache->blocks[block->next].previous = block->previous;
+    } else {
+        paramBlockCache->tail[block->priority] = block->previous;
+    }
+}
 
-    printIndent(paramIndentSize);
-    printf("%00.00f\n", seconds);
+/**
+ * Puts a block at the head of the list of its priority, making it the most recently used
+ * @param paramBlockCache - The block cache
+ * @param paramIndex      - The index of the block
+ */
+void linkCacheBlockAtHead(BlockCache *paramBlockCache, int paramIndex) {
 
+    CacheBlock *block = paramBlockCache->blocks + paramIndex;
 
+    block->previous = -1;
+    block->next = paramBlockCache->head[block->priority];
+    if(block->next >= 0) {
+        paramBlockCache->blocks[block->next].previous = paramIndex;
+    } else {
+        paramBlockCache->tail[block->priority] = paramIndex;
+    }
+    paramBlockCache->head[block->priority] = paramIndex;
 }
 
 /**
- * Pretty prints the directory entry to console
- * @param paramDirectoryEntry - The directory entry being printed
- * @param paramIndentSize     - The indent size of the print
+ * Takes a block for a new part of the image, evicting the least recently used data block or, when there are none,
+ * the least recently used FAT block
+ * @param paramBlockCache - The block cache
+ * @return                - The index of a block that is in no list or hash bucket
  */
-void printDirectoryEntry(DirectoryEntry *paramDirectoryEntry, int paramIndentSize) {
-    printf("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
-    printf("File Name: ");
-    printLongFileName(paramDirectoryEntry, paramIndentSize);
+int takeCacheBlock(BlockCache *paramBlockCache) {
 
-    printf("File Size: %d bytes\n", paramDirectoryEntry->entry->DIR_FileSize);
+    if(paramBlockCache->numberOfUsedBlocks < paramBlockCache->numberOfBlocks) {
+        return paramBlockCache->numberOfUsedBlocks++;
+    }
 
-    printf("\nFile Attributes:\n");
-    if(paramDirectoryEntry->entryAttributes->archive) printf("- Archive\n");
-    if(paramDirectoryEntry->entryAttributes->directory) printf("- Directory\n");
-    if(paramDirectoryEntry->entryAttributes->volume_name) printf("- Volume Name\n");
-    if(paramDirectoryEntry->entryAttributes->system) printf("- System\n");
-    if(paramDirectoryEntry->entryAttributes->hidden) printf("- Hidden\n");
-    if(paramDirectoryEntry->entryAttributes->read_only) printf("- Read Only\n");
+    int priority = paramBlockCache->tail[CACHE_PRIORITY_DATA] >= 0 ? CACHE_PRIORITY_DATA : CACHE_PRIORITY_FAT;
+    int index = paramBlockCache->tail[priority];
+    CacheBlock *block = paramBlockCache->blocks + index;
 
-    printf("\nCreation Date: ");
-    print16BitDate(paramDirectoryEntry->entry->DIR_CrtDate, 0);
-    printf("Creation Time:\n- Hours: ");
-    print16BitTimeHour(paramDirectoryEntry->entry->DIR_CrtTime, 0);
-    printf("- Minutes: ");
-    print16BitTimeMinute(paramDirectoryEntry->entry->DIR_CrtTime, 0);
-    printf("- Seconds: ");
-    printTimeTenthSeconds(paramDirectoryEntry->entry->DIR_CrtTime, paramDirectoryEntry->entry->DIR_CrtTimeTenth, 0);
+    unlinkCacheBlock(paramBlockCache, index);
 
-    printf("\nLast Access Date: ");
-    print16BitDate(paramDirectoryEntry->entry->DIR_LstAccDate, 0);
+    int *link = paramBlockCache->hashBuckets + (block->blockNumber & (paramBlockCache->numberOfHashBuckets - 1));
+    while(*link != index) {
+        link = &paramBlockCache->blocks[*link].hashNext;
+    }
+    *link = block->hashNext;
 
-    printf("\nLast Write Date: ");
-    print16BitDate(paramDirectoryEntry->entry->DIR_WrtDate, 0);
-    printf("Last Write Time:\n- Hours: ");
-    print16BitTimeHour(paramDirectoryEntry->entry->DIR_WrtTime, 0);
-    printf("- Minutes: ");
-    print16BitTimeMinute(paramDirectoryEntry->entry->DIR_WrtTime, 0);
-    printf("- Seconds (2): ");
-    print16BitTime2Seconds(paramDirectoryEntry->entry->DIR_WrtTime, 0);
+    paramBlockCache->evictions++;
+    if(priority == CACHE_PRIORITY_FAT) {
+        paramBlockCache->fatEvictions++;
+    }
 
-    printf("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n");
+    return index;
 }
 
 /**
- * Creates a directory entry where all values are null
- * @return the new directory entry
+ * Finds the block holding part of the image. The lock of the cache must be held.
+ * @param paramBlockCache  - The block cache
+ * @param paramBlockNumber - The block of the image
+ * @return                 - The index of the block, -1 when it is not held
  */
-ReturnStack *createDirectoryEntry() {
-
-    ReturnStack *returnStack = createReturnStack();
+int findCacheBlock(BlockCache *paramBlockCache, long paramBlockNumber) {
+    int bucket = (int) (paramBlockNumber & (paramBlockCache->numberOfHashBuckets - 1));
+    for(int index = paramBlockCache->hashBuckets[bucket]; index >= 0; index = paramBlockCache->blocks[index].hashNext) {
+        if(paramBlockCache->blocks[index].blockNumber == paramBlockNumber) {
+            return index;
+        }
+    }
+    return -1;
+}
 
-    DirectoryEntry *entry = (DirectoryEntry *) malloc(sizeof(DirectoryEntry));
+/**
+ * Takes a block for a part of the image that is not held and makes it the most recently used. The lock of the cache
+ * must be held.
+ * @param paramBlockCache  - The block cache
+ * @param paramBlockNumber - The block of the image
+ * @return                 - The block, its bytes are left for the caller to fill
+ */
+CacheBlock *addCacheBlock(BlockCache *paramBlockCache, long paramBlockNumber) {
 
-    setReturnValueToReturnStack(returnStack, entry);
+    int bucket = (int) (paramBlockNumber & (paramBlockCache->numberOfHashBuckets - 1));
+    int index = takeCacheBlock(paramBlockCache);
+    CacheBlock *block = paramBlockCache->blocks + index;
 
-    return returnStack;
+    block->blockNumber = paramBlockNumber;
+    block->priority = (paramBlockNumber >= paramBlockCache->fatStartBlock && paramBlockNumber <= paramBlockCache->fatEndBlock) ? CACHE_PRIORITY_FAT : CACHE_PRIORITY_DATA;
+    block->hashNext = paramBlockCache->hashBuckets[bucket];
+    paramBlockCache->hashBuckets[bucket] = index;
+    linkCacheBlockAtHead(paramBlockCache, index);
 
+    return block;
 }
 
 /**
- * Get all of the directory entries within a buffer / stops at 0x00
- * @param paramBuffer       - The buffer the entries are being generated from
- * @param paramStartingByte - The starting byte for reading the buffer
- * @return                  - A linked list containing all of the entries
+ * Gets a block of the image, reading it when it is not held. The lock of the cache must be held.
+ * @param paramBlockCache - The block cache
+ * @param paramBlockNumber - The block of the image
+ * @return                - The bytes of the block, valid until the lock is released
  */
-ReturnStack *getAllEntriesFromDirectory(Buffer *paramBuffer, int paramStartingByte) {
-
-    ReturnStack *returnStack = createReturnStack();
-    LinkedList *entries = createLinkedList();
+const unsigned char *getCacheBlock(BlockCache *paramBlockCache, long paramBlockNumber) {
+
+    int index = findCacheBlock(paramBlockCache, paramBlockNumber);
+    if(index >= 0) {
+        paramBlockCache->hits++;
+        unlinkCacheBlock(paramBlockCache, index);
+        linkCacheBlockAtHead(paramBlockCache, index);
+        return paramBlockCache->blocks[index].bytes;
+    }
 
-    int startingByte = paramStartingByte;
+    paramBlockCache->misses++;
 
-    int longFileNameEntryCount = 0;
-    while(paramBuffer->bufferPtr[startingByte] != 0x00) {
+    CacheBlock *block = addCacheBlock(paramBlockCache, paramBlockNumber);
 
-        if(paramBuffer->bufferPtr[startingByte] == 0xe5) {
-            startingByte += sizeof(Entry);
-            continue;
+    long bytesRead = 0;
+    if(paramBlockCache->chunkedImage != NULL) {
+        bytesRead = readChunkedBytes(paramBlockCache->chunkedImage, paramBlockNumber * paramBlockCache->blockSize, block->bytes, paramBlockCache->blockSize);
+    }
+    while(paramBlockCache->chunkedImage == NULL && bytesRead < paramBlockCache->blockSize) {
+        ssize_t result = pread(paramBlockCache->fileDescriptor, block->bytes + bytesRead, paramBlockCache->blockSize - bytesRead,
+                               paramBlockNumber * paramBlockCache->blockSize + bytesRead);
+        if(result <= 0) {
+            break;
         }
+        bytesRead += result;
+    }
+    memset(block->bytes + bytesRead, 0, paramBlockCache->blockSize - bytesRead);
 
-        if(paramBuffer->bufferPtr[startingByte] == 0x2e) {                                          // File begins with "." meaning should not be read
-            startingByte += sizeof(Entry);
-            continue;
+    return block->bytes;
+}
+
+/**
+ * Stores blocks that were read ahead of being needed, leaving any already held as they are
+ * @param paramBlockCache      - The block cache
+ * @param paramFirstBlock      - The first block of the image that was read
+ * @param paramNumberOfBlocks  - The number of blocks that were read
+ * @param paramBytes           - The bytes of the blocks
+ */
+void storeCacheBlocks(BlockCache *paramBlockCache, long paramFirstBlock, int paramNumberOfBlocks, const unsigned char *paramBytes) {
+
+    pthread_mutex_lock(&paramBlockCache->lock);
+
+    for(int blockIndex = 0; blockIndex < paramNumberOfBlocks; blockIndex++) {
+        if(findCacheBlock(paramBlockCache, paramFirstBlock + blockIndex) < 0) {
+            CacheBlock *block = addCacheBlock(paramBlockCache, paramFirstBlock + blockIndex);
+            memcpy(block->bytes, paramBytes + (size_t) blockIndex * paramBlockCache->blockSize, paramBlockCache->blockSize);
         }
+    }
 
-        if(paramBuffer->bufferPtr[startingByte + 11] == 0x0f) {                                     // Long File Name Entry
-            longFileNameEntryCount += 1;
-        } else {
+    pthread_mutex_unlock(&paramBlockCache->lock);
+}
+
+/**
+ * Copies bytes of the image through the cache
+ * @param paramBlockCache - The block cache
+ * @param paramOffset     - The first byte of the image being copied
+ * @param paramBytes      - Where the bytes are copied to
+ * @param paramLength     - The number of bytes
+ */
+void readCachedBytes(BlockCache *paramBlockCache, long paramOffset, unsigned char *paramBytes, long paramLength) {
 
-            Entry *entry = createEntry(paramBuffer, startingByte)->returnedValue;
+    pthread_mutex_lock(&paramBlockCache->lock);
 
-            EntryAttributes *entryAttributes = createEntryAttributes(entry)->returnedValue;
-            DirectoryEntry *directoryEntry = createDirectoryEntry()->returnedValue;
+    while(paramLength > 0) {
+        long blockNumber = paramOffset / paramBlockCache->blockSize;
+        int blockOffset = (int) (paramOffset % paramBlockCache->blockSize);
+        long length = paramBlockCache->blockSize - blockOffset < paramLength ? paramBlockCache->blockSize - blockOffset : paramLength;
 
-            directoryEntry->entry = entry;
-            directoryEntry->entryAttributes = entryAttributes;
+        memcpy(paramBytes, getCacheBlock(paramBlockCache, blockNumber) + blockOffset, length);
 
-            if(longFileNameEntryCount) {
-                int startingMemoryAddress = startingByte - sizeof(LongFileNameEntry);
+        paramBytes += length;
+        paramOffset += length;
+        paramLength -= length;
+    }
 
-                wchar_t characters[longFileNameEntryCount * 13];
-                int nextCharacterPosition = 0;
+    pthread_mutex_unlock(&paramBlockCache->lock);
+}
 
-                for(int index = longFileNameEntryCount; index > 0; index--) {
+/**
+ * Prints the hit rate and eviction counters of a cache to standard error so they do not mix with the output
+ * @param paramBlockCache - The block cache
+ */
+void printBlockCacheStatistics(BlockCache *paramBlockCache) {
+    long lookups = paramBlockCache->hits + paramBlockCache->misses;
+    fprintf(stderr, "Cache: %d blocks of %d bytes, %ld hits, %ld misses (%.2f%% hit rate), %ld evictions (%ld FAT)\n",
+            paramBlockCache->numberOfBlocks, paramBlockCache->blockSize, paramBlockCache->hits, paramBlockCache->misses,
+            lookups == 0 ? 0.0 : (100.0 * paramBlockCache->hits) / lookups, paramBlockCache->evictions, paramBlockCache->fatEvictions);
+    if(paramBlockCache->chunkedImage != NULL) {
+        printChunkedImageStatistics(paramBlockCache->chunkedImage);
+    }
+}
 
-                    LongFileNameEntry *longFileNameEntry = createLongFileNameEntry(paramBuffer, startingMemoryAddress)->returnedValue;
 
-                    for(int cIndex = 0; cIndex < 10; cIndex+=2) {
-                        characters[nextCharacterPosition] = (wchar_t) (longFileNameEntry->LDIR_Name1[cIndex] + longFileNameEntry->LDIR_Name1[cIndex+1] * 256);
-                        nextCharacterPosition++;
-                    }
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                           Read Engine                                            |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
 
-                    for(int cIndex = 0; cIndex < 12; cIndex+=2) {
-                        characters[nextCharacterPosition] = (wchar_t) (longFileNameEntry->LDIR_Name2[cIndex] + longFileNameEntry->LDIR_Name2[cIndex+1] * 256);
-                        nextCharacterPosition++;
-                    }
+/*
+ * A volume read through its block cache can also be given read engines, which keep many reads of an image in
+ * flight at once instead of waiting for each pread in turn. The io_uring engine writes reads to a submission ring,
+ * enters them with one system call and takes them back from a completion ring in whatever order the device finishes
+ * them, into buffers that are registered with the kernel once. The pread engine does each read when its completion
+ * is asked for, it is used when io_uring is not available so callers never need to know which engine they have.
+ *
+ * A ring must only be used by one thread at a time so each thread has its own engine for a volume, created the
+ * first time the thread reads through it. Every read is aligned to READ_ENGINE_ALIGNMENT so the image can be opened
+ * with O_DIRECT, bypassing the page cache.
+ */
 
-                    for(int cIndex = 0; cIndex < 4; cIndex+=2) {
-                        characters[nextCharacterPosition] = (wchar_t) (longFileNameEntry->LDIR_Name3[cIndex] + longFileNameEntry->LDIR_Name3[cIndex+1] * 256);
-                        nextCharacterPosition++;
-                    }
+#define READ_ENGINE_NONE 0
+#define READ_ENGINE_PREAD 1
+#define READ_ENGINE_IO_URING 2
 
-                    startingMemoryAddress -= sizeof(LongFileNameEntry);
-                }
+#define READ_ENGINE_DEFAULT_QUEUE_DEPTH 16
+#define READ_ENGINE_MAXIMUM_QUEUE_DEPTH 256
+#define READ_ENGINE_ALIGNMENT 4096
+#define READ_ENGINE_SLOT_SIZE (CACHE_MAXIMUM_READ + 2 * READ_ENGINE_ALIGNMENT)
+#define READ_ENGINE_DEFAULT_CACHE_BYTES (64L * 1024 * 1024)     // Budget of the block cache when only --io is given
 
-                int totalNameSize = 0;
-                for(int index = 0; index < longFileNameEntryCount * 13; index++) {
-                    if(characters[index] == 0x0000) {
-                        break;
-                    }
-                    totalNameSize++;
-                }
+/**
+ * A read slot holds one read and the buffer it is read into
+ */
+struct ReadSlot {
+    long offset;                // First byte of the image wanted
+    long length;                // Number of bytes wanted, at most CACHE_MAXIMUM_READ
+    long alignedOffset;         // First byte of the image read
+    long alignedLength;         // Number of bytes read
+    void *context;              // Given with the read, for the caller
+    int sequence;               // Given with the read, for the caller
+    unsigned char *bytes;       // READ_ENGINE_SLOT_SIZE bytes aligned to READ_ENGINE_ALIGNMENT
+    uint8_t is_in_flight;       // Submitted and not yet given back by waitForRead
+
+}; typedef struct ReadSlot ReadSlot;
 
-                wchar_t *entryName = (wchar_t *) malloc(sizeof(wchar_t) * totalNameSize);
+/**
+ * A read engine keeps up to its queue depth of reads of one image in flight
+ */
+struct ReadEngine {
+    int engineType;                     // READ_ENGINE_PREAD or READ_ENGINE_IO_URING
+    int fileDescriptor;                 // The image, owned by the pool of the engine
+    pthread_t owner;                    // The only thread using the engine
+    int queueDepth;
+
+    ReadSlot *slots;
+    unsigned char *slotBytes;           // The bytes of every slot in one aligned allocation
+    int *freeSlots;                     // Slots that are not in flight
+    int numberOfFreeSlots;
+    int *pendingSlots;                  // Slots submitted but not yet completed, oldest first
+    int pendingStart;
+    int numberOfPendingSlots;
+
+    int ringFileDescriptor;             // -1 for the pread engine
+    unsigned char *submissionRing;
+    size_t submissionRingSize;
+    unsigned char *completionRing;      // The same mapping as the submission ring when the kernel allows it
+    size_t completionRingSize;
+    void *submissionEntries;
+    size_t submissionEntriesSize;
+    unsigned *submissionTail;
+    unsigned *submissionMask;
+    unsigned *submissionArray;
+    unsigned *completionHead;
+    unsigned *completionTail;
+    unsigned *completionMask;
+    void *completionEntries;
+    uint8_t is_registered;              // The slot buffers are registered and read with READ_FIXED
+    unsigned numberOfUnsubmitted;       // Written to the submission ring but not entered
+
+    long numberOfReads;
+    long bytesRead;
+    int maximumInFlight;
+    long headOffset;                    // The byte after the last read submitted, where the disk head is left
+    long seekDistance;                  // The bytes skipped over or back between one read and the next
+
+}; typedef struct ReadEngine ReadEngine;
 
-                for(int index = 0; index < totalNameSize; index++) {
-                    entryName[index] = characters[index];
-                }
+/**
+ * A read engine pool holds the engines of every thread reading one image
+ */
+struct ReadEnginePool {
+    int engineType;                     // The engine asked for
+    int queueDepth;
+    int fileDescriptor;                 // The image, opened on its own so it can use O_DIRECT
+    uint8_t is_direct;                  // The image was opened with O_DIRECT
+    long identifier;                    // Unique to the pool, so a thread can tell whether its engine belongs to it
 
-                directoryEntry->longFileName = entryName;
-                directoryEntry->fileNameSize = totalNameSize;
+    ReadEngine **engines;
+    int numberOfEngines;
+    pthread_mutex_t lock;               // Held while an engine is added
 
-                longFileNameEntryCount = 0;
+}; typedef struct ReadEnginePool ReadEnginePool;
 
-            } else {
+static long nextReadEnginePoolIdentifier = 1;
+static __thread ReadEngine *threadReadEngine = NULL;
+static __thread long threadReadEnginePoolIdentifier = 0;
 
-                wchar_t *entryName = (wchar_t *) malloc(sizeof(wchar_t) * 11);
+#if defined(FAT16_IO_URING)
+/**
+ * Sets up the rings of an io_uring engine and registers its slot buffers
+ * @param paramReadEngine - The engine, with its slots created
+ * @return                - 1 if the rings were set up
+ */
+uint8_t setupIoUring(ReadEngine *paramReadEngine) {
 
-                for(int index = 0; index < 11; index++) {
-                    entryName[index] = (wchar_t) entry->DIR_Name[index];
-                }
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
 
-                directoryEntry->longFileName = entryName;
-                directoryEntry->fileNameSize = 11;
+    int ringFileDescriptor = (int) syscall(__NR_io_uring_setup, paramReadEngine->queueDepth, &params);
+    if(ringFileDescriptor < 0) {
+        return 0;
+    }
 
-            }
+    size_t submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    uint8_t is_single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(is_single_mapping) {
+        submissionRingSize = submissionRingSize > completionRingSize ? submissionRingSize : completionRingSize;
+        completionRingSize = submissionRingSize;
+    }
 
-            addNewLink(entries, directoryEntry);
+    unsigned char *submissionRing = (unsigned char *) mmap(NULL, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFileDescriptor, IORING_OFF_SQ_RING);
+    unsigned char *completionRing = submissionRing;
+    if(submissionRing != MAP_FAILED && !is_single_mapping) {
+        completionRing = (unsigned char *) mmap(NULL, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFileDescriptor, IORING_OFF_CQ_RING);
+    }
+    size_t submissionEntriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *submissionEntries = submissionRing == MAP_FAILED || completionRing == MAP_FAILED ? MAP_FAILED :
+            mmap(NULL, submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFileDescriptor, IORING_OFF_SQES);
 
+    if(submissionEntries == MAP_FAILED) {
+        if(completionRing != MAP_FAILED && completionRing != submissionRing) {
+            munmap(completionRing, completionRingSize);
         }
-        startingByte += sizeof(Entry);
+        if(submissionRing != MAP_FAILED) {
+            munmap(submissionRing, submissionRingSize);
+        }
+        close(ringFileDescriptor);
+        return 0;
     }
 
-    setReturnValueToReturnStack(returnStack, entries);
+    paramReadEngine->ringFileDescriptor = ringFileDescriptor;
+    paramReadEngine->submissionRing = submissionRing;
+    paramReadEngine->submissionRingSize = submissionRingSize;
+    paramReadEngine->completionRing = completionRing;
+    paramReadEngine->completionRingSize = completionRingSize;
+    paramReadEngine->submissionEntries = submissionEntries;
+    paramReadEngine->submissionEntriesSize = submissionEntriesSize;
+    paramReadEngine->submissionTail = (unsigned *) (submissionRing + params.sq_off.tail);
+    paramReadEngine->submissionMask = (unsigned *) (submissionRing + params.sq_off.ring_mask);
+    paramReadEngine->submissionArray = (unsigned *) (submissionRing + params.sq_off.array);
+    paramReadEngine->completionHead = (unsigned *) (completionRing + params.cq_off.head);
+    paramReadEngine->completionTail = (unsigned *) (completionRing + params.cq_off.tail);
+    paramReadEngine->completionMask = (unsigned *) (completionRing + params.cq_off.ring_mask);
+    paramReadEngine->completionEntries = completionRing + params.cq_off.cqes;
+
+    // Registered buffers save the kernel mapping each buffer on every read, they are optional as they count
+    // against the locked memory limit
+    struct iovec *buffers = (struct iovec *) malloc(sizeof(struct iovec) * paramReadEngine->queueDepth);
+    for(int index = 0; index < paramReadEngine->queueDepth; index++) {
+        buffers[index].iov_base = paramReadEngine->slots[index].bytes;
+        buffers[index].iov_len = READ_ENGINE_SLOT_SIZE;
+    }
+    paramReadEngine->is_registered = syscall(__NR_io_uring_register, ringFileDescriptor, IORING_REGISTER_BUFFERS, buffers, paramReadEngine->queueDepth) == 0;
+    free(buffers);
 
-    return returnStack;
+    return 1;
 }
+#endif
+
+void freeReadEngine(ReadEngine *paramReadEngine);
 
 /**
- * Get the cluster number from the entry
- * @param paramDirectoryEntry - The directory being used
- * @return                    - uint16 value containing the first cluster number
+ * Creates a read engine for an image
+ * @param paramFileDescriptor - The image, opened for reading
+ * @param paramEngineType     - READ_ENGINE_PREAD or READ_ENGINE_IO_URING
+ * @param paramQueueDepth     - The most reads in flight at once
+ * @return                    - The engine, a pread engine when io_uring was asked for but could not be set up, NULL when
+ *                              its slots could not be allocated
  */
-ReturnStack *getClusterNFromDirectoryEntry(DirectoryEntry *paramDirectoryEntry) {
-
-    ReturnStack *returnStack = createReturnStack();
+ReadEngine *createReadEngine(int paramFileDescriptor, int paramEngineType, int paramQueueDepth) {
+
+    ReadEngine *readEngine = (ReadEngine *) calloc(1, sizeof(ReadEngine));
+    readEngine->fileDescriptor = paramFileDescriptor;
+    readEngine->queueDepth = paramQueueDepth;
+    readEngine->ringFileDescriptor = -1;
+
+    readEngine->slots = (ReadSlot *) calloc(paramQueueDepth, sizeof(ReadSlot));
+    readEngine->freeSlots = (int *) malloc(sizeof(int) * paramQueueDepth);
+    readEngine->pendingSlots = (int *) malloc(sizeof(int) * paramQueueDepth);
+    if(posix_memalign((void **) &readEngine->slotBytes, READ_ENGINE_ALIGNMENT, (size_t) paramQueueDepth * READ_ENGINE_SLOT_SIZE) != 0) {
+        readEngine->slotBytes = NULL;
+        freeReadEngine(readEngine);
+        return NULL;
+    }
 
-    uint16_t clusterN = paramDirectoryEntry->entry->DIR_FstClusHI * 256 + paramDirectoryEntry->entry->DIR_FstClusLO;
+    for(int index = 0; index < paramQueueDepth; index++) {
+        readEngine->slots[index].bytes = readEngine->slotBytes + (size_t) index * READ_ENGINE_SLOT_SIZE;
+        readEngine->freeSlots[index] = paramQueueDepth - 1 - index;
+    }
+    readEngine->numberOfFreeSlots = paramQueueDepth;
 
-    setReturnValueToReturnStack(returnStack, clusterN);
+    readEngine->engineType = READ_ENGINE_PREAD;
+#if defined(FAT16_IO_URING)
+    if(paramEngineType == READ_ENGINE_IO_URING && setupIoUring(readEngine)) {
+        readEngine->engineType = READ_ENGINE_IO_URING;
+    }
+#endif
 
-    return returnStack;
+    return readEngine;
 }
 
-
-/// +--------------------------------------------------------------------------------------------------+
-/// |                                                                                                  |
+/**
+ * Frees a read engine, it must have no reads in flight
+ * @param paramReadEngine - The engine being freed
+ */
+void freeReadEngine(ReadEngine *paramReadEngine) {
+#if defined(FAT16_IO_URING)
+    if(paramReadEngine->ringFileDescriptor >= 0) {
+        munmap(paramReadEngine->submissionEntries, paramReadEngine->submissionEntriesSize);
+        if(paramReadEngine->completionRing != paramReadEngine->submissionRing) {
+            munmap(paramReadEngine->completionRing, paramReadEngine->completionRingSize);
+        }
+        munmap(paramReadEngine->submissionRing, paramReadEngine->submissionRingSize);
+        close(paramReadEngine->ringFileDescriptor);
+    }
+#endif
+    free(paramReadEngine->slots);
+    free(paramReadEngine->slotBytes);
+    free(paramReadEngine->freeSlots);
+    free(paramReadEngine->pendingSlots);
+    free(paramReadEngine);
+}
+
+/**
+ * Submits a read, it is only sent to the kernel once a completion is waited for
+ * @param paramReadEngine - The engine
+ * @param paramOffset     - The first byte of the image wanted
+ * @param paramLength     - The number of bytes wanted, at most CACHE_MAXIMUM_READ
+ * @param paramContext    - Given back with the read
+ * @param paramSequence   - Given back with the read
+ * @return                - 1 if the read was submitted, 0 when the queue is full
+ */
+uint8_t submitRead(ReadEngine *paramReadEngine, long paramOffset, long paramLength, void *paramContext, int paramSequence) {
+
+    if(paramReadEngine->numberOfFreeSlots == 0) {
+        return 0;
+    }
+
+    int slotIndex = paramReadEngine->freeSlots[--paramReadEngine->numberOfFreeSlots];
+    ReadSlot *slot = paramReadEngine->slots + slotIndex;
+
+    slot->offset = paramOffset;
+    slot->length = paramLength;
+    slot->alignedOffset = paramOffset & ~((long) READ_ENGINE_ALIGNMENT - 1);
+    slot->alignedLength = ((paramOffset + paramLength + READ_ENGINE_ALIGNMENT - 1) & ~((long) READ_ENGINE_ALIGNMENT - 1)) - slot->alignedOffset;
+    slot->context = paramContext;
+    slot->sequence = paramSequence;
+    slot->is_in_flight = 1;
+
+    int numberInFlight = paramReadEngine->queueDepth - paramReadEngine->numberOfFreeSlots;
+    if(numberInFlight > paramReadEngine->maximumInFlight) {
+        paramReadEngine->maximumInFlight = numberInFlight;
+    }
+    paramReadEngine->numberOfReads++;
+    paramReadEngine->seekDistance += labs(slot->alignedOffset - paramReadEngine->headOffset);
+    paramReadEngine->headOffset = slot->alignedOffset + slot->alignedLength;
+
+#if defined(FAT16_IO_URING)
+    if(paramReadEngine->engineType == READ_ENGINE_IO_URING) {
+        unsigned tail = *paramReadEngine->submissionTail;
+        unsigned index = tail & *paramReadEngine->submissionMask;
+
+        struct io_uring_sqe *entry = (struct io_uring_sqe *) paramReadEngine->submissionEntries + index;
+        memset(entry, 0, sizeof(struct io_uring_sqe));
+        entry->opcode = paramReadEngine->is_registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        entry->fd = paramReadEngine->fileDescriptor;
+        entry->off = (uint64_t) slot->alignedOffset;
+        entry->addr = (uint64_t) (uintptr_t) slot->bytes;
+        entry->len = (uint32_t) slot->alignedLength;
+        entry->buf_index = (uint16_t) slotIndex;
+        entry->user_data = (uint64_t) slotIndex;
+
+        paramReadEngine->submissionArray[index] = index;
+        __atomic_store_n(paramReadEngine->submissionTail, tail + 1, __ATOMIC_RELEASE);
+        paramReadEngine->numberOfUnsubmitted++;
+        return 1;
+    }
+#endif
+
+    paramReadEngine->pendingSlots[(paramReadEngine->pendingStart + paramReadEngine->numberOfPendingSlots) % paramReadEngine->queueDepth] = slotIndex;
+    paramReadEngine->numberOfPendingSlots++;
+    return 1;
+}
+
+/**
+ * Reads the rest of a slot with pread after a read came back short or failed, the bytes past the end of the image
+ * are set to 0 the same as the block cache does
+ * @param paramReadEngine - The engine
+ * @param paramSlot       - The slot
+ * @param paramBytesRead  - The number of bytes already read into the slot
+ */
+void finishSlotWithPread(ReadEngine *paramReadEngine, ReadSlot *paramSlot, long paramBytesRead) {
+
+    long bytesRead = paramBytesRead;
+    while(bytesRead < paramSlot->alignedLength) {
+        ssize_t result = pread(paramReadEngine->fileDescriptor, paramSlot->bytes + bytesRead, paramSlot->alignedLength - bytesRead,
+                               paramSlot->alignedOffset + bytesRead);
+        if(result <= 0) {
+            break;
+        }
+        bytesRead += result;
+    }
+    memset(paramSlot->bytes + bytesRead, 0, paramSlot->alignedLength - bytesRead);
+}
+
+/**
+ * Turns an io_uring engine whose ring failed into a pread engine, every read in flight is queued again to be done
+ * with pread as whatever the ring completed of it can no longer be taken
+ * @param paramReadEngine - The engine
+ */
+void fallBackToPread(ReadEngine *paramReadEngine) {
+
+    paramReadEngine->pendingStart = 0;
+    paramReadEngine->numberOfPendingSlots = 0;
+    for(int index = 0; index < paramReadEngine->queueDepth; index++) {
+        if(paramReadEngine->slots[index].is_in_flight) {
+            paramReadEngine->pendingSlots[paramReadEngine->numberOfPendingSlots++] = index;
+        }
+    }
+
+    paramReadEngine->engineType = READ_ENGINE_PREAD;
+    paramReadEngine->numberOfUnsubmitted = 0;
+}
+
+/**
+ * Waits for a read to complete, io_uring engines give back whichever read the device finished first while pread
+ * engines do the oldest read submitted. An io_uring engine whose ring fails falls back to pread.
+ * @param paramReadEngine - The engine, with at least one read in flight
+ * @return                - The slot of the read, held until it is released
+ */
+ReadSlot *waitForRead(ReadEngine *paramReadEngine) {
+
+#if defined(FAT16_IO_URING)
+    if(paramReadEngine->engineType == READ_ENGINE_IO_URING) {
+        while(1) {
+            unsigned head = *paramReadEngine->completionHead;
+            uint8_t is_completed = head != __atomic_load_n(paramReadEngine->completionTail, __ATOMIC_ACQUIRE);
+
+            // Reads written since the last wait are entered before a completion is taken so they are already in
+            // flight while the caller handles it
+            if(paramReadEngine->numberOfUnsubmitted > 0 || !is_completed) {
+                int submitted = (int) syscall(__NR_io_uring_enter, paramReadEngine->ringFileDescriptor, paramReadEngine->numberOfUnsubmitted,
+                                              is_completed ? 0 : 1, IORING_ENTER_GETEVENTS, NULL, 0);
+                if(submitted > 0) {
+                    paramReadEngine->numberOfUnsubmitted -= submitted;
+                }
+                if(submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    fallBackToPread(paramReadEngine);
+                    break;
+                }
+                if(submitted >= 0 || !is_completed) {   // A busy ring is emptied before it is entered again
+                    continue;
+                }
+            }
+
+            struct io_uring_cqe *completion = (struct io_uring_cqe *) paramReadEngine->completionEntries + (head & *paramReadEngine->completionMask);
+            ReadSlot *slot = paramReadEngine->slots + completion->user_data;
+            int result = completion->res;
+            __atomic_store_n(paramReadEngine->completionHead, head + 1, __ATOMIC_RELEASE);
+
+            if(result < slot->alignedLength) {
+                finishSlotWithPread(paramReadEngine, slot, result < 0 ? 0 : result);
+            }
+            slot->is_in_flight = 0;
+            paramReadEngine->bytesRead += slot->length;
+            return slot;
+        }
+    }
+#endif
+
+    ReadSlot *slot = paramReadEngine->slots + paramReadEngine->pendingSlots[paramReadEngine->pendingStart];
+    paramReadEngine->pendingStart = (paramReadEngine->pendingStart + 1) % paramReadEngine->queueDepth;
+    paramReadEngine->numberOfPendingSlots--;
+
+    finishSlotWithPread(paramReadEngine, slot, 0);
+    slot->is_in_flight = 0;
+    paramReadEngine->bytesRead += slot->length;
+    return slot;
+}
+
+/**
+ * Gets the bytes that were asked for from a completed read
+ * @param paramSlot - The slot of the read
+ * @return          - The bytes, valid until the slot is released
+ */
+const unsigned char *getReadBytes(ReadSlot *paramSlot) {
+    return paramSlot->bytes + (paramSlot->offset - paramSlot->alignedOffset);
+}
+
+/**
+ * Releases the slot of a completed read so it can be used again
+ * @param paramReadEngine - The engine
+ * @param paramSlot       - The slot
+ */
+void releaseRead(ReadEngine *paramReadEngine, ReadSlot *paramSlot) {
+    paramReadEngine->freeSlots[paramReadEngine->numberOfFreeSlots++] = (int) (paramSlot - paramReadEngine->slots);
+}
+
+/**
+ * Gets the number of reads in flight
+ * @param paramReadEngine - The engine
+ * @return                - The number of slots submitted and not yet released
+ */
+int getReadsInFlight(ReadEngine *paramReadEngine) {
+    return paramReadEngine->queueDepth - paramReadEngine->numberOfFreeSlots;
+}
+
+/**
+ * Opens an image for a pool of read engines
+ * @param paramImageLocation - The location of the image
+ * @param paramEngineType    - READ_ENGINE_PREAD or READ_ENGINE_IO_URING
+ * @param paramQueueDepth    - The most reads each engine keeps in flight
+ * @param paramIsDirect      - 1 to open the image with O_DIRECT, it is opened without when the file system refuses
+ * @param paramReadEnginePool - Set to the pool
+ * @return                   - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
+ */
+int createReadEnginePool(char *paramImageLocation, int paramEngineType, int paramQueueDepth, uint8_t paramIsDirect, ReadEnginePool **paramReadEnginePool) {
+
+    int fileDescriptor = -1;
+    uint8_t is_direct = 0;
+#if defined(O_DIRECT)
+    if(paramIsDirect) {
+        fileDescriptor = open(paramImageLocation, O_RDONLY | O_DIRECT);
+        is_direct = fileDescriptor >= 0;
+    }
+#endif
+    if(fileDescriptor < 0) {
+        fileDescriptor = open(paramImageLocation, O_RDONLY);
+    }
+    if(fileDescriptor < 0) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    ReadEnginePool *readEnginePool = (ReadEnginePool *) calloc(1, sizeof(ReadEnginePool));
+    readEnginePool->engineType = paramEngineType;
+    readEnginePool->queueDepth = paramQueueDepth;
+    readEnginePool->fileDescriptor = fileDescriptor;
+    readEnginePool->is_direct = is_direct;
+    readEnginePool->identifier = __atomic_fetch_add(&nextReadEnginePoolIdentifier, 1, __ATOMIC_RELAXED);
+    pthread_mutex_init(&readEnginePool->lock, NULL);
+
+    *paramReadEnginePool = readEnginePool;
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Gets the read engine of the calling thread, creating it the first time the thread reads through the pool
+ * @param paramReadEnginePool - The pool
+ * @return                    - The engine of this thread, NULL when it could not be created and the thread has to read
+ *                              one block at a time
+ */
+ReadEngine *getReadEngine(ReadEnginePool *paramReadEnginePool) {
+
+    if(threadReadEnginePoolIdentifier == paramReadEnginePool->identifier) {
+        return threadReadEngine;
+    }
+
+    // The thread may be switching between the pools of two volumes
+    ReadEngine *readEngine = NULL;
+    pthread_mutex_lock(&paramReadEnginePool->lock);
+    for(int index = 0; index < paramReadEnginePool->numberOfEngines && readEngine == NULL; index++) {
+        if(pthread_equal(paramReadEnginePool->engines[index]->owner, pthread_self())) {
+            readEngine = paramReadEnginePool->engines[index];
+        }
+    }
+    pthread_mutex_unlock(&paramReadEnginePool->lock);
+
+    if(readEngine == NULL) {
+        readEngine = createReadEngine(paramReadEnginePool->fileDescriptor, paramReadEnginePool->engineType, paramReadEnginePool->queueDepth);
+        if(readEngine == NULL) {
+            return NULL;
+        }
+        readEngine->owner = pthread_self();
+
+        pthread_mutex_lock(&paramReadEnginePool->lock);
+        paramReadEnginePool->engines = (ReadEngine **) realloc(paramReadEnginePool->engines, sizeof(ReadEngine *) * (paramReadEnginePool->numberOfEngines + 1));
+        paramReadEnginePool->engines[paramReadEnginePool->numberOfEngines++] = readEngine;
+        pthread_mutex_unlock(&paramReadEnginePool->lock);
+    }
+
+    threadReadEngine = readEngine;
+    threadReadEnginePoolIdentifier = paramReadEnginePool->identifier;
+    return readEngine;
+}
+
+/**
+ * Frees a pool along with the engine of every thread and closes its image
+ * @param paramReadEnginePool - The pool being freed
+ */
+void freeReadEnginePool(ReadEnginePool *paramReadEnginePool) {
+    for(int index = 0; index < paramReadEnginePool->numberOfEngines; index++) {
+        freeReadEngine(paramReadEnginePool->engines[index]);
+    }
+    free(paramReadEnginePool->engines);
+    pthread_mutex_destroy(&paramReadEnginePool->lock);
+    close(paramReadEnginePool->fileDescriptor);
+    free(paramReadEnginePool);
+}
+
+/**
+ * Prints the engine used and how many reads it kept in flight to standard error
+ * @param paramReadEnginePool - The pool
+ */
+void printReadEngineStatistics(ReadEnginePool *paramReadEnginePool) {
+
+    long numberOfReads = 0;
+    long bytesRead = 0;
+    long seekDistance = 0;
+    int maximumInFlight = 0;
+    int engineType = paramReadEnginePool->engineType;
+
+    for(int index = 0; index < paramReadEnginePool->numberOfEngines; index++) {
+        ReadEngine *readEngine = paramReadEnginePool->engines[index];
+        numberOfReads += readEngine->numberOfReads;
+        bytesRead += readEngine->bytesRead;
+        seekDistance += readEngine->seekDistance;
+        maximumInFlight = readEngine->maximumInFlight > maximumInFlight ? readEngine->maximumInFlight : maximumInFlight;
+        engineType = readEngine->engineType;
+    }
+
+    fprintf(stderr, "Reads: %s%s%s, queue depth %d, %d engines, %ld reads of %ld bytes, at most %d in flight, %ld bytes of seeking\n",
+            engineType == READ_ENGINE_IO_URING ? "io_uring" : "pread",
+            paramReadEnginePool->engineType == READ_ENGINE_IO_URING && engineType != READ_ENGINE_IO_URING ? " (io_uring unavailable)" : "",
+            paramReadEnginePool->is_direct ? " O_DIRECT" : "",
+            paramReadEnginePool->queueDepth, paramReadEnginePool->numberOfEngines, numberOfReads, bytesRead, maximumInFlight, seekDistance);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                            FAT Types                                             |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The type of a FAT image is decided only by how many clusters its data region holds. FAT12 packs two entries into
+ * every 3 bytes, FAT16 stores each entry in 2 bytes and FAT32 stores each in 4 bytes of which the top 4 bits are
+ * reserved. Each type has a backend that decodes and encodes its entries, so the rest of the program only sees
+ * cluster numbers. Bad and end of chain markers are widened to their FAT32 values so they compare the same on
+ * every type.
+ */
+
+#define FAT_TYPE_12 12                          // Also the number of bits in each entry
+#define FAT_TYPE_16 16
+#define FAT_TYPE_32 32
+
+#define FAT12_MAXIMUM_CLUSTERS 4085             // Fewer clusters than this is FAT12
+#define FAT16_MAXIMUM_CLUSTERS 65525            // Fewer clusters than this is FAT16, otherwise FAT32
+
+#define FAT_BAD_CLUSTER 0x0FFFFFF7
+#define FAT_END_OF_CHAIN 0x0FFFFFFF
+
+/**
+ * Counts of how the clusters of a volume are used
+ */
+struct FatUsage {
+    long usedClusters;
+    long freeClusters;
+    long badClusters;
+
+}; typedef struct FatUsage FatUsage;
+
+/**
+ * The functions reading and writing the entries of one type of FAT
+ */
+struct FatBackend {
+    const char *name;               // The name of the type, e.g. "FAT16"
+    int fatType;                    // FAT_TYPE_12, FAT_TYPE_16 or FAT_TYPE_32
+    int entryBytes;                 // Bytes holding one entry, an entry starts at byte (cluster * fatType / 8)
+
+    uint32_t (*decodeEntry)(const unsigned char *paramEntry, int paramClusterNumber);
+    void (*encodeEntry)(unsigned char *paramEntry, int paramClusterNumber, uint32_t paramValue);
+    void (*countEntries)(const unsigned char *paramEntries, int paramNumberOfEntries, FatUsage *paramUsage);
+
+}; typedef struct FatBackend FatBackend;
+
+/**
+ * Decodes a FAT12 entry, the low 12 bits of its bytes for an even cluster and the high 12 bits for an odd one
+ * @param paramEntry         - The bytes of the entry
+ * @param paramClusterNumber - The cluster of the entry
+ * @return                   - The value of the entry
+ */
+uint32_t decodeFat12Entry(const unsigned char *paramEntry, int paramClusterNumber) {
+    uint32_t value = paramEntry[0] | (paramEntry[1] << 8);
+    value = (paramClusterNumber & 1) ? value >> 4 : value & 0x0FFF;
+    return value >= 0x0FF7 ? value + 0x0FFFF000 : value;
+}
+
+/**
+ * Encodes a FAT12 entry, leaving the 4 bits shared with its neighbour alone
+ * @param paramEntry         - The bytes of the entry
+ * @param paramClusterNumber - The cluster of the entry
+ * @param paramValue         - The value being stored
+ */
+void encodeFat12Entry(unsigned char *paramEntry, int paramClusterNumber, uint32_t paramValue) {
+    if(paramClusterNumber & 1) {
+        paramEntry[0] = (paramEntry[0] & 0x0F) | ((paramValue << 4) & 0xF0);
+        paramEntry[1] = (paramValue >> 4) & 0xFF;
+    } else {
+        paramEntry[0] = paramValue & 0xFF;
+        paramEntry[1] = (paramEntry[1] & 0xF0) | ((paramValue >> 8) & 0x0F);
+    }
+}
+
+/**
+ * Counts the free and bad entries of a FAT12, two entries at a time
+ * @param paramEntries         - The bytes of the first entry, which must be for an even cluster
+ * @param paramNumberOfEntries - The number of entries
+ * @param paramUsage           - Has the free and bad entries added to it
+ */
+void countFat12Entries(const unsigned char *paramEntries, int paramNumberOfEntries, FatUsage *paramUsage) {
+
+    long freeClusters = 0;
+    long badClusters = 0;
+
+    int index = 0;
+    for(; index + 1 < paramNumberOfEntries; index += 2, paramEntries += 3) {
+        uint32_t evenValue = paramEntries[0] | ((paramEntries[1] & 0x0F) << 8);
+        uint32_t oddValue = (paramEntries[1] >> 4) | (paramEntries[2] << 4);
+        freeClusters += (evenValue == 0) + (oddValue == 0);
+        badClusters += (evenValue == 0x0FF7) + (oddValue == 0x0FF7);
+    }
+    if(index < paramNumberOfEntries) {
+        uint32_t evenValue = paramEntries[0] | ((paramEntries[1] & 0x0F) << 8);
+        freeClusters += evenValue == 0;
+        badClusters += evenValue == 0x0FF7;
+    }
+
+    paramUsage->freeClusters += freeClusters;
+    paramUsage->badClusters += badClusters;
+}
+
+/**
+ * Decodes a FAT16 entry
+ * @param paramEntry         - The bytes of the entry
+ * @param paramClusterNumber - The cluster of the entry
+ * @return                   - The value of the entry
+ */
+uint32_t decodeFat16Entry(const unsigned char *paramEntry, int paramClusterNumber) {
+    (void) paramClusterNumber;
+    uint32_t value = paramEntry[0] | (paramEntry[1] << 8);
+    return value >= 0xFFF7 ? value + 0x0FFF0000 : value;
+}
+
+/**
+ * Encodes a FAT16 entry
+ * @param paramEntry         - The bytes of the entry
+ * @param paramClusterNumber - The cluster of the entry
+ * @param paramValue         - The value being stored
+ */
+void encodeFat16Entry(unsigned char *paramEntry, int paramClusterNumber, uint32_t paramValue) {
+    (void) paramClusterNumber;
+    paramEntry[0] = paramValue & 0xFF;
+    paramEntry[1] = (paramValue >> 8) & 0xFF;
+}
+
+/**
+ * Counts the free and bad entries of a FAT16
+ * @param paramEntries         - The bytes of the first entry
+ * @param paramNumberOfEntries - The number of entries
+ * @param paramUsage           - Has the free and bad entries added to it
+ */
+void countFat16Entries(const unsigned char *paramEntries, int paramNumberOfEntries, FatUsage *paramUsage) {
+
+    long freeClusters = 0;
+    long badClusters = 0;
+
+    for(int index = 0; index < paramNumberOfEntries; index++) {
+        uint32_t value = paramEntries[index * 2] | (paramEntries[index * 2 + 1] << 8);
+        freeClusters += value == 0;
+        badClusters += value == 0xFFF7;
+    }
+
+    paramUsage->freeClusters += freeClusters;
+    paramUsage->badClusters += badClusters;
+}
+
+/**
+ * Decodes a FAT32 entry, ignoring its reserved top 4 bits
+ * @param paramEntry         - The bytes of the entry
+ * @param paramClusterNumber - The cluster of the entry
+ * @return                   - The value of the entry
+ */
+uint32_t decodeFat32Entry(const unsigned char *paramEntry, int paramClusterNumber) {
+    (void) paramClusterNumber;
+    return (paramEntry[0] | (paramEntry[1] << 8) | (paramEntry[2] << 16) | ((uint32_t) paramEntry[3] << 24)) & 0x0FFFFFFF;
+}
+
+/**
+ * Encodes a FAT32 entry, leaving its reserved top 4 bits alone
+ * @param paramEntry         - The bytes of the entry
+ * @param paramClusterNumber - The cluster of the entry
+ * @param paramValue         - The value being stored
+ */
+void encodeFat32Entry(unsigned char *paramEntry, int paramClusterNumber, uint32_t paramValue) {
+    (void) paramClusterNumber;
+    paramEntry[0] = paramValue & 0xFF;
+    paramEntry[1] = (paramValue >> 8) & 0xFF;
+    paramEntry[2] = (paramValue >> 16) & 0xFF;
+    paramEntry[3] = (paramEntry[3] & 0xF0) | ((paramValue >> 24) & 0x0F);
+}
+
+/**
+ * Counts the free and bad entries of a FAT32
+ * @param paramEntries         - The bytes of the first entry
+ * @param paramNumberOfEntries - The number of entries
+ * @param paramUsage           - Has the free and bad entries added to it
+ */
+void countFat32Entries(const unsigned char *paramEntries, int paramNumberOfEntries, FatUsage *paramUsage) {
+
+    long freeClusters = 0;
+    long badClusters = 0;
+
+    for(int index = 0; index < paramNumberOfEntries; index++) {
+        const unsigned char *entry = paramEntries + index * 4;
+        uint32_t value = (entry[0] | (entry[1] << 8) | (entry[2] << 16) | ((uint32_t) entry[3] << 24)) & 0x0FFFFFFF;
+        freeClusters += value == 0;
+        badClusters += value == FAT_BAD_CLUSTER;
+    }
+
+    paramUsage->freeClusters += freeClusters;
+    paramUsage->badClusters += badClusters;
+}
+
+static const FatBackend FAT12_BACKEND = {"FAT12", FAT_TYPE_12, 2, decodeFat12Entry, encodeFat12Entry, countFat12Entries};
+static const FatBackend FAT16_BACKEND = {"FAT16", FAT_TYPE_16, 2, decodeFat16Entry, encodeFat16Entry, countFat16Entries};
+static const FatBackend FAT32_BACKEND = {"FAT32", FAT_TYPE_32, 4, decodeFat32Entry, encodeFat32Entry, countFat32Entries};
+
+/**
+ * Gets the backend for the type of FAT a volume with a number of clusters must have
+ * @param paramNumberOfClusters - The number of clusters in the data region
+ * @return                      - The FAT12, FAT16 or FAT32 backend
+ */
+const FatBackend *getFatBackend(long paramNumberOfClusters) {
+    if(paramNumberOfClusters < FAT12_MAXIMUM_CLUSTERS) {
+        return &FAT12_BACKEND;
+    }
+    if(paramNumberOfClusters < FAT16_MAXIMUM_CLUSTERS) {
+        return &FAT16_BACKEND;
+    }
+    return &FAT32_BACKEND;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                              Volume                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * A volume holds everything known about one opened FAT image. Each image has its own volume so that several
+ * images can be processed at the same time without sharing any state. The bytes of the image are either all held
+ * in memory or read through a block cache of a fixed size.
+ */
+
+/**
+ * The volume stores the image bytes, its boot sector and the layout values derived from the boot sector
+ */
+struct Volume {
+    char *imageLocation;            // The location the image was opened from
+    Buffer *buffer;                 // The bytes of the entire image, NULL when it is read through the block cache
+    BlockCache *blockCache;         // The blocks of the image read so far, NULL when buffer holds the image
+    ReadEnginePool *readEngines;    // Keeps many reads of the image in flight, NULL when it is read one block at a time
+    BootSector *bootSector;         // The boot sector of the image
+    Fat32BootSector *fat32BootSector; // The FAT32 properties of the boot sector, NULL unless BPB_FATSz16 is 0
+    const FatBackend *fat;          // Reads and writes the entries of the type of FAT the image has
+
+    int sectorFatStart;             // First sector of the first FAT
+    long sectorsPerFat;             // Number of sectors in each FAT
+    int sectorRootDirectoryStart;   // First sector of the root directory region, empty on FAT32
+    int sectorDataStart;            // First sector of the data region
+    int bytesPerCluster;            // Number of bytes in each cluster
+    int numberOfClusters;           // Number of data clusters, the first being cluster 2
+    int rootDirectoryCluster;       // First cluster of the root directory on FAT32, 0 when it is a fixed region
+
+    int sectorFsInfo;               // Sector of a valid FSInfo structure, 0 when there is none
+    long freeClusterHint;           // Free clusters recorded by FSInfo, -1 when unknown
+    int nextFreeClusterHint;        // Where FSInfo suggests looking for a free cluster
+
+    struct WriteCache *writeCache;  // Changes not yet flushed, NULL when the image was opened read only
+
+}; typedef struct Volume Volume;
+
+#define MEMORY_IMAGE_MAXIMUM_SIZE (1L << 30)            // Larger images are read through a block cache and never written
+#define LARGE_IMAGE_CACHE_BYTES (64L * 1024 * 1024)     // Budget of the block cache of an image too large for memory
+
+/**
+ * Gets the total number of sectors in the image
+ * @param paramBootSector - Boot sector of the FAT image
+ * @return                - BPB_TotSec16 or BPB_TotSec32 when that is 0
+ */
+uint32_t getTotalSectors(BootSector *paramBootSector) {
+    if(paramBootSector->BPB_TotSec16 != 0) {
+        return paramBootSector->BPB_TotSec16;
+    }
+    return paramBootSector->BPB_TotSec32;
+}
+
+/**
+ * Checks the boot sector describes a layout that fits the image, so working out the layout never divides by zero and
+ * no cluster lies past the end of the image
+ * @param paramBootSector      - The boot sector of the image
+ * @param paramFat32BootSector - The FAT32 properties of the boot sector, NULL unless BPB_FATSz16 is 0
+ * @param paramImageSize       - The number of bytes in the image
+ * @return                     - 1 if a volume can be created from the boot sector
+ */
+uint8_t isValidBootSector(BootSector *paramBootSector, Fat32BootSector *paramFat32BootSector, long paramImageSize) {
+
+    long bytesPerSector = paramBootSector->BPB_BytsPerSec;
+    long sectorsPerCluster = paramBootSector->BPB_SecPerClus;
+    if(bytesPerSector < 512 || bytesPerSector > 4096 || (bytesPerSector & (bytesPerSector - 1)) != 0 ||
+       sectorsPerCluster == 0 || (sectorsPerCluster & (sectorsPerCluster - 1)) != 0 || paramBootSector->BPB_NumFATs == 0) {
+        return 0;
+    }
+
+    long sectorsPerFat = getSectorsPerFat(paramBootSector, paramFat32BootSector);
+    if(sectorsPerFat == 0) {
+        return 0;
+    }
+
+    long rootDirectorySectors = (paramBootSector->BPB_RootEntCnt * 32 + bytesPerSector - 1) / bytesPerSector;
+    long sectorDataStart = paramBootSector->BPB_RsvdSecCnt + paramBootSector->BPB_NumFATs * sectorsPerFat + rootDirectorySectors;
+    long totalSectors = getTotalSectors(paramBootSector);
+
+    return sectorDataStart <= totalSectors && totalSectors * bytesPerSector <= paramImageSize;
+}
+
+/**
+ * Creates a volume and works out its layout from the boot sector
+ * @param paramImageLocation - The location the image was opened from
+ * @param paramBuffer        - The bytes of the entire image, NULL when they are read through a block cache
+ * @param paramBootSector    - The boot sector of the image
+ * @param paramFat32BootSector - The FAT32 properties of the boot sector, NULL unless BPB_FATSz16 is 0
+ * @return                   - The new volume
+ */
+Volume *createVolume(char *paramImageLocation, Buffer *paramBuffer, BootSector *paramBootSector, Fat32BootSector *paramFat32BootSector) {
+
+    Volume *volume = (Volume *) malloc(sizeof(Volume));
+    volume->imageLocation = paramImageLocation;
+    volume->buffer = paramBuffer;
+    volume->blockCache = NULL;
+    volume->readEngines = NULL;
+    volume->bootSector = paramBootSector;
+    volume->fat32BootSector = paramFat32BootSector;
+    volume->writeCache = NULL;
+
+    int rootDirectorySectors = (paramBootSector->BPB_RootEntCnt * 32 + paramBootSector->BPB_BytsPerSec - 1) / paramBootSector->BPB_BytsPerSec;
+
+    volume->sectorFatStart = paramBootSector->BPB_RsvdSecCnt;
+    volume->sectorsPerFat = getSectorsPerFat(paramBootSector, paramFat32BootSector);
+    volume->sectorRootDirectoryStart = volume->sectorFatStart + (int) (paramBootSector->BPB_NumFATs * volume->sectorsPerFat);
+    volume->sectorDataStart = volume->sectorRootDirectoryStart + rootDirectorySectors;
+    volume->bytesPerCluster = paramBootSector->BPB_SecPerClus * paramBootSector->BPB_BytsPerSec;
+    volume->numberOfClusters = (getTotalSectors(paramBootSector) - volume->sectorDataStart) / paramBootSector->BPB_SecPerClus;
+
+    volume->fat = getFatBackend(volume->numberOfClusters);
+    volume->rootDirectoryCluster = 0;
+    if(volume->fat->fatType == FAT_TYPE_32 && paramFat32BootSector != NULL) {
+        volume->rootDirectoryCluster = (int) (paramFat32BootSector->BPB_RootClus & 0x0FFFFFFF);
+    }
+
+    volume->sectorFsInfo = 0;
+    volume->freeClusterHint = -1;
+    volume->nextFreeClusterHint = 2;
+
+    return volume;
+}
+
+/**
+ * Copies bytes of the image, from memory or through the block cache
+ * @param paramVolume - The volume being read
+ * @param paramOffset - The first byte of the image being copied
+ * @param paramBytes  - Where the bytes are copied to
+ * @param paramLength - The number of bytes
+ */
+void readVolumeBytes(Volume *paramVolume, long paramOffset, unsigned char *paramBytes, long paramLength) {
+    if(paramVolume->buffer != NULL) {
+        memcpy(paramBytes, paramVolume->buffer->bufferPtr + paramOffset, paramLength);
+        return;
+    }
+    readCachedBytes(paramVolume->blockCache, paramOffset, paramBytes, paramLength);
+}
+
+/**
+ * Reads the free cluster hints from the FSInfo sector of a FAT32 volume, leaving them unknown when the sector is
+ * missing, its signatures are wrong or its values are out of range
+ * @param paramVolume - The volume, readable through its buffer or block cache
+ */
+void readFsInfo(Volume *paramVolume) {
+
+    if(paramVolume->fat->fatType != FAT_TYPE_32 || paramVolume->fat32BootSector == NULL) {
+        return;
+    }
+
+    int sectorFsInfo = paramVolume->fat32BootSector->BPB_FSInfo;
+    if(sectorFsInfo == 0 || sectorFsInfo >= paramVolume->sectorFatStart || paramVolume->bootSector->BPB_BytsPerSec < sizeof(FsInfo)) {
+        return;
+    }
+
+    FsInfo fsInfo;
+    readVolumeBytes(paramVolume, (long) sectorFsInfo * paramVolume->bootSector->BPB_BytsPerSec, (unsigned char *) &fsInfo, sizeof(FsInfo));
+    if(fsInfo.FSI_LeadSig != FSINFO_LEAD_SIGNATURE || fsInfo.FSI_StrucSig != FSINFO_STRUCTURE_SIGNATURE) {
+        return;
+    }
+
+    paramVolume->sectorFsInfo = sectorFsInfo;
+    if(fsInfo.FSI_Free_Count != FSINFO_UNKNOWN && fsInfo.FSI_Free_Count <= (uint32_t) paramVolume->numberOfClusters) {
+        paramVolume->freeClusterHint = fsInfo.FSI_Free_Count;
+    }
+    if(fsInfo.FSI_Nxt_Free >= 2 && fsInfo.FSI_Nxt_Free < (uint32_t) paramVolume->numberOfClusters + 2) {
+        paramVolume->nextFreeClusterHint = (int) fsInfo.FSI_Nxt_Free;
+    }
+}
+
+/**
+ * Opens an image, reads it into memory and works out its layout
+ * @param paramImageLocation - The location of the image being opened
+ * @param paramVolume        - Set to the volume
+ * @return                   - EXCEPTION_NONE, EXCEPTION_UNABLE_TO_OPEN_FILE or EXCEPTION_IMAGE_TOO_LARGE when it is
+ *                             larger than MEMORY_IMAGE_MAXIMUM_SIZE or could not be held in memory
+ */
+int openVolume(char *paramImageLocation, Volume **paramVolume) {
+
+    struct stat imageStatus;
+    if(stat(paramImageLocation, &imageStatus) == 0 && imageStatus.st_size > MEMORY_IMAGE_MAXIMUM_SIZE) {
+        return EXCEPTION_IMAGE_TOO_LARGE;
+    }
+
+    FILE *file;
+    int exception = openFile(paramImageLocation, &file);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    Buffer *buffer = convertFileToBuffer(file);
+    closeFile(file);
+    if(buffer == NULL) {
+        return EXCEPTION_IMAGE_TOO_LARGE;
+    }
+
+    if(buffer->size < 512) {                                // Too short to hold a boot sector
+        freeBuffer(buffer);
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    BootSector *bootSector = createBootSector(buffer);
+    Fat32BootSector *fat32BootSector = bootSector->BPB_FATSz16 == 0 ? createFat32BootSector(buffer) : NULL;
+    if(!isValidBootSector(bootSector, fat32BootSector, buffer->size)) {
+        free(bootSector);
+        free(fat32BootSector);
+        freeBuffer(buffer);
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    Volume *volume = createVolume(paramImageLocation, buffer, bootSector, fat32BootSector);
+    readFsInfo(volume);
+
+    *paramVolume = volume;
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Opens an image without reading it into memory, its bytes are read through a block cache as they are needed. A
+ * compressed image has its blocks inflated from the chunks holding them.
+ * @param paramImageLocation - The location of the image being opened
+ * @param paramCacheBytes    - The number of bytes the block cache may use
+ * @param paramVolume        - Set to the volume
+ * @return                   - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
+ */
+int openCachedVolume(char *paramImageLocation, long paramCacheBytes, Volume **paramVolume) {
+
+    int fileDescriptor = open(paramImageLocation, O_RDONLY);
+    if(fileDescriptor < 0) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    ChunkedImage *chunkedImage = NULL;
+    if(isChunkedImage(fileDescriptor) && openChunkedImage(fileDescriptor, &chunkedImage) != EXCEPTION_NONE) {
+        close(fileDescriptor);
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    struct stat fileStatus;
+    long imageSize = chunkedImage != NULL ? chunkedImage->imageSize : fstat(fileDescriptor, &fileStatus) == 0 ? (long) fileStatus.st_size : 0;
+
+    Buffer *bootSectorBuffer = createBuffer(FAT32_BOOT_SECTOR_START + sizeof(Fat32BootSector));
+    long bytesRead = chunkedImage != NULL ? readChunkedBytes(chunkedImage, 0, bootSectorBuffer->bufferPtr, bootSectorBuffer->size)
+                                          : pread(fileDescriptor, bootSectorBuffer->bufferPtr, bootSectorBuffer->size, 0);
+    BootSector *bootSector = NULL;
+    Fat32BootSector *fat32BootSector = NULL;
+    if(bytesRead == bootSectorBuffer->size && imageSize >= 512) {
+        bootSector = createBootSector(bootSectorBuffer);
+        fat32BootSector = bootSector->BPB_FATSz16 == 0 ? createFat32BootSector(bootSectorBuffer) : NULL;
+    }
+    freeBuffer(bootSectorBuffer);
+
+    if(bootSector == NULL || !isValidBootSector(bootSector, fat32BootSector, imageSize)) {
+        if(chunkedImage != NULL) {
+            freeChunkedImage(chunkedImage);
+        }
+        close(fileDescriptor);
+        free(bootSector);
+        free(fat32BootSector);
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    Volume *volume = createVolume(paramImageLocation, NULL, bootSector, fat32BootSector);
+    volume->blockCache = createBlockCache(fileDescriptor, bootSector, volume->sectorsPerFat, paramCacheBytes);
+    volume->blockCache->chunkedImage = chunkedImage;
+    readFsInfo(volume);
+
+    *paramVolume = volume;
+    return EXCEPTION_NONE;
+}
+
+void freeWriteCache(struct WriteCache *paramWriteCache);
+
+/**
+ * Frees the memory held by a volume
+ * @param paramVolume - The volume being freed
+ */
+void freeVolume(Volume *paramVolume) {
+    if(paramVolume->writeCache != NULL) {
+        freeWriteCache(paramVolume->writeCache);
+    }
+    if(paramVolume->readEngines != NULL) {
+        freeReadEnginePool(paramVolume->readEngines);
+    }
+    if(paramVolume->blockCache != NULL) {
+        freeBlockCache(paramVolume->blockCache);
+    }
+    if(paramVolume->buffer != NULL) {
+        freeBuffer(paramVolume->buffer);
+    }
+    free(paramVolume->bootSector);
+    free(paramVolume->fat32BootSector);
+    free(paramVolume);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                                FATS                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The File allocation tables are stored after the reserved sector, there are usually 2.
+ * This reads the first FAT table and ignores the second as it is redundant
+ *
+ * Starts after the reserved sectors and carries on for the length of the fat table
+ */
+
+/**
+ * Gets the first byte of a FAT entry within the image
+ * @param paramVolume        - The volume the FAT belongs to
+ * @param paramFatIndex      - Which copy of the FAT, 0 for the first
+ * @param paramClusterNumber - The cluster entry number
+ * @return                   - The byte offset of the entry
+ */
+long getFatEntryOffset(Volume *paramVolume, int paramFatIndex, int paramClusterNumber) {
+    long fatStart = (paramVolume->sectorFatStart + paramFatIndex * paramVolume->sectorsPerFat) * paramVolume->bootSector->BPB_BytsPerSec;
+    return fatStart + (long) paramClusterNumber * paramVolume->fat->fatType / 8;
+}
+
+/**
+ * Reads an entry of the first FAT
+ * @param paramVolume        - The volume the FAT belongs to
+ * @param paramClusterNumber - The cluster entry number
+ * @return                   - The value stored in the FAT for the cluster, FAT_BAD_CLUSTER or at least 0x0FFFFFF8 at
+ *                             the end of a chain whatever the type of the FAT
+ */
+uint32_t getFatEntry(Volume *paramVolume, int paramClusterNumber) {
+
+    long fatEntryOffset = getFatEntryOffset(paramVolume, 0, paramClusterNumber);
+
+    if(paramVolume->buffer != NULL) {
+        return paramVolume->fat->decodeEntry(paramVolume->buffer->bufferPtr + fatEntryOffset, paramClusterNumber);
+    }
+
+    unsigned char fatEntry[4];
+    readCachedBytes(paramVolume->blockCache, fatEntryOffset, fatEntry, paramVolume->fat->entryBytes);
+    return paramVolume->fat->decodeEntry(fatEntry, paramClusterNumber);
+}
+
+/**
+ * Counts the used, free and bad clusters of a volume with the loop of its type of FAT, reading a cached FAT a
+ * window at a time
+ * @param paramVolume - The volume being counted
+ * @param paramUsage  - Set to the counts
+ */
+void countFatEntries(Volume *paramVolume, FatUsage *paramUsage) {
+
+    const FatBackend *fat = paramVolume->fat;
+    int lastCluster = paramVolume->numberOfClusters + 2;
+
+    memset(paramUsage, 0, sizeof(FatUsage));
+
+    if(paramVolume->buffer != NULL) {
+        fat->countEntries(paramVolume->buffer->bufferPtr + getFatEntryOffset(paramVolume, 0, 2), paramVolume->numberOfClusters, paramUsage);
+    } else {
+        // An even number of entries per window keeps every window of a FAT12 starting on a whole byte
+        int entriesPerWindow = (CACHE_MAXIMUM_READ * 8 / fat->fatType) & ~1;
+        unsigned char *window = (unsigned char *) malloc(CACHE_MAXIMUM_READ);
+
+        for(int cluster = 2; cluster < lastCluster; cluster += entriesPerWindow) {
+            int numberOfEntries = lastCluster - cluster < entriesPerWindow ? lastCluster - cluster : entriesPerWindow;
+            long windowStart = getFatEntryOffset(paramVolume, 0, cluster);
+            long windowEnd = getFatEntryOffset(paramVolume, 0, 0) + ((long) (cluster + numberOfEntries) * fat->fatType + 7) / 8;
+
+            readCachedBytes(paramVolume->blockCache, windowStart, window, windowEnd - windowStart);
+            fat->countEntries(window, numberOfEntries, paramUsage);
+        }
+
+        free(window);
+    }
+
+    paramUsage->usedClusters = paramVolume->numberOfClusters - paramUsage->freeClusters - paramUsage->badClusters;
+}
+
+/**
+ * Decodes every entry of the first FAT into an array, reading a cached FAT a window at a time
+ * @param paramVolume - The volume whose FAT is decoded
+ * @return            - The value getFatEntry gives for each cluster, indexed by cluster number, 0 for clusters 0 and 1
+ */
+uint32_t *decodeFat(Volume *paramVolume) {
+
+    const FatBackend *fat = paramVolume->fat;
+    int lastCluster = paramVolume->numberOfClusters + 2;
+    uint32_t *fatEntries = (uint32_t *) calloc(lastCluster, sizeof(uint32_t));
+
+    if(paramVolume->buffer != NULL) {
+        for(int cluster = 2; cluster < lastCluster; cluster++) {
+            fatEntries[cluster] = fat->decodeEntry(paramVolume->buffer->bufferPtr + getFatEntryOffset(paramVolume, 0, cluster), cluster);
+        }
+        return fatEntries;
+    }
+
+    // Windows end on a whole byte, so a FAT12 entry is never split across two of them
+    int entriesPerWindow = (CACHE_MAXIMUM_READ * 8 / fat->fatType) & ~1;
+    unsigned char *window = (unsigned char *) malloc(CACHE_MAXIMUM_READ);
+
+    for(int cluster = 2; cluster < lastCluster; cluster += entriesPerWindow) {
+        int numberOfEntries = lastCluster - cluster < entriesPerWindow ? lastCluster - cluster : entriesPerWindow;
+        long windowStart = getFatEntryOffset(paramVolume, 0, cluster);
+        long windowEnd = getFatEntryOffset(paramVolume, 0, 0) + ((long) (cluster + numberOfEntries) * fat->fatType + 7) / 8;
+
+        readCachedBytes(paramVolume->blockCache, windowStart, window, windowEnd - windowStart);
+        for(int index = 0; index < numberOfEntries; index++) {
+            fatEntries[cluster + index] = fat->decodeEntry(window + (getFatEntryOffset(paramVolume, 0, cluster + index) - windowStart), cluster + index);
+        }
+    }
+
+    free(window);
+    return fatEntries;
+}
+
+/**
+ * Checks whether a cluster number points inside the data region
+ * @param paramVolume        - The volume the cluster belongs to
+ * @param paramClusterNumber - The cluster number being checked
+ * @return                   - 1 if the cluster is in the data region
+ */
+uint8_t isValidCluster(Volume *paramVolume, int paramClusterNumber) {
+    return paramClusterNumber >= 2 && paramClusterNumber < paramVolume->numberOfClusters + 2;
+}
+
+/**
+ * Gets the first byte of a cluster within the image
+ * @param paramVolume        - The volume the cluster belongs to
+ * @param paramClusterNumber - The cluster number
+ * @return                   - The byte offset of the cluster
+ */
+long getClusterOffset(Volume *paramVolume, int paramClusterNumber) {
+    return ((long) (paramClusterNumber - 2) * paramVolume->bootSector->BPB_SecPerClus + paramVolume->sectorDataStart) * paramVolume->bootSector->BPB_BytsPerSec;
+}
+
+void prefetchClusters(Volume *paramVolume, const int *paramClusters, int paramNumberOfClusters);
+
+/**
+ * Copies every cluster in a chain into one buffer, stopping at the end of chain or an invalid cluster
+ * @param paramVolume       - The volume the chain belongs to
+ * @param paramStartCluster - The first cluster in the chain
+ * @return                  - A buffer holding the clusters of the chain in order
+ */
+Buffer *readClusterChain(Volume *paramVolume, int paramStartCluster) {
+
+    int numberOfClusters = 0;
+    int currentCluster = paramStartCluster;
+
+    while(isValidCluster(paramVolume, currentCluster) && numberOfClusters < paramVolume->numberOfClusters) {
+        numberOfClusters++;
+        currentCluster = getFatEntry(paramVolume, currentCluster);
+    }
+
+    Buffer *buffer = createBuffer(numberOfClusters * paramVolume->bytesPerCluster);
+    int *clusters = (int *) malloc(sizeof(int) * (numberOfClusters > 0 ? numberOfClusters : 1));
+
+    currentCluster = paramStartCluster;
+    for(int clusterIndex = 0; clusterIndex < numberOfClusters; clusterIndex++) {
+        clusters[clusterIndex] = currentCluster;
+        currentCluster = getFatEntry(paramVolume, currentCluster);
+    }
+
+    prefetchClusters(paramVolume, clusters, numberOfClusters);
+
+    for(int clusterIndex = 0; clusterIndex < numberOfClusters; clusterIndex++) {
+        readVolumeBytes(paramVolume, getClusterOffset(paramVolume, clusters[clusterIndex]),
+                        buffer->bufferPtr + (clusterIndex * paramVolume->bytesPerCluster), paramVolume->bytesPerCluster);
+    }
+
+    free(clusters);
+    return buffer;
+}
+
+/**
+ * Gets the most clusters that should be looked at in one extent. A volume read through its block cache is limited
+ * to CACHE_MAXIMUM_READ bytes at a time so that an extent can be copied into a buffer of that size.
+ * @param paramVolume         - The volume of the chain
+ * @param paramRemainingBytes - The number of bytes left to be looked at
+ * @return                    - The most clusters for the next extent, at least 1
+ */
+int getMaxExtentClusters(Volume *paramVolume, long paramRemainingBytes) {
+
+    long maxClusters = (paramRemainingBytes + paramVolume->bytesPerCluster - 1) / paramVolume->bytesPerCluster;
+
+    if(paramVolume->buffer == NULL) {
+        long cachedClusters = CACHE_MAXIMUM_READ / paramVolume->bytesPerCluster;
+        maxClusters = maxClusters < cachedClusters ? maxClusters : cachedClusters;
+    }
+
+    return maxClusters < 1 ? 1 : (int) maxClusters;
+}
+
+/**
+ * Counts the clusters of a chain that follow each other in the data region, so they can be read as one extent
+ * @param paramVolume       - The volume of the chain
+ * @param paramStartCluster - The first cluster of the extent
+ * @param paramMaxClusters  - The most clusters the extent may hold
+ * @param paramNextCluster  - Set to the cluster after the extent
+ * @return                  - The number of clusters in the extent
+ */
+int getExtentLength(Volume *paramVolume, int paramStartCluster, int paramMaxClusters, int *paramNextCluster) {
+
+    int numberOfClusters = 1;
+    int nextCluster = getFatEntry(paramVolume, paramStartCluster);
+
+    while(numberOfClusters < paramMaxClusters && nextCluster == paramStartCluster + numberOfClusters) {
+        numberOfClusters++;
+        nextCluster = getFatEntry(paramVolume, nextCluster);
+    }
+
+    *paramNextCluster = nextCluster;
+    return numberOfClusters;
+}
+
+/**
+ * Gets the bytes of an extent, pointing into the image when it is held in memory and otherwise copying them
+ * @param paramVolume        - The volume of the extent
+ * @param paramClusterNumber - The first cluster of the extent
+ * @param paramLength        - The number of bytes, at most CACHE_MAXIMUM_READ for a volume read through its cache
+ * @param paramScratch       - Where the bytes are copied when they are not held in memory
+ * @return                   - The bytes of the extent
+ */
+const unsigned char *getExtentBytes(Volume *paramVolume, int paramClusterNumber, long paramLength, unsigned char *paramScratch) {
+
+    if(paramVolume->buffer != NULL) {
+        return paramVolume->buffer->bufferPtr + getClusterOffset(paramVolume, paramClusterNumber);
+    }
+
+    readCachedBytes(paramVolume->blockCache, getClusterOffset(paramVolume, paramClusterNumber), paramScratch, paramLength);
+    return paramScratch;
+}
+
+/**
+ * A chain stream is one chain being passed to its consumer by streamClusterChains
+ */
+struct ChainStream {
+    int firstCluster;
+    long length;                        // The number of bytes being read from the chain
+    void (*consumer)(const unsigned char *, size_t, void *);
+    void *context;                      // Passed to the consumer
+    long bytesStreamed;                 // Set to the number of bytes passed to the consumer
+
+    int nextCluster;                    // The first cluster not yet read
+    long bytesSubmitted;                // The number of bytes read or being read
+    int extentsSubmitted;
+    int extentsDelivered;
+
+}; typedef struct ChainStream ChainStream;
+
+void streamClusterChains(Volume *paramVolume, ChainStream *paramChainStreams, int paramNumberOfChains);
+
+/**
+ * Calls a function with each extent of a chain, without copying it when the image is held in memory
+ * @param paramVolume       - The volume of the chain
+ * @param paramStartCluster - The first cluster of the chain
+ * @param paramLength       - The number of bytes being read from the chain
+ * @param paramConsumer     - Called with each extent in order
+ * @param paramContext      - Passed to the consumer
+ * @return                  - The number of bytes passed to the consumer, less than paramLength if the chain ends early
+ */
+long streamClusterChain(Volume *paramVolume, int paramStartCluster, long paramLength, void (*paramConsumer)(const unsigned char *, size_t, void *), void *paramContext) {
+
+    if(paramVolume->readEngines != NULL && getReadEngine(paramVolume->readEngines) != NULL) {
+        ChainStream chainStream;
+        memset(&chainStream, 0, sizeof(ChainStream));
+        chainStream.firstCluster = paramStartCluster;
+        chainStream.length = paramLength;
+        chainStream.consumer = paramConsumer;
+        chainStream.context = paramContext;
+        streamClusterChains(paramVolume, &chainStream, 1);
+        return chainStream.bytesStreamed;
+    }
+
+    long remainingBytes = paramLength;
+    int currentCluster = paramStartCluster;
+
+    unsigned char *scratch = paramVolume->buffer == NULL ? (unsigned char *) malloc(CACHE_MAXIMUM_READ) : NULL;
+
+    while(remainingBytes > 0 && isValidCluster(paramVolume, currentCluster)) {
+
+        int maxClusters = getMaxExtentClusters(paramVolume, remainingBytes);
+        int nextCluster;
+        int numberOfClusters = getExtentLength(paramVolume, currentCluster, maxClusters, &nextCluster);
+
+        long extentLength = (long) numberOfClusters * paramVolume->bytesPerCluster;
+        if(extentLength > remainingBytes) {
+            extentLength = remainingBytes;
+        }
+
+        paramConsumer(getExtentBytes(paramVolume, currentCluster, extentLength, scratch), extentLength, paramContext);
+
+        remainingBytes -= extentLength;
+        currentCluster = nextCluster;
+    }
+
+    free(scratch);
+    return paramLength - remainingBytes;
+}
+
+/**
+ * Calls the consumer of each chain with its extents in order, keeping as many extents in flight as the read engine
+ * of the thread allows. Extents are read in the order the chains are given, so a long chain is read ahead of its
+ * consumer while many short chains are read at the same time. Each chain is streamed on its own when the volume has
+ * no read engines.
+ * @param paramVolume         - The volume of the chains
+ * @param paramChainStreams   - The chains, bytesStreamed is set on each
+ * @param paramNumberOfChains - The number of chains
+ */
+void streamClusterChains(Volume *paramVolume, ChainStream *paramChainStreams, int paramNumberOfChains) {
+
+    for(int chainIndex = 0; chainIndex < paramNumberOfChains; chainIndex++) {
+        ChainStream *chainStream = paramChainStreams + chainIndex;
+        chainStream->bytesStreamed = 0;
+        chainStream->nextCluster = chainStream->firstCluster;
+        chainStream->bytesSubmitted = 0;
+        chainStream->extentsSubmitted = 0;
+        chainStream->extentsDelivered = 0;
+    }
+
+    ReadEngine *readEngine = paramVolume->readEngines == NULL ? NULL : getReadEngine(paramVolume->readEngines);
+
+    if(readEngine == NULL) {
+        for(int chainIndex = 0; chainIndex < paramNumberOfChains; chainIndex++) {
+            ChainStream *chainStream = paramChainStreams + chainIndex;
+            chainStream->bytesStreamed = streamClusterChain(paramVolume, chainStream->firstCluster, chainStream->length, chainStream->consumer, chainStream->context);
+        }
+        return;
+    }
+
+    // Extents that completed before an earlier extent of the same chain
+    ReadSlot **waitingSlots = (ReadSlot **) malloc(sizeof(ReadSlot *) * readEngine->queueDepth);
+    int numberOfWaitingSlots = 0;
+
+    int chainIndex = 0;
+    while(1) {
+
+        while(chainIndex < paramNumberOfChains && readEngine->numberOfFreeSlots > 0) {
+            ChainStream *chainStream = paramChainStreams + chainIndex;
+
+            long remainingBytes = chainStream->length - chainStream->bytesSubmitted;
+            if(remainingBytes <= 0 || !isValidCluster(paramVolume, chainStream->nextCluster)) {
+                chainIndex++;
+                continue;
+            }
+
+            int maxClusters = getMaxExtentClusters(paramVolume, remainingBytes);
+            int nextCluster;
+            int numberOfClusters = getExtentLength(paramVolume, chainStream->nextCluster, maxClusters, &nextCluster);
+
+            long extentLength = (long) numberOfClusters * paramVolume->bytesPerCluster;
+            if(extentLength > remainingBytes) {
+                extentLength = remainingBytes;
+            }
+
+            submitRead(readEngine, getClusterOffset(paramVolume, chainStream->nextCluster), extentLength, chainStream, chainStream->extentsSubmitted++);
+            chainStream->bytesSubmitted += extentLength;
+            chainStream->nextCluster = nextCluster;
+        }
+
+        // The queue is only left with free slots once every extent has been submitted
+        if(getReadsInFlight(readEngine) == 0) {
+            break;
+        }
+
+        waitingSlots[numberOfWaitingSlots++] = waitForRead(readEngine);
+
+        for(int index = 0; index < numberOfWaitingSlots; index++) {
+            ReadSlot *slot = waitingSlots[index];
+            ChainStream *chainStream = (ChainStream *) slot->context;
+            if(slot->sequence != chainStream->extentsDelivered) {
+                continue;
+            }
+
+            chainStream->consumer(getReadBytes(slot), slot->length, chainStream->context);
+            chainStream->bytesStreamed += slot->length;
+            chainStream->extentsDelivered++;
+
+            releaseRead(readEngine, slot);
+            waitingSlots[index] = waitingSlots[--numberOfWaitingSlots];
+            index = -1;                         // The next extent of the chain may already be waiting
+        }
+    }
+
+    free(waitingSlots);
+}
+
+/**
+ * Gets the most clusters a prefetch reads, a quarter of the cache so the blocks in use are not pushed out
+ * @param paramVolume - The volume of the clusters
+ * @return            - The most clusters, at least 1
+ */
+int getPrefetchClusterLimit(Volume *paramVolume) {
+    long limit = (paramVolume->blockCache->numberOfBlocks / 4) * paramVolume->blockCache->blockSize / paramVolume->bytesPerCluster;
+    return limit < 1 ? 1 : (limit > paramVolume->numberOfClusters ? paramVolume->numberOfClusters : (int) limit);
+}
+
+/** Orders clusters by their position in the image */
+int compareClusters(const void *paramFirst, const void *paramSecond) {
+    int first = *(const int *) paramFirst;
+    int second = *(const int *) paramSecond;
+    return (first > second) - (first < second);
+}
+
+/**
+ * Reads clusters into the block cache all at once through the read engine of the thread, so a walk reaching them
+ * does not wait for each read in turn. Nothing is read when the volume has no read engines, and only the first
+ * clusters that fit in a quarter of the cache are read so the blocks in use are not pushed out.
+ *
+ * The clusters are wanted in the order a walk reaches them, but that order jumps about the image on a fragmented
+ * volume. They are read by position instead, elevator style: clusters already held are left out, neighbours are
+ * merged into one read of up to CACHE_MAXIMUM_READ bytes, and the reads sweep up from where the last read of the
+ * engine ended then back down over those below it. The walk still reads the clusters in its own order from the cache.
+ * @param paramVolume           - The volume of the clusters
+ * @param paramClusters         - The clusters being read
+ * @param paramNumberOfClusters - The number of clusters
+ */
+void prefetchClusters(Volume *paramVolume, const int *paramClusters, int paramNumberOfClusters) {
+
+    if(paramVolume->readEngines == NULL || paramNumberOfClusters == 0) {
+        return;
+    }
+
+    BlockCache *blockCache = paramVolume->blockCache;
+    ReadEngine *readEngine = getReadEngine(paramVolume->readEngines);
+    if(readEngine == NULL) {
+        return;
+    }
+
+    int limit = getPrefetchClusterLimit(paramVolume);
+    int numberOfClusters = paramNumberOfClusters < limit ? paramNumberOfClusters : limit;
+    int *clusters = (int *) malloc(sizeof(int) * numberOfClusters);
+    memcpy(clusters, paramClusters, sizeof(int) * numberOfClusters);
+    qsort(clusters, numberOfClusters, sizeof(int), compareClusters);
+
+    /*
+     * Drop repeats and clusters whose blocks are all held, then merge runs of neighbouring clusters into extents
+     */
+    long *extentOffsets = (long *) malloc(sizeof(long) * numberOfClusters);
+    long *extentLengths = (long *) malloc(sizeof(long) * numberOfClusters);
+    int numberOfExtents = 0;
+
+    pthread_mutex_lock(&blockCache->lock);
+    for(int clusterIndex = 0; clusterIndex < numberOfClusters; clusterIndex++) {
+        if(clusterIndex > 0 && clusters[clusterIndex] == clusters[clusterIndex - 1]) {
+            continue;
+        }
+
+        long offset = getClusterOffset(paramVolume, clusters[clusterIndex]);
+        long firstBlock = offset / blockCache->blockSize;
+        long lastBlock = (offset + paramVolume->bytesPerCluster - 1) / blockCache->blockSize;
+        long numberOfBlocks = lastBlock - firstBlock + 1;
+
+        if(numberOfBlocks * blockCache->blockSize > CACHE_MAXIMUM_READ) {
+            continue;
+        }
+
+        uint8_t is_held = 1;
+        for(long block = firstBlock; block <= lastBlock && is_held; block++) {
+            is_held = findCacheBlock(blockCache, block) >= 0;
+        }
+        if(is_held) {
+            continue;
+        }
+
+        if(numberOfExtents > 0) {
+            long *extentLength = extentLengths + numberOfExtents - 1;
+            long extentEnd = extentOffsets[numberOfExtents - 1] + *extentLength;
+            long blockEnd = (lastBlock + 1) * blockCache->blockSize;
+
+            if(firstBlock * blockCache->blockSize <= extentEnd && blockEnd - extentOffsets[numberOfExtents - 1] <= CACHE_MAXIMUM_READ) {
+                *extentLength = blockEnd > extentEnd ? blockEnd - extentOffsets[numberOfExtents - 1] : *extentLength;
+                continue;
+            }
+        }
+
+        extentOffsets[numberOfExtents] = firstBlock * blockCache->blockSize;
+        extentLengths[numberOfExtents] = numberOfBlocks * blockCache->blockSize;
+        numberOfExtents++;
+    }
+    pthread_mutex_unlock(&blockCache->lock);
+
+    /*
+     * Sweep up from the head of the engine, then turn and come back down over the extents below it
+     */
+    int turn = 0;
+    while(turn < numberOfExtents && extentOffsets[turn] < readEngine->headOffset) {
+        turn++;
+    }
+
+    int submitted = 0;
+    while(1) {
+
+        while(submitted < numberOfExtents && readEngine->numberOfFreeSlots > 0) {
+            int extentIndex = turn + submitted < numberOfExtents ? turn + submitted : numberOfExtents - 1 - submitted;
+            submitRead(readEngine, extentOffsets[extentIndex], extentLengths[extentIndex], NULL, 0);
+            submitted++;
+        }
+
+        if(getReadsInFlight(readEngine) == 0) {
+            break;
+        }
+
+        ReadSlot *slot = waitForRead(readEngine);
+        storeCacheBlocks(blockCache, slot->offset / blockCache->blockSize, (int) (slot->length / blockCache->blockSize), getReadBytes(slot));
+        releaseRead(readEngine, slot);
+    }
+
+    free(extentLengths);
+    free(extentOffsets);
+    free(clusters);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                           Directory                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Directories are the folders within fat image.
+ * Each entry is either a folder or file within the directory
+ */
+
+/**
+ * An entry is a 32 byte entry from a directory, this holds all of the standard values but not longer names
+ */
+struct __attribute__((__packed__)) Entry {
+    uint8_t         DIR_Name[ 11 ];         // Non zero terminated string
+    uint8_t         DIR_Attr;               // File attributes
+    uint8_t         DIR_NTRes;              // Used by Windows NT, ignore
+    uint8_t         DIR_CrtTimeTenth;       // Tenths of sec. 0...199
+    uint16_t        DIR_CrtTime;            // Creation Time in 2s intervals
+    uint16_t        DIR_CrtDate;            // Date file created
+    uint16_t        DIR_LstAccDate;         // Date of last read or write
+    uint16_t        DIR_FstClusHI;          // Top 16 bits file's 1st cluster
+    uint16_t        DIR_WrtTime;            // Time of last write
+    uint16_t        DIR_WrtDate;            // Date of last write
+    uint16_t        DIR_FstClusLO;          // Lower 16 bits file's 1st cluster
+    uint32_t        DIR_FileSize;           // File size in bytes
+}; typedef struct Entry Entry;
+
+/**
+ * Print values stored within an entry
+ * @param paramEntry
+ */
+void printEntry(Entry *paramEntry) {
+    printOutput("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+    for(int index=0; index<11; index++) {
+        printOutput("DIR_Name[%d]= %d | %08x\n", index, paramEntry->DIR_Name[index], paramEntry->DIR_Name[index]);
+    }
+    printOutput("DIR_Attr= %d | %08x\n", paramEntry->DIR_Attr, paramEntry->DIR_Attr);
+    printOutput("DIR_NTRes= %d | %08x\n", paramEntry->DIR_NTRes, paramEntry->DIR_NTRes);
+    printOutput("DIR_CrtTimeTenth= %d | %08x\n", paramEntry->DIR_CrtTimeTenth, paramEntry->DIR_CrtTimeTenth);
+    printOutput("DIR_CrtTime= %d | %08x\n", paramEntry->DIR_CrtTime, paramEntry->DIR_CrtTime);
+    printOutput("DIR_CrtDate= %d | %08x\n", paramEntry->DIR_CrtDate, paramEntry->DIR_CrtDate);
+    printOutput("DIR_LstAccDate= %d | %08x\n", paramEntry->DIR_LstAccDate, paramEntry->DIR_LstAccDate);
+    printOutput("DIR_FstClusHI= %d | %08x\n", paramEntry->DIR_FstClusHI, paramEntry->DIR_FstClusHI);
+    printOutput("DIR_WrtTime= %d | %08x\n", paramEntry->DIR_WrtTime, paramEntry->DIR_WrtTime);
+    printOutput("DIR_WrtDate= %d | %08x\n", paramEntry->DIR_WrtDate, paramEntry->DIR_WrtDate);
+    printOutput("DIR_FstClusLO= %d | %08x\n", paramEntry->DIR_FstClusLO, paramEntry->DIR_FstClusLO);
+    printOutput("DIR_FileSize= %d | %08x\n", paramEntry->DIR_FileSize, paramEntry->DIR_FileSize);
+    printOutput("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+}
+
+/**
+ * Creates an entry from a buffer and a start location
+ * @param paramBuffer       - The buffer for the entry to be copied from
+ * @param paramEntryStart   - The first byte of the entry in the buffer
+ * @return
+ */
+Entry *createEntry(Buffer *paramBuffer, int paramEntryStart) {
+
+    Entry *entry = (Entry *) malloc(sizeof(Entry));
+    memcpy(entry, paramBuffer->bufferPtr + paramEntryStart, sizeof(Entry));
+
+    return entry;
+}
+
+/**
+ * Entry attributes makes the values within the Entry-Attribute value accessible
+ */
+struct __attribute__((__packed__)) EntryAttributes {
+    uint8_t archive;
+    uint8_t directory;
+    uint8_t volume_name;
+    uint8_t system;
+    uint8_t hidden;
+    uint8_t read_only;
+
+    uint8_t is_file;
+
+}; typedef struct EntryAttributes EntryAttributes;
+
+/**
+ * Prints the entries attribute
+ * @param paramEntryAttributes - Attributes to be printed
+ */
+void printEntryAttributes(EntryAttributes *paramEntryAttributes) {
+    printOutput("archive= %d\n", paramEntryAttributes->archive);
+    printOutput("directory= %d\n", paramEntryAttributes->directory);
+    printOutput("volume_name= %d\n", paramEntryAttributes->volume_name);
+    printOutput("system= %d\n", paramEntryAttributes->system);
+    printOutput("hidden= %d\n", paramEntryAttributes->hidden);
+    printOutput("read_only= %d\n", paramEntryAttributes->read_only);
+    printOutput("is_file= %d\n", paramEntryAttributes->is_file);
+}
+
+/**
+ * Sets the entry attributes from the attribute byte of an entry
+ * @param paramEntry           - Entry for the entry attributes to be based off
+ * @param paramEntryAttributes - The entry attributes being set
+ */
+void setEntryAttributes(Entry *paramEntry, EntryAttributes *paramEntryAttributes) {
+
+    paramEntryAttributes->read_only = ((int)paramEntry->DIR_Attr & 0x01);
+    paramEntryAttributes->hidden =  ((int)paramEntry->DIR_Attr & 0x02) >> 1;
+    paramEntryAttributes->system =  ((int)paramEntry->DIR_Attr & 0x04) >> 2;
+    paramEntryAttributes->volume_name =  ((int)paramEntry->DIR_Attr & 0x08) >> 3;
+    paramEntryAttributes->directory =  ((int)paramEntry->DIR_Attr & 0x10) >> 4;
+    paramEntryAttributes->archive =  ((int)paramEntry->DIR_Attr & 0x20) >> 5;
+
+    paramEntryAttributes->is_file = (!paramEntryAttributes->directory & !paramEntryAttributes->volume_name);
+}
+
+/**
+ * Creates the entries attributes
+ * @param paramEntry - Entry for the entry attributes to be based off
+ * @return           - Returns the entry attributes
+ */
+EntryAttributes *createEntryAttributes(Entry *paramEntry) {
+
+    EntryAttributes *entryAttributes = (EntryAttributes *) malloc(sizeof(EntryAttributes));
+    setEntryAttributes(paramEntry, entryAttributes);
+
+    return entryAttributes;
+}
+
+/**
+ * A Long File Name is a 32 byte array that contains values used in a Long File Name entry in the directory
+ */
+struct __attribute__((__packed__)) LongFileNameEntry {
+    uint8_t         LDIR_Ord;               // Order/ position in sequence/ set
+    uint8_t         LDIR_Name1[ 10 ];       // First 5 UNICODE characters
+    uint8_t         LDIR_Attr;              // = ATTR_LONG_NAME (xx001111)
+    uint8_t         LDIR_Type;              // Should = 0
+    uint8_t         LDIR_Chksum;            // Checksum of short name
+    uint8_t         LDIR_Name2[ 12 ];       // Middle 6 UNICODE characters
+    uint16_t        LDIR_FstClusLO;         // MUST be zero
+    uint8_t         LDIR_Name3[ 4 ];        // Last 2 UNICODE characters
+}; typedef struct LongFileNameEntry LongFileNameEntry;
+
+/**
+ * Gets a long file name entry in place within a buffer, the entry is packed so it can be read at any byte
+ * @param paramBuffer       - Buffer holding the binary entry of the long file name
+ * @param paramEntryStart   - The first byte of the long file name entry
+ * @return                  - The long file name entry, valid for as long as the buffer
+ */
+LongFileNameEntry *getLongFileNameEntry(Buffer *paramBuffer, int paramEntryStart) {
+    return (LongFileNameEntry *) (paramBuffer->bufferPtr + paramEntryStart);
+}
+
+/**
+ * Decodes the 13 UCS-2 characters held in a long file name entry
+ * @param paramLongFileNameEntry - The long file name entry
+ * @param paramCharacters        - Where the 13 characters are written
+ */
+void getLongFileNameCharacters(LongFileNameEntry *paramLongFileNameEntry, wchar_t *paramCharacters) {
+
+    int nextCharacterPosition = 0;
+
+    for(int cIndex = 0; cIndex < 10; cIndex+=2) {
+        paramCharacters[nextCharacterPosition] = (wchar_t) (paramLongFileNameEntry->LDIR_Name1[cIndex] + paramLongFileNameEntry->LDIR_Name1[cIndex+1] * 256);
+        nextCharacterPosition++;
+    }
+
+    for(int cIndex = 0; cIndex < 12; cIndex+=2) {
+        paramCharacters[nextCharacterPosition] = (wchar_t) (paramLongFileNameEntry->LDIR_Name2[cIndex] + paramLongFileNameEntry->LDIR_Name2[cIndex+1] * 256);
+        nextCharacterPosition++;
+    }
+
+    for(int cIndex = 0; cIndex < 4; cIndex+=2) {
+        paramCharacters[nextCharacterPosition] = (wchar_t) (paramLongFileNameEntry->LDIR_Name3[cIndex] + paramLongFileNameEntry->LDIR_Name3[cIndex+1] * 256);
+        nextCharacterPosition++;
+    }
+}
+
+/**
+ * Calculates the checksum of a short name that is stored in LDIR_Chksum of its long file name entries
+ * @param paramShortName - The 11 byte short name
+ * @return               - The checksum
+ */
+uint8_t getShortNameChecksum(const uint8_t *paramShortName) {
+
+    uint8_t checksum = 0;
+
+    for(int index = 0; index < 11; index++) {
+        checksum = ((checksum & 1) ? 0x80 : 0) + (checksum >> 1) + paramShortName[index];
+    }
+
+    return checksum;
+}
+
+/**
+ * Checks that every long file name entry before a short entry holds the checksum of its short name, entries that
+ * do not were left behind by something that did not understand long file names
+ * @param paramLongFileNameEntries   - The long file name entries
+ * @param paramNumberOfLongFileNames - The number of long file name entries
+ * @param paramEntry                 - The short entry after them
+ * @return                           - 1 if the long file name belongs to the entry
+ */
+uint8_t isLongFileNameOfEntry(LongFileNameEntry *paramLongFileNameEntries, int paramNumberOfLongFileNames, Entry *paramEntry) {
+
+    uint8_t checksum = getShortNameChecksum(paramEntry->DIR_Name);
+
+    for(int index = 0; index < paramNumberOfLongFileNames; index++) {
+        if(paramLongFileNameEntries[index].LDIR_Chksum != checksum) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * A directory entry stores the filename long or short of the file / directory and the entry
+ *
+ * The long file name entries are left where they are in the directory's buffer and the name is only decoded by
+ * getDirectoryEntryName, until then longFileName is NULL and fileNameSize is 0
+ */
+struct __attribute__((__packed__)) DirectoryEntry {
+    Entry *entry;
+    EntryAttributes *entryAttributes;
+    wchar_t *longFileName;
+    int fileNameSize;
+
+    LongFileNameEntry *longFileNameEntries;     // In the directory's buffer, the last part of the name first
+    int numberOfLongFileNameEntries;
+
+}; typedef struct DirectoryEntry DirectoryEntry;
+
+/**
+ * Byte offsets of the 13 UCS-2 characters within a long file name entry
+ */
+static const uint8_t LONG_FILE_NAME_CHARACTER_OFFSETS[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+
+/**
+ * Gets a character of the long file name without decoding the rest of it
+ * @param paramDirectoryEntry - The directory entry, must have long file name entries
+ * @param paramIndex          - The position of the character in the name
+ * @return                    - The little endian UCS-2 character
+ */
+uint16_t getLongFileNameCharacter(DirectoryEntry *paramDirectoryEntry, int paramIndex) {
+    const uint8_t *longFileNameEntry = (const uint8_t *) (paramDirectoryEntry->longFileNameEntries +
+            paramDirectoryEntry->numberOfLongFileNameEntries - 1 - paramIndex / 13);
+    const uint8_t *character = longFileNameEntry + LONG_FILE_NAME_CHARACTER_OFFSETS[paramIndex % 13];
+    return (uint16_t) (character[0] | character[1] << 8);
+}
+
+/**
+ * Decodes the name of a directory entry the first time it is asked for, sets fileNameSize to its length
+ * @param paramDirectoryEntry - The directory entry, its buffer must not have been freed if the name is not decoded yet
+ * @return                    - The long file name, or the 11 character short name when there is none
+ */
+wchar_t *getDirectoryEntryName(DirectoryEntry *paramDirectoryEntry) {
+
+    if(paramDirectoryEntry->longFileName != NULL) {
+        return paramDirectoryEntry->longFileName;
+    }
+
+    if(paramDirectoryEntry->numberOfLongFileNameEntries == 0) {
+
+        wchar_t *entryName = (wchar_t *) malloc(sizeof(wchar_t) * 11);
+
+        for(int index = 0; index < 11; index++) {
+            entryName[index] = (wchar_t) paramDirectoryEntry->entry->DIR_Name[index];
+        }
+
+        paramDirectoryEntry->longFileName = entryName;
+        paramDirectoryEntry->fileNameSize = 11;
+        return entryName;
+    }
+
+    int maximumNameSize = paramDirectoryEntry->numberOfLongFileNameEntries * 13;
+
+    int totalNameSize = 0;
+    while(totalNameSize < maximumNameSize && getLongFileNameCharacter(paramDirectoryEntry, totalNameSize) != 0x0000) {
+        totalNameSize++;
+    }
+
+    wchar_t *entryName = (wchar_t *) malloc(sizeof(wchar_t) * (totalNameSize + 1));
+
+    for(int index = 0; index < totalNameSize; index++) {
+        entryName[index] = (wchar_t) getLongFileNameCharacter(paramDirectoryEntry, index);
+    }
+
+    paramDirectoryEntry->longFileName = entryName;
+    paramDirectoryEntry->fileNameSize = totalNameSize;
+    return entryName;
+}
+
+/**
+ * Checks the name of a directory entry against a name without decoding it, long file names are compared a UCS-2
+ * character at a time straight from the directory's buffer
+ * @param paramDirectoryEntry - The directory entry
+ * @param paramName           - The name being looked for
+ * @param paramNameLength     - The length of the name
+ * @return                    - 1 if the entry has the name
+ */
+uint8_t isDirectoryEntryNamed(DirectoryEntry *paramDirectoryEntry, wchar_t *paramName, int paramNameLength) {
+
+    if(paramDirectoryEntry->longFileName != NULL) {
+        return paramDirectoryEntry->fileNameSize == paramNameLength &&
+               memcmp(paramDirectoryEntry->longFileName, paramName, sizeof(wchar_t) * paramNameLength) == 0;
+    }
+
+    if(paramDirectoryEntry->numberOfLongFileNameEntries == 0) {
+        if(paramNameLength != 11) {
+            return 0;
+        }
+        for(int index = 0; index < 11; index++) {
+            if(paramName[index] != (wchar_t) paramDirectoryEntry->entry->DIR_Name[index]) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    int maximumNameSize = paramDirectoryEntry->numberOfLongFileNameEntries * 13;
+    if(paramNameLength > maximumNameSize) {
+        return 0;
+    }
+
+    for(int index = 0; index < paramNameLength; index++) {
+        uint16_t character = getLongFileNameCharacter(paramDirectoryEntry, index);
+        if(character == 0x0000 || paramName[index] != (wchar_t) character) {
+            return 0;
+        }
+    }
+
+    return paramNameLength == maximumNameSize || getLongFileNameCharacter(paramDirectoryEntry, paramNameLength) == 0x0000;
+}
+
+/**
+ * Prints the long file name from the directory entry
+ * @param paramDirectoryEntry - The entry containing the file name to be printed
+ * @param paramIndentSize     - The ident size
+ */
+void printLongFileName(DirectoryEntry *paramDirectoryEntry, int paramIndentSize) {
+
+    printIndent(paramIndentSize);
+
+    wchar_t *name = getDirectoryEntryName(paramDirectoryEntry);
+    printPath(name, paramDirectoryEntry->fileNameSize);
+    printOutput("\n");
+}
+
+/**
+ * Prints the date to console
+ * @param paramDate         - date value from directory entry
+ * @param paramIndentSize   - number of spaces before printed
+ */
+void print16BitDate(uint16_t paramDate, int paramIndentSize) {
+
+    int year = 1980;
+
+    year += (((long) paramDate & 0x0200) >> 9);
+    year += (((long) paramDate & 0x0400) >> 10) * 2;
+    year += (((long) paramDate & 0x0800) >> 11) * 4;
+    year += (((long) paramDate & 0x1000) >> 12) * 8;
+    year += (((long) paramDate & 0x2000) >> 13) * 16;
+    year += (((long) paramDate & 0x4000) >> 14) * 32;
+    year += (((long) paramDate & 0x8000) >> 15) * 64;
+
+    int month = 0;
+
+    month += (((long) paramDate & 0x0020) >> 5);
+    month += (((long) paramDate & 0x0040) >> 6) * 2;
+    month += (((long) paramDate & 0x0080) >> 7) * 4;
+    month += (((long) paramDate & 0x0100) >> 8) * 8;
+
+    int day = 0;
+
+    day += (((long) paramDate & 0x0001));
+    day += (((long) paramDate & 0x0002) >> 1) * 2;
+    day += (((long) paramDate & 0x0004) >> 2) * 4;
+    day += (((long) paramDate & 0x0008) >> 3) * 8;
+    day += (((long) paramDate & 0x0010) >> 4) * 16;
+
+
+    printIndent(paramIndentSize);
+    printOutput("%2d/%2d/%d\n", day, month, year);
+
+}
+
+/**
+ * Prints the time hour to console
+ * @param paramTime         - time value from directory entry
+ * @param paramIndentSize   - number of spaces before printed
+ */
+void print16BitTimeHour(uint16_t paramTime, int paramIndentSize) {
+
+    int hours = 0;
+
+    hours += (((long) paramTime & 0x0800) >> 11);
+    hours += (((long) paramTime & 0x1000) >> 12) * 2;
+    hours += (((long) paramTime & 0x2000) >> 13) * 4;
+    hours += (((long) paramTime & 0x4000) >> 14) * 8;
+    hours += (((long) paramTime & 0x8000) >> 15) * 16;
+
+    printIndent(paramIndentSize);
+    printOutput("%d\n", hours);
+
+}
+
+/**
+ * Prints the time minutes to console
+ * @param paramTime         - time value from directory entry
+ * @param paramIndentSize   - number of spaces before printed
+ */
+void print16BitTimeMinute(uint16_t paramTime, int paramIndentSize) {
+
+    int minutes = 0;
+
+    minutes += (((long) paramTime & 0x0020) >> 5);
+    minutes += (((long) paramTime & 0x0040) >> 6) * 2;
+    minutes += (((long) paramTime & 0x0080) >> 7) * 4;
+    minutes += (((long) paramTime & 0x0100) >> 8) * 8;
+    minutes += (((long) paramTime & 0x0200) >> 9) * 16;
+    minutes += (((long) paramTime & 0x0400) >> 10) * 32;
+
+    printIndent(paramIndentSize);
+    printOutput("%d\n", minutes);
+
+}
+
+/**
+ * Prints the time within 2 seconds to the console
+ * @param paramTime         - time value from directory entry
+ * @param paramIndentSize   - number of spaces before printed
+ */
+void print16BitTime2Seconds(uint16_t paramTime, int paramIndentSize) {
+
+    int seconds = 0;
+
+    seconds += (((long) paramTime & 0x0001));
+    seconds += (((long) paramTime & 0x0002) >> 1) * 2;
+    seconds += (((long) paramTime & 0x0004) >> 2) * 4;
+    seconds += (((long) paramTime & 0x0008) >> 3) * 8;
+    seconds += (((long) paramTime & 0x0010) >> 4) * 16;
+
+    printIndent(paramIndentSize);
+    printOutput("%d\n", seconds * 2);
+
+}
+
+/**
+ * Prints the seconds to 2dp
+ * @param paramTime         - time value from directory entry
+ * @param paramTenths       - numbers of tenths of seconds
+ * @param paramIndentSize   - number of spaces before printed
+ */
+void printTimeTenthSeconds(uint16_t paramTime, uint8_t paramTenths, int paramIndentSize) {
+
+    double seconds = 0;
+
+    seconds += (((long) paramTime & 0x0001));
+    seconds += (((long) paramTime & 0x0002) >> 1) * 2;
+    seconds += (((long) paramTime & 0x0004) >> 2) * 4;
+    seconds += (((long) paramTime & 0x0008) >> 3) * 8;
+    seconds += (((long) paramTime & 0x0010) >> 4) * 16;
+
+    seconds *= 2; seconds--;
+
+    seconds += (int) paramTenths / 100;
+
+    printIndent(paramIndentSize);
+    printOutput("%00.00f\n", seconds);
+
+
+}
+
+/**
+ * Pretty prints the directory entry to console
+ * @param paramDirectoryEntry - The directory entry being printed
+ * @param paramIndentSize     - The indent size of the print
+ */
+void printDirectoryEntry(DirectoryEntry *paramDirectoryEntry, int paramIndentSize) {
+    printOutput("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+    printOutput("File Name: ");
+    printLongFileName(paramDirectoryEntry, paramIndentSize);
+
+    printOutput("File Size: %d bytes\n", paramDirectoryEntry->entry->DIR_FileSize);
+
+    printOutput("\nFile Attributes:\n");
+    if(paramDirectoryEntry->entryAttributes->archive) printOutput("- Archive\n");
+    if(paramDirectoryEntry->entryAttributes->directory) printOutput("- Directory\n");
+    if(paramDirectoryEntry->entryAttributes->volume_name) printOutput("- Volume Name\n");
+    if(paramDirectoryEntry->entryAttributes->system) printOutput("- System\n");
+    if(paramDirectoryEntry->entryAttributes->hidden) printOutput("- Hidden\n");
+    if(paramDirectoryEntry->entryAttributes->read_only) printOutput("- Read Only\n");
+
+    printOutput("\nCreation Date: ");
+    print16BitDate(paramDirectoryEntry->entry->DIR_CrtDate, 0);
+    printOutput("Creation Time:\n- Hours: ");
+    print16BitTimeHour(paramDirectoryEntry->entry->DIR_CrtTime, 0);
+    printOutput("- Minutes: ");
+    print16BitTimeMinute(paramDirectoryEntry->entry->DIR_CrtTime, 0);
+    printOutput("- Seconds: ");
+    printTimeTenthSeconds(paramDirectoryEntry->entry->DIR_CrtTime, paramDirectoryEntry->entry->DIR_CrtTimeTenth, 0);
+
+    printOutput("\nLast Access Date: ");
+    print16BitDate(paramDirectoryEntry->entry->DIR_LstAccDate, 0);
+
+    printOutput("\nLast Write Date: ");
+    print16BitDate(paramDirectoryEntry->entry->DIR_WrtDate, 0);
+    printOutput("Last Write Time:\n- Hours: ");
+    print16BitTimeHour(paramDirectoryEntry->entry->DIR_WrtTime, 0);
+    printOutput("- Minutes: ");
+    print16BitTimeMinute(paramDirectoryEntry->entry->DIR_WrtTime, 0);
+    printOutput("- Seconds (2): ");
+    print16BitTime2Seconds(paramDirectoryEntry->entry->DIR_WrtTime, 0);
+
+    printOutput("-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n");
+}
+
+/**
+ * Creates a directory entry where all values are null
+ * @return the new directory entry
+ */
+DirectoryEntry *createDirectoryEntry() {
+    return (DirectoryEntry *) malloc(sizeof(DirectoryEntry));
+}
+
+/**
+ * Get all of the directory entries within a buffer / stops at 0x00. Long file names are not decoded, the entries
+ * point at their long file name entries in the buffer so it must be freed after the entries
+ * @param paramBuffer       - The buffer the entries are being generated from
+ * @param paramStartingByte - The starting byte for reading the buffer
+ * @return                  - A linked list containing all of the entries
+ */
+LinkedList *getAllEntriesFromDirectory(Buffer *paramBuffer, int paramStartingByte) {
+
+    LinkedList *entries = createLinkedList();
+    LinkedList *lastEntry = entries;
+
+    int startingByte = paramStartingByte;
+
+    int longFileNameEntryCount = 0;
+    while(startingByte < paramBuffer->size && paramBuffer->bufferPtr[startingByte] != 0x00) {
+
+        if(paramBuffer->bufferPtr[startingByte] == 0xe5) {
+            longFileNameEntryCount = 0;
+            startingByte += sizeof(Entry);
+            continue;
+        }
+
+        if(paramBuffer->bufferPtr[startingByte] == 0x2e) {                                          // File begins with "." meaning should not be read
+            longFileNameEntryCount = 0;
+            startingByte += sizeof(Entry);
+            continue;
+        }
+
+        if(paramBuffer->bufferPtr[startingByte + 11] == 0x0f) {                                     // Long File Name Entry
+            longFileNameEntryCount += 1;
+        } else {
+
+            Entry *entry = createEntry(paramBuffer, startingByte);
+
+            EntryAttributes *entryAttributes = createEntryAttributes(entry);
+            DirectoryEntry *directoryEntry = createDirectoryEntry();
+
+            directoryEntry->entry = entry;
+            directoryEntry->entryAttributes = entryAttributes;
+            directoryEntry->longFileName = NULL;
+            directoryEntry->fileNameSize = 0;
+            directoryEntry->longFileNameEntries = getLongFileNameEntry(paramBuffer, startingByte - longFileNameEntryCount * (int) sizeof(LongFileNameEntry));
+            directoryEntry->numberOfLongFileNameEntries = longFileNameEntryCount;
+
+            if(!isLongFileNameOfEntry(directoryEntry->longFileNameEntries, longFileNameEntryCount, entry)) {
+                directoryEntry->numberOfLongFileNameEntries = 0;                                    // Orphaned, use the short name
+            }
+
+            longFileNameEntryCount = 0;
+
+            lastEntry = addNewLink(lastEntry, directoryEntry);
+
+        }
+        startingByte += sizeof(Entry);
+    }
+
+    return entries;
+}
+
+
+/**
+ * Gets the first cluster of an entry
+ * @param paramEntry - The entry
+ * @return           - The first cluster made from DIR_FstClusHI and DIR_FstClusLO
+ */
+int getFirstClusterOfEntry(Entry *paramEntry) {
+    return ((int) paramEntry->DIR_FstClusHI << 16) | paramEntry->DIR_FstClusLO;
+}
+
+/**
+ * Frees a linked list of directory entries along with every entry in it
+ * @param paramEntries - Linked list from getAllEntriesFromDirectory
+ */
+void freeDirectoryEntries(LinkedList *paramEntries) {
+
+    LinkedList *entry = paramEntries;
+    while(entry->next != NULL) {
+        entry = entry->next;
+        DirectoryEntry *directoryEntry = (DirectoryEntry *) entry->pointer;
+
+        free(directoryEntry->entry);
+        free(directoryEntry->entryAttributes);
+        free(directoryEntry->longFileName);
+        free(directoryEntry);
+    }
+    freeLinkedList(paramEntries);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
 /// |                                      Root Directory                                              |
 /// |                                                                                                  |
 /// +--------------------------------------------------------------------------------------------------+
 
 /*
- * The root directory is a standard directory that is common in all fat images
- * It is located after the FAT tables.
+ * The root directory is a standard directory that is common in all fat images
+ * On FAT12 and FAT16 it is a fixed region located after the FAT tables, on FAT32 it is a chain of clusters starting
+ * at BPB_RootClus. Entries pointing at the root directory hold cluster 0 on every type.
+ */
+
+/**
+ * Gets the cluster a directory's chain starts at
+ * @param paramVolume       - The volume of the directory
+ * @param paramFirstCluster - The first cluster of the directory, 0 for the root directory
+ * @return                  - The first cluster of the chain, 0 when it is the fixed root directory region
+ */
+int getDirectoryChainStart(Volume *paramVolume, int paramFirstCluster) {
+    return paramFirstCluster == 0 ? paramVolume->rootDirectoryCluster : paramFirstCluster;
+}
+
+/**
+ * Copies the root directory into a buffer
+ * @param paramVolume - The volume of the root directory
+ * @return            - A buffer holding every slot of the root directory
+ */
+Buffer *readRootDirectory(Volume *paramVolume) {
+    if(paramVolume->rootDirectoryCluster != 0) {
+        return readClusterChain(paramVolume, paramVolume->rootDirectoryCluster);
+    }
+    Buffer *buffer = createBuffer(paramVolume->bootSector->BPB_RootEntCnt * sizeof(Entry));
+    readVolumeBytes(paramVolume, (long) paramVolume->sectorRootDirectoryStart * paramVolume->bootSector->BPB_BytsPerSec, buffer->bufferPtr, buffer->size);
+    return buffer;
+}
+
+/**
+ * Reads a directory from a volume, the root directory when the cluster is 0
+ */
+Buffer *readDirectory(Volume *paramVolume, int paramFirstCluster) {
+    if(paramFirstCluster == 0) {
+        return readRootDirectory(paramVolume);
+    }
+    return readClusterChain(paramVolume, paramFirstCluster);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                              Search                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Uses other functions to aid all methods in searching for a file within the FAT16 image
+ */
+
+/**
+ * A search result contains the directory entry of the file found, along with the directory it was found in which
+ * holds the entry's long file name
+ */
+struct SearchResult {
+    DirectoryEntry *directoryEntryPtr;
+    LinkedList *directoryEntries;
+    Buffer *directoryBuffer;
+}; typedef struct SearchResult SearchResult;
+
+/**
+ * Creates a search result struct
+ * @param paramDirectoryEntry   - The Directory Entry
+ * @param paramDirectoryEntries - The entries of the directory it was found in, owned by the search result
+ * @param paramDirectoryBuffer  - The buffer of the directory it was found in, owned by the search result
+ * @return                      - Returns a new search result with these values
+ */
+SearchResult *createSearchResult(DirectoryEntry *paramDirectoryEntry, LinkedList *paramDirectoryEntries, Buffer *paramDirectoryBuffer) {
+
+    SearchResult *searchResult = (SearchResult *) malloc(sizeof(SearchResult));
+
+    searchResult->directoryEntryPtr = paramDirectoryEntry;
+    searchResult->directoryEntries = paramDirectoryEntries;
+    searchResult->directoryBuffer = paramDirectoryBuffer;
+
+    return searchResult;
+}
+
+/**
+ * Frees a search result and the directory it was found in
+ * @param paramSearchResult - The search result
+ */
+void freeSearchResult(SearchResult *paramSearchResult) {
+    freeDirectoryEntries(paramSearchResult->directoryEntries);
+    freeBuffer(paramSearchResult->directoryBuffer);
+    free(paramSearchResult);
+}
+
+/**
+ * Recursively search through each directory then sub directory until the file is found
+ * @param paramVolume       - The volume being searched
+ * @param paramEntries      - The directory entries being searched through
+ * @param paramBuffer       - The buffer the entries were read from
+ * @param paramFileLocation - The location of the file being found
+ * @param paramSearchResult - Set to the search result when the file is found
+ * @return                  - EXCEPTION_NONE or EXCEPTION_FILE_DOES_NOT_EXIST
+ */
+int recursiveSearch(Volume *paramVolume, LinkedList *paramEntries, Buffer *paramBuffer, wchar_t *paramFileLocation, int paramFileLocationLength, SearchResult **paramSearchResult) {
+
+    /*
+     * Break down the file path
+     *
+     * searchEnquiry is the entry being searched for
+     * remainingFileLocation is the rest of the file location to be searched for
+     */
+    int searchEnquiryLength = 0;
+    for(; searchEnquiryLength < paramFileLocationLength; searchEnquiryLength++) {
+        if(paramFileLocation[searchEnquiryLength] == '/') {
+            break;
+        }
+    }
+
+    if(searchEnquiryLength == 0) {
+        return EXCEPTION_FILE_DOES_NOT_EXIST;
+    }
+
+    wchar_t searchEnquiry[searchEnquiryLength];
+    memcpy(&searchEnquiry, paramFileLocation, searchEnquiryLength * sizeof(wchar_t));
+
+    int remainingFileLocationLength = paramFileLocationLength - searchEnquiryLength - 1;
+
+    LinkedList *entry = paramEntries; // Loading in the first entry null entry at the start of linked list
+
+    while(entry->next != NULL) {
+        entry = entry->next; // loading in the first non-null entry
+        DirectoryEntry *directoryEntry = entry->pointer; // casting the pointer in the entry to a DirectoryEntry
+
+        if(!isDirectoryEntryNamed(directoryEntry, searchEnquiry, searchEnquiryLength)) {
+            continue;
+        }
+
+        if(directoryEntry->entryAttributes->volume_name && remainingFileLocationLength > 0) {
+            if(remainingFileLocationLength > 0) {
+                wchar_t remainingFileLocation[remainingFileLocationLength];
+                memcpy(&remainingFileLocation, paramFileLocation + searchEnquiryLength + 1,
+                       remainingFileLocationLength * sizeof(wchar_t));
+
+                return recursiveSearch(paramVolume, paramEntries, paramBuffer, remainingFileLocation, remainingFileLocationLength, paramSearchResult);
+            }
+        }
+
+        if(paramFileLocationLength - searchEnquiryLength == 0 && directoryEntry->entryAttributes->is_file) {
+            *paramSearchResult = createSearchResult(directoryEntry, paramEntries, paramBuffer);
+            return EXCEPTION_NONE;
+        }
+
+        int firstCluster = getFirstClusterOfEntry(directoryEntry->entry);
+
+        if(directoryEntry->entryAttributes->directory && isValidCluster(paramVolume, firstCluster)) {
+            if(remainingFileLocationLength > 0) {
+                wchar_t remainingFileLocation[remainingFileLocationLength];
+                memcpy(&remainingFileLocation, paramFileLocation + searchEnquiryLength + 1,
+                       remainingFileLocationLength * sizeof(wchar_t));
+
+                Buffer *directoryBuffer = readClusterChain(paramVolume, firstCluster);
+                LinkedList *directory = getAllEntriesFromDirectory(directoryBuffer, 0);
+
+                int exception = recursiveSearch(paramVolume, directory, directoryBuffer, remainingFileLocation, remainingFileLocationLength, paramSearchResult);
+                if(exception != EXCEPTION_NONE || (*paramSearchResult)->directoryEntries != directory) {
+                    freeDirectoryEntries(directory);
+                    freeBuffer(directoryBuffer);
+                }
+                return exception;
+            }
+        }
+
+
+    }
+
+    return EXCEPTION_FILE_DOES_NOT_EXIST;
+}
+
+/**
+ * Used to begin a search at the root directory, finding the firs LinkedList of entries
+ * @param paramVolume       - The volume being searched
+ * @param paramFileLocation - The location of the file being found
+ * @param paramSearchResult - Set to the search result when the file is found
+ * @return                  - EXCEPTION_NONE or EXCEPTION_FILE_DOES_NOT_EXIST
+ */
+int searchForFile(Volume *paramVolume, wchar_t *paramFileLocation, int paramFileLocationLength, SearchResult **paramSearchResult) {
+
+    Buffer *rootDirectory = readRootDirectory(paramVolume);
+    LinkedList *rootDirectoryEntries = getAllEntriesFromDirectory(rootDirectory, 0);
+
+    int exception = recursiveSearch(paramVolume, rootDirectoryEntries, rootDirectory, paramFileLocation, paramFileLocationLength, paramSearchResult);
+    if(exception != EXCEPTION_NONE || (*paramSearchResult)->directoryEntries != rootDirectoryEntries) {
+        freeDirectoryEntries(rootDirectoryEntries);
+        freeBuffer(rootDirectory);
+    }
+    return exception;
+}
+
+/**
+ * Prints part of a file as ASCII text, used as the consumer when streaming a file
+ * @param paramBytes   - The bytes of the extent
+ * @param paramLength  - The number of bytes
+ * @param paramContext - Unused
+ */
+void printExtentAsASCII(const unsigned char *paramBytes, size_t paramLength, void *paramContext) {
+    (void) paramContext;
+    Buffer extent = {(long) paramLength, (unsigned char *) paramBytes};
+    printBufferAsASCII(&extent, 0);
+}
+
+/**
+ * Prints the contents of a file as ASCII text one extent at a time, so the file is never held in memory
+ * @param paramVolume         - The volume the file belongs to
+ * @param paramDirectoryEntry - The directory entry of the file
+ */
+void printFileContents(Volume *paramVolume, DirectoryEntry *paramDirectoryEntry) {
+    streamClusterChain(paramVolume, getFirstClusterOfEntry(paramDirectoryEntry->entry), paramDirectoryEntry->entry->DIR_FileSize, printExtentAsASCII, NULL);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                           Write Cache                                            |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Changes to a volume are made to the bytes held in memory and the sectors they touch are marked dirty. Nothing
+ * reaches the image until the volume is flushed, where the dirty sectors are sorted and joined into as few writes
+ * as possible. Each sector is marked with the kind of write that dirtied it so a flush can write every data
+ * sector before any FAT sector and every FAT sector before any directory sector, syncing in between. A crash
+ * part way through a flush then leaves at worst clusters that are allocated but not yet referenced.
+ */
+
+#define WRITE_KIND_DATA 0
+#define WRITE_KIND_FAT 1
+#define WRITE_KIND_DIRECTORY 2
+#define NUMBER_OF_WRITE_KINDS 3
+
+#define WRITE_COALESCE_GAP_SECTORS 8
+
+/**
+ * The write cache tracks which sectors of a volume have changed since the last flush
+ */
+struct WriteCache {
+    int fileDescriptor;                                 // The image opened for writing
+    int numberOfSectors;                                // Number of sectors in the image
+    uint64_t *dirtySectors[NUMBER_OF_WRITE_KINDS];      // One bit per sector for each kind of write
+    int numberOfDirtySectors[NUMBER_OF_WRITE_KINDS];    // Number of bits set for each kind of write
+
+    long numberOfWrites;                                // Writes made by every flush so far
+    long numberOfSectorsWritten;                        // Sectors written by every flush so far
+    int nextFreeCluster;                                // Where the search for a free cluster starts
+
+}; typedef struct WriteCache WriteCache;
+
+/**
+ * Creates the write cache of a volume
+ * @param paramVolume         - The volume being written to
+ * @param paramFileDescriptor - The image opened for reading and writing
+ * @return                    - The write cache with no dirty sectors
+ */
+WriteCache *createWriteCache(Volume *paramVolume, int paramFileDescriptor) {
+
+    WriteCache *writeCache = (WriteCache *) calloc(1, sizeof(WriteCache));
+    writeCache->fileDescriptor = paramFileDescriptor;
+    writeCache->numberOfSectors = paramVolume->buffer->size / paramVolume->bootSector->BPB_BytsPerSec;
+    writeCache->nextFreeCluster = paramVolume->nextFreeClusterHint;
+
+    for(int kind = 0; kind < NUMBER_OF_WRITE_KINDS; kind++) {
+        writeCache->dirtySectors[kind] = (uint64_t *) calloc((writeCache->numberOfSectors + 63) / 64, sizeof(uint64_t));
+    }
+
+    return writeCache;
+}
+
+/**
+ * Frees a write cache and closes its image, any sectors not yet flushed are lost
+ * @param paramWriteCache - The write cache being freed
+ */
+void freeWriteCache(WriteCache *paramWriteCache) {
+    for(int kind = 0; kind < NUMBER_OF_WRITE_KINDS; kind++) {
+        free(paramWriteCache->dirtySectors[kind]);
+    }
+    close(paramWriteCache->fileDescriptor);
+    free(paramWriteCache);
+}
+
+/**
+ * Opens an image for writing, the volume gets a write cache that holds its changes until flushed
+ * @param paramImageLocation - The location of the image being opened
+ * @param paramVolume        - Set to the volume
+ * @return                   - EXCEPTION_NONE, EXCEPTION_UNABLE_TO_OPEN_FILE or EXCEPTION_IMAGE_TOO_LARGE as the image
+ *                             is written from memory
+ */
+int openVolumeForWriting(char *paramImageLocation, Volume **paramVolume) {
+
+    int fileDescriptor = open(paramImageLocation, O_RDWR);
+    if(fileDescriptor < 0) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    int exception = openVolume(paramImageLocation, paramVolume);
+    if(exception != EXCEPTION_NONE) {
+        close(fileDescriptor);
+        return exception;
+    }
+    (*paramVolume)->writeCache = createWriteCache(*paramVolume, fileDescriptor);
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Marks every sector overlapping a range of bytes as dirty
+ * @param paramVolume - The volume being written to
+ * @param paramOffset - The first byte of the range
+ * @param paramLength - The number of bytes in the range
+ * @param paramKind   - The kind of write, deciding when the sectors are flushed
+ */
+void markSectorsDirty(Volume *paramVolume, long paramOffset, long paramLength, int paramKind) {
+
+    WriteCache *writeCache = paramVolume->writeCache;
+    int bytesPerSector = paramVolume->bootSector->BPB_BytsPerSec;
+    uint64_t *dirtySectors = writeCache->dirtySectors[paramKind];
+
+    long lastSector = (paramOffset + paramLength - 1) / bytesPerSector;
+    for(long sector = paramOffset / bytesPerSector; sector <= lastSector; sector++) {
+        uint64_t bit = (uint64_t) 1 << (sector % 64);
+        if(!(dirtySectors[sector / 64] & bit)) {
+            dirtySectors[sector / 64] |= bit;
+            writeCache->numberOfDirtySectors[paramKind]++;
+        }
+    }
+}
+
+/**
+ * Writes bytes into a volume, they reach the image on the next flush
+ * @param paramVolume - The volume being written to, it must have a write cache
+ * @param paramOffset - Where in the image the bytes are written
+ * @param paramBytes  - The bytes being written
+ * @param paramLength - The number of bytes
+ * @param paramKind   - The kind of write, one of the WRITE_KIND values
+ */
+void writeVolumeBytes(Volume *paramVolume, long paramOffset, const void *paramBytes, long paramLength, int paramKind) {
+    if(paramLength <= 0) {
+        return;
+    }
+    memcpy(paramVolume->buffer->bufferPtr + paramOffset, paramBytes, paramLength);
+    markSectorsDirty(paramVolume, paramOffset, paramLength, paramKind);
+}
+
+/**
+ * Zeros bytes of a volume, they reach the image on the next flush
+ * @param paramVolume - The volume being written to, it must have a write cache
+ * @param paramOffset - The first byte being zeroed
+ * @param paramLength - The number of bytes
+ * @param paramKind   - The kind of write, one of the WRITE_KIND values
+ */
+void zeroVolumeBytes(Volume *paramVolume, long paramOffset, long paramLength, int paramKind) {
+    if(paramLength <= 0) {
+        return;
+    }
+    memset(paramVolume->buffer->bufferPtr + paramOffset, 0, paramLength);
+    markSectorsDirty(paramVolume, paramOffset, paramLength, paramKind);
+}
+
+/**
+ * Sets the entry of a cluster in every copy of the FAT
+ * @param paramVolume        - The volume being written to, it must have a write cache
+ * @param paramClusterNumber - The cluster entry number
+ * @param paramValue         - The value stored for the cluster, FAT_END_OF_CHAIN ends a chain on every type of FAT
+ */
+void setFatEntry(Volume *paramVolume, int paramClusterNumber, uint32_t paramValue) {
+
+    const FatBackend *fat = paramVolume->fat;
+
+    for(int fatIndex = 0; fatIndex < paramVolume->bootSector->BPB_NumFATs; fatIndex++) {
+        long fatEntryOffset = getFatEntryOffset(paramVolume, fatIndex, paramClusterNumber);
+
+        unsigned char fatEntry[4];
+        memcpy(fatEntry, paramVolume->buffer->bufferPtr + fatEntryOffset, fat->entryBytes);
+        fat->encodeEntry(fatEntry, paramClusterNumber, paramValue);
+        writeVolumeBytes(paramVolume, fatEntryOffset, fatEntry, fat->entryBytes, WRITE_KIND_FAT);
+    }
+}
+
+/**
+ * Writes the free cluster hints of a FAT32 volume back into its FSInfo sector
+ * @param paramVolume - The volume being written to, it must have a write cache
+ */
+void writeFsInfo(Volume *paramVolume) {
+
+    if(paramVolume->sectorFsInfo == 0) {
+        return;
+    }
+
+    long fsInfoStart = (long) paramVolume->sectorFsInfo * paramVolume->bootSector->BPB_BytsPerSec;
+    uint32_t hints[2];
+    hints[0] = paramVolume->freeClusterHint < 0 ? FSINFO_UNKNOWN : (uint32_t) paramVolume->freeClusterHint;
+    hints[1] = (uint32_t) paramVolume->writeCache->nextFreeCluster;
+
+    writeVolumeBytes(paramVolume, fsInfoStart + offsetof(FsInfo, FSI_Free_Count), hints, sizeof(hints), WRITE_KIND_FAT);
+}
+
+/**
+ * Checks whether a sector is dirty for any kind of write
+ * @param paramWriteCache - The write cache of the volume
+ * @param paramSector     - The sector being checked
+ * @return                - 1 if any kind of write has dirtied the sector
+ */
+uint8_t isSectorDirty(WriteCache *paramWriteCache, long paramSector) {
+    uint64_t bit = (uint64_t) 1 << (paramSector % 64);
+    for(int kind = 0; kind < NUMBER_OF_WRITE_KINDS; kind++) {
+        if(paramWriteCache->dirtySectors[kind][paramSector / 64] & bit) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Gets the next dirty sector of one kind
+ * @param paramWriteCache - The write cache of the volume
+ * @param paramKind       - The kind of write
+ * @param paramSector     - The sector the search starts at
+ * @return                - The next dirty sector, or the number of sectors when there are none
+ */
+long getNextDirtySector(WriteCache *paramWriteCache, int paramKind, long paramSector) {
+
+    uint64_t *dirtySectors = paramWriteCache->dirtySectors[paramKind];
+    long numberOfWords = (paramWriteCache->numberOfSectors + 63) / 64;
+
+    if(paramSector >= paramWriteCache->numberOfSectors) {
+        return paramWriteCache->numberOfSectors;
+    }
+
+    long wordIndex = paramSector / 64;
+    uint64_t word = dirtySectors[wordIndex] & (~(uint64_t) 0 << (paramSector % 64));
+
+    while(word == 0) {
+        if(++wordIndex >= numberOfWords) {
+            return paramWriteCache->numberOfSectors;
+        }
+        word = dirtySectors[wordIndex];
+    }
+
+    return wordIndex * 64 + __builtin_ctzll(word);
+}
+
+/**
+ * Writes a run of sectors from memory to the image
+ * @param paramVolume      - The volume being flushed
+ * @param paramFirstSector - The first sector of the run
+ * @param paramLastSector  - The last sector of the run
+ * @return                 - 1 if every byte was written
+ */
+uint8_t writeSectorRun(Volume *paramVolume, long paramFirstSector, long paramLastSector) {
+
+    int bytesPerSector = paramVolume->bootSector->BPB_BytsPerSec;
+    long offset = paramFirstSector * bytesPerSector;
+    long remaining = (paramLastSector - paramFirstSector + 1) * bytesPerSector;
+
+    while(remaining > 0) {
+        ssize_t written = pwrite(paramVolume->writeCache->fileDescriptor, paramVolume->buffer->bufferPtr + offset, remaining, offset);
+        if(written <= 0) {
+            return 0;
+        }
+        offset += written;
+        remaining -= written;
+    }
+
+    paramVolume->writeCache->numberOfWrites++;
+    paramVolume->writeCache->numberOfSectorsWritten += paramLastSector - paramFirstSector + 1;
+    return 1;
+}
+
+/**
+ * Writes every dirty sector of one kind in order of position, joining sectors that are next to each other. Small
+ * gaps of sectors that are not dirty for any kind are written as well, as memory already holds what the image does,
+ * so that a run is not split into several writes for the sake of a sector or two.
+ * @param paramVolume - The volume being flushed
+ * @param paramKind   - The kind of write being flushed
+ * @return            - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_WRITE_FILE
+ */
+int flushWriteKind(Volume *paramVolume, int paramKind) {
+
+    WriteCache *writeCache = paramVolume->writeCache;
+
+    long firstSector = getNextDirtySector(writeCache, paramKind, 0);
+    while(firstSector < writeCache->numberOfSectors) {
+
+        long lastSector = firstSector;
+        long nextSector = getNextDirtySector(writeCache, paramKind, lastSector + 1);
+
+        while(nextSector < writeCache->numberOfSectors && nextSector - lastSector - 1 <= WRITE_COALESCE_GAP_SECTORS) {
+            uint8_t is_gap_clean = 1;
+            for(long sector = lastSector + 1; sector < nextSector; sector++) {
+                if(isSectorDirty(writeCache, sector)) {
+                    is_gap_clean = 0;
+                    break;
+                }
+            }
+            if(!is_gap_clean) {
+                break;
+            }
+            lastSector = nextSector;
+            nextSector = getNextDirtySector(writeCache, paramKind, lastSector + 1);
+        }
+
+        if(!writeSectorRun(paramVolume, firstSector, lastSector)) {
+            return EXCEPTION_UNABLE_TO_WRITE_FILE;
+        }
+
+        firstSector = nextSector;
+    }
+
+    memset(writeCache->dirtySectors[paramKind], 0, sizeof(uint64_t) * ((writeCache->numberOfSectors + 63) / 64));
+    writeCache->numberOfDirtySectors[paramKind] = 0;
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Flushes every dirty sector of a volume to its image and waits for them to be stored. Data is written first,
+ * then the FAT, then the directories, with a sync after each so that they are stored in that order.
+ * @param paramVolume - The volume being flushed, it must have a write cache
+ * @return            - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_WRITE_FILE
+ */
+int flushVolume(Volume *paramVolume) {
+
+    WriteCache *writeCache = paramVolume->writeCache;
+
+    if(writeCache->numberOfDirtySectors[WRITE_KIND_FAT] != 0) {
+        writeFsInfo(paramVolume);
+    }
+
+    for(int kind = 0; kind < NUMBER_OF_WRITE_KINDS; kind++) {
+        if(writeCache->numberOfDirtySectors[kind] == 0) {
+            continue;
+        }
+
+        int exception = flushWriteKind(paramVolume, kind);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+
+        if(fdatasync(writeCache->fileDescriptor) != 0) {
+            return EXCEPTION_UNABLE_TO_WRITE_FILE;
+        }
+    }
+
+    return EXCEPTION_NONE;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                               Usage                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Usage counts how the clusters of the data region are used by reading every entry in the first FAT. The FSInfo
+ * count of a FAT32 volume is only a hint, so it is checked against the FAT rather than trusted.
+ */
+
+/**
+ * Prints how many clusters are used, free and bad on the volume
+ * @param paramVolume - The volume being counted
+ */
+void printUsage(Volume *paramVolume) {
+
+    FatUsage usage;
+    countFatEntries(paramVolume, &usage);
+
+    long long totalBytes = (long long) paramVolume->numberOfClusters * paramVolume->bytesPerCluster;
+    long long usedBytes = (long long) usage.usedClusters * paramVolume->bytesPerCluster;
+
+    printOutput("Type: %s\n", paramVolume->fat->name);
+    printOutput("Clusters: %d total, %ld used, %ld free, %ld bad\n", paramVolume->numberOfClusters, usage.usedClusters, usage.freeClusters, usage.badClusters);
+    if(paramVolume->freeClusterHint >= 0 && paramVolume->freeClusterHint != usage.freeClusters) {
+        printOutput("FSInfo: %ld free clusters recorded, out of date\n", paramVolume->freeClusterHint);
+    }
+    printOutput("Space: %lld of %lld bytes used (%.2f%%)\n", usedBytes, totalBytes, totalBytes == 0 ? 0.0 : (100.0 * usedBytes) / totalBytes);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                         Thread Pool                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The thread pool runs tasks on a fixed number of worker threads. Tasks are queued in the order they are
+ * submitted and each worker takes the next task as soon as it has finished its last one.
+ */
+
+/**
+ * A task is a function and the argument it is called with
+ */
+struct ThreadPoolTask {
+    void (*function)(void *);
+    void *argument;
+    struct ThreadPoolTask *next;
+}; typedef struct ThreadPoolTask ThreadPoolTask;
+
+/**
+ * The thread pool stores its workers and the queue of tasks waiting to be run
+ */
+struct ThreadPool {
+    pthread_t *threads;
+    int numberOfThreads;
+
+    ThreadPoolTask *firstTask;          // Next task to be run
+    ThreadPoolTask *lastTask;           // Last task submitted
+    int unfinishedTasks;                // Tasks queued or running
+    uint8_t is_shutting_down;
+
+    pthread_mutex_t lock;
+    pthread_cond_t taskAvailable;
+    pthread_cond_t tasksFinished;
+
+}; typedef struct ThreadPool ThreadPool;
+
+/**
+ * Gets the number of processors that are online
+ * @return - The number of processors, at least 1
+ */
+int getNumberOfProcessors() {
+    long numberOfProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    if(numberOfProcessors < 1) {
+        return 1;
+    }
+    return (int) numberOfProcessors;
+}
+
+/**
+ * Runs tasks from the queue until the pool is shut down
+ * @param paramThreadPool - The thread pool the worker belongs to
+ * @return                - NULL
+ */
+void *runThreadPoolWorker(void *paramThreadPool) {
+
+    ThreadPool *threadPool = (ThreadPool *) paramThreadPool;
+
+    pthread_mutex_lock(&threadPool->lock);
+
+    while(1) {
+        while(threadPool->firstTask == NULL && !threadPool->is_shutting_down) {
+            pthread_cond_wait(&threadPool->taskAvailable, &threadPool->lock);
+        }
+
+        if(threadPool->firstTask == NULL) {
+            break;
+        }
+
+        ThreadPoolTask *task = threadPool->firstTask;
+        threadPool->firstTask = task->next;
+        if(threadPool->firstTask == NULL) {
+            threadPool->lastTask = NULL;
+        }
+
+        pthread_mutex_unlock(&threadPool->lock);
+        task->function(task->argument);
+        free(task);
+        pthread_mutex_lock(&threadPool->lock);
+
+        threadPool->unfinishedTasks--;
+        if(threadPool->unfinishedTasks == 0) {
+            pthread_cond_broadcast(&threadPool->tasksFinished);
+        }
+    }
+
+    pthread_mutex_unlock(&threadPool->lock);
+
+    return NULL;
+}
+
+/**
+ * Creates a thread pool and starts its workers
+ * @param paramNumberOfThreads - The number of worker threads
+ * @param paramThreadPool      - Set to the thread pool
+ * @return                     - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_CREATE_THREAD
+ */
+int createThreadPool(int paramNumberOfThreads, ThreadPool **paramThreadPool) {
+
+    ThreadPool *threadPool = (ThreadPool *) malloc(sizeof(ThreadPool));
+    threadPool->threads = (pthread_t *) malloc(sizeof(pthread_t) * paramNumberOfThreads);
+    threadPool->numberOfThreads = 0;
+    threadPool->firstTask = NULL;
+    threadPool->lastTask = NULL;
+    threadPool->unfinishedTasks = 0;
+    threadPool->is_shutting_down = 0;
+
+    pthread_mutex_init(&threadPool->lock, NULL);
+    pthread_cond_init(&threadPool->taskAvailable, NULL);
+    pthread_cond_init(&threadPool->tasksFinished, NULL);
+
+    for(int index = 0; index < paramNumberOfThreads; index++) {
+        if(pthread_create(threadPool->threads + index, NULL, runThreadPoolWorker, threadPool) != 0) {
+            break;
+        }
+        threadPool->numberOfThreads++;
+    }
+
+    if(threadPool->numberOfThreads == 0) {
+        return EXCEPTION_UNABLE_TO_CREATE_THREAD;
+    }
+
+    *paramThreadPool = threadPool;
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Adds a task to the back of the queue
+ * @param paramThreadPool - The thread pool running the task
+ * @param paramFunction   - The function being run
+ * @param paramArgument   - The argument the function is called with
+ */
+void submitTaskToThreadPool(ThreadPool *paramThreadPool, void (*paramFunction)(void *), void *paramArgument) {
+
+    ThreadPoolTask *task = (ThreadPoolTask *) malloc(sizeof(ThreadPoolTask));
+    task->function = paramFunction;
+    task->argument = paramArgument;
+    task->next = NULL;
+
+    pthread_mutex_lock(&paramThreadPool->lock);
+
+    if(paramThreadPool->lastTask == NULL) {
+        paramThreadPool->firstTask = task;
+    } else {
+        paramThreadPool->lastTask->next = task;
+    }
+    paramThreadPool->lastTask = task;
+    paramThreadPool->unfinishedTasks++;
+
+    pthread_cond_signal(&paramThreadPool->taskAvailable);
+    pthread_mutex_unlock(&paramThreadPool->lock);
+}
+
+/**
+ * Waits until every submitted task has finished
+ * @param paramThreadPool - The thread pool being waited on
+ */
+void waitForThreadPool(ThreadPool *paramThreadPool) {
+
+    pthread_mutex_lock(&paramThreadPool->lock);
+    while(paramThreadPool->unfinishedTasks > 0) {
+        pthread_cond_wait(&paramThreadPool->tasksFinished, &paramThreadPool->lock);
+    }
+    pthread_mutex_unlock(&paramThreadPool->lock);
+}
+
+/**
+ * Finishes the remaining tasks, stops the workers and frees the thread pool
+ * @param paramThreadPool - The thread pool being freed
+ */
+void freeThreadPool(ThreadPool *paramThreadPool) {
+
+    pthread_mutex_lock(&paramThreadPool->lock);
+    paramThreadPool->is_shutting_down = 1;
+    pthread_cond_broadcast(&paramThreadPool->taskAvailable);
+    pthread_mutex_unlock(&paramThreadPool->lock);
+
+    for(int index = 0; index < paramThreadPool->numberOfThreads; index++) {
+        pthread_join(paramThreadPool->threads[index], NULL);
+    }
+
+    pthread_mutex_destroy(&paramThreadPool->lock);
+    pthread_cond_destroy(&paramThreadPool->taskAvailable);
+    pthread_cond_destroy(&paramThreadPool->tasksFinished);
+
+    free(paramThreadPool->threads);
+    free(paramThreadPool);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                              Hashing                                             |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * CRC32C (Castagnoli) and SHA-256 are both fed a piece at a time so that a file can be hashed straight from its
+ * clusters. CRC32C uses the SSE4.2 crc32 instruction when the processor has it and a table otherwise. Two CRC32C
+ * values can be combined, which lets the pieces of a large file be hashed apart, SHA-256 cannot.
+ */
+
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+static uint32_t crc32cTable[8][256];
+static pthread_once_t crc32cTableOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Fills the slice-by-8 table used when the crc32 instruction is not available
+ */
+void createCrc32cTable() {
+
+    for(int index = 0; index < 256; index++) {
+        uint32_t crc = index;
+        for(int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+        }
+        crc32cTable[0][index] = crc;
+    }
+
+    for(int index = 0; index < 256; index++) {
+        for(int slice = 1; slice < 8; slice++) {
+            crc32cTable[slice][index] = (crc32cTable[slice - 1][index] >> 8) ^ crc32cTable[0][crc32cTable[slice - 1][index] & 0xFF];
+        }
+    }
+}
+
+/**
+ * Continues a CRC32C over more bytes using the table
+ * @param paramCrc    - The CRC of the bytes before, 0 to start
+ * @param paramBytes  - The bytes being added
+ * @param paramLength - The number of bytes
+ * @return            - The CRC including the new bytes
+ */
+uint32_t updateCrc32cTable(uint32_t paramCrc, const unsigned char *paramBytes, size_t paramLength) {
+
+    uint32_t crc = ~paramCrc;
+
+    while(paramLength >= 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, paramBytes, 4);
+        memcpy(&high, paramBytes + 4, 4);
+        low ^= crc;
+
+        crc = crc32cTable[7][low & 0xFF] ^ crc32cTable[6][(low >> 8) & 0xFF] ^
+              crc32cTable[5][(low >> 16) & 0xFF] ^ crc32cTable[4][low >> 24] ^
+              crc32cTable[3][high & 0xFF] ^ crc32cTable[2][(high >> 8) & 0xFF] ^
+              crc32cTable[1][(high >> 16) & 0xFF] ^ crc32cTable[0][high >> 24];
+
+        paramBytes += 8;
+        paramLength -= 8;
+    }
+
+    while(paramLength > 0) {
+        crc = (crc >> 8) ^ crc32cTable[0][(crc ^ *paramBytes) & 0xFF];
+        paramBytes++;
+        paramLength--;
+    }
+
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+/**
+ * Continues a CRC32C over more bytes using the SSE4.2 crc32 instruction
+ * @param paramCrc    - The CRC of the bytes before, 0 to start
+ * @param paramBytes  - The bytes being added
+ * @param paramLength - The number of bytes
+ * @return            - The CRC including the new bytes
+ */
+__attribute__((target("sse4.2"))) uint32_t updateCrc32cHardware(uint32_t paramCrc, const unsigned char *paramBytes, size_t paramLength) {
+
+    uint64_t crc = ~paramCrc;
+
+    while(paramLength >= 8) {
+        uint64_t value;
+        memcpy(&value, paramBytes, 8);
+        crc = __builtin_ia32_crc32di(crc, value);
+        paramBytes += 8;
+        paramLength -= 8;
+    }
+
+    while(paramLength > 0) {
+        crc = __builtin_ia32_crc32qi((uint32_t) crc, *paramBytes);
+        paramBytes++;
+        paramLength--;
+    }
+
+    return ~((uint32_t) crc);
+}
+#endif
+
+/**
+ * Continues a CRC32C over more bytes
+ * @param paramCrc    - The CRC of the bytes before, 0 to start
+ * @param paramBytes  - The bytes being added
+ * @param paramLength - The number of bytes
+ * @return            - The CRC including the new bytes
+ */
+uint32_t updateCrc32c(uint32_t paramCrc, const unsigned char *paramBytes, size_t paramLength) {
+
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("sse4.2")) {
+        return updateCrc32cHardware(paramCrc, paramBytes, paramLength);
+    }
+#endif
+
+    pthread_once(&crc32cTableOnce, createCrc32cTable);
+    return updateCrc32cTable(paramCrc, paramBytes, paramLength);
+}
+
+/**
+ * Multiplies a vector by a 32x32 matrix over GF(2)
+ */
+uint32_t multiplyGf2Matrix(const uint32_t *paramMatrix, uint32_t paramVector) {
+    uint32_t sum = 0;
+    for(int index = 0; paramVector != 0; index++, paramVector >>= 1) {
+        if(paramVector & 1) {
+            sum ^= paramMatrix[index];
+        }
+    }
+    return sum;
+}
+
+/**
+ * Squares a 32x32 matrix over GF(2)
+ */
+void squareGf2Matrix(uint32_t *paramSquare, const uint32_t *paramMatrix) {
+    for(int index = 0; index < 32; index++) {
+        paramSquare[index] = multiplyGf2Matrix(paramMatrix, paramMatrix[index]);
+    }
+}
+
+/**
+ * Combines the CRC32C of two pieces into the CRC32C of the first piece followed by the second
+ * @param paramFirstCrc     - CRC32C of the first piece
+ * @param paramSecondCrc    - CRC32C of the second piece
+ * @param paramSecondLength - The length of the second piece in bytes
+ * @return                  - CRC32C of both pieces
+ */
+uint32_t combineCrc32c(uint32_t paramFirstCrc, uint32_t paramSecondCrc, long paramSecondLength) {
+
+    if(paramSecondLength <= 0) {
+        return paramFirstCrc;
+    }
+
+    uint32_t evenMatrix[32];
+    uint32_t oddMatrix[32];
+
+    // Operator for one zero bit
+    oddMatrix[0] = CRC32C_POLYNOMIAL;
+    uint32_t row = 1;
+    for(int index = 1; index < 32; index++) {
+        oddMatrix[index] = row;
+        row <<= 1;
+    }
+
+    squareGf2Matrix(evenMatrix, oddMatrix);     // Two zero bits
+    squareGf2Matrix(oddMatrix, evenMatrix);     // Four zero bits
+
+    // Apply len2 zero bytes to the first CRC
+    do {
+        squareGf2Matrix(evenMatrix, oddMatrix);
+        if(paramSecondLength & 1) {
+            paramFirstCrc = multiplyGf2Matrix(evenMatrix, paramFirstCrc);
+        }
+        paramSecondLength >>= 1;
+        if(paramSecondLength == 0) {
+            break;
+        }
+
+        squareGf2Matrix(oddMatrix, evenMatrix);
+        if(paramSecondLength & 1) {
+            paramFirstCrc = multiplyGf2Matrix(oddMatrix, paramFirstCrc);
+        }
+        paramSecondLength >>= 1;
+    } while(paramSecondLength != 0);
+
+    return paramFirstCrc ^ paramSecondCrc;
+}
+
+/**
+ * The SHA-256 context stores the state of a hash between pieces
+ */
+struct Sha256Context {
+    uint32_t state[8];
+    uint64_t totalLength;
+    uint8_t block[64];
+    int blockLength;
+}; typedef struct Sha256Context Sha256Context;
+
+static const uint32_t SHA256_ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTATE(value, bits) (((value) >> (bits)) | ((value) << (32 - (bits))))
+
+/**
+ * Starts a new SHA-256 hash
+ * @param paramContext - The context being started
+ */
+void startSha256(Sha256Context *paramContext) {
+    static const uint32_t INITIAL_STATE[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(paramContext->state, INITIAL_STATE, sizeof(INITIAL_STATE));
+    paramContext->totalLength = 0;
+    paramContext->blockLength = 0;
+}
+
+/**
+ * Runs the SHA-256 compression function over one 64 byte block
+ * @param paramContext - The context being updated
+ * @param paramBlock   - The block
+ */
+void compressSha256Block(Sha256Context *paramContext, const uint8_t *paramBlock) {
+
+    uint32_t words[64];
+
+    for(int index = 0; index < 16; index++) {
+        words[index] = ((uint32_t) paramBlock[index * 4] << 24) | ((uint32_t) paramBlock[index * 4 + 1] << 16) |
+                       ((uint32_t) paramBlock[index * 4 + 2] << 8) | paramBlock[index * 4 + 3];
+    }
+
+    for(int index = 16; index < 64; index++) {
+        uint32_t sigma0 = SHA256_ROTATE(words[index - 15], 7) ^ SHA256_ROTATE(words[index - 15], 18) ^ (words[index - 15] >> 3);
+        uint32_t sigma1 = SHA256_ROTATE(words[index - 2], 17) ^ SHA256_ROTATE(words[index - 2], 19) ^ (words[index - 2] >> 10);
+        words[index] = words[index - 16] + sigma0 + words[index - 7] + sigma1;
+    }
+
+    uint32_t a = paramContext->state[0], b = paramContext->state[1], c = paramContext->state[2], d = paramContext->state[3];
+    uint32_t e = paramContext->state[4], f = paramContext->state[5], g = paramContext->state[6], h = paramContext->state[7];
+
+    for(int index = 0; index < 64; index++) {
+        uint32_t sum1 = SHA256_ROTATE(e, 6) ^ SHA256_ROTATE(e, 11) ^ SHA256_ROTATE(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + sum1 + choice + SHA256_ROUND_CONSTANTS[index] + words[index];
+        uint32_t sum0 = SHA256_ROTATE(a, 2) ^ SHA256_ROTATE(a, 13) ^ SHA256_ROTATE(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = sum0 + majority;
+
+        h = g; g = f; f = e; e = d + temp1;
+        d = c; c = b; b = a; a = temp1 + temp2;
+    }
+
+    paramContext->state[0] += a; paramContext->state[1] += b; paramContext->state[2] += c; paramContext->state[3] += d;
+    paramContext->state[4] += e; paramContext->state[5] += f; paramContext->state[6] += g; paramContext->state[7] += h;
+}
+
+/**
+ * Adds more bytes to a SHA-256 hash
+ * @param paramContext - The context being updated
+ * @param paramBytes   - The bytes being added
+ * @param paramLength  - The number of bytes
+ */
+void updateSha256(Sha256Context *paramContext, const unsigned char *paramBytes, size_t paramLength) {
+
+    paramContext->totalLength += paramLength;
+
+    if(paramContext->blockLength > 0) {
+        size_t fillLength = 64 - paramContext->blockLength;
+        if(fillLength > paramLength) {
+            fillLength = paramLength;
+        }
+        memcpy(paramContext->block + paramContext->blockLength, paramBytes, fillLength);
+        paramContext->blockLength += fillLength;
+        paramBytes += fillLength;
+        paramLength -= fillLength;
+
+        if(paramContext->blockLength < 64) {
+            return;
+        }
+        compressSha256Block(paramContext, paramContext->block);
+        paramContext->blockLength = 0;
+    }
+
+    while(paramLength >= 64) {
+        compressSha256Block(paramContext, paramBytes);
+        paramBytes += 64;
+        paramLength -= 64;
+    }
+
+    memcpy(paramContext->block, paramBytes, paramLength);
+    paramContext->blockLength = paramLength;
+}
+
+/**
+ * Finishes a SHA-256 hash
+ * @param paramContext - The context being finished
+ * @param paramDigest  - Where the 32 byte digest is written
+ */
+void finishSha256(Sha256Context *paramContext, uint8_t *paramDigest) {
+
+    uint64_t totalBits = paramContext->totalLength * 8;
+
+    uint8_t padding[72] = {0x80};
+    int paddingLength = (paramContext->blockLength < 56) ? 56 - paramContext->blockLength : 120 - paramContext->blockLength;
+
+    for(int index = 0; index < 8; index++) {
+        padding[paddingLength + index] = (uint8_t) (totalBits >> (56 - (index * 8)));
+    }
+    updateSha256(paramContext, padding, paddingLength + 8);
+
+    for(int index = 0; index < 8; index++) {
+        paramDigest[index * 4] = (uint8_t) (paramContext->state[index] >> 24);
+        paramDigest[index * 4 + 1] = (uint8_t) (paramContext->state[index] >> 16);
+        paramDigest[index * 4 + 2] = (uint8_t) (paramContext->state[index] >> 8);
+        paramDigest[index * 4 + 3] = (uint8_t) paramContext->state[index];
+    }
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                       Directory Walk                                             |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The directory walk visits every directory and entry of a volume depth first, giving each one its full path.
+ * Operations that need to look at the whole image are written as a visitor instead of their own recursion.
+ */
+
+#define MAX_DIRECTORY_DEPTH 128
+
+/**
+ * A visitor holds the functions called during a walk, either may be NULL
+ */
+struct DirectoryVisitor {
+    // Called with the bytes of every directory, the root directory has a first cluster of 0
+    void (*visitDirectory)(Volume *paramVolume, wchar_t *paramPath, int paramPathLength, int paramFirstCluster, Buffer *paramDirectoryBuffer, void *paramContext);
+    // Called for every entry other than the volume name
+    void (*visitEntry)(Volume *paramVolume, DirectoryEntry *paramDirectoryEntry, wchar_t *paramPath, int paramPathLength, void *paramContext);
+    void *context;
+}; typedef struct DirectoryVisitor DirectoryVisitor;
+
+/**
+ * Creates the path of a child by joining it onto the path of its parent with '/'
+ * @param paramPath       - The path of the parent
+ * @param paramPathLength - The length of the parent path
+ * @param paramName       - The name of the child
+ * @param paramNameLength - The length of the name
+ * @return                - The new path, paramPathLength + paramNameLength + 1 characters long
+ */
+wchar_t *createChildPath(wchar_t *paramPath, int paramPathLength, wchar_t *paramName, int paramNameLength) {
+    wchar_t *path = (wchar_t *) malloc(sizeof(wchar_t) * (paramPathLength + paramNameLength + 1));
+    if(paramPathLength > 0) {
+        memcpy(path, paramPath, sizeof(wchar_t) * paramPathLength);
+    }
+    path[paramPathLength] = '/';
+    memcpy(path + paramPathLength + 1, paramName, sizeof(wchar_t) * paramNameLength);
+    return path;
+}
+
+/**
+ * Reads every cluster of every sub directory in a run of slots ahead of the walk reaching them, so the clusters of
+ * the next level are read in one sweep over the image rather than as each directory is opened
+ * @param paramVolume        - The volume being walked
+ * @param paramSlots         - The slots of a directory
+ * @param paramNumberOfSlots - The number of slots
+ */
+void prefetchChildDirectories(Volume *paramVolume, const unsigned char *paramSlots, int paramNumberOfSlots) {
+
+    if(paramVolume->readEngines == NULL) {
+        return;
+    }
+
+    int limit = getPrefetchClusterLimit(paramVolume);
+    int *clusters = (int *) malloc(sizeof(int) * limit);
+    int numberOfClusters = 0;
+
+    for(int slotIndex = 0; slotIndex < paramNumberOfSlots && numberOfClusters < limit; slotIndex++) {
+        Entry *entry = (Entry *) (paramSlots + (long) slotIndex * sizeof(Entry));
+        if(entry->DIR_Name[0] == 0x00) {
+            break;
+        }
+        if(entry->DIR_Name[0] == 0xe5 || entry->DIR_Name[0] == 0x2e || entry->DIR_Attr == 0x0f || (entry->DIR_Attr & 0x18) != 0x10) {
+            continue;
+        }
+        int cluster = getFirstClusterOfEntry(entry);
+        for(int chainLength = 0; isValidCluster(paramVolume, cluster) && chainLength < paramVolume->numberOfClusters && numberOfClusters < limit; chainLength++) {
+            clusters[numberOfClusters++] = cluster;
+            cluster = (int) getFatEntry(paramVolume, cluster);
+        }
+    }
+
+    prefetchClusters(paramVolume, clusters, numberOfClusters);
+    free(clusters);
+}
+
+/**
+ * Visits a directory then every entry within it, walking into each sub directory
+ * @param paramVolume          - The volume being walked
+ * @param paramVisitor         - The functions being called
+ * @param paramPath            - Path of the directory
+ * @param paramPathLength      - Length of the path
+ * @param paramFirstCluster    - First cluster of the directory, 0 for the root
+ * @param paramDirectoryBuffer - The bytes of the directory
+ * @param paramDepth           - Depth of the directory, the root is 0
+ */
+void walkDirectory(Volume *paramVolume, DirectoryVisitor *paramVisitor, wchar_t *paramPath, int paramPathLength, int paramFirstCluster, Buffer *paramDirectoryBuffer, int paramDepth) {
+
+    if(paramVisitor->visitDirectory != NULL) {
+        paramVisitor->visitDirectory(paramVolume, paramPath, paramPathLength, paramFirstCluster, paramDirectoryBuffer, paramVisitor->context);
+    }
+
+    LinkedList *entries = getAllEntriesFromDirectory(paramDirectoryBuffer, 0);
+    prefetchChildDirectories(paramVolume, paramDirectoryBuffer->bufferPtr, (int) (paramDirectoryBuffer->size / sizeof(Entry)));
+
+    LinkedList *entry = entries;
+    while(entry->next != NULL) {
+        entry = entry->next;
+        DirectoryEntry *directoryEntry = (DirectoryEntry *) entry->pointer;
+
+        if(directoryEntry->entryAttributes->volume_name) {
+            continue;
+        }
+
+        wchar_t *name = getDirectoryEntryName(directoryEntry);
+        int pathLength = paramPathLength + 1 + directoryEntry->fileNameSize;
+        wchar_t *path = createChildPath(paramPath, paramPathLength, name, directoryEntry->fileNameSize);
+
+        if(paramVisitor->visitEntry != NULL) {
+            paramVisitor->visitEntry(paramVolume, directoryEntry, path, pathLength, paramVisitor->context);
+        }
+
+        int firstCluster = getFirstClusterOfEntry(directoryEntry->entry);
+        if(directoryEntry->entryAttributes->directory && isValidCluster(paramVolume, firstCluster) && paramDepth < MAX_DIRECTORY_DEPTH) {
+            Buffer *directoryBuffer = readClusterChain(paramVolume, firstCluster);
+            walkDirectory(paramVolume, paramVisitor, path, pathLength, firstCluster, directoryBuffer, paramDepth + 1);
+            freeBuffer(directoryBuffer);
+        }
+
+        free(path);
+    }
+
+    freeDirectoryEntries(entries);
+}
+
+/**
+ * Walks every directory and entry of a volume starting at the root directory
+ * @param paramVolume  - The volume being walked
+ * @param paramVisitor - The functions being called
+ */
+void walkVolume(Volume *paramVolume, DirectoryVisitor *paramVisitor) {
+    Buffer *rootDirectory = readRootDirectory(paramVolume);
+    walkDirectory(paramVolume, paramVisitor, NULL, 0, 0, rootDirectory, 0);
+    freeBuffer(rootDirectory);
+}
+
+/**
+ * A file reference stores what is needed to read a file after the walk has finished
+ */
+struct FileReference {
+    wchar_t *path;
+    int pathLength;
+    int firstCluster;
+    uint32_t fileSize;
+}; typedef struct FileReference FileReference;
+
+/**
+ * Adds every file found during a walk to the linked list passed as the context
+ */
+void visitEntryForFileList(Volume *paramVolume, DirectoryEntry *paramDirectoryEntry, wchar_t *paramPath, int paramPathLength, void *paramContext) {
+
+    (void) paramVolume;
+
+    if(!paramDirectoryEntry->entryAttributes->is_file) {
+        return;
+    }
+
+    FileReference *fileReference = (FileReference *) malloc(sizeof(FileReference));
+    fileReference->path = (wchar_t *) malloc(sizeof(wchar_t) * paramPathLength);
+    memcpy(fileReference->path, paramPath, sizeof(wchar_t) * paramPathLength);
+    fileReference->pathLength = paramPathLength;
+    fileReference->firstCluster = getFirstClusterOfEntry(paramDirectoryEntry->entry);
+    fileReference->fileSize = paramDirectoryEntry->entry->DIR_FileSize;
+
+    *((LinkedList **) paramContext) = addNewLink(*((LinkedList **) paramContext), (unsigned int *) fileReference);
+}
+
+/**
+ * Gets a reference to every file on the volume in walk order
+ * @param paramVolume           - The volume being walked
+ * @param paramNumberOfFiles    - Set to the number of files found
+ * @return                      - An array of file references, freed with freeFileReferences
+ */
+FileReference **getFileReferences(Volume *paramVolume, int *paramNumberOfFiles) {
+
+    LinkedList *files = createLinkedList();
+    LinkedList *lastFile = files;
+
+    DirectoryVisitor visitor = {NULL, visitEntryForFileList, &lastFile};
+    walkVolume(paramVolume, &visitor);
+
+    int numberOfFiles = 0;
+    for(LinkedList *file = files->next; file != NULL; file = file->next) {
+        numberOfFiles++;
+    }
+
+    FileReference **fileReferences = (FileReference **) malloc(sizeof(FileReference *) * (numberOfFiles + 1));
+    int fileIndex = 0;
+    for(LinkedList *file = files->next; file != NULL; file = file->next) {
+        fileReferences[fileIndex++] = (FileReference *) file->pointer;
+    }
+    freeLinkedList(files);
+
+    *paramNumberOfFiles = numberOfFiles;
+    return fileReferences;
+}
+
+/**
+ * Frees an array of file references
+ * @param paramFileReferences - The array from getFileReferences
+ * @param paramNumberOfFiles  - The number of files in the array
+ */
+void freeFileReferences(FileReference **paramFileReferences, int paramNumberOfFiles) {
+    for(int index = 0; index < paramNumberOfFiles; index++) {
+        free(paramFileReferences[index]->path);
+        free(paramFileReferences[index]);
+    }
+    free(paramFileReferences);
+}
+
+/*
+ * The streaming walk visits the same entries as walkVolume without holding a whole directory. It keeps an explicit
+ * stack of cursors, one for each directory between the root and the one being scanned, and only the cluster under
+ * the top cursor is held in memory. Each entry is decoded, visited and dropped as its slot is reached, so the memory
+ * used depends on the depth of the tree rather than on the number of entries. Returning to a parent reads the
+ * cluster its cursor stopped in again.
+ */
+
+#define MAX_LONG_FILE_NAME_ENTRIES 20       // 255 characters need at most 20 entries of 13
+
+/**
+ * A directory cursor is the position of the streaming walk within one directory
+ */
+struct DirectoryCursor {
+    int cluster;                            // Cluster being scanned, 0 when scanning the fixed root directory region
+    int window;                             // Number of clusters or root region windows scanned before this one
+    int slot;                               // Next slot within the window
+    int numberOfSlots;                      // Slots in the window, 0 once the directory has ended
+    int pathLength;                         // Length of the path of this directory
+}; typedef struct DirectoryCursor DirectoryCursor;
+
+/**
+ * Reads the window under a cursor, one cluster of a chain or one cluster sized part of the fixed root region
+ * @param paramVolume          - The volume being walked
+ * @param paramDirectoryCursor - The cursor whose window is read, numberOfSlots is set
+ * @param paramWindow          - A buffer of one cluster that the window is read into
+ */
+void readDirectoryWindow(Volume *paramVolume, DirectoryCursor *paramDirectoryCursor, Buffer *paramWindow) {
+
+    paramDirectoryCursor->numberOfSlots = 0;
+
+    if(paramDirectoryCursor->cluster == 0) {
+        long windowStart = (long) paramDirectoryCursor->window * paramVolume->bytesPerCluster;
+        long windowLength = (long) paramVolume->bootSector->BPB_RootEntCnt * sizeof(Entry) - windowStart;
+        if(windowLength > paramVolume->bytesPerCluster) {
+            windowLength = paramVolume->bytesPerCluster;
+        }
+        if(windowLength > 0) {
+            readVolumeBytes(paramVolume, (long) paramVolume->sectorRootDirectoryStart * paramVolume->bootSector->BPB_BytsPerSec + windowStart, paramWindow->bufferPtr, windowLength);
+            paramDirectoryCursor->numberOfSlots = (int) (windowLength / sizeof(Entry));
+        }
+        return;
+    }
+
+    if(isValidCluster(paramVolume, paramDirectoryCursor->cluster) && paramDirectoryCursor->window < paramVolume->numberOfClusters) {
+        readVolumeBytes(paramVolume, getClusterOffset(paramVolume, paramDirectoryCursor->cluster), paramWindow->bufferPtr, paramVolume->bytesPerCluster);
+        paramDirectoryCursor->numberOfSlots = paramVolume->bytesPerCluster / sizeof(Entry);
+    }
+}
+
+/**
+ * Moves a cursor onto the next window of its directory and reads it
+ * @param paramVolume          - The volume being walked
+ * @param paramDirectoryCursor - The cursor being moved
+ * @param paramWindow          - A buffer of one cluster that the window is read into
+ */
+void advanceDirectoryCursor(Volume *paramVolume, DirectoryCursor *paramDirectoryCursor, Buffer *paramWindow) {
+
+    if(paramDirectoryCursor->cluster != 0) {
+        paramDirectoryCursor->cluster = (int) getFatEntry(paramVolume, paramDirectoryCursor->cluster);
+    }
+    paramDirectoryCursor->window++;
+    paramDirectoryCursor->slot = 0;
+
+    readDirectoryWindow(paramVolume, paramDirectoryCursor, paramWindow);
+}
+
+/**
+ * Moves a cursor onto the next window of its directory and reads it, prefetching the sub directories it holds
+ * @param paramVolume          - The volume being walked
+ * @param paramDirectoryCursor - The cursor being moved
+ * @param paramWindow          - A buffer of one cluster that the window is read into
+ */
+void readNextDirectoryWindow(Volume *paramVolume, DirectoryCursor *paramDirectoryCursor, Buffer *paramWindow) {
+    advanceDirectoryCursor(paramVolume, paramDirectoryCursor, paramWindow);
+    prefetchChildDirectories(paramVolume, paramWindow->bufferPtr, paramDirectoryCursor->numberOfSlots);
+}
+
+/**
+ * Starts a cursor at the first slot of a directory and reads its first window
+ * @param paramVolume          - The volume being walked
+ * @param paramDirectoryCursor - The cursor being started
+ * @param paramFirstCluster    - The first cluster of the directory, 0 for the root directory
+ * @param paramPathLength      - The length of the path of the directory
+ * @param paramWindow          - A buffer of one cluster that the window is read into
+ */
+void openDirectoryCursor(Volume *paramVolume, DirectoryCursor *paramDirectoryCursor, int paramFirstCluster, int paramPathLength, Buffer *paramWindow) {
+
+    paramDirectoryCursor->cluster = getDirectoryChainStart(paramVolume, paramFirstCluster);
+    paramDirectoryCursor->window = 0;
+    paramDirectoryCursor->slot = 0;
+    paramDirectoryCursor->pathLength = paramPathLength;
+
+    readDirectoryWindow(paramVolume, paramDirectoryCursor, paramWindow);
+}
+
+/**
+ * Starts a cursor at the first slot of a directory and reads its first window, prefetching the sub directories it holds
+ * @param paramVolume          - The volume being walked
+ * @param paramDirectoryCursor - The cursor being started
+ * @param paramFirstCluster    - The first cluster of the directory, 0 for the root directory
+ * @param paramPathLength      - The length of the path of the directory
+ * @param paramWindow          - A buffer of one cluster that the window is read into
+ */
+void startDirectoryCursor(Volume *paramVolume, DirectoryCursor *paramDirectoryCursor, int paramFirstCluster, int paramPathLength, Buffer *paramWindow) {
+    openDirectoryCursor(paramVolume, paramDirectoryCursor, paramFirstCluster, paramPathLength, paramWindow);
+    prefetchChildDirectories(paramVolume, paramWindow->bufferPtr, paramDirectoryCursor->numberOfSlots);
+}
+
+/**
+ * Gets the name of a short entry from the long file name entries that came before it, or its 11 character short name
+ * @param paramEntry                   - The short entry
+ * @param paramLongFileNameEntries     - The long file name entries in the order they were found
+ * @param paramNumberOfLongFileNames   - The number of long file name entries
+ * @param paramName                    - Set to the name, at least MAX_LONG_FILE_NAME_ENTRIES * 13 characters long
+ * @return                             - The length of the name
+ */
+int getStreamedEntryName(Entry *paramEntry, LongFileNameEntry *paramLongFileNameEntries, int paramNumberOfLongFileNames, wchar_t *paramName) {
+
+    if(paramNumberOfLongFileNames == 0) {
+        for(int index = 0; index < 11; index++) {
+            paramName[index] = (wchar_t) paramEntry->DIR_Name[index];
+        }
+        return 11;
+    }
+
+    for(int index = 0; index < paramNumberOfLongFileNames; index++) {
+        getLongFileNameCharacters(paramLongFileNameEntries + paramNumberOfLongFileNames - 1 - index, paramName + index * 13);
+    }
+
+    int nameLength = 0;
+    while(nameLength < paramNumberOfLongFileNames * 13 && paramName[nameLength] != 0x0000) {
+        nameLength++;
+    }
+    return nameLength;
+}
+
+/**
+ * Visits every entry of a volume depth first while holding one cluster of directory at a time. Entries are visited in
+ * the same order as walkVolume, but the volume name is visited too and the DirectoryEntry is only valid during the call.
+ * @param paramVolume     - The volume being walked
+ * @param paramVisitEntry - Called for every entry with its full path
+ * @param paramContext    - Passed to paramVisitEntry
+ */
+void streamVolume(Volume *paramVolume, void (*paramVisitEntry)(Volume *, DirectoryEntry *, wchar_t *, int, void *), void *paramContext) {
+
+    DirectoryCursor directoryCursors[MAX_DIRECTORY_DEPTH + 1];
+    int depth = 0;
+
+    Buffer *window = createBuffer(paramVolume->bytesPerCluster);
+
+    int pathCapacity = 256;
+    wchar_t *path = (wchar_t *) malloc(sizeof(wchar_t) * pathCapacity);
+
+    LongFileNameEntry longFileNameEntries[MAX_LONG_FILE_NAME_ENTRIES];
+    int numberOfLongFileNames = 0;
+    wchar_t name[MAX_LONG_FILE_NAME_ENTRIES * 13];
+
+    Entry entry;
+    EntryAttributes entryAttributes;
+    DirectoryEntry directoryEntry;
+    directoryEntry.entry = &entry;
+    directoryEntry.entryAttributes = &entryAttributes;
+    directoryEntry.longFileName = name;
+    directoryEntry.longFileNameEntries = NULL;
+    directoryEntry.numberOfLongFileNameEntries = 0;
+
+    startDirectoryCursor(paramVolume, directoryCursors, 0, 0, window);
+
+    while(depth >= 0) {
+
+        DirectoryCursor *directoryCursor = directoryCursors + depth;
+
+        if(directoryCursor->slot == directoryCursor->numberOfSlots && directoryCursor->numberOfSlots > 0) {
+            readNextDirectoryWindow(paramVolume, directoryCursor, window);
+        }
+
+        unsigned char *slot = window->bufferPtr + (long) directoryCursor->slot * sizeof(Entry);
+
+        if(directoryCursor->numberOfSlots == 0 || slot[0] == 0x00) {             // End of the directory, back to its parent
+            numberOfLongFileNames = 0;
+            depth--;
+            if(depth >= 0) {
+                readDirectoryWindow(paramVolume, directoryCursors + depth, window);
+            }
+            continue;
+        }
+
+        directoryCursor->slot++;
+
+        if(slot[0] == 0xe5 || slot[0] == 0x2e) {                                        // Deleted or "." and ".."
+            numberOfLongFileNames = 0;
+            continue;
+        }
+
+        if(slot[11] == 0x0f) {
+            if(numberOfLongFileNames < MAX_LONG_FILE_NAME_ENTRIES) {
+                memcpy(longFileNameEntries + numberOfLongFileNames, slot, sizeof(LongFileNameEntry));
+                numberOfLongFileNames++;
+            }
+            continue;
+        }
+
+        memcpy(&entry, slot, sizeof(Entry));
+        setEntryAttributes(&entry, &entryAttributes);
+        if(!isLongFileNameOfEntry(longFileNameEntries, numberOfLongFileNames, &entry)) {
+            numberOfLongFileNames = 0;
+        }
+        directoryEntry.fileNameSize = getStreamedEntryName(&entry, longFileNameEntries, numberOfLongFileNames, name);
+        numberOfLongFileNames = 0;
+
+        int pathLength = directoryCursor->pathLength + 1 + directoryEntry.fileNameSize;
+        if(pathLength > pathCapacity) {
+            pathCapacity = pathLength * 2;
+            path = (wchar_t *) realloc(path, sizeof(wchar_t) * pathCapacity);
+        }
+        path[directoryCursor->pathLength] = '/';
+        memcpy(path + directoryCursor->pathLength + 1, name, sizeof(wchar_t) * directoryEntry.fileNameSize);
+
+        paramVisitEntry(paramVolume, &directoryEntry, path, pathLength, paramContext);
+
+        int firstCluster = getFirstClusterOfEntry(&entry);
+        if(entryAttributes.directory && !entryAttributes.volume_name && isValidCluster(paramVolume, firstCluster) && depth < MAX_DIRECTORY_DEPTH) {
+            depth++;
+            startDirectoryCursor(paramVolume, directoryCursors + depth, firstCluster, pathLength, window);
+        }
+    }
+
+    free(path);
+    freeBuffer(window);
+}
+
+/*
+ * A single directory is streamed the same way without walking below it, which is how paths are looked up and single
+ * directories listed. Only the clusters of that directory up to the slot the scan stops at are read, and nothing is
+ * prefetched, so the time taken does not depend on anything else on the volume.
+ */
+
+/**
+ * Visits the entries of one directory in slot order while holding one cluster of it at a time. The scan stops at the
+ * first empty slot or when the visitor asks it to, the volume name is visited too.
+ * @param paramVolume       - The volume of the directory
+ * @param paramFirstCluster - The first cluster of the directory, 0 for the root directory
+ * @param paramVisitEntry   - Called with every short entry and its name, returns 1 to stop the scan
+ * @param paramContext      - Passed to paramVisitEntry
+ */
+void streamDirectory(Volume *paramVolume, int paramFirstCluster, uint8_t (*paramVisitEntry)(Volume *, Entry *, wchar_t *, int, void *), void *paramContext) {
+
+    Buffer *window = createBuffer(paramVolume->bytesPerCluster);
+    DirectoryCursor directoryCursor;
+
+    LongFileNameEntry longFileNameEntries[MAX_LONG_FILE_NAME_ENTRIES];
+    int numberOfLongFileNames = 0;
+    wchar_t name[MAX_LONG_FILE_NAME_ENTRIES * 13];
+
+    openDirectoryCursor(paramVolume, &directoryCursor, paramFirstCluster, 0, window);
+
+    while(directoryCursor.numberOfSlots > 0) {
+
+        if(directoryCursor.slot == directoryCursor.numberOfSlots) {
+            advanceDirectoryCursor(paramVolume, &directoryCursor, window);
+            continue;
+        }
+
+        unsigned char *slot = window->bufferPtr + (long) directoryCursor.slot++ * sizeof(Entry);
+
+        if(slot[0] == 0x00) {
+            break;
+        }
+        if(slot[0] == 0xe5 || slot[0] == 0x2e) {
+            numberOfLongFileNames = 0;
+            continue;
+        }
+        if(slot[11] == 0x0f) {
+            if(numberOfLongFileNames < MAX_LONG_FILE_NAME_ENTRIES) {
+                memcpy(longFileNameEntries + numberOfLongFileNames++, slot, sizeof(LongFileNameEntry));
+            }
+            continue;
+        }
+
+        Entry entry;
+        memcpy(&entry, slot, sizeof(Entry));
+        if(!isLongFileNameOfEntry(longFileNameEntries, numberOfLongFileNames, &entry)) {
+            numberOfLongFileNames = 0;
+        }
+        int nameLength = getStreamedEntryName(&entry, longFileNameEntries, numberOfLongFileNames, name);
+        numberOfLongFileNames = 0;
+
+        if(paramVisitEntry(paramVolume, &entry, name, nameLength, paramContext)) {
+            break;
+        }
+    }
+
+    freeBuffer(window);
+}
+
+/**
+ * A path lookup is the name being looked for in one directory and the entry once it is found
+ */
+struct PathLookup {
+    wchar_t *name;
+    int nameLength;
+    uint8_t is_directory_only;              // Only a directory can have the name, as it is not the last in the path
+    uint8_t is_found;
+    Entry entry;
+}; typedef struct PathLookup PathLookup;
+
+/**
+ * Stops the scan of a directory at the entry with the name of the path lookup passed as the context
+ */
+uint8_t visitEntryForPathLookup(Volume *paramVolume, Entry *paramEntry, wchar_t *paramName, int paramNameLength, void *paramContext) {
+
+    (void) paramVolume;
+
+    PathLookup *pathLookup = (PathLookup *) paramContext;
+
+    if((paramEntry->DIR_Attr & 0x18) == 0x08 || (pathLookup->is_directory_only && !(paramEntry->DIR_Attr & 0x10))) {
+        return 0;
+    }
+    if(paramNameLength != pathLookup->nameLength || memcmp(paramName, pathLookup->name, sizeof(wchar_t) * paramNameLength) != 0) {
+        return 0;
+    }
+
+    memcpy(&pathLookup->entry, paramEntry, sizeof(Entry));
+    pathLookup->is_found = 1;
+    return 1;
+}
+
+/**
+ * Finds the entry at the end of a path by looking each name up in the directory before it. Only the directories on
+ * the path are read, each up to the entry that was looked for.
+ * @param paramVolume     - The volume being searched
+ * @param paramPath       - Names separated by '/', empty or "/" for the root directory
+ * @param paramPathLength - The length of the path
+ * @param paramEntry      - Set to the short entry found, a directory entry with cluster 0 for the root directory
+ * @return                - EXCEPTION_NONE or EXCEPTION_FILE_DOES_NOT_EXIST
+ */
+int findPathEntry(Volume *paramVolume, wchar_t *paramPath, int paramPathLength, Entry *paramEntry) {
+
+    Entry entry;
+    memset(&entry, 0, sizeof(Entry));
+    entry.DIR_Attr = 0x10;
+
+    int nameStart = 0;
+    while(nameStart < paramPathLength) {
+        int nameLength = 0;
+        while(nameStart + nameLength < paramPathLength && paramPath[nameStart + nameLength] != '/') {
+            nameLength++;
+        }
+        if(nameLength == 0) {
+            nameStart++;
+            continue;
+        }
+
+        int firstCluster = getFirstClusterOfEntry(&entry);
+        if(!(entry.DIR_Attr & 0x10) || (firstCluster != 0 && !isValidCluster(paramVolume, firstCluster))) {
+            return EXCEPTION_FILE_DOES_NOT_EXIST;
+        }
+
+        PathLookup pathLookup;
+        memset(&pathLookup, 0, sizeof(PathLookup));
+        pathLookup.name = paramPath + nameStart;
+        pathLookup.nameLength = nameLength;
+        for(int index = nameStart + nameLength; index < paramPathLength && !pathLookup.is_directory_only; index++) {
+            pathLookup.is_directory_only = paramPath[index] != '/';
+        }
+
+        streamDirectory(paramVolume, firstCluster, visitEntryForPathLookup, &pathLookup);
+        if(!pathLookup.is_found) {
+            return EXCEPTION_FILE_DOES_NOT_EXIST;
+        }
+
+        memcpy(&entry, &pathLookup.entry, sizeof(Entry));
+        nameStart += nameLength + 1;
+    }
+
+    memcpy(paramEntry, &entry, sizeof(Entry));
+    return EXCEPTION_NONE;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                              TREE                                                |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The tree is called when the input is for the file to be found is '//'
+ * It prints out every file and directory name as the streaming walk reaches it, indented by its depth
+ */
+
+/**
+ * Prints an entry of the tree, indenting it by the number of directories in its path
+ */
+void visitEntryForTree(Volume *paramVolume, DirectoryEntry *paramDirectoryEntry, wchar_t *paramPath, int paramPathLength, void *paramContext) {
+
+    (void) paramVolume;
+    (void) paramContext;
+
+    if(paramDirectoryEntry->entryAttributes->volume_name) {
+        printOutput("Volume: ");
+        printLongFileName(paramDirectoryEntry, 0);
+        return;
+    }
+
+    int depth = 0;
+    for(int index = 0; index < paramPathLength - paramDirectoryEntry->fileNameSize; index++) {
+        depth += paramPath[index] == '/';
+    }
+
+    printLongFileName(paramDirectoryEntry, depth * 2);
+}
+
+/**
+ * Begins the tree at the root directory
+ * @param paramVolume     - The volume being printed
+ */
+void beginTree(Volume *paramVolume) {
+    streamVolume(paramVolume, visitEntryForTree, NULL);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                              Records                                             |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Records are the machine readable form of the tree and lookup, one line per entry as either NDJSON or CSV. Each
+ * record is built in a fixed size buffer that is written out whenever it fills, so the memory used does not grow
+ * with the number of entries and a reader on the other end of a pipe sees records while the walk is still going.
+ * Dates and times are split into fields with shifts and masks and turned into digits with a table of every pair
+ * of digits rather than through printf.
+ */
+
+#define OUTPUT_FORMAT_TEXT 0
+#define OUTPUT_FORMAT_NDJSON 1
+#define OUTPUT_FORMAT_CSV 2
+
+#define RECORD_WRITER_SIZE (64 * 1024)
+#define RECORD_MAXIMUM_CHARACTER_BYTES 6         // A character escaped as \u00XX, or 4 bytes of UTF-8
+
+static const char TWO_DIGITS[201] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+/**
+ * A record writer collects records and writes them to the output a buffer at a time
+ */
+struct RecordWriter {
+    FILE *stream;               // Where the records are written
+    int format;                 // OUTPUT_FORMAT_NDJSON or OUTPUT_FORMAT_CSV
+    char *bytes;                // Records not yet written
+    size_t length;              // Number of bytes not yet written
+    long numberOfRecords;       // Records written so far
+
+}; typedef struct RecordWriter RecordWriter;
+
+/**
+ * Writes the records held by a writer to its stream and flushes the stream so a reader sees them straight away
+ * @param paramRecordWriter - The record writer
+ */
+void flushRecordWriter(RecordWriter *paramRecordWriter) {
+    if(paramRecordWriter->length > 0) {
+        fwrite(paramRecordWriter->bytes, 1, paramRecordWriter->length, paramRecordWriter->stream);
+        paramRecordWriter->length = 0;
+    }
+    fflush(paramRecordWriter->stream);
+}
+
+/**
+ * Makes room in a record writer, writing out what it holds when there is not enough
+ * @param paramRecordWriter - The record writer
+ * @param paramLength       - The number of bytes needed, at most RECORD_WRITER_SIZE
+ * @return                  - Where the bytes can be put
+ */
+char *reserveRecordBytes(RecordWriter *paramRecordWriter, size_t paramLength) {
+    if(paramRecordWriter->length + paramLength > RECORD_WRITER_SIZE) {
+        flushRecordWriter(paramRecordWriter);
+    }
+    return paramRecordWriter->bytes + paramRecordWriter->length;
+}
+
+/**
+ * Adds bytes to the record being written
+ * @param paramRecordWriter - The record writer
+ * @param paramBytes        - The bytes being added
+ * @param paramLength       - The number of bytes, at most RECORD_WRITER_SIZE
+ */
+void appendRecordBytes(RecordWriter *paramRecordWriter, const char *paramBytes, size_t paramLength) {
+    memcpy(reserveRecordBytes(paramRecordWriter, paramLength), paramBytes, paramLength);
+    paramRecordWriter->length += paramLength;
+}
+
+/**
+ * Creates a record writer for the output stream of the calling thread, writing the CSV header line
+ * @param paramFormat - OUTPUT_FORMAT_NDJSON or OUTPUT_FORMAT_CSV
+ * @return            - The record writer
+ */
+RecordWriter *createRecordWriter(int paramFormat) {
+
+    RecordWriter *recordWriter = (RecordWriter *) malloc(sizeof(RecordWriter));
+    recordWriter->stream = getOutputStream();
+    recordWriter->format = paramFormat;
+    recordWriter->bytes = (char *) malloc(RECORD_WRITER_SIZE);
+    recordWriter->length = 0;
+    recordWriter->numberOfRecords = 0;
+
+    if(paramFormat == OUTPUT_FORMAT_CSV) {
+        const char HEADER[] = "path,type,size,attributes,cluster,created,modified,accessed\n";
+        appendRecordBytes(recordWriter, HEADER, sizeof(HEADER) - 1);
+    }
+
+    return recordWriter;
+}
+
+/**
+ * Writes out anything left in a record writer and frees it
+ * @param paramRecordWriter - The record writer being freed
+ */
+void freeRecordWriter(RecordWriter *paramRecordWriter) {
+    flushRecordWriter(paramRecordWriter);
+    free(paramRecordWriter->bytes);
+    free(paramRecordWriter);
+}
+
+/**
+ * Adds a number to the record being written, two digits at a time
+ * @param paramRecordWriter - The record writer
+ * @param paramNumber       - The number being added
+ */
+void appendRecordNumber(RecordWriter *paramRecordWriter, uint32_t paramNumber) {
+
+    char digits[10];
+    int start = 10;
+
+    while(paramNumber >= 100) {
+        start -= 2;
+        memcpy(digits + start, TWO_DIGITS + (paramNumber % 100) * 2, 2);
+        paramNumber /= 100;
+    }
+    if(paramNumber >= 10) {
+        start -= 2;
+        memcpy(digits + start, TWO_DIGITS + paramNumber * 2, 2);
+    } else {
+        digits[--start] = (char) ('0' + paramNumber);
+    }
+
+    appendRecordBytes(paramRecordWriter, digits + start, 10 - start);
+}
+
+/**
+ * Adds a path to the record being written as UTF-8, quoted and escaped for the format of the writer
+ * @param paramRecordWriter - The record writer
+ * @param paramPath         - The path being added
+ * @param paramPathLength   - The length of the path
+ */
+void appendRecordPath(RecordWriter *paramRecordWriter, wchar_t *paramPath, int paramPathLength) {
+
+    appendRecordBytes(paramRecordWriter, "\"", 1);
+
+    for(int index = 0; index < paramPathLength; index++) {
+
+        uint32_t character = (uint32_t) paramPath[index];
+        unsigned char *bytes = (unsigned char *) reserveRecordBytes(paramRecordWriter, RECORD_MAXIMUM_CHARACTER_BYTES);
+        int length = 0;
+
+        if(character == '"') {
+            bytes[length++] = paramRecordWriter->format == OUTPUT_FORMAT_CSV ? '"' : '\\';
+            bytes[length++] = '"';
+        } else if(character == '\\' && paramRecordWriter->format == OUTPUT_FORMAT_NDJSON) {
+            bytes[length++] = '\\';
+            bytes[length++] = '\\';
+        } else if(character < 0x20 && paramRecordWriter->format == OUTPUT_FORMAT_NDJSON) {
+            memcpy(bytes, "\\u00", 4);
+            bytes[4] = "0123456789abcdef"[character >> 4];
+            bytes[5] = "0123456789abcdef"[character & 0x0F];
+            length = 6;
+        } else if(character < 0x80) {
+            bytes[length++] = (unsigned char) character;
+        } else {
+            index += encodeUtf8Character(paramPath + index, paramPathLength - index, bytes, &length) - 1;
+        }
+
+        paramRecordWriter->length += length;
+    }
+
+    appendRecordBytes(paramRecordWriter, "\"", 1);
+}
+
+/**
+ * Adds an ISO 8601 timestamp to the record being written, null in NDJSON or empty in CSV when the date is not set
+ * @param paramRecordWriter  - The record writer
+ * @param paramDate          - The date from the entry
+ * @param paramTime          - The time from the entry, -1 for only the date
+ * @param paramCentiseconds  - Hundredths of a second added to the time, 0 to 199, -1 to leave them out
+ */
+void appendRecordTimestamp(RecordWriter *paramRecordWriter, uint16_t paramDate, int paramTime, int paramCentiseconds) {
+
+    int year = 1980 + (paramDate >> 9);
+    int month = (paramDate >> 5) & 0x0F;
+    int day = paramDate & 0x1F;
+
+    if(month < 1 || month > 12 || day < 1) {
+        if(paramRecordWriter->format == OUTPUT_FORMAT_NDJSON) {
+            appendRecordBytes(paramRecordWriter, "null", 4);
+        }
+        return;
+    }
+
+    char timestamp[26];
+    int length = 0;
+
+    if(paramRecordWriter->format == OUTPUT_FORMAT_NDJSON) {
+        timestamp[length++] = '"';
+    }
+    memcpy(timestamp + length, TWO_DIGITS + (year / 100) * 2, 2);
+    memcpy(timestamp + length + 2, TWO_DIGITS + (year % 100) * 2, 2);
+    timestamp[length + 4] = '-';
+    memcpy(timestamp + length + 5, TWO_DIGITS + month * 2, 2);
+    timestamp[length + 7] = '-';
+    memcpy(timestamp + length + 8, TWO_DIGITS + day * 2, 2);
+    length += 10;
+
+    if(paramTime >= 0) {
+        int seconds = (paramTime & 0x1F) * 2;
+        if(paramCentiseconds >= 0) {
+            seconds += paramCentiseconds / 100;
+        }
+        timestamp[length] = 'T';
+        memcpy(timestamp + length + 1, TWO_DIGITS + ((paramTime >> 11) % 100) * 2, 2);
+        timestamp[length + 3] = ':';
+        memcpy(timestamp + length + 4, TWO_DIGITS + (((paramTime >> 5) & 0x3F) % 100) * 2, 2);
+        timestamp[length + 6] = ':';
+        memcpy(timestamp + length + 7, TWO_DIGITS + (seconds % 100) * 2, 2);
+        length += 9;
+
+        if(paramCentiseconds >= 0) {
+            timestamp[length] = '.';
+            memcpy(timestamp + length + 1, TWO_DIGITS + (paramCentiseconds % 100) * 2, 2);
+            length += 3;
+        }
+    }
+
+    if(paramRecordWriter->format == OUTPUT_FORMAT_NDJSON) {
+        timestamp[length++] = '"';
+    }
+    appendRecordBytes(paramRecordWriter, timestamp, length);
+}
+
+/**
+ * Adds the record of one entry: its full path, type, size, attributes, first cluster and timestamps
+ * @param paramRecordWriter   - The record writer
+ * @param paramDirectoryEntry - The entry
+ * @param paramPath           - The full path of the entry
+ * @param paramPathLength     - The length of the path
+ */
+void writeEntryRecord(RecordWriter *paramRecordWriter, DirectoryEntry *paramDirectoryEntry, wchar_t *paramPath, int paramPathLength) {
+
+    Entry *entry = paramDirectoryEntry->entry;
+    EntryAttributes *entryAttributes = paramDirectoryEntry->entryAttributes;
+    uint8_t is_ndjson = paramRecordWriter->format == OUTPUT_FORMAT_NDJSON;
+
+    char attributes[6];
+    int numberOfAttributes = 0;
+    if(entryAttributes->read_only) attributes[numberOfAttributes++] = 'R';
+    if(entryAttributes->hidden) attributes[numberOfAttributes++] = 'H';
+    if(entryAttributes->system) attributes[numberOfAttributes++] = 'S';
+    if(entryAttributes->volume_name) attributes[numberOfAttributes++] = 'V';
+    if(entryAttributes->directory) attributes[numberOfAttributes++] = 'D';
+    if(entryAttributes->archive) attributes[numberOfAttributes++] = 'A';
+
+    const char *type = entryAttributes->directory ? "directory" : "file";
+
+    if(is_ndjson) {
+        appendRecordBytes(paramRecordWriter, "{\"path\":", 8);
+    }
+    appendRecordPath(paramRecordWriter, paramPath, paramPathLength);
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? ",\"type\":\"" : ",", is_ndjson ? 9 : 1);
+    appendRecordBytes(paramRecordWriter, type, strlen(type));
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? "\",\"size\":" : ",", is_ndjson ? 9 : 1);
+    appendRecordNumber(paramRecordWriter, entry->DIR_FileSize);
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? ",\"attributes\":\"" : ",", is_ndjson ? 15 : 1);
+    appendRecordBytes(paramRecordWriter, attributes, numberOfAttributes);
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? "\",\"cluster\":" : ",", is_ndjson ? 12 : 1);
+    appendRecordNumber(paramRecordWriter, (uint32_t) getFirstClusterOfEntry(entry));
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? ",\"created\":" : ",", is_ndjson ? 11 : 1);
+    appendRecordTimestamp(paramRecordWriter, entry->DIR_CrtDate, entry->DIR_CrtTime, entry->DIR_CrtTimeTenth);
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? ",\"modified\":" : ",", is_ndjson ? 12 : 1);
+    appendRecordTimestamp(paramRecordWriter, entry->DIR_WrtDate, entry->DIR_WrtTime, -1);
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? ",\"accessed\":" : ",", is_ndjson ? 12 : 1);
+    appendRecordTimestamp(paramRecordWriter, entry->DIR_LstAccDate, -1, -1);
+
+    appendRecordBytes(paramRecordWriter, is_ndjson ? "}\n" : "\n", is_ndjson ? 2 : 1);
+
+    paramRecordWriter->numberOfRecords++;
+}
+
+/**
+ * Writes the record of every entry found during a walk to the record writer passed as the context
+ */
+void visitEntryForRecords(Volume *paramVolume, DirectoryEntry *paramDirectoryEntry, wchar_t *paramPath, int paramPathLength, void *paramContext) {
+    (void) paramVolume;
+    if(paramDirectoryEntry->entryAttributes->volume_name) {
+        return;
+    }
+    writeEntryRecord((RecordWriter *) paramContext, paramDirectoryEntry, paramPath, paramPathLength);
+}
+
+/**
+ * Prints a record for every entry of a volume as the walk reaches it
+ * @param paramVolume - The volume being walked
+ * @param paramFormat - OUTPUT_FORMAT_NDJSON or OUTPUT_FORMAT_CSV
+ */
+void printRecords(Volume *paramVolume, int paramFormat) {
+
+    RecordWriter *recordWriter = createRecordWriter(paramFormat);
+
+    streamVolume(paramVolume, visitEntryForRecords, recordWriter);
+
+    freeRecordWriter(recordWriter);
+}
+
+/**
+ * Prints the record of a single entry
+ * @param paramDirectoryEntry - The entry
+ * @param paramPath           - The path the entry was found at, given a leading '/' like the paths of a walk
+ * @param paramPathLength     - The length of the path
+ * @param paramFormat         - OUTPUT_FORMAT_NDJSON or OUTPUT_FORMAT_CSV
+ */
+void printEntryRecord(DirectoryEntry *paramDirectoryEntry, wchar_t *paramPath, int paramPathLength, int paramFormat) {
+
+    RecordWriter *recordWriter = createRecordWriter(paramFormat);
+
+    if(paramPathLength > 0 && paramPath[0] == '/') {
+        writeEntryRecord(recordWriter, paramDirectoryEntry, paramPath, paramPathLength);
+    } else {
+        wchar_t *path = createChildPath(NULL, 0, paramPath, paramPathLength);
+        writeEntryRecord(recordWriter, paramDirectoryEntry, path, paramPathLength + 1);
+        free(path);
+    }
+
+    freeRecordWriter(recordWriter);
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                            Undelete                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * When an entry is deleted the first byte of its short entry and each of its long file name entries is set to 0xE5
+ * and its clusters are freed in the FAT, the rest of the slots and the data are left behind.
+ *
+ * The undelete scan walks every live directory and lists the deleted entries still in it, rebuilding the long file
+ * name and the lost first character of the short name from the checksum. It then carves the data region for
+ * directory clusters that start with '.' and '..' but are not part of any live directory. The carve is split by
+ * cluster range across the thread pool.
+ */
+
+#define DELETED_ENTRY 0xE5
+#define CARVE_TASKS_PER_THREAD 4
+
+/**
+ * The undelete context is shared by the visitor while walking the live directories
+ */
+struct UndeleteContext {
+    uint8_t *liveDirectoryClusters;     // 1 for each cluster belonging to a live directory
+    int numberOfDeletedEntries;
+}; typedef struct UndeleteContext UndeleteContext;
+
+/**
+ * A carve task searches one range of clusters for directory signatures
+ */
+struct CarveTask {
+    Volume *volume;
+    int firstCluster;                   // First cluster searched
+    int lastCluster;                    // One past the last cluster searched
+    uint8_t *liveDirectoryClusters;
+
+    int *foundClusters;                 // Clusters of orphaned directories, in ascending order
+    int numberOfFoundClusters;
+}; typedef struct CarveTask CarveTask;
+
+/**
+ * Gets the state of the clusters a deleted entry used to occupy, assuming they were allocated contiguously
+ * @param paramVolume       - The volume of the entry
+ * @param paramEntry        - The deleted entry
+ * @return                  - A description of whether the clusters are still free
+ */
+const char *getDeletedClusterState(Volume *paramVolume, Entry *paramEntry) {
+
+    int firstCluster = getFirstClusterOfEntry(paramEntry);
+    if(!isValidCluster(paramVolume, firstCluster)) {
+        return "no clusters";
+    }
+
+    int numberOfClusters = (paramEntry->DIR_FileSize + paramVolume->bytesPerCluster - 1) / paramVolume->bytesPerCluster;
+    if(numberOfClusters == 0) {
+        numberOfClusters = 1;
+    }
+
+    if(getFatEntry(paramVolume, firstCluster) != 0x0000) {
+        return "overwritten";
+    }
+
+    for(int clusterIndex = 1; clusterIndex < numberOfClusters; clusterIndex++) {
+        int cluster = firstCluster + clusterIndex;
+        if(!isValidCluster(paramVolume, cluster) || getFatEntry(paramVolume, cluster) != 0x0000) {
+            return "partially overwritten";
+        }
+    }
+
+    return "recoverable";
+}
+
+/**
+ * Finds the first character of a deleted short name by matching the checksum held in its long file name entries
+ * @param paramShortName       - The short name, its first byte being 0xE5
+ * @param paramChecksum        - LDIR_Chksum of the long file name entries
+ * @param paramFirstCharacter  - The first character of the long file name, tried before anything else
+ * @return                     - The recovered character or '_' when none matches
+ */
+uint8_t recoverFirstCharacter(const uint8_t *paramShortName, uint8_t paramChecksum, wchar_t paramFirstCharacter) {
+
+    uint8_t shortName[11];
+    memcpy(shortName, paramShortName, 11);
+
+    if(paramFirstCharacter > 0 && paramFirstCharacter < 0x80) {
+        shortName[0] = (uint8_t) paramFirstCharacter;
+        if(shortName[0] >= 'a' && shortName[0] <= 'z') {
+            shortName[0] -= 'a' - 'A';
+        }
+        if(getShortNameChecksum(shortName) == paramChecksum) {
+            return shortName[0];
+        }
+    }
+
+    for(int character = 0x21; character < 0x100; character++) {
+        if(character == DELETED_ENTRY) {
+            continue;
+        }
+        shortName[0] = (uint8_t) character;
+        if(getShortNameChecksum(shortName) == paramChecksum) {
+            return shortName[0];
+        }
+    }
+
+    return '_';
+}
+
+/**
+ * Prints every deleted entry within the slots of a directory
+ * @param paramVolume          - The volume of the directory
+ * @param paramPath            - Path of the directory
+ * @param paramPathLength      - Length of the path
+ * @param paramDirectoryBuffer - The bytes of the directory
+ * @return                     - The number of deleted entries printed
+ */
+int printDeletedEntriesFromDirectory(Volume *paramVolume, wchar_t *paramPath, int paramPathLength, Buffer *paramDirectoryBuffer) {
+
+    int numberOfDeletedEntries = 0;
+    int longFileNameEntryCount = 0;
+
+    for(int startingByte = 0; startingByte + (int) sizeof(Entry) <= paramDirectoryBuffer->size; startingByte += sizeof(Entry)) {
+
+        unsigned char *slot = paramDirectoryBuffer->bufferPtr + startingByte;
+
+        if(slot[0] == 0x00) {
+            break;
+        }
+
+        if(slot[0] != DELETED_ENTRY) {
+            longFileNameEntryCount = 0;
+            continue;
+        }
+
+        if(slot[11] == 0x0f) {                                                                      // Long File Name Entry
+            longFileNameEntryCount++;
+            continue;
+        }
+
+        Entry entry;
+        memcpy(&entry, slot, sizeof(Entry));
+
+        /*
+         * The ordinal of each long file name entry was overwritten so they are read backwards from the short entry
+         * for as long as their checksums agree
+         */
+        wchar_t characters[(longFileNameEntryCount * 13) + 11];
+        int numberOfCharacters = 0;
+        uint8_t checksum = 0;
+
+        for(int index = 1; index <= longFileNameEntryCount; index++) {
+            LongFileNameEntry longFileNameEntry;
+            memcpy(&longFileNameEntry, slot - (index * sizeof(LongFileNameEntry)), sizeof(LongFileNameEntry));
+
+            if(index == 1) {
+                checksum = longFileNameEntry.LDIR_Chksum;
+            } else if(longFileNameEntry.LDIR_Chksum != checksum) {
+                break;
+            }
+
+            getLongFileNameCharacters(&longFileNameEntry, characters + numberOfCharacters);
+            numberOfCharacters += 13;
+        }
+
+        int fileNameSize = 0;
+        while(fileNameSize < numberOfCharacters && characters[fileNameSize] != 0x0000 && characters[fileNameSize] != 0xFFFF) {
+            fileNameSize++;
+        }
+
+        if(fileNameSize == 0) {
+            entry.DIR_Name[0] = '_';
+            if(longFileNameEntryCount > 0) {
+                entry.DIR_Name[0] = recoverFirstCharacter(entry.DIR_Name, checksum, 0);
+            }
+            for(int index = 0; index < 11; index++) {
+                characters[index] = (wchar_t) entry.DIR_Name[index];
+            }
+            fileNameSize = 11;
+        }
+
+        printOutput("Deleted: ");
+        printPath(paramPath, paramPathLength);
+        printOutput("/");
+        printPath(characters, fileNameSize);
+        printOutput("  %u bytes  cluster %d  %s%s\n",
+                    entry.DIR_FileSize,
+                    getFirstClusterOfEntry(&entry),
+                    (entry.DIR_Attr & 0x10) ? "directory " : "",
+                    getDeletedClusterState(paramVolume, &entry));
+
+        numberOfDeletedEntries++;
+        longFileNameEntryCount = 0;
+    }
+
+    return numberOfDeletedEntries;
+}
+
+/**
+ * Marks the clusters of a live directory and prints the deleted entries within it
+ */
+void visitDirectoryForUndelete(Volume *paramVolume, wchar_t *paramPath, int paramPathLength, int paramFirstCluster, Buffer *paramDirectoryBuffer, void *paramContext) {
+
+    UndeleteContext *undeleteContext = (UndeleteContext *) paramContext;
+
+    int currentCluster = getDirectoryChainStart(paramVolume, paramFirstCluster);
+    int numberOfClusters = 0;
+    while(isValidCluster(paramVolume, currentCluster) && numberOfClusters < paramVolume->numberOfClusters) {
+        undeleteContext->liveDirectoryClusters[currentCluster] = 1;
+        currentCluster = getFatEntry(paramVolume, currentCluster);
+        numberOfClusters++;
+    }
+
+    undeleteContext->numberOfDeletedEntries += printDeletedEntriesFromDirectory(paramVolume, paramPath, paramPathLength, paramDirectoryBuffer);
+}
+
+/**
+ * Checks whether a cluster starts with the '.' and '..' entries of a directory that points to itself
+ * @param paramVolume        - The volume of the cluster
+ * @param paramClusterNumber - The cluster being checked
+ * @return                   - 1 if the cluster looks like the first cluster of a directory
+ */
+uint8_t isDirectoryClusterSignature(Volume *paramVolume, int paramClusterNumber) {
+
+    static const uint8_t DOT_NAME[11] = {'.', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+    static const uint8_t DOT_DOT_NAME[11] = {'.', '.', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' '};
+
+    Entry dotEntries[2];
+    readVolumeBytes(paramVolume, getClusterOffset(paramVolume, paramClusterNumber), (unsigned char *) dotEntries, sizeof(dotEntries));
+
+    const Entry *dotEntry = dotEntries;
+    const Entry *dotDotEntry = dotEntries + 1;
+
+    return memcmp(dotEntry->DIR_Name, DOT_NAME, 11) == 0 && (dotEntry->DIR_Attr & 0x10) &&
+           memcmp(dotDotEntry->DIR_Name, DOT_DOT_NAME, 11) == 0 && (dotDotEntry->DIR_Attr & 0x10) &&
+           getFirstClusterOfEntry((Entry *) dotEntry) == paramClusterNumber;
+}
+
+/**
+ * Searches the range of a carve task for orphaned directory clusters, run by a worker of the thread pool
+ * @param paramCarveTask - The carve task
+ */
+void carveDirectoryClusters(void *paramCarveTask) {
+
+    CarveTask *carveTask = (CarveTask *) paramCarveTask;
+
+    int capacity = 16;
+    carveTask->foundClusters = (int *) malloc(sizeof(int) * capacity);
+    carveTask->numberOfFoundClusters = 0;
+
+    for(int cluster = carveTask->firstCluster; cluster < carveTask->lastCluster; cluster++) {
+
+        if(carveTask->liveDirectoryClusters[cluster] || !isDirectoryClusterSignature(carveTask->volume, cluster)) {
+            continue;
+        }
+
+        if(carveTask->numberOfFoundClusters == capacity) {
+            capacity *= 2;
+            carveTask->foundClusters = (int *) realloc(carveTask->foundClusters, sizeof(int) * capacity);
+        }
+        carveTask->foundClusters[carveTask->numberOfFoundClusters++] = cluster;
+    }
+}
+
+/**
+ * Prints an orphaned directory cluster and the entries within it
+ * @param paramVolume        - The volume of the cluster
+ * @param paramClusterNumber - The first cluster of the orphaned directory
+ */
+void printOrphanedDirectory(Volume *paramVolume, int paramClusterNumber) {
+
+    Buffer *directoryBuffer = createBuffer(paramVolume->bytesPerCluster);
+    readVolumeBytes(paramVolume, getClusterOffset(paramVolume, paramClusterNumber), directoryBuffer->bufferPtr, directoryBuffer->size);
+
+    const Entry *dotDotEntry = ((const Entry *) directoryBuffer->bufferPtr) + 1;
+
+    printOutput("Orphaned directory: cluster %d  parent cluster %d  %s\n",
+                paramClusterNumber,
+                getFirstClusterOfEntry((Entry *) dotDotEntry),
+                getFatEntry(paramVolume, paramClusterNumber) == 0x0000 ? "free" : "allocated");
+
+    LinkedList *entries = getAllEntriesFromDirectory(directoryBuffer, 0);
+
+    LinkedList *entry = entries;
+    while(entry->next != NULL) {
+        entry = entry->next;
+        DirectoryEntry *directoryEntry = (DirectoryEntry *) entry->pointer;
+
+        wchar_t *name = getDirectoryEntryName(directoryEntry);
+        printIndent(2);
+        printPath(name, directoryEntry->fileNameSize);
+        printOutput("  %u bytes  cluster %d%s\n",
+                    directoryEntry->entry->DIR_FileSize,
+                    getFirstClusterOfEntry(directoryEntry->entry),
+                    directoryEntry->entryAttributes->directory ? "  directory" : "");
+    }
+    freeDirectoryEntries(entries);
+
+    wchar_t orphanPath[32];
+    int orphanPathLength = swprintf(orphanPath, 32, L"[cluster %d]", paramClusterNumber);
+    printDeletedEntriesFromDirectory(paramVolume, orphanPath, orphanPathLength, directoryBuffer);
+
+    freeBuffer(directoryBuffer);
+}
+
+/**
+ * Lists every deleted entry in the live directories then carves the data region for orphaned directories
+ * @param paramVolume          - The volume being scanned
+ * @param paramNumberOfThreads - The number of threads the carve is split across
+ * @return                     - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int printDeletedEntries(Volume *paramVolume, int paramNumberOfThreads) {
+
+    UndeleteContext undeleteContext;
+    undeleteContext.liveDirectoryClusters = (uint8_t *) calloc(paramVolume->numberOfClusters + 2, sizeof(uint8_t));
+    undeleteContext.numberOfDeletedEntries = 0;
+
+    DirectoryVisitor visitor = {visitDirectoryForUndelete, NULL, &undeleteContext};
+    walkVolume(paramVolume, &visitor);
+
+    ThreadPool *threadPool;
+    int exception = createThreadPool(paramNumberOfThreads, &threadPool);
+    if(exception != EXCEPTION_NONE) {
+        free(undeleteContext.liveDirectoryClusters);
+        return exception;
+    }
+
+    int numberOfTasks = paramNumberOfThreads * CARVE_TASKS_PER_THREAD;
+    int clustersPerTask = (paramVolume->numberOfClusters + numberOfTasks - 1) / numberOfTasks;
+    CarveTask carveTasks[numberOfTasks];
+
+    for(int taskIndex = 0; taskIndex < numberOfTasks; taskIndex++) {
+        CarveTask *carveTask = carveTasks + taskIndex;
+        carveTask->volume = paramVolume;
+        carveTask->firstCluster = 2 + (taskIndex * clustersPerTask);
+        carveTask->lastCluster = carveTask->firstCluster + clustersPerTask;
+        if(carveTask->lastCluster > paramVolume->numberOfClusters + 2) {
+            carveTask->lastCluster = paramVolume->numberOfClusters + 2;
+        }
+        carveTask->liveDirectoryClusters = undeleteContext.liveDirectoryClusters;
+
+        submitTaskToThreadPool(threadPool, carveDirectoryClusters, carveTask);
+    }
+
+    waitForThreadPool(threadPool);
+    freeThreadPool(threadPool);
+
+    int numberOfOrphanedDirectories = 0;
+    for(int taskIndex = 0; taskIndex < numberOfTasks; taskIndex++) {
+        for(int index = 0; index < carveTasks[taskIndex].numberOfFoundClusters; index++) {
+            printOrphanedDirectory(paramVolume, carveTasks[taskIndex].foundClusters[index]);
+            numberOfOrphanedDirectories++;
+        }
+        free(carveTasks[taskIndex].foundClusters);
+    }
+
+    printOutput("%d deleted entries, %d orphaned directories\n", undeleteContext.numberOfDeletedEntries, numberOfOrphanedDirectories);
+
+    free(undeleteContext.liveDirectoryClusters);
+
+    return EXCEPTION_NONE;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                               Grep                                               |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Grep searches the contents of every file for a literal pattern without extracting the files. Each file's chain is
+ * split into extents of neighbouring clusters which are searched where they lie in the image. A match crossing from
+ * one extent to the next is found by searching only the last pattern length - 1 bytes of one extent joined to the
+ * first pattern length - 1 bytes of the next.
+ *
+ * Files are spread across the thread pool and their matches are printed in walk order once all have been searched.
+ */
+
+/**
+ * A grep task searches one file and keeps the offsets it finds
+ */
+struct GrepTask {
+    Volume *volume;
+    FileReference *fileReference;
+    const unsigned char *pattern;
+    int patternLength;
+
+    long *matchOffsets;
+    int numberOfMatches;
+    int matchCapacity;
+
+    unsigned char *boundary;        // The end of the extents searched so far followed by the start of the next
+    int boundaryLength;             // Bytes held from the end of the last extent
+    long fileOffset;                // Offset of the next extent within the file
+}; typedef struct GrepTask GrepTask;
+
+/**
+ * Finds the first occurrence of a pattern. Candidates are found 16 bytes at a time by comparing the first and last
+ * byte of the pattern at once, then checked with memcmp.
+ * @param paramHaystack       - The bytes being searched
+ * @param paramHaystackLength - The number of bytes being searched
+ * @param paramPattern        - The pattern being found
+ * @param paramPatternLength  - The length of the pattern, at least 1
+ * @return                    - Pointer to the first match or NULL
+ */
+const unsigned char *findPattern(const unsigned char *paramHaystack, size_t paramHaystackLength, const unsigned char *paramPattern, size_t paramPatternLength) {
+
+    if(paramHaystackLength < paramPatternLength) {
+        return NULL;
+    }
+
+    if(paramPatternLength == 1) {
+        return (const unsigned char *) memchr(paramHaystack, paramPattern[0], paramHaystackLength);
+    }
+
+    size_t index = 0;
+    const size_t lastStart = paramHaystackLength - paramPatternLength;
+
+#if defined(__SSE2__)
+    const __m128i firstBytes = _mm_set1_epi8((char) paramPattern[0]);
+    const __m128i lastBytes = _mm_set1_epi8((char) paramPattern[paramPatternLength - 1]);
+
+    for(; index + 16 <= lastStart + 1; index += 16) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i *) (paramHaystack + index));
+        __m128i blockLast = _mm_loadu_si128((const __m128i *) (paramHaystack + index + paramPatternLength - 1));
+
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firstBytes, blockFirst), _mm_cmpeq_epi8(lastBytes, blockLast)));
+
+        while(mask != 0) {
+            int bit = __builtin_ctz(mask);
+            if(memcmp(paramHaystack + index + bit + 1, paramPattern + 1, paramPatternLength - 2) == 0) {
+                return paramHaystack + index + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while(index <= lastStart) {
+        const unsigned char *candidate = (const unsigned char *) memchr(paramHaystack + index, paramPattern[0], lastStart - index + 1);
+        if(candidate == NULL) {
+            return NULL;
+        }
+        if(memcmp(candidate + 1, paramPattern + 1, paramPatternLength - 1) == 0) {
+            return candidate;
+        }
+        index = (candidate - paramHaystack) + 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * Records the offset of a match within the file
+ * @param paramGrepTask - The task the match belongs to
+ * @param paramOffset   - Byte offset of the match within the file
+ */
+void addMatchToGrepTask(GrepTask *paramGrepTask, long paramOffset) {
+    if(paramGrepTask->numberOfMatches == paramGrepTask->matchCapacity) {
+        paramGrepTask->matchCapacity = paramGrepTask->matchCapacity == 0 ? 16 : paramGrepTask->matchCapacity * 2;
+        paramGrepTask->matchOffsets = (long *) realloc(paramGrepTask->matchOffsets, sizeof(long) * paramGrepTask->matchCapacity);
+    }
+    paramGrepTask->matchOffsets[paramGrepTask->numberOfMatches++] = paramOffset;
+}
+
+/**
+ * Searches one extent of a file for the pattern, including matches that start in the extents before it
+ * @param paramExtent       - The bytes of the extent
+ * @param paramExtentLength - The number of bytes in the extent
+ * @param paramGrepTask     - The grep task of the file
+ */
+void grepExtent(const unsigned char *paramExtent, size_t paramExtentLength, void *paramGrepTask) {
+
+    GrepTask *grepTask = (GrepTask *) paramGrepTask;
+
+    const int OVERLAP = grepTask->patternLength - 1;
+    const unsigned char *extent = paramExtent;
+    long extentLength = (long) paramExtentLength;
+
+    unsigned char *boundary = grepTask->boundary;
+    int boundaryLength = grepTask->boundaryLength;
+    long fileOffset = grepTask->fileOffset;
+
+    // Matches that start in the last extent and end in this one
+    if(boundaryLength > 0) {
+        int headLength = extentLength < OVERLAP ? extentLength : OVERLAP;
+        memcpy(boundary + boundaryLength, extent, headLength);
+
+        const unsigned char *searchStart = boundary;
+        const unsigned char *match;
+        while((match = findPattern(searchStart, (boundary + boundaryLength + headLength) - searchStart, grepTask->pattern, grepTask->patternLength)) != NULL
+              && match - boundary < boundaryLength) {
+            addMatchToGrepTask(grepTask, fileOffset - boundaryLength + (match - boundary));
+            searchStart = match + 1;
+        }
+    }
+
+    // Matches within this extent
+    const unsigned char *searchStart = extent;
+    const unsigned char *match;
+    while((match = findPattern(searchStart, (extent + extentLength) - searchStart, grepTask->pattern, grepTask->patternLength)) != NULL) {
+        addMatchToGrepTask(grepTask, fileOffset + (match - extent));
+        searchStart = match + 1;
+    }
+
+    // Keep the end of this extent for the next boundary, joining it onto what is left of the last one if this extent is short
+    if(OVERLAP > 0) {
+        if(extentLength >= OVERLAP) {
+            memcpy(boundary, extent + extentLength - OVERLAP, OVERLAP);
+            boundaryLength = OVERLAP;
+        } else {
+            int keptLength = boundaryLength + extentLength > OVERLAP ? OVERLAP - extentLength : boundaryLength;
+            memmove(boundary, boundary + boundaryLength - keptLength, keptLength);
+            memcpy(boundary + keptLength, extent, extentLength);
+            boundaryLength = keptLength + extentLength;
+        }
+    }
+
+    grepTask->boundaryLength = boundaryLength;
+    grepTask->fileOffset = fileOffset + extentLength;
+}
+
+/**
+ * Searches every extent of a file for the pattern, run by a worker of the thread pool
+ * @param paramGrepTask - The grep task
+ */
+void grepFile(void *paramGrepTask) {
+
+    GrepTask *grepTask = (GrepTask *) paramGrepTask;
+
+    grepTask->boundary = (unsigned char *) malloc(2 * (grepTask->patternLength - 1) + 1);
+    grepTask->boundaryLength = 0;
+    grepTask->fileOffset = 0;
+
+    streamClusterChain(grepTask->volume, grepTask->fileReference->firstCluster, grepTask->fileReference->fileSize, grepExtent, grepTask);
+
+    free(grepTask->boundary);
+}
+
+/**
+ * Searches the contents of every file on the volume and prints the path and offset of each match
+ * @param paramVolume          - The volume being searched
+ * @param paramPattern         - The literal pattern
+ * @param paramNumberOfThreads - The number of threads the files are spread across
+ * @return                     - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int grepVolume(Volume *paramVolume, char *paramPattern, int paramNumberOfThreads) {
+
+    int numberOfFiles;
+    FileReference **fileReferences = getFileReferences(paramVolume, &numberOfFiles);
+
+    ThreadPool *threadPool;
+    int exception = createThreadPool(paramNumberOfThreads, &threadPool);
+    if(exception != EXCEPTION_NONE) {
+        freeFileReferences(fileReferences, numberOfFiles);
+        return exception;
+    }
+
+    GrepTask *grepTasks = (GrepTask *) calloc(numberOfFiles, sizeof(GrepTask));
+
+    for(int fileIndex = 0; fileIndex < numberOfFiles; fileIndex++) {
+        GrepTask *grepTask = grepTasks + fileIndex;
+        grepTask->volume = paramVolume;
+        grepTask->fileReference = fileReferences[fileIndex];
+        grepTask->pattern = (const unsigned char *) paramPattern;
+        grepTask->patternLength = strlen(paramPattern);
+
+        submitTaskToThreadPool(threadPool, grepFile, grepTask);
+    }
+
+    waitForThreadPool(threadPool);
+    freeThreadPool(threadPool);
+
+    for(int fileIndex = 0; fileIndex < numberOfFiles; fileIndex++) {
+        for(int matchIndex = 0; matchIndex < grepTasks[fileIndex].numberOfMatches; matchIndex++) {
+            printPath(fileReferences[fileIndex]->path, fileReferences[fileIndex]->pathLength);
+            printOutput(":%ld\n", grepTasks[fileIndex].matchOffsets[matchIndex]);
+        }
+        free(grepTasks[fileIndex].matchOffsets);
+    }
+
+    free(grepTasks);
+    freeFileReferences(fileReferences, numberOfFiles);
+
+    return EXCEPTION_NONE;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                            Manifest                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The manifest prints the SHA-256, CRC32C and size of every file, sorted by path so two manifests can be diffed.
+ * Files are streamed through the hashes straight from their clusters and spread across the thread pool.
+ *
+ * Files larger than MANIFEST_CHUNK_SIZE have their CRC32C split into chunks on cluster boundaries that are hashed
+ * by separate tasks then combined, leaving only the SHA-256 to be read from start to end by one task.
+ *
+ * When the volume has read engines the smaller files are hashed in batches instead, so each task keeps the chains of
+ * up to MANIFEST_BATCH_FILES files in flight rather than waiting on one file at a time.
+ */
+
+#define MANIFEST_CHUNK_SIZE (4 * 1024 * 1024)
+#define MANIFEST_BATCH_FILES 64
+
+/**
+ * A manifest chunk is a piece of a large file that has its CRC32C found on its own
+ */
+struct ManifestChunk {
+    Volume *volume;
+    int firstCluster;
+    long length;
+    uint32_t crc32c;
+}; typedef struct ManifestChunk ManifestChunk;
+
+/**
+ * A manifest file stores the digests of one file
+ */
+struct ManifestFile {
+    Volume *volume;
+    FileReference *fileReference;
+
+    uint8_t sha256[32];
+    uint32_t crc32c;
+    long bytesRead;                     // Less than the file size if the chain ended early
+
+    ManifestChunk *chunks;              // NULL when the CRC32C is found with the SHA-256
+    int numberOfChunks;
+}; typedef struct ManifestFile ManifestFile;
+
+/**
+ * A manifest batch is a run of files that are not split into chunks, hashed together by one task
+ */
+struct ManifestBatch {
+    ManifestFile **manifestFiles;
+    int numberOfFiles;
+}; typedef struct ManifestBatch ManifestBatch;
+
+/**
+ * Stores the two running hashes of a file while it is streamed
+ */
+struct ManifestHashes {
+    Sha256Context sha256;
+    uint32_t crc32c;
+    uint8_t is_crc32c;
+}; typedef struct ManifestHashes ManifestHashes;
+
+/**
+ * Adds an extent to the running hashes
+ */
+void hashExtentForManifest(const unsigned char *paramBytes, size_t paramLength, void *paramHashes) {
+    ManifestHashes *hashes = (ManifestHashes *) paramHashes;
+    updateSha256(&hashes->sha256, paramBytes, paramLength);
+    if(hashes->is_crc32c) {
+        hashes->crc32c = updateCrc32c(hashes->crc32c, paramBytes, paramLength);
+    }
+}
+
+/**
+ * Adds an extent to the CRC32C of a chunk
+ */
+void hashExtentForChunk(const unsigned char *paramBytes, size_t paramLength, void *paramChunk) {
+    ManifestChunk *chunk = (ManifestChunk *) paramChunk;
+    chunk->crc32c = updateCrc32c(chunk->crc32c, paramBytes, paramLength);
+}
+
+/**
+ * Finds the SHA-256 of a file and its CRC32C when it is not split into chunks, run by a worker of the thread pool
+ * @param paramManifestFile - The manifest file
+ */
+void hashManifestFile(void *paramManifestFile) {
+
+    ManifestFile *manifestFile = (ManifestFile *) paramManifestFile;
+
+    ManifestHashes hashes;
+    startSha256(&hashes.sha256);
+    hashes.crc32c = 0;
+    hashes.is_crc32c = manifestFile->chunks == NULL;
+
+    manifestFile->bytesRead = streamClusterChain(manifestFile->volume, manifestFile->fileReference->firstCluster, manifestFile->fileReference->fileSize, hashExtentForManifest, &hashes);
+
+    finishSha256(&hashes.sha256, manifestFile->sha256);
+    manifestFile->crc32c = hashes.crc32c;
+}
+
+/**
+ * Finds the SHA-256 and CRC32C of every file in a batch with their chains read at the same time, run by a worker of
+ * the thread pool
+ * @param paramManifestBatch - The batch
+ */
+void hashManifestBatch(void *paramManifestBatch) {
+
+    ManifestBatch *manifestBatch = (ManifestBatch *) paramManifestBatch;
+    int numberOfFiles = manifestBatch->numberOfFiles;
+
+    ManifestHashes *hashes = (ManifestHashes *) malloc(sizeof(ManifestHashes) * numberOfFiles);
+    ChainStream *chainStreams = (ChainStream *) calloc(numberOfFiles, sizeof(ChainStream));
+
+    for(int fileIndex = 0; fileIndex < numberOfFiles; fileIndex++) {
+        FileReference *fileReference = manifestBatch->manifestFiles[fileIndex]->fileReference;
+
+        startSha256(&hashes[fileIndex].sha256);
+        hashes[fileIndex].crc32c = 0;
+        hashes[fileIndex].is_crc32c = 1;
+
+        chainStreams[fileIndex].firstCluster = fileReference->firstCluster;
+        chainStreams[fileIndex].length = fileReference->fileSize;
+        chainStreams[fileIndex].consumer = hashExtentForManifest;
+        chainStreams[fileIndex].context = hashes + fileIndex;
+    }
+
+    streamClusterChains(manifestBatch->manifestFiles[0]->volume, chainStreams, numberOfFiles);
+
+    for(int fileIndex = 0; fileIndex < numberOfFiles; fileIndex++) {
+        ManifestFile *manifestFile = manifestBatch->manifestFiles[fileIndex];
+        manifestFile->bytesRead = chainStreams[fileIndex].bytesStreamed;
+        finishSha256(&hashes[fileIndex].sha256, manifestFile->sha256);
+        manifestFile->crc32c = hashes[fileIndex].crc32c;
+    }
+
+    free(chainStreams);
+    free(hashes);
+}
+
+/**
+ * Finds the CRC32C of one chunk, run by a worker of the thread pool
+ * @param paramManifestChunk - The chunk
+ */
+void hashManifestChunk(void *paramManifestChunk) {
+    ManifestChunk *chunk = (ManifestChunk *) paramManifestChunk;
+    chunk->crc32c = 0;
+    streamClusterChain(chunk->volume, chunk->firstCluster, chunk->length, hashExtentForChunk, chunk);
+}
+
+/**
+ * Splits a large file into chunks on cluster boundaries by following its chain
+ * @param paramManifestFile - The file being split
+ */
+void createManifestChunks(ManifestFile *paramManifestFile) {
+
+    Volume *volume = paramManifestFile->volume;
+
+    const int CLUSTERS_PER_CHUNK = MANIFEST_CHUNK_SIZE / volume->bytesPerCluster;
+    const long fileSize = paramManifestFile->fileReference->fileSize;
+
+    paramManifestFile->numberOfChunks = (fileSize + MANIFEST_CHUNK_SIZE - 1) / MANIFEST_CHUNK_SIZE;
+    paramManifestFile->chunks = (ManifestChunk *) calloc(paramManifestFile->numberOfChunks, sizeof(ManifestChunk));
+
+    int currentCluster = paramManifestFile->fileReference->firstCluster;
+    for(int chunkIndex = 0; chunkIndex < paramManifestFile->numberOfChunks; chunkIndex++) {
+
+        ManifestChunk *chunk = paramManifestFile->chunks + chunkIndex;
+        chunk->volume = volume;
+        chunk->firstCluster = currentCluster;
+        chunk->length = (chunkIndex == paramManifestFile->numberOfChunks - 1) ? fileSize - ((long) chunkIndex * MANIFEST_CHUNK_SIZE) : MANIFEST_CHUNK_SIZE;
+
+        for(int clusterIndex = 0; clusterIndex < CLUSTERS_PER_CHUNK && isValidCluster(volume, currentCluster); clusterIndex++) {
+            currentCluster = getFatEntry(volume, currentCluster);
+        }
+    }
+}
+
+/**
+ * Compares the paths of two manifest files for sorting
+ */
+int compareManifestFiles(const void *paramFirst, const void *paramSecond) {
+
+    const FileReference *first = ((const ManifestFile *) paramFirst)->fileReference;
+    const FileReference *second = ((const ManifestFile *) paramSecond)->fileReference;
+
+    int length = first->pathLength < second->pathLength ? first->pathLength : second->pathLength;
+    for(int index = 0; index < length; index++) {
+        if(first->path[index] != second->path[index]) {
+            return first->path[index] < second->path[index] ? -1 : 1;
+        }
+    }
+    return first->pathLength - second->pathLength;
+}
+
+/**
+ * Prints the SHA-256, CRC32C, size and path of every file on the volume
+ * @param paramVolume          - The volume being hashed
+ * @param paramNumberOfThreads - The number of threads the files are spread across
+ * @return                     - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int printManifest(Volume *paramVolume, int paramNumberOfThreads) {
+
+    int numberOfFiles;
+    FileReference **fileReferences = getFileReferences(paramVolume, &numberOfFiles);
+
+    ThreadPool *threadPool;
+    int exception = createThreadPool(paramNumberOfThreads, &threadPool);
+    if(exception != EXCEPTION_NONE) {
+        freeFileReferences(fileReferences, numberOfFiles);
+        return exception;
+    }
+
+    ManifestFile *manifestFiles = (ManifestFile *) calloc(numberOfFiles, sizeof(ManifestFile));
+
+    // Without read engines every file is its own task, as batching would only take away from the threads
+    ManifestFile **batchedFiles = (ManifestFile **) malloc(sizeof(ManifestFile *) * (numberOfFiles + 1));
+    int numberOfBatchedFiles = 0;
+
+    for(int fileIndex = 0; fileIndex < numberOfFiles; fileIndex++) {
+        ManifestFile *manifestFile = manifestFiles + fileIndex;
+        manifestFile->volume = paramVolume;
+        manifestFile->fileReference = fileReferences[fileIndex];
+
+        if(manifestFile->fileReference->fileSize > MANIFEST_CHUNK_SIZE) {
+            createManifestChunks(manifestFile);
+            for(int chunkIndex = 0; chunkIndex < manifestFile->numberOfChunks; chunkIndex++) {
+                submitTaskToThreadPool(threadPool, hashManifestChunk, manifestFile->chunks + chunkIndex);
+            }
+        } else if(paramVolume->readEngines != NULL) {
+            batchedFiles[numberOfBatchedFiles++] = manifestFile;
+            continue;
+        }
+
+        submitTaskToThreadPool(threadPool, hashManifestFile, manifestFile);
+    }
+
+    // Batches are kept small enough that every thread gets at least one
+    int filesPerBatch = (numberOfBatchedFiles + paramNumberOfThreads - 1) / paramNumberOfThreads;
+    filesPerBatch = filesPerBatch > MANIFEST_BATCH_FILES ? MANIFEST_BATCH_FILES : (filesPerBatch < 1 ? 1 : filesPerBatch);
+
+    int numberOfBatches = (numberOfBatchedFiles + filesPerBatch - 1) / filesPerBatch;
+    ManifestBatch *manifestBatches = (ManifestBatch *) malloc(sizeof(ManifestBatch) * (numberOfBatches + 1));
+
+    for(int batchIndex = 0; batchIndex < numberOfBatches; batchIndex++) {
+        ManifestBatch *manifestBatch = manifestBatches + batchIndex;
+        manifestBatch->manifestFiles = batchedFiles + batchIndex * filesPerBatch;
+        manifestBatch->numberOfFiles = numberOfBatchedFiles - batchIndex * filesPerBatch < filesPerBatch ? numberOfBatchedFiles - batchIndex * filesPerBatch : filesPerBatch;
+        submitTaskToThreadPool(threadPool, hashManifestBatch, manifestBatch);
+    }
+
+    waitForThreadPool(threadPool);
+    freeThreadPool(threadPool);
+
+    free(manifestBatches);
+    free(batchedFiles);
+
+    for(int fileIndex = 0; fileIndex < numberOfFiles; fileIndex++) {
+        ManifestFile *manifestFile = manifestFiles + fileIndex;
+        if(manifestFile->chunks == NULL) {
+            continue;
+        }
+
+        manifestFile->crc32c = manifestFile->chunks[0].crc32c;
+        for(int chunkIndex = 1; chunkIndex < manifestFile->numberOfChunks; chunkIndex++) {
+            manifestFile->crc32c = combineCrc32c(manifestFile->crc32c, manifestFile->chunks[chunkIndex].crc32c, manifestFile->chunks[chunkIndex].length);
+        }
+        free(manifestFile->chunks);
+    }
+
+    qsort(manifestFiles, numberOfFiles, sizeof(ManifestFile), compareManifestFiles);
+
+    for(int fileIndex = 0; fileIndex < numberOfFiles; fileIndex++) {
+        ManifestFile *manifestFile = manifestFiles + fileIndex;
+
+        for(int index = 0; index < 32; index++) {
+            printOutput("%02x", manifestFile->sha256[index]);
+        }
+        printOutput("  %08x  %u  ", manifestFile->crc32c, manifestFile->fileReference->fileSize);
+        printPath(manifestFile->fileReference->path, manifestFile->fileReference->pathLength);
+        printOutput(manifestFile->bytesRead < manifestFile->fileReference->fileSize ? "  (truncated chain)\n" : "\n");
+    }
+
+    free(manifestFiles);
+    freeFileReferences(fileReferences, numberOfFiles);
+
+    return EXCEPTION_NONE;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                                Diff                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Diff reports the files that were added, removed, modified or moved between two images.
+ *
+ * The boot sectors and FATs are compared first. Directories are then compared a cluster at a time and only those
+ * whose bytes or chain differ have their entries matched by name, identical directories are only used to find the
+ * directories below them. A file is only read when its entry or chain differs, and then both copies are compared
+ * extent by extent until the first difference. File data is never read for unchanged entries, so the time taken
+ * grows with the size of the change and the number of directories rather than the size of the image.
+ *
+ * Entries that only appear on one side are paired by first cluster and size to find moves, a moved directory then
+ * has its contents compared against its new location.
+ */
+
+/**
+ * A diff entry is an entry that only appears in one of the two images
+ */
+struct DiffEntry {
+    wchar_t *path;
+    int pathLength;
+    Entry entry;
+    uint8_t is_paired;                  // Set once the entry has been matched as a move
+}; typedef struct DiffEntry DiffEntry;
+
+/**
+ * A list of diff entries
+ */
+struct DiffEntryList {
+    DiffEntry *entries;
+    int numberOfEntries;
+    int capacity;
+}; typedef struct DiffEntryList DiffEntryList;
+
+/**
+ * The diff context holds both volumes and the entries found on only one side
+ */
+struct DiffContext {
+    Volume *oldVolume;
+    Volume *newVolume;
+    uint8_t is_same_layout;             // Both boot sectors describe the same layout so clusters can be compared
+
+    DiffEntryList removedEntries;
+    DiffEntryList addedEntries;
+
+    int numberOfModified;
+    int numberOfDirectoriesCompared;
+}; typedef struct DiffContext DiffContext;
+
+/**
+ * Adds an entry to a diff entry list
+ * @param paramList       - The list
+ * @param paramPath       - Path of the entry, copied into the list
+ * @param paramPathLength - Length of the path
+ * @param paramEntry      - The entry, copied into the list
+ */
+void addDiffEntry(DiffEntryList *paramList, wchar_t *paramPath, int paramPathLength, Entry *paramEntry) {
+
+    if(paramList->numberOfEntries == paramList->capacity) {
+        paramList->capacity = paramList->capacity == 0 ? 16 : paramList->capacity * 2;
+        paramList->entries = (DiffEntry *) realloc(paramList->entries, sizeof(DiffEntry) * paramList->capacity);
+    }
+
+    DiffEntry *diffEntry = paramList->entries + paramList->numberOfEntries++;
+    diffEntry->path = (wchar_t *) malloc(sizeof(wchar_t) * paramPathLength);
+    memcpy(diffEntry->path, paramPath, sizeof(wchar_t) * paramPathLength);
+    diffEntry->pathLength = paramPathLength;
+    diffEntry->entry = *paramEntry;
+    diffEntry->is_paired = 0;
+}
+
+/**
+ * Compares the bytes of two files extent by extent, stopping at the first difference
+ * @param paramOldVolume  - Volume of the first file
+ * @param paramOldCluster - First cluster of the first file
+ * @param paramNewVolume  - Volume of the second file
+ * @param paramNewCluster - First cluster of the second file
+ * @param paramLength     - Number of bytes compared
+ * @return                - 1 if the bytes are the same
+ */
+uint8_t isFileDataEqual(Volume *paramOldVolume, int paramOldCluster, Volume *paramNewVolume, int paramNewCluster, long paramLength) {
+
+    long oldRemaining = 0, newRemaining = 0;
+    const unsigned char *oldExtent = NULL, *newExtent = NULL;
+    int oldCluster = paramOldCluster, newCluster = paramNewCluster;
+
+    unsigned char *oldScratch = paramOldVolume->buffer == NULL ? (unsigned char *) malloc(CACHE_MAXIMUM_READ) : NULL;
+    unsigned char *newScratch = paramNewVolume->buffer == NULL ? (unsigned char *) malloc(CACHE_MAXIMUM_READ) : NULL;
+
+    uint8_t is_equal = 1;
+
+    while(paramLength > 0 && is_equal) {
+
+        if(oldRemaining == 0) {
+            if(!isValidCluster(paramOldVolume, oldCluster)) {
+                is_equal = 0;
+                break;
+            }
+            int nextCluster;
+            oldRemaining = (long) getExtentLength(paramOldVolume, oldCluster, getMaxExtentClusters(paramOldVolume, paramLength), &nextCluster) * paramOldVolume->bytesPerCluster;
+            oldExtent = getExtentBytes(paramOldVolume, oldCluster, oldRemaining, oldScratch);
+            oldCluster = nextCluster;
+        }
+
+        if(newRemaining == 0) {
+            if(!isValidCluster(paramNewVolume, newCluster)) {
+                is_equal = 0;
+                break;
+            }
+            int nextCluster;
+            newRemaining = (long) getExtentLength(paramNewVolume, newCluster, getMaxExtentClusters(paramNewVolume, paramLength), &nextCluster) * paramNewVolume->bytesPerCluster;
+            newExtent = getExtentBytes(paramNewVolume, newCluster, newRemaining, newScratch);
+            newCluster = nextCluster;
+        }
+
+        long compareLength = oldRemaining < newRemaining ? oldRemaining : newRemaining;
+        if(compareLength > paramLength) {
+            compareLength = paramLength;
+        }
+
+        is_equal = memcmp(oldExtent, newExtent, compareLength) == 0;
+
+        oldExtent += compareLength;
+        newExtent += compareLength;
+        oldRemaining -= compareLength;
+        newRemaining -= compareLength;
+        paramLength -= compareLength;
+    }
+
+    free(oldScratch);
+    free(newScratch);
+    return is_equal;
+}
+
+/**
+ * Checks whether a chain is stored the same in both FATs
+ * @param paramDiffContext  - The diff context
+ * @param paramStartCluster - First cluster of the chain in both images
+ * @return                  - 1 if every cluster of the chain has the same FAT entry in both images
+ */
+uint8_t isChainEqual(DiffContext *paramDiffContext, int paramStartCluster) {
+
+    if(!paramDiffContext->is_same_layout) {
+        return 0;
+    }
+
+    int currentCluster = paramStartCluster;
+    int numberOfClusters = 0;
+
+    while(isValidCluster(paramDiffContext->oldVolume, currentCluster) && numberOfClusters < paramDiffContext->oldVolume->numberOfClusters) {
+        uint32_t nextCluster = getFatEntry(paramDiffContext->oldVolume, currentCluster);
+        if(nextCluster != getFatEntry(paramDiffContext->newVolume, currentCluster)) {
+            return 0;
+        }
+        currentCluster = nextCluster;
+        numberOfClusters++;
+    }
+
+    return 1;
+}
+
+/**
+ * Compares two wide strings the way memcmp compares bytes, shorter strings first when one is a prefix
+ */
+int compareWideStrings(const wchar_t *paramFirst, int paramFirstLength, const wchar_t *paramSecond, int paramSecondLength) {
+    int length = paramFirstLength < paramSecondLength ? paramFirstLength : paramSecondLength;
+    for(int index = 0; index < length; index++) {
+        if(paramFirst[index] != paramSecond[index]) {
+            return paramFirst[index] < paramSecond[index] ? -1 : 1;
+        }
+    }
+    return paramFirstLength - paramSecondLength;
+}
+
+/**
+ * Compares the names of two directory entries for sorting
+ */
+int compareDirectoryEntryNames(const void *paramFirst, const void *paramSecond) {
+    DirectoryEntry *first = *(DirectoryEntry **) paramFirst;
+    DirectoryEntry *second = *(DirectoryEntry **) paramSecond;
+    return compareWideStrings(first->longFileName, first->fileNameSize, second->longFileName, second->fileNameSize);
+}
+
+/**
+ * Gets the entries of a directory sorted by name, skipping the volume name
+ * @param paramEntries           - Linked list from getAllEntriesFromDirectory
+ * @param paramNumberOfEntries   - Set to the number of entries
+ * @return                       - Array of the entries sorted by name
+ */
+DirectoryEntry **getSortedDirectoryEntries(LinkedList *paramEntries, int *paramNumberOfEntries) {
+
+    int numberOfEntries = 0;
+    for(LinkedList *entry = paramEntries->next; entry != NULL; entry = entry->next) {
+        numberOfEntries++;
+    }
+
+    DirectoryEntry **sortedEntries = (DirectoryEntry **) malloc(sizeof(DirectoryEntry *) * (numberOfEntries + 1));
+    numberOfEntries = 0;
+    for(LinkedList *entry = paramEntries->next; entry != NULL; entry = entry->next) {
+        DirectoryEntry *directoryEntry = (DirectoryEntry *) entry->pointer;
+        if(!directoryEntry->entryAttributes->volume_name) {
+            getDirectoryEntryName(directoryEntry);
+            sortedEntries[numberOfEntries++] = directoryEntry;
+        }
+    }
+
+    qsort(sortedEntries, numberOfEntries, sizeof(DirectoryEntry *), compareDirectoryEntryNames);
+
+    *paramNumberOfEntries = numberOfEntries;
+    return sortedEntries;
+}
+
+void diffDirectories(DiffContext *paramDiffContext, wchar_t *paramOldPath, int paramOldPathLength, int paramOldCluster, wchar_t *paramNewPath, int paramNewPathLength, int paramNewCluster, int paramDepth);
+
+/**
+ * Compares two entries with the same name that are both files or both directories
+ */
+void diffMatchingEntries(DiffContext *paramDiffContext, DirectoryEntry *paramOldEntry, wchar_t *paramOldPath, int paramOldPathLength,
+                         DirectoryEntry *paramNewEntry, wchar_t *paramNewPath, int paramNewPathLength, int paramDepth) {
+
+    int oldCluster = getFirstClusterOfEntry(paramOldEntry->entry);
+    int newCluster = getFirstClusterOfEntry(paramNewEntry->entry);
+
+    if(paramOldEntry->entryAttributes->directory) {
+        if(isValidCluster(paramDiffContext->oldVolume, oldCluster) && isValidCluster(paramDiffContext->newVolume, newCluster) && paramDepth < MAX_DIRECTORY_DEPTH) {
+            diffDirectories(paramDiffContext, paramOldPath, paramOldPathLength, oldCluster, paramNewPath, paramNewPathLength, newCluster, paramDepth + 1);
+        }
+        return;
+    }
+
+    uint8_t is_entry_equal = memcmp(paramOldEntry->entry, paramNewEntry->entry, sizeof(Entry)) == 0;
+    if(is_entry_equal && isChainEqual(paramDiffContext, oldCluster)) {
+        return;
+    }
+
+    uint8_t is_data_equal = paramOldEntry->entry->DIR_FileSize == paramNewEntry->entry->DIR_FileSize &&
+            isFileDataEqual(paramDiffContext->oldVolume, oldCluster, paramDiffContext->newVolume, newCluster, paramOldEntry->entry->DIR_FileSize);
+
+    if(is_data_equal && is_entry_equal) {
+        return;
+    }
+
+    printOutput("Modified: ");
+    printPath(paramNewPath, paramNewPathLength);
+    printOutput(is_data_equal ? "  (metadata)\n" : "  (content)\n");
+    paramDiffContext->numberOfModified++;
+}
+
+/**
+ * Compares a directory of the old image with a directory of the new image and everything below them
+ * @param paramDiffContext    - The diff context
+ * @param paramOldPath        - Path of the old directory
+ * @param paramOldPathLength  - Length of the old path
+ * @param paramOldCluster     - First cluster of the old directory, 0 for the root
+ * @param paramNewPath        - Path of the new directory
+ * @param paramNewPathLength  - Length of the new path
+ * @param paramNewCluster     - First cluster of the new directory, 0 for the root
+ * @param paramDepth          - Depth of the directories
+ */
+void diffDirectories(DiffContext *paramDiffContext, wchar_t *paramOldPath, int paramOldPathLength, int paramOldCluster, wchar_t *paramNewPath, int paramNewPathLength, int paramNewCluster, int paramDepth) {
+
+    paramDiffContext->numberOfDirectoriesCompared++;
+
+    Buffer *oldDirectory = readDirectory(paramDiffContext->oldVolume, paramOldCluster);
+    Buffer *newDirectory = readDirectory(paramDiffContext->newVolume, paramNewCluster);
+
+    uint8_t is_directory_equal = paramOldCluster == paramNewCluster &&
+            oldDirectory->size == newDirectory->size &&
+            (paramOldCluster == 0 || isChainEqual(paramDiffContext, paramOldCluster)) &&
+            memcmp(oldDirectory->bufferPtr, newDirectory->bufferPtr, oldDirectory->size) == 0;
+
+    LinkedList *oldList = getAllEntriesFromDirectory(oldDirectory, 0);
+    int numberOfOldEntries;
+    DirectoryEntry **oldEntries = getSortedDirectoryEntries(oldList, &numberOfOldEntries);
+
+    if(is_directory_equal) {
+
+        // The entries are the same on both sides so only the directories below can hold a change
+        for(int index = 0; index < numberOfOldEntries; index++) {
+            DirectoryEntry *directoryEntry = oldEntries[index];
+            int cluster = getFirstClusterOfEntry(directoryEntry->entry);
+
+            if(!directoryEntry->entryAttributes->directory || !isValidCluster(paramDiffContext->oldVolume, cluster) || paramDepth >= MAX_DIRECTORY_DEPTH) {
+                continue;
+            }
+
+            wchar_t *oldPath = createChildPath(paramOldPath, paramOldPathLength, directoryEntry->longFileName, directoryEntry->fileNameSize);
+            wchar_t *newPath = createChildPath(paramNewPath, paramNewPathLength, directoryEntry->longFileName, directoryEntry->fileNameSize);
+            diffDirectories(paramDiffContext, oldPath, paramOldPathLength + 1 + directoryEntry->fileNameSize, cluster,
+                            newPath, paramNewPathLength + 1 + directoryEntry->fileNameSize, cluster, paramDepth + 1);
+            free(oldPath);
+            free(newPath);
+        }
+
+    } else {
+
+        LinkedList *newList = getAllEntriesFromDirectory(newDirectory, 0);
+        int numberOfNewEntries;
+        DirectoryEntry **newEntries = getSortedDirectoryEntries(newList, &numberOfNewEntries);
+
+        int oldIndex = 0, newIndex = 0;
+        while(oldIndex < numberOfOldEntries || newIndex < numberOfNewEntries) {
+
+            DirectoryEntry *oldEntry = oldIndex < numberOfOldEntries ? oldEntries[oldIndex] : NULL;
+            DirectoryEntry *newEntry = newIndex < numberOfNewEntries ? newEntries[newIndex] : NULL;
+
+            int comparison;
+            if(oldEntry == NULL) {
+                comparison = 1;
+            } else if(newEntry == NULL) {
+                comparison = -1;
+            } else {
+                comparison = compareWideStrings(oldEntry->longFileName, oldEntry->fileNameSize, newEntry->longFileName, newEntry->fileNameSize);
+                if(comparison == 0 && oldEntry->entryAttributes->directory != newEntry->entryAttributes->directory) {
+                    comparison = -1;                                                                // Replaced by a different kind of entry
+                }
+            }
+
+            wchar_t *oldPath = oldEntry == NULL ? NULL : createChildPath(paramOldPath, paramOldPathLength, oldEntry->longFileName, oldEntry->fileNameSize);
+            wchar_t *newPath = newEntry == NULL ? NULL : createChildPath(paramNewPath, paramNewPathLength, newEntry->longFileName, newEntry->fileNameSize);
+            int oldPathLength = oldEntry == NULL ? 0 : paramOldPathLength + 1 + oldEntry->fileNameSize;
+            int newPathLength = newEntry == NULL ? 0 : paramNewPathLength + 1 + newEntry->fileNameSize;
+
+            if(comparison < 0) {
+                addDiffEntry(&paramDiffContext->removedEntries, oldPath, oldPathLength, oldEntry->entry);
+                oldIndex++;
+            } else if(comparison > 0) {
+                addDiffEntry(&paramDiffContext->addedEntries, newPath, newPathLength, newEntry->entry);
+                newIndex++;
+            } else {
+                diffMatchingEntries(paramDiffContext, oldEntry, oldPath, oldPathLength, newEntry, newPath, newPathLength, paramDepth);
+                oldIndex++;
+                newIndex++;
+            }
+
+            free(oldPath);
+            free(newPath);
+        }
+
+        free(newEntries);
+        freeDirectoryEntries(newList);
+    }
+
+    free(oldEntries);
+    freeDirectoryEntries(oldList);
+    freeBuffer(oldDirectory);
+    freeBuffer(newDirectory);
+}
+
+/**
+ * Pairs removed and added entries that share a first cluster and size as moves. Moved directories are compared
+ * against their new location, which may find more entries to pair.
+ * @param paramDiffContext - The diff context
+ */
+void pairMovedEntries(DiffContext *paramDiffContext) {
+
+    int pairedUpTo = 0;
+    int addedUpTo = 0;
+
+    // Repeat while comparing moved directories finds more added or removed entries
+    while(pairedUpTo < paramDiffContext->removedEntries.numberOfEntries || addedUpTo < paramDiffContext->addedEntries.numberOfEntries) {
+
+        int removedCount = paramDiffContext->removedEntries.numberOfEntries;
+        int addedCount = paramDiffContext->addedEntries.numberOfEntries;
+
+        for(int removedIndex = 0; removedIndex < removedCount; removedIndex++) {
+            DiffEntry *removedEntry = paramDiffContext->removedEntries.entries + removedIndex;
+            int removedCluster = getFirstClusterOfEntry(&removedEntry->entry);
+
+            if(removedEntry->is_paired || removedCluster == 0) {
+                continue;
+            }
+
+            for(int addedIndex = 0; addedIndex < addedCount; addedIndex++) {
+                DiffEntry *addedEntry = paramDiffContext->addedEntries.entries + addedIndex;
+
+                if(addedEntry->is_paired || getFirstClusterOfEntry(&addedEntry->entry) != removedCluster ||
+                   addedEntry->entry.DIR_FileSize != removedEntry->entry.DIR_FileSize ||
+                   (addedEntry->entry.DIR_Attr & 0x10) != (removedEntry->entry.DIR_Attr & 0x10)) {
+                    continue;
+                }
+
+                // Only entries found in this pass can be new pairs
+                if(removedIndex < pairedUpTo && addedIndex < addedUpTo) {
+                    continue;
+                }
+
+                removedEntry->is_paired = 1;
+                addedEntry->is_paired = 1;
+
+                printOutput("Moved: ");
+                printPath(removedEntry->path, removedEntry->pathLength);
+                printOutput(" -> ");
+                printPath(addedEntry->path, addedEntry->pathLength);
+
+                if(removedEntry->entry.DIR_Attr & 0x10) {
+                    printOutput("\n");
+                    diffDirectories(paramDiffContext, removedEntry->path, removedEntry->pathLength, removedCluster,
+                                    addedEntry->path, addedEntry->pathLength, removedCluster, 1);
+                } else if(!isFileDataEqual(paramDiffContext->oldVolume, removedCluster, paramDiffContext->newVolume, removedCluster, removedEntry->entry.DIR_FileSize)) {
+                    printOutput("  (content)\n");
+                    paramDiffContext->numberOfModified++;
+                } else {
+                    printOutput("\n");
+                }
+                break;
+            }
+        }
+
+        pairedUpTo = removedCount;
+        addedUpTo = addedCount;
+    }
+}
+
+/**
+ * Prints the entries of a list that were not paired as moves
+ * @param paramList   - The list being printed
+ * @param paramPrefix - Printed before each path
+ * @return            - The number of entries printed
+ */
+int printUnpairedDiffEntries(DiffEntryList *paramList, const char *paramPrefix) {
+
+    int numberOfPrinted = 0;
+
+    for(int index = 0; index < paramList->numberOfEntries; index++) {
+        DiffEntry *diffEntry = paramList->entries + index;
+        if(!diffEntry->is_paired) {
+            printOutput("%s", paramPrefix);
+            printPath(diffEntry->path, diffEntry->pathLength);
+            printOutput((diffEntry->entry.DIR_Attr & 0x10) ? "/\n" : "\n");
+            numberOfPrinted++;
+        }
+        free(diffEntry->path);
+    }
+    free(paramList->entries);
+
+    return numberOfPrinted;
+}
+
+/**
+ * Prints the differences between two images
+ * @param paramOldVolume - The earlier image
+ * @param paramNewVolume - The later image
+ * @return               - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int diffVolumes(Volume *paramOldVolume, Volume *paramNewVolume) {
+
+    DiffContext diffContext;
+    memset(&diffContext, 0, sizeof(DiffContext));
+    diffContext.oldVolume = paramOldVolume;
+    diffContext.newVolume = paramNewVolume;
+
+    BootSector *oldBootSector = paramOldVolume->bootSector;
+    BootSector *newBootSector = paramNewVolume->bootSector;
+
+    diffContext.is_same_layout = oldBootSector->BPB_BytsPerSec == newBootSector->BPB_BytsPerSec &&
+            oldBootSector->BPB_SecPerClus == newBootSector->BPB_SecPerClus &&
+            oldBootSector->BPB_RsvdSecCnt == newBootSector->BPB_RsvdSecCnt &&
+            oldBootSector->BPB_NumFATs == newBootSector->BPB_NumFATs &&
+            oldBootSector->BPB_RootEntCnt == newBootSector->BPB_RootEntCnt &&
+            paramOldVolume->sectorsPerFat == paramNewVolume->sectorsPerFat &&
+            paramOldVolume->fat == paramNewVolume->fat &&
+            paramOldVolume->numberOfClusters == paramNewVolume->numberOfClusters;
+
+    if(memcmp(oldBootSector, newBootSector, sizeof(BootSector)) != 0) {
+        printOutput(diffContext.is_same_layout ? "Boot sector: differs\n" : "Boot sector: differs in layout, comparing by content\n");
+    }
+
+    if(diffContext.is_same_layout) {
+        int numberOfChangedClusters = 0;
+        for(int cluster = 2; cluster < paramOldVolume->numberOfClusters + 2; cluster++) {
+            if(getFatEntry(paramOldVolume, cluster) != getFatEntry(paramNewVolume, cluster)) {
+                numberOfChangedClusters++;
+            }
+        }
+        if(numberOfChangedClusters > 0) {
+            printOutput("FAT: %d entries differ\n", numberOfChangedClusters);
+        }
+    }
+
+    diffDirectories(&diffContext, NULL, 0, 0, NULL, 0, 0, 0);
+    pairMovedEntries(&diffContext);
+
+    int numberOfMoved = 0;
+    for(int index = 0; index < diffContext.addedEntries.numberOfEntries; index++) {
+        numberOfMoved += diffContext.addedEntries.entries[index].is_paired;
+    }
+
+    int numberOfAdded = printUnpairedDiffEntries(&diffContext.addedEntries, "Added: ");
+    int numberOfRemoved = printUnpairedDiffEntries(&diffContext.removedEntries, "Removed: ");
+
+    printOutput("%d added, %d removed, %d modified, %d moved, %d directories compared\n",
+                numberOfAdded, numberOfRemoved, diffContext.numberOfModified, numberOfMoved, diffContext.numberOfDirectoriesCompared);
+
+    return EXCEPTION_NONE;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                         Incremental Scan                                         |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * An incremental scan reports what changed in an image since the last time it was scanned, for images that change
+ * a little at a time underneath us. The state of a scan is kept in a file holding a CRC32C of every sector of the
+ * first FAT, and for every directory its chain, a CRC32C of each of its clusters and its entries sorted by name.
+ *
+ * A re-scan hashes the FAT and compares it sector by sector. A directory keeps the chain it had unless one of the
+ * sectors holding the entries of that chain changed, only then is the chain followed again. Its clusters are then
+ * read and hashed, and a directory whose chain and hashes are all the same takes its entries from the state without
+ * being parsed. Only the directories that changed are parsed and matched by name against their old entries like
+ * diff does, so the time taken grows with the FAT and the directory clusters rather than with the number of
+ * entries. A directory is known by its first cluster, so one that moved is compared with what it held before.
+ *
+ * Only metadata is read, a file rewritten in place without a change to its entry is not noticed. The state is
+ * written to a temporary file and renamed over the old one, so a scan that is stopped leaves the last state whole.
+ */
+
+#define SCAN_STATE_MAGIC "FAT16SS1"
+#define SCAN_CACHE_BYTES (16L * 1024 * 1024)    // Block cache budget of a scan, which reads the FAT and directories
+#define SCAN_FAT_WINDOW_SECTORS 256             // Sectors of the FAT read and hashed at a time
+
+/**
+ * The header at the start of a scan state, the layout values must match the image for its hashes to be compared
+ */
+struct __attribute__((__packed__)) ScanStateHeader {
+    uint8_t     magic[ 8 ];             // SCAN_STATE_MAGIC
+    uint16_t    bytesPerSector;
+    uint8_t     sectorsPerCluster;
+    uint8_t     fatType;
+    uint32_t    sectorFatStart;
+    uint32_t    sectorsPerFat;
+    uint32_t    numberOfClusters;
+    uint32_t    rootDirectoryCluster;
+    uint32_t    numberOfFatSectors;     // CRC32C values that follow the header
+    uint32_t    numberOfDirectories;    // Directories that follow the hashes
+
+}; typedef struct ScanStateHeader ScanStateHeader;
+
+/**
+ * The header of each directory in a scan state, followed by its clusters, their hashes and then its entries, each
+ * an Entry, a uint16_t name length and the characters of the name as uint32_t
+ */
+struct __attribute__((__packed__)) ScanDirectoryHeader {
+    uint32_t    firstCluster;           // 0 for the root directory
+    uint32_t    numberOfClusters;       // Clusters hashed, on the fixed root region each is a cluster sized piece
+    uint32_t    numberOfEntries;
+
+}; typedef struct ScanDirectoryHeader ScanDirectoryHeader;
+
+/**
+ * An entry of a scanned directory
+ */
+struct ScanEntry {
+    Entry entry;
+    wchar_t *name;
+    int nameLength;
+}; typedef struct ScanEntry ScanEntry;
+
+/**
+ * A scanned directory, its clusters, their hashes and its entries sorted by name
+ */
+struct ScanDirectory {
+    int firstCluster;
+    int numberOfClusters;
+    int *clusters;                      // All 0 on the fixed root region
+    uint32_t *clusterHashes;
+    ScanEntry *entries;
+    int numberOfEntries;
+    uint8_t is_claimed;                 // Matched to a directory of the image by the re-scan
+}; typedef struct ScanDirectory ScanDirectory;
+
+/**
+ * The state of a scan
+ */
+struct ScanState {
+    ScanStateHeader header;
+    uint32_t *fatSectorHashes;
+    ScanDirectory *directories;         // Sorted by first cluster once loaded
+    int numberOfDirectories;
+    int directoriesCapacity;
+}; typedef struct ScanState ScanState;
+
+/**
+ * The scan context holds the state being compared against and the state being built
+ */
+struct ScanContext {
+    Volume *volume;
+    ScanState *oldState;                // Empty when there was no earlier scan
+    ScanState *newState;
+    uint8_t is_same_layout;             // The old hashes and chains can be compared with the image
+    uint8_t *changedFatSectors;         // 1 for each sector of the FAT whose hash changed
+    uint8_t *is_reached;                // 1 for each first cluster already scanned, index 0 is the root directory
+
+    DiffEntryList removedEntries;
+    DiffEntryList addedEntries;
+    int numberOfModified;
+    int numberOfParsed;                 // Directories whose entries were parsed rather than taken from the state
+}; typedef struct ScanContext ScanContext;
+
+/**
+ * Frees the arrays of the directories of a scan state and the state
+ * @param paramScanState - The scan state, may be NULL
+ */
+void freeScanState(ScanState *paramScanState) {
+
+    if(paramScanState == NULL) {
+        return;
+    }
+
+    for(int directoryIndex = 0; directoryIndex < paramScanState->numberOfDirectories; directoryIndex++) {
+        ScanDirectory *scanDirectory = paramScanState->directories + directoryIndex;
+        for(int entryIndex = 0; entryIndex < scanDirectory->numberOfEntries && scanDirectory->entries != NULL; entryIndex++) {
+            free(scanDirectory->entries[entryIndex].name);
+        }
+        free(scanDirectory->entries);
+        free(scanDirectory->clusters);
+        free(scanDirectory->clusterHashes);
+    }
+    free(paramScanState->directories);
+    free(paramScanState->fatSectorHashes);
+    free(paramScanState);
+}
+
+/**
+ * Fills the layout values of a scan state header from a volume
+ * @param paramVolume          - The volume
+ * @param paramScanStateHeader - The header being filled
+ */
+void setScanStateLayout(Volume *paramVolume, ScanStateHeader *paramScanStateHeader) {
+    memset(paramScanStateHeader, 0, sizeof(ScanStateHeader));
+    memcpy(paramScanStateHeader->magic, SCAN_STATE_MAGIC, sizeof(paramScanStateHeader->magic));
+    paramScanStateHeader->bytesPerSector = paramVolume->bootSector->BPB_BytsPerSec;
+    paramScanStateHeader->sectorsPerCluster = paramVolume->bootSector->BPB_SecPerClus;
+    paramScanStateHeader->fatType = (uint8_t) paramVolume->fat->fatType;
+    paramScanStateHeader->sectorFatStart = (uint32_t) paramVolume->sectorFatStart;
+    paramScanStateHeader->sectorsPerFat = (uint32_t) paramVolume->sectorsPerFat;
+    paramScanStateHeader->numberOfClusters = (uint32_t) paramVolume->numberOfClusters;
+    paramScanStateHeader->rootDirectoryCluster = (uint32_t) paramVolume->rootDirectoryCluster;
+    paramScanStateHeader->numberOfFatSectors = (uint32_t) paramVolume->sectorsPerFat;
+}
+
+/**
+ * Gets the next bytes of a scan state being loaded
+ * @param paramBuffer - The bytes of the state file
+ * @param paramCursor - The first byte wanted, moved past the bytes
+ * @param paramLength - The number of bytes wanted
+ * @return            - The bytes, NULL when the file is too short to hold them
+ */
+const unsigned char *takeScanStateBytes(Buffer *paramBuffer, long *paramCursor, long paramLength) {
+    if(paramLength < 0 || *paramCursor + paramLength > paramBuffer->size) {
+        return NULL;
+    }
+    const unsigned char *bytes = paramBuffer->bufferPtr + *paramCursor;
+    *paramCursor += paramLength;
+    return bytes;
+}
+
+/** Orders scanned directories by their first cluster */
+int compareScanDirectories(const void *paramFirst, const void *paramSecond) {
+    int first = ((const ScanDirectory *) paramFirst)->firstCluster;
+    int second = ((const ScanDirectory *) paramSecond)->firstCluster;
+    return (first > second) - (first < second);
+}
+
+/**
+ * Parses the directories of a scan state after its header and FAT hashes
+ * @param paramBuffer    - The bytes of the state file
+ * @param paramCursor    - The first byte of the directories
+ * @param paramScanState - The scan state, its directories are added to it
+ * @return               - EXCEPTION_NONE or EXCEPTION_INVALID_SCAN_STATE
+ */
+int parseScanDirectories(Buffer *paramBuffer, long *paramCursor, ScanState *paramScanState) {
+
+    int numberOfDirectories = (int) paramScanState->header.numberOfDirectories;
+    if(numberOfDirectories < 0 || (long) numberOfDirectories * (long) sizeof(ScanDirectoryHeader) > paramBuffer->size) {
+        return EXCEPTION_INVALID_SCAN_STATE;
+    }
+    paramScanState->directories = (ScanDirectory *) calloc(numberOfDirectories + 1, sizeof(ScanDirectory));
+    paramScanState->directoriesCapacity = numberOfDirectories + 1;
+
+    for(int directoryIndex = 0; directoryIndex < numberOfDirectories; directoryIndex++) {
+
+        const ScanDirectoryHeader *directoryHeader = (const ScanDirectoryHeader *) takeScanStateBytes(paramBuffer, paramCursor, sizeof(ScanDirectoryHeader));
+        if(directoryHeader == NULL || directoryHeader->numberOfClusters > (uint32_t) paramBuffer->size ||
+           directoryHeader->numberOfEntries > (uint32_t) paramBuffer->size) {
+            return EXCEPTION_INVALID_SCAN_STATE;
+        }
+
+        ScanDirectory *scanDirectory = paramScanState->directories + paramScanState->numberOfDirectories++;
+        scanDirectory->firstCluster = (int) directoryHeader->firstCluster;
+        scanDirectory->numberOfClusters = (int) directoryHeader->numberOfClusters;
+        scanDirectory->clusters = (int *) malloc(sizeof(int) * (scanDirectory->numberOfClusters + 1));
+        scanDirectory->clusterHashes = (uint32_t *) malloc(sizeof(uint32_t) * (scanDirectory->numberOfClusters + 1));
+        scanDirectory->entries = (ScanEntry *) calloc(directoryHeader->numberOfEntries + 1, sizeof(ScanEntry));
+        int numberOfEntries = (int) directoryHeader->numberOfEntries;
+
+        const unsigned char *clusters = takeScanStateBytes(paramBuffer, paramCursor, 4L * scanDirectory->numberOfClusters);
+        const unsigned char *hashes = takeScanStateBytes(paramBuffer, paramCursor, 4L * scanDirectory->numberOfClusters);
+        if(clusters == NULL || hashes == NULL) {
+            return EXCEPTION_INVALID_SCAN_STATE;
+        }
+        memcpy(scanDirectory->clusters, clusters, 4L * scanDirectory->numberOfClusters);
+        memcpy(scanDirectory->clusterHashes, hashes, 4L * scanDirectory->numberOfClusters);
+
+        for(int entryIndex = 0; entryIndex < numberOfEntries; entryIndex++) {
+            const unsigned char *entry = takeScanStateBytes(paramBuffer, paramCursor, sizeof(Entry));
+            const unsigned char *nameLength = takeScanStateBytes(paramBuffer, paramCursor, sizeof(uint16_t));
+            if(entry == NULL || nameLength == NULL) {
+                return EXCEPTION_INVALID_SCAN_STATE;
+            }
+
+            ScanEntry *scanEntry = scanDirectory->entries + scanDirectory->numberOfEntries++;
+            memcpy(&scanEntry->entry, entry, sizeof(Entry));
+            scanEntry->nameLength = nameLength[0] | nameLength[1] << 8;
+
+            const uint32_t *characters = (const uint32_t *) takeScanStateBytes(paramBuffer, paramCursor, 4L * scanEntry->nameLength);
+            if(characters == NULL) {
+                return EXCEPTION_INVALID_SCAN_STATE;
+            }
+            scanEntry->name = (wchar_t *) malloc(sizeof(wchar_t) * (scanEntry->nameLength + 1));
+            for(int characterIndex = 0; characterIndex < scanEntry->nameLength; characterIndex++) {
+                uint32_t character;
+                memcpy(&character, characters + characterIndex, sizeof(uint32_t));
+                scanEntry->name[characterIndex] = (wchar_t) character;
+            }
+        }
+    }
+
+    qsort(paramScanState->directories, paramScanState->numberOfDirectories, sizeof(ScanDirectory), compareScanDirectories);
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Loads the state of the last scan of an image
+ * @param paramStateLocation - The location of the state file
+ * @param paramScanState     - Set to the state, NULL when there is no state file yet
+ * @return                   - EXCEPTION_NONE, EXCEPTION_UNABLE_TO_OPEN_FILE or EXCEPTION_INVALID_SCAN_STATE
+ */
+int loadScanState(char *paramStateLocation, ScanState **paramScanState) {
+
+    *paramScanState = NULL;
+
+    int fileDescriptor = open(paramStateLocation, O_RDONLY);
+    if(fileDescriptor < 0) {
+        return errno == ENOENT ? EXCEPTION_NONE : EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    struct stat stateStat;
+    if(fstat(fileDescriptor, &stateStat) != 0 || stateStat.st_size > INT32_MAX) {
+        close(fileDescriptor);
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    Buffer *buffer = createBuffer((long) stateStat.st_size);
+    long bytesRead = 0;
+    while(bytesRead < buffer->size) {
+        ssize_t result = read(fileDescriptor, buffer->bufferPtr + bytesRead, buffer->size - bytesRead);
+        if(result <= 0) {
+            break;
+        }
+        bytesRead += result;
+    }
+    close(fileDescriptor);
+
+    ScanState *scanState = (ScanState *) calloc(1, sizeof(ScanState));
+    long cursor = 0;
+
+    const unsigned char *header = takeScanStateBytes(buffer, &cursor, sizeof(ScanStateHeader));
+    int exception = bytesRead == buffer->size && header != NULL ? EXCEPTION_NONE : EXCEPTION_INVALID_SCAN_STATE;
+
+    if(exception == EXCEPTION_NONE) {
+        memcpy(&scanState->header, header, sizeof(ScanStateHeader));
+        if(memcmp(scanState->header.magic, SCAN_STATE_MAGIC, sizeof(scanState->header.magic)) != 0) {
+            exception = EXCEPTION_INVALID_SCAN_STATE;
+        }
+    }
+
+    if(exception == EXCEPTION_NONE) {
+        const unsigned char *hashes = takeScanStateBytes(buffer, &cursor, 4L * scanState->header.numberOfFatSectors);
+        if(hashes == NULL) {
+            exception = EXCEPTION_INVALID_SCAN_STATE;
+        } else {
+            scanState->fatSectorHashes = (uint32_t *) malloc(4L * scanState->header.numberOfFatSectors + 4);
+            memcpy(scanState->fatSectorHashes, hashes, 4L * scanState->header.numberOfFatSectors);
+        }
+    }
+
+    if(exception == EXCEPTION_NONE) {
+        exception = parseScanDirectories(buffer, &cursor, scanState);
+    }
+
+    freeBuffer(buffer);
+
+    if(exception != EXCEPTION_NONE) {
+        freeScanState(scanState);
+        return exception;
+    }
+
+    *paramScanState = scanState;
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Writes a scan state to a temporary file beside its location then renames it over the location
+ * @param paramScanState     - The scan state
+ * @param paramStateLocation - The location of the state file
+ * @return                   - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_WRITE_FILE
+ */
+int saveScanState(ScanState *paramScanState, char *paramStateLocation) {
+
+    paramScanState->header.numberOfDirectories = (uint32_t) paramScanState->numberOfDirectories;
+
+    long size = sizeof(ScanStateHeader) + 4L * paramScanState->header.numberOfFatSectors;
+    for(int directoryIndex = 0; directoryIndex < paramScanState->numberOfDirectories; directoryIndex++) {
+        ScanDirectory *scanDirectory = paramScanState->directories + directoryIndex;
+        size += sizeof(ScanDirectoryHeader) + 8L * scanDirectory->numberOfClusters;
+        for(int entryIndex = 0; entryIndex < scanDirectory->numberOfEntries; entryIndex++) {
+            size += sizeof(Entry) + sizeof(uint16_t) + 4L * scanDirectory->entries[entryIndex].nameLength;
+        }
+    }
+
+    unsigned char *bytes = (unsigned char *) malloc(size);
+    unsigned char *cursor = bytes;
+
+    memcpy(cursor, &paramScanState->header, sizeof(ScanStateHeader));
+    cursor += sizeof(ScanStateHeader);
+    memcpy(cursor, paramScanState->fatSectorHashes, 4L * paramScanState->header.numberOfFatSectors);
+    cursor += 4L * paramScanState->header.numberOfFatSectors;
+
+    for(int directoryIndex = 0; directoryIndex < paramScanState->numberOfDirectories; directoryIndex++) {
+        ScanDirectory *scanDirectory = paramScanState->directories + directoryIndex;
+
+        ScanDirectoryHeader directoryHeader = { (uint32_t) scanDirectory->firstCluster, (uint32_t) scanDirectory->numberOfClusters, (uint32_t) scanDirectory->numberOfEntries };
+        memcpy(cursor, &directoryHeader, sizeof(ScanDirectoryHeader));
+        cursor += sizeof(ScanDirectoryHeader);
+        memcpy(cursor, scanDirectory->clusters, 4L * scanDirectory->numberOfClusters);
+        cursor += 4L * scanDirectory->numberOfClusters;
+        memcpy(cursor, scanDirectory->clusterHashes, 4L * scanDirectory->numberOfClusters);
+        cursor += 4L * scanDirectory->numberOfClusters;
+
+        for(int entryIndex = 0; entryIndex < scanDirectory->numberOfEntries; entryIndex++) {
+            ScanEntry *scanEntry = scanDirectory->entries + entryIndex;
+            memcpy(cursor, &scanEntry->entry, sizeof(Entry));
+            cursor += sizeof(Entry);
+            *cursor++ = (unsigned char) (scanEntry->nameLength & 0xff);
+            *cursor++ = (unsigned char) (scanEntry->nameLength >> 8);
+            for(int characterIndex = 0; characterIndex < scanEntry->nameLength; characterIndex++) {
+                uint32_t character = (uint32_t) scanEntry->name[characterIndex];
+                memcpy(cursor, &character, sizeof(uint32_t));
+                cursor += sizeof(uint32_t);
+            }
+        }
+    }
+
+    size_t locationLength = strlen(paramStateLocation);
+    char *temporaryLocation = (char *) malloc(locationLength + 5);
+    memcpy(temporaryLocation, paramStateLocation, locationLength);
+    memcpy(temporaryLocation + locationLength, ".tmp", 5);
+
+    int exception = EXCEPTION_NONE;
+    int fileDescriptor = open(temporaryLocation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fileDescriptor < 0) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    } else {
+        for(long written = 0; written < size && exception == EXCEPTION_NONE; ) {
+            ssize_t result = write(fileDescriptor, bytes + written, size - written);
+            if(result <= 0) {
+                exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+            }
+            written += result;
+        }
+        if((fdatasync(fileDescriptor) != 0 || close(fileDescriptor) != 0) && exception == EXCEPTION_NONE) {
+            exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+        }
+        if(exception == EXCEPTION_NONE && rename(temporaryLocation, paramStateLocation) != 0) {
+            exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+        }
+        if(exception != EXCEPTION_NONE) {
+            unlink(temporaryLocation);
+        }
+    }
+
+    free(temporaryLocation);
+    free(bytes);
+    return exception;
+}
+
+/**
+ * Hashes each sector of the first FAT, reading it a window at a time
+ * @param paramVolume - The volume
+ * @return            - A CRC32C for each of the sectorsPerFat sectors
+ */
+uint32_t *hashFatSectors(Volume *paramVolume) {
+
+    int bytesPerSector = paramVolume->bootSector->BPB_BytsPerSec;
+    long fatStart = (long) paramVolume->sectorFatStart * bytesPerSector;
+    uint32_t *hashes = (uint32_t *) malloc(sizeof(uint32_t) * (paramVolume->sectorsPerFat + 1));
+    unsigned char *window = (unsigned char *) malloc((size_t) SCAN_FAT_WINDOW_SECTORS * bytesPerSector);
+
+    for(long sector = 0; sector < paramVolume->sectorsPerFat; sector += SCAN_FAT_WINDOW_SECTORS) {
+        long numberOfSectors = paramVolume->sectorsPerFat - sector < SCAN_FAT_WINDOW_SECTORS ? paramVolume->sectorsPerFat - sector : SCAN_FAT_WINDOW_SECTORS;
+        readVolumeBytes(paramVolume, fatStart + sector * bytesPerSector, window, numberOfSectors * bytesPerSector);
+        for(long sectorIndex = 0; sectorIndex < numberOfSectors; sectorIndex++) {
+            hashes[sector + sectorIndex] = updateCrc32c(0, window + sectorIndex * bytesPerSector, bytesPerSector);
+        }
+    }
+
+    free(window);
+    return hashes;
+}
+
+/**
+ * Checks whether the FAT entries of a chain from the last scan are all in sectors whose hash did not change
+ * @param paramScanContext   - The scan context
+ * @param paramScanDirectory - The directory from the last scan
+ * @return                   - 1 if the chain can be taken from the state without following it
+ */
+uint8_t isScanChainUnchanged(ScanContext *paramScanContext, ScanDirectory *paramScanDirectory) {
+
+    Volume *volume = paramScanContext->volume;
+    int bytesPerSector = volume->bootSector->BPB_BytsPerSec;
+    long fatStart = getFatEntryOffset(volume, 0, 0);
+
+    for(int clusterIndex = 0; clusterIndex < paramScanDirectory->numberOfClusters; clusterIndex++) {
+        int cluster = paramScanDirectory->clusters[clusterIndex];
+        if(cluster < 2 || cluster >= volume->numberOfClusters + 2) {
+            return 0;
+        }
+        long entryOffset = getFatEntryOffset(volume, 0, cluster) - fatStart;
+        if(paramScanContext->changedFatSectors[entryOffset / bytesPerSector] ||
+           paramScanContext->changedFatSectors[(entryOffset + volume->fat->entryBytes - 1) / bytesPerSector]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Follows the chain of a directory
+ * @param paramVolume           - The volume
+ * @param paramChainStart       - The first cluster of the chain
+ * @param paramNumberOfClusters - Set to the number of clusters in the chain
+ * @return                      - The clusters of the chain
+ */
+int *getScanChain(Volume *paramVolume, int paramChainStart, int *paramNumberOfClusters) {
+
+    int numberOfClusters = 0;
+    int capacity = 16;
+    int *clusters = (int *) malloc(sizeof(int) * capacity);
+
+    int currentCluster = paramChainStart;
+    while(isValidCluster(paramVolume, currentCluster) && numberOfClusters < paramVolume->numberOfClusters) {
+        if(numberOfClusters == capacity) {
+            capacity *= 2;
+            clusters = (int *) realloc(clusters, sizeof(int) * capacity);
+        }
+        clusters[numberOfClusters++] = currentCluster;
+        currentCluster = (int) getFatEntry(paramVolume, currentCluster);
+    }
+
+    *paramNumberOfClusters = numberOfClusters;
+    return clusters;
+}
+
+/**
+ * Reads the clusters of a directory, prefetching them when the volume has read engines
+ * @param paramVolume           - The volume
+ * @param paramClusters         - The chain of the directory, ignored for the fixed root region
+ * @param paramNumberOfClusters - The number of clusters, or cluster sized pieces of the fixed root region
+ * @return                      - The bytes of the directory, paramNumberOfClusters clusters long
+ */
+Buffer *readScanDirectory(Volume *paramVolume, const int *paramClusters, int paramNumberOfClusters) {
+
+    Buffer *buffer = createBuffer(paramNumberOfClusters * paramVolume->bytesPerCluster);
+
+    if(paramNumberOfClusters > 0 && paramClusters[0] == 0) {
+        memset(buffer->bufferPtr, 0, buffer->size);
+        readVolumeBytes(paramVolume, (long) paramVolume->sectorRootDirectoryStart * paramVolume->bootSector->BPB_BytsPerSec, buffer->bufferPtr,
+                        paramVolume->bootSector->BPB_RootEntCnt * sizeof(Entry));
+        return buffer;
+    }
+
+    prefetchClusters(paramVolume, paramClusters, paramNumberOfClusters);
+    for(int clusterIndex = 0; clusterIndex < paramNumberOfClusters; clusterIndex++) {
+        readVolumeBytes(paramVolume, getClusterOffset(paramVolume, paramClusters[clusterIndex]),
+                        buffer->bufferPtr + (long) clusterIndex * paramVolume->bytesPerCluster, paramVolume->bytesPerCluster);
+    }
+    return buffer;
+}
+
+/**
+ * Parses the entries of a directory into scan entries sorted by name
+ * @param paramDirectoryBuffer - The bytes of the directory
+ * @param paramNumberOfEntries - Set to the number of entries
+ * @return                     - The entries
+ */
+ScanEntry *parseScanEntries(Buffer *paramDirectoryBuffer, int *paramNumberOfEntries) {
+
+    LinkedList *list = getAllEntriesFromDirectory(paramDirectoryBuffer, 0);
+    int numberOfEntries;
+    DirectoryEntry **sortedEntries = getSortedDirectoryEntries(list, &numberOfEntries);
+
+    ScanEntry *scanEntries = (ScanEntry *) malloc(sizeof(ScanEntry) * (numberOfEntries + 1));
+    for(int entryIndex = 0; entryIndex < numberOfEntries; entryIndex++) {
+        DirectoryEntry *directoryEntry = sortedEntries[entryIndex];
+        ScanEntry *scanEntry = scanEntries + entryIndex;
+        scanEntry->entry = *directoryEntry->entry;
+        scanEntry->nameLength = directoryEntry->fileNameSize;
+        scanEntry->name = (wchar_t *) malloc(sizeof(wchar_t) * (directoryEntry->fileNameSize + 1));
+        memcpy(scanEntry->name, directoryEntry->longFileName, sizeof(wchar_t) * directoryEntry->fileNameSize);
+    }
+
+    free(sortedEntries);
+    freeDirectoryEntries(list);
+
+    *paramNumberOfEntries = numberOfEntries;
+    return scanEntries;
+}
+
+/**
+ * Finds a directory of the last scan that has not been matched to a directory of the image yet
+ * @param paramScanContext  - The scan context
+ * @param paramFirstCluster - The first cluster of the directory, 0 for the root directory
+ * @return                  - The directory, NULL when there is none
+ */
+ScanDirectory *claimScanDirectory(ScanContext *paramScanContext, int paramFirstCluster) {
+
+    if(paramScanContext->oldState->numberOfDirectories == 0) {
+        return NULL;
+    }
+
+    ScanDirectory key;
+    key.firstCluster = paramFirstCluster;
+    ScanDirectory *scanDirectory = (ScanDirectory *) bsearch(&key, paramScanContext->oldState->directories, paramScanContext->oldState->numberOfDirectories,
+                                                             sizeof(ScanDirectory), compareScanDirectories);
+    if(scanDirectory == NULL || scanDirectory->is_claimed) {
+        return NULL;
+    }
+    scanDirectory->is_claimed = 1;
+    return scanDirectory;
+}
+
+void rescanDirectory(ScanContext *paramScanContext, wchar_t *paramPath, int paramPathLength, int paramFirstCluster, ScanDirectory *paramOldDirectory,
+                     uint8_t paramIsLogged, int paramDepth);
+
+/**
+ * Re-scans a sub directory of a directory, claiming the directory of the last scan with the same first cluster
+ * @param paramScanContext - The scan context
+ * @param paramPath        - Path of the parent directory
+ * @param paramPathLength  - Length of the path
+ * @param paramScanEntry   - The entry of the sub directory
+ * @param paramOldCluster  - The first cluster the entry had in the last scan, whose directory is compared when none
+ *                           has the new first cluster, 0 when the entry is new
+ * @param paramIsLogged    - Changes within the sub directory are reported
+ * @param paramDepth       - Depth of the parent directory
+ */
+void rescanChildDirectory(ScanContext *paramScanContext, wchar_t *paramPath, int paramPathLength, ScanEntry *paramScanEntry, int paramOldCluster,
+                          uint8_t paramIsLogged, int paramDepth) {
+
+    int firstCluster = getFirstClusterOfEntry(&paramScanEntry->entry);
+    if(!isValidCluster(paramScanContext->volume, firstCluster) || paramDepth >= MAX_DIRECTORY_DEPTH) {
+        return;
+    }
+
+    ScanDirectory *oldDirectory = claimScanDirectory(paramScanContext, firstCluster);
+    if(oldDirectory == NULL && paramOldCluster != 0) {
+        oldDirectory = claimScanDirectory(paramScanContext, paramOldCluster);
+    }
+
+    wchar_t *path = createChildPath(paramPath, paramPathLength, paramScanEntry->name, paramScanEntry->nameLength);
+    rescanDirectory(paramScanContext, path, paramPathLength + 1 + paramScanEntry->nameLength, firstCluster, oldDirectory,
+                    paramIsLogged && (oldDirectory != NULL || paramOldCluster != 0), paramDepth + 1);
+    free(path);
+}
+
+/**
+ * Matches the entries of a directory that changed against its entries from the last scan by name, reporting the
+ * differences and re-scanning its sub directories
+ * @param paramScanContext    - The scan context
+ * @param paramPath           - Path of the directory
+ * @param paramPathLength     - Length of the path
+ * @param paramOldEntries     - The entries from the last scan sorted by name
+ * @param paramNumberOfOld    - The number of old entries
+ * @param paramNewEntries     - The entries now sorted by name
+ * @param paramNumberOfNew    - The number of new entries
+ * @param paramDepth          - Depth of the directory
+ */
+void diffScanEntries(ScanContext *paramScanContext, wchar_t *paramPath, int paramPathLength, ScanEntry *paramOldEntries, int paramNumberOfOld,
+                     ScanEntry *paramNewEntries, int paramNumberOfNew, int paramDepth) {
+
+    int oldIndex = 0, newIndex = 0;
+    while(oldIndex < paramNumberOfOld || newIndex < paramNumberOfNew) {
+
+        ScanEntry *oldEntry = oldIndex < paramNumberOfOld ? paramOldEntries + oldIndex : NULL;
+        ScanEntry *newEntry = newIndex < paramNumberOfNew ? paramNewEntries + newIndex : NULL;
+
+        int comparison;
+        if(oldEntry == NULL) {
+            comparison = 1;
+        } else if(newEntry == NULL) {
+            comparison = -1;
+        } else {
+            comparison = compareWideStrings(oldEntry->name, oldEntry->nameLength, newEntry->name, newEntry->nameLength);
+            if(comparison == 0 && (oldEntry->entry.DIR_Attr & 0x10) != (newEntry->entry.DIR_Attr & 0x10)) {
+                comparison = -1;                                                                    // Replaced by a different kind of entry
+            }
+        }
+
+        if(comparison < 0) {
+            wchar_t *path = createChildPath(paramPath, paramPathLength, oldEntry->name, oldEntry->nameLength);
+            addDiffEntry(&paramScanContext->removedEntries, path, paramPathLength + 1 + oldEntry->nameLength, &oldEntry->entry);
+            free(path);
+            oldIndex++;
+            continue;
+        }
+
+        if(comparison > 0) {
+            wchar_t *path = createChildPath(paramPath, paramPathLength, newEntry->name, newEntry->nameLength);
+            addDiffEntry(&paramScanContext->addedEntries, path, paramPathLength + 1 + newEntry->nameLength, &newEntry->entry);
+            free(path);
+            if(newEntry->entry.DIR_Attr & 0x10) {
+                rescanChildDirectory(paramScanContext, paramPath, paramPathLength, newEntry, 0, 1, paramDepth);
+            }
+            newIndex++;
+            continue;
+        }
+
+        if(newEntry->entry.DIR_Attr & 0x10) {
+            rescanChildDirectory(paramScanContext, paramPath, paramPathLength, newEntry, getFirstClusterOfEntry(&oldEntry->entry), 1, paramDepth);
+        } else if(memcmp(&oldEntry->entry, &newEntry->entry, sizeof(Entry)) != 0) {
+            printOutput("Modified: ");
+            printPath(paramPath, paramPathLength);
+            printOutput("/");
+            printPath(newEntry->name, newEntry->nameLength);
+            printOutput("\n");
+            paramScanContext->numberOfModified++;
+        }
+        oldIndex++;
+        newIndex++;
+    }
+}
+
+/**
+ * Re-scans a directory and everything below it, taking its entries from the last scan when its chain and the
+ * hashes of its clusters are the same and parsing them otherwise
+ * @param paramScanContext  - The scan context
+ * @param paramPath         - Path of the directory
+ * @param paramPathLength   - Length of the path
+ * @param paramFirstCluster - First cluster of the directory, 0 for the root directory
+ * @param paramOldDirectory - The directory from the last scan, NULL when it was not scanned
+ * @param paramIsLogged     - Changes within the directory are reported, otherwise it is only recorded
+ * @param paramDepth        - Depth of the directory, the root is 0
+ */
+void rescanDirectory(ScanContext *paramScanContext, wchar_t *paramPath, int paramPathLength, int paramFirstCluster, ScanDirectory *paramOldDirectory,
+                     uint8_t paramIsLogged, int paramDepth) {
+
+    Volume *volume = paramScanContext->volume;
+    if(paramScanContext->is_reached[paramFirstCluster]) {
+        return;                                                                                     // Cross linked or a loop
+    }
+    paramScanContext->is_reached[paramFirstCluster] = 1;
+
+    /*
+     * Find the chain, from the state when none of its FAT entries changed
+     */
+    int numberOfClusters;
+    int *clusters;
+    uint8_t is_comparable = paramOldDirectory != NULL && paramScanContext->is_same_layout;
+
+    if(getDirectoryChainStart(volume, paramFirstCluster) == 0) {
+        long rootBytes = volume->bootSector->BPB_RootEntCnt * sizeof(Entry);
+        numberOfClusters = (int) ((rootBytes + volume->bytesPerCluster - 1) / volume->bytesPerCluster);
+        clusters = (int *) calloc(numberOfClusters + 1, sizeof(int));
+    } else if(is_comparable && isScanChainUnchanged(paramScanContext, paramOldDirectory) &&
+              paramOldDirectory->numberOfClusters > 0 && paramOldDirectory->clusters[0] == getDirectoryChainStart(volume, paramFirstCluster)) {
+        numberOfClusters = paramOldDirectory->numberOfClusters;
+        clusters = (int *) malloc(sizeof(int) * (numberOfClusters + 1));
+        memcpy(clusters, paramOldDirectory->clusters, sizeof(int) * numberOfClusters);
+    } else {
+        clusters = getScanChain(volume, getDirectoryChainStart(volume, paramFirstCluster), &numberOfClusters);
+    }
+
+    /*
+     * Hash its clusters and compare them with the state
+     */
+    Buffer *directoryBuffer = readScanDirectory(volume, clusters, numberOfClusters);
+    uint32_t *clusterHashes = (uint32_t *) malloc(sizeof(uint32_t) * (numberOfClusters + 1));
+    for(int clusterIndex = 0; clusterIndex < numberOfClusters; clusterIndex++) {
+        clusterHashes[clusterIndex] = updateCrc32c(0, directoryBuffer->bufferPtr + (long) clusterIndex * volume->bytesPerCluster, volume->bytesPerCluster);
+    }
+
+    uint8_t is_unchanged = is_comparable && paramOldDirectory->numberOfClusters == numberOfClusters &&
+            memcmp(paramOldDirectory->clusters, clusters, sizeof(int) * numberOfClusters) == 0 &&
+            memcmp(paramOldDirectory->clusterHashes, clusterHashes, sizeof(uint32_t) * numberOfClusters) == 0;
+
+    ScanEntry *entries;
+    int numberOfEntries;
+    if(is_unchanged) {
+        entries = paramOldDirectory->entries;
+        numberOfEntries = paramOldDirectory->numberOfEntries;
+        paramOldDirectory->entries = NULL;                                                          // Now owned by the new state
+    } else {
+        entries = parseScanEntries(directoryBuffer, &numberOfEntries);
+        paramScanContext->numberOfParsed++;
+    }
+    freeBuffer(directoryBuffer);
+
+    ScanState *newState = paramScanContext->newState;
+    if(newState->numberOfDirectories == newState->directoriesCapacity) {
+        newState->directoriesCapacity = newState->directoriesCapacity == 0 ? 64 : newState->directoriesCapacity * 2;
+        newState->directories = (ScanDirectory *) realloc(newState->directories, sizeof(ScanDirectory) * newState->directoriesCapacity);
+    }
+    ScanDirectory *scanDirectory = newState->directories + newState->numberOfDirectories++;
+    memset(scanDirectory, 0, sizeof(ScanDirectory));
+    scanDirectory->firstCluster = paramFirstCluster;
+    scanDirectory->numberOfClusters = numberOfClusters;
+    scanDirectory->clusters = clusters;
+    scanDirectory->clusterHashes = clusterHashes;
+    scanDirectory->entries = entries;
+    scanDirectory->numberOfEntries = numberOfEntries;
+
+    /*
+     * Walk into the sub directories, matching the entries by name first when the directory changed
+     */
+    if(!is_unchanged && paramIsLogged) {
+        ScanEntry *oldEntries = paramOldDirectory == NULL ? NULL : paramOldDirectory->entries;
+        int numberOfOld = paramOldDirectory == NULL || oldEntries == NULL ? 0 : paramOldDirectory->numberOfEntries;
+        diffScanEntries(paramScanContext, paramPath, paramPathLength, oldEntries, numberOfOld, entries, numberOfEntries, paramDepth);
+        return;
+    }
+
+    for(int entryIndex = 0; entryIndex < numberOfEntries; entryIndex++) {
+        if(entries[entryIndex].entry.DIR_Attr & 0x10) {
+            rescanChildDirectory(paramScanContext, paramPath, paramPathLength, entries + entryIndex, 0, paramIsLogged, paramDepth);
+        }
+    }
+}
+
+/**
+ * Pairs removed and added entries that share a first cluster, size and kind as moves
+ * @param paramScanContext - The scan context
+ * @return                 - The number of moves
+ */
+int pairRescannedMoves(ScanContext *paramScanContext) {
+
+    int numberOfMoved = 0;
+
+    for(int removedIndex = 0; removedIndex < paramScanContext->removedEntries.numberOfEntries; removedIndex++) {
+        DiffEntry *removedEntry = paramScanContext->removedEntries.entries + removedIndex;
+        int removedCluster = getFirstClusterOfEntry(&removedEntry->entry);
+        if(removedCluster == 0) {
+            continue;
+        }
+
+        for(int addedIndex = 0; addedIndex < paramScanContext->addedEntries.numberOfEntries; addedIndex++) {
+            DiffEntry *addedEntry = paramScanContext->addedEntries.entries + addedIndex;
+            if(addedEntry->is_paired || getFirstClusterOfEntry(&addedEntry->entry) != removedCluster ||
+               addedEntry->entry.DIR_FileSize != removedEntry->entry.DIR_FileSize ||
+               (addedEntry->entry.DIR_Attr & 0x10) != (removedEntry->entry.DIR_Attr & 0x10)) {
+                continue;
+            }
+
+            removedEntry->is_paired = 1;
+            addedEntry->is_paired = 1;
+            numberOfMoved++;
+
+            printOutput("Moved: ");
+            printPath(removedEntry->path, removedEntry->pathLength);
+            printOutput(" -> ");
+            printPath(addedEntry->path, addedEntry->pathLength);
+            printOutput("\n");
+            break;
+        }
+    }
+
+    return numberOfMoved;
+}
+
+/**
+ * Prints what changed in an image since the state of its last scan was written, then writes the new state. The
+ * first scan of an image only writes the state.
+ * @param paramVolume        - The volume being scanned
+ * @param paramStateLocation - The location of the state file
+ * @return                   - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int rescanVolume(Volume *paramVolume, char *paramStateLocation) {
+
+    ScanState *oldState;
+    int exception = loadScanState(paramStateLocation, &oldState);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    uint8_t is_first_scan = oldState == NULL;
+    if(is_first_scan) {
+        oldState = (ScanState *) calloc(1, sizeof(ScanState));
+    }
+
+    ScanContext scanContext;
+    memset(&scanContext, 0, sizeof(ScanContext));
+    scanContext.volume = paramVolume;
+    scanContext.oldState = oldState;
+    scanContext.newState = (ScanState *) calloc(1, sizeof(ScanState));
+    scanContext.is_reached = (uint8_t *) calloc(paramVolume->numberOfClusters + 2, sizeof(uint8_t));
+
+    ScanState *newState = scanContext.newState;
+    setScanStateLayout(paramVolume, &newState->header);
+    newState->fatSectorHashes = hashFatSectors(paramVolume);
+
+    ScanStateHeader layout = newState->header;
+    layout.numberOfDirectories = oldState->header.numberOfDirectories;
+    scanContext.is_same_layout = !is_first_scan && memcmp(&layout, &oldState->header, sizeof(ScanStateHeader)) == 0;
+
+    scanContext.changedFatSectors = (uint8_t *) calloc(paramVolume->sectorsPerFat + 1, sizeof(uint8_t));
+    int numberOfChangedFatSectors = 0;
+    for(long sector = 0; sector < paramVolume->sectorsPerFat; sector++) {
+        uint8_t is_changed = !scanContext.is_same_layout || newState->fatSectorHashes[sector] != oldState->fatSectorHashes[sector];
+        scanContext.changedFatSectors[sector] = is_changed;
+        numberOfChangedFatSectors += is_changed;
+    }
+
+    if(!is_first_scan && !scanContext.is_same_layout) {
+        printOutput("Layout: differs from the last scan, every directory is parsed\n");
+    } else if(numberOfChangedFatSectors > 0 && !is_first_scan) {
+        printOutput("FAT: %d of %ld sectors changed\n", numberOfChangedFatSectors, paramVolume->sectorsPerFat);
+    }
+
+    rescanDirectory(&scanContext, NULL, 0, 0, claimScanDirectory(&scanContext, 0), !is_first_scan, 0);
+
+    int numberOfMoved = pairRescannedMoves(&scanContext);
+    int numberOfAdded = printUnpairedDiffEntries(&scanContext.addedEntries, "Added: ");
+    int numberOfRemoved = printUnpairedDiffEntries(&scanContext.removedEntries, "Removed: ");
+
+    if(is_first_scan) {
+        printOutput("First scan, %d directories recorded\n", newState->numberOfDirectories);
+    } else {
+        printOutput("%d added, %d removed, %d modified, %d moved, %d of %d directories parsed\n",
+                    numberOfAdded, numberOfRemoved, scanContext.numberOfModified, numberOfMoved, scanContext.numberOfParsed, newState->numberOfDirectories);
+    }
+
+    qsort(newState->directories, newState->numberOfDirectories, sizeof(ScanDirectory), compareScanDirectories);
+    exception = saveScanState(newState, paramStateLocation);
+
+    free(scanContext.changedFatSectors);
+    free(scanContext.is_reached);
+    freeScanState(newState);
+    freeScanState(oldState);
+
+    return exception;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                          Writing Files                                           |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Files are added to a volume through its write cache. Clusters are allocated as one run where possible, the
+ * contents are written into them, the chain is linked in every FAT and finally the long and short entries are
+ * written into the directory. Adding many files then costs a handful of writes when the volume is flushed.
+ */
+
+/**
+ * Finds a run of free clusters, starting the search at the cluster after the last allocation
+ * @param paramVolume           - The volume being searched, it must have a write cache
+ * @param paramNumberOfClusters - The length of the run
+ * @return                      - The first cluster of the run, or 0 if there is no run that long
+ */
+int findFreeClusterRun(Volume *paramVolume, int paramNumberOfClusters) {
+
+    int lastCluster = paramVolume->numberOfClusters + 1;
+    int startCluster = paramVolume->writeCache->nextFreeCluster;
+
+    for(int pass = 0; pass < 2; pass++) {
+        int runLength = 0;
+        for(int cluster = startCluster; cluster <= lastCluster; cluster++) {
+            runLength = getFatEntry(paramVolume, cluster) == 0 ? runLength + 1 : 0;
+            if(runLength == paramNumberOfClusters) {
+                return cluster - runLength + 1;
+            }
+        }
+        if(startCluster == 2) {
+            break;
+        }
+        startCluster = 2;
+    }
+
+    return 0;
+}
+
+/**
+ * Allocates a chain of clusters, as one run when there is one long enough otherwise from every free cluster in order
+ * @param paramVolume           - The volume being written to, it must have a write cache
+ * @param paramNumberOfClusters - The number of clusters in the chain, more than 0
+ * @param paramFirstCluster     - Set to the first cluster of the chain
+ * @return                      - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int allocateClusterChain(Volume *paramVolume, int paramNumberOfClusters, int *paramFirstCluster) {
+
+    int firstCluster = findFreeClusterRun(paramVolume, paramNumberOfClusters);
+    if(firstCluster != 0) {
+        for(int cluster = firstCluster; cluster < firstCluster + paramNumberOfClusters - 1; cluster++) {
+            setFatEntry(paramVolume, cluster, cluster + 1);
+        }
+        setFatEntry(paramVolume, firstCluster + paramNumberOfClusters - 1, FAT_END_OF_CHAIN);
+
+        paramVolume->writeCache->nextFreeCluster = firstCluster + paramNumberOfClusters;
+        if(paramVolume->freeClusterHint >= paramNumberOfClusters) {
+            paramVolume->freeClusterHint -= paramNumberOfClusters;
+        }
+        *paramFirstCluster = firstCluster;
+        return EXCEPTION_NONE;
+    }
+
+    int *freeClusters = (int *) malloc(sizeof(int) * paramNumberOfClusters);
+    int numberOfFreeClusters = 0;
+    for(int cluster = 2; cluster < paramVolume->numberOfClusters + 2 && numberOfFreeClusters < paramNumberOfClusters; cluster++) {
+        if(getFatEntry(paramVolume, cluster) == 0) {
+            freeClusters[numberOfFreeClusters++] = cluster;
+        }
+    }
+
+    if(numberOfFreeClusters < paramNumberOfClusters) {
+        free(freeClusters);
+        return EXCEPTION_VOLUME_FULL;
+    }
+
+    for(int index = 0; index < paramNumberOfClusters - 1; index++) {
+        setFatEntry(paramVolume, freeClusters[index], freeClusters[index + 1]);
+    }
+    setFatEntry(paramVolume, freeClusters[paramNumberOfClusters - 1], FAT_END_OF_CHAIN);
+
+    paramVolume->writeCache->nextFreeCluster = freeClusters[paramNumberOfClusters - 1] + 1;
+    if(paramVolume->freeClusterHint >= paramNumberOfClusters) {
+        paramVolume->freeClusterHint -= paramNumberOfClusters;
+    }
+    *paramFirstCluster = freeClusters[0];
+    free(freeClusters);
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Writes bytes into a chain of clusters one extent at a time, zeroing the rest of the last cluster
+ * @param paramVolume       - The volume being written to, it must have a write cache
+ * @param paramStartCluster - The first cluster of the chain
+ * @param paramBytes        - The bytes being written
+ * @param paramLength       - The number of bytes, the chain must be long enough to hold them
+ * @param paramKind         - The kind of write, one of the WRITE_KIND values
+ */
+void writeClusterChain(Volume *paramVolume, int paramStartCluster, const unsigned char *paramBytes, long paramLength, int paramKind) {
+
+    int currentCluster = paramStartCluster;
+    long written = 0;
+
+    while(written < paramLength && isValidCluster(paramVolume, currentCluster)) {
+        int maxClusters = (int) ((paramLength - written + paramVolume->bytesPerCluster - 1) / paramVolume->bytesPerCluster);
+        int nextCluster;
+        int numberOfClusters = getExtentLength(paramVolume, currentCluster, maxClusters, &nextCluster);
+
+        long extentSize = (long) numberOfClusters * paramVolume->bytesPerCluster;
+        long length = paramLength - written < extentSize ? paramLength - written : extentSize;
+        long offset = getClusterOffset(paramVolume, currentCluster);
+
+        writeVolumeBytes(paramVolume, offset, paramBytes + written, length, paramKind);
+        zeroVolumeBytes(paramVolume, offset + length, extentSize - length, paramKind);
+
+        written += length;
+        currentCluster = nextCluster;
+    }
+}
+
+/**
+ * Gets the byte offset of every slot in a directory
+ * @param paramVolume        - The volume of the directory
+ * @param paramFirstCluster  - The first cluster of the directory, 0 for the root directory
+ * @param paramNumberOfSlots - Set to the number of slots
+ * @return                   - Array of the offsets of each slot in order
+ */
+long *getDirectorySlotOffsets(Volume *paramVolume, int paramFirstCluster, int *paramNumberOfSlots) {
+
+    int slotsPerCluster = paramVolume->bytesPerCluster / sizeof(Entry);
+    int firstCluster = getDirectoryChainStart(paramVolume, paramFirstCluster);
+
+    if(firstCluster == 0) {
+        int numberOfSlots = paramVolume->bootSector->BPB_RootEntCnt;
+        long rootDirectoryStart = (long) paramVolume->sectorRootDirectoryStart * paramVolume->bootSector->BPB_BytsPerSec;
+
+        long *slotOffsets = (long *) malloc(sizeof(long) * numberOfSlots);
+        for(int slot = 0; slot < numberOfSlots; slot++) {
+            slotOffsets[slot] = rootDirectoryStart + slot * sizeof(Entry);
+        }
+        *paramNumberOfSlots = numberOfSlots;
+        return slotOffsets;
+    }
+
+    int numberOfClusters = 0;
+    for(int cluster = firstCluster; isValidCluster(paramVolume, cluster) && numberOfClusters < paramVolume->numberOfClusters; cluster = getFatEntry(paramVolume, cluster)) {
+        numberOfClusters++;
+    }
+
+    long *slotOffsets = (long *) malloc(sizeof(long) * (numberOfClusters * slotsPerCluster + 1));
+    int cluster = firstCluster;
+    for(int clusterIndex = 0; clusterIndex < numberOfClusters; clusterIndex++) {
+        for(int slot = 0; slot < slotsPerCluster; slot++) {
+            slotOffsets[clusterIndex * slotsPerCluster + slot] = getClusterOffset(paramVolume, cluster) + slot * sizeof(Entry);
+        }
+        cluster = getFatEntry(paramVolume, cluster);
+    }
+
+    *paramNumberOfSlots = numberOfClusters * slotsPerCluster;
+    return slotOffsets;
+}
+
+/**
+ * Finds a run of free slots in a directory, growing a sub directory when it has no run long enough. A sub directory
+ * grows by as many clusters as it already has so that a directory filled one file at a time ends up in a few runs
+ * rather than one cluster between the data of every few files.
+ * @param paramVolume        - The volume of the directory, it must have a write cache
+ * @param paramFirstCluster  - The first cluster of the directory, 0 for the root directory, which only grows on FAT32
+ * @param paramNumberOfSlots - The number of slots needed
+ * @param paramSlotOffsets   - Set to the offsets of the free slots
+ * @return                   - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int findFreeDirectorySlots(Volume *paramVolume, int paramFirstCluster, int paramNumberOfSlots, long *paramSlotOffsets) {
+
+    unsigned char *bytes = paramVolume->buffer->bufferPtr;
+
+    int numberOfSlots;
+    long *slotOffsets = getDirectorySlotOffsets(paramVolume, paramFirstCluster, &numberOfSlots);
+
+    int runLength = 0;
+    uint8_t is_end_of_directory = 0;
+    for(int slot = 0; slot < numberOfSlots; slot++) {
+        uint8_t firstByte = bytes[slotOffsets[slot]];
+        is_end_of_directory = is_end_of_directory || firstByte == 0x00;
+
+        runLength = (is_end_of_directory || firstByte == DELETED_ENTRY) ? runLength + 1 : 0;
+        if(runLength == paramNumberOfSlots) {
+            memcpy(paramSlotOffsets, slotOffsets + slot - runLength + 1, sizeof(long) * paramNumberOfSlots);
+            free(slotOffsets);
+            return EXCEPTION_NONE;
+        }
+    }
+    free(slotOffsets);
+
+    int lastCluster = getDirectoryChainStart(paramVolume, paramFirstCluster);
+    if(lastCluster == 0) {
+        return EXCEPTION_DIRECTORY_FULL;
+    }
+
+    int numberOfClusters = 1;
+    while(isValidCluster(paramVolume, getFatEntry(paramVolume, lastCluster)) && numberOfClusters < paramVolume->numberOfClusters) {
+        lastCluster = getFatEntry(paramVolume, lastCluster);
+        numberOfClusters++;
+    }
+
+    int slotsPerCluster = paramVolume->bytesPerCluster / sizeof(Entry);
+    int neededClusters = (paramNumberOfSlots + slotsPerCluster - 1) / slotsPerCluster;
+    int maxClusters = 65536 / slotsPerCluster - numberOfClusters;
+    int newClusters = numberOfClusters > neededClusters ? numberOfClusters : neededClusters;
+    newClusters = newClusters < maxClusters ? newClusters : maxClusters;
+
+    if(newClusters < neededClusters) {
+        return EXCEPTION_DIRECTORY_FULL;
+    }
+
+    int newCluster;
+    int exception = allocateClusterChain(paramVolume, newClusters, &newCluster);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    for(int cluster = newCluster; isValidCluster(paramVolume, cluster); cluster = getFatEntry(paramVolume, cluster)) {
+        zeroVolumeBytes(paramVolume, getClusterOffset(paramVolume, cluster), paramVolume->bytesPerCluster, WRITE_KIND_DIRECTORY);
+    }
+    setFatEntry(paramVolume, lastCluster, newCluster);
+
+    return findFreeDirectorySlots(paramVolume, paramFirstCluster, paramNumberOfSlots, paramSlotOffsets);
+}
+
+/**
+ * Converts a character to the character stored for it in a short name
+ * @param paramCharacter - The character from the long name
+ * @param paramIsLossy   - Set to 1 if the character had to be replaced
+ * @return               - The upper case character, or '_' when it is not allowed in a short name
+ */
+uint8_t getShortNameCharacter(wchar_t paramCharacter, uint8_t *paramIsLossy) {
+
+    if(paramCharacter >= 'a' && paramCharacter <= 'z') {
+        return (uint8_t) (paramCharacter - 'a' + 'A');
+    }
+    if((paramCharacter >= 'A' && paramCharacter <= 'Z') || (paramCharacter >= '0' && paramCharacter <= '9') ||
+       (paramCharacter < 0x80 && paramCharacter > 0x20 && strchr("$%'-_@~`!(){}^#&", (int) paramCharacter) != NULL)) {
+        return (uint8_t) paramCharacter;
+    }
+
+    *paramIsLossy = 1;
+    return '_';
+}
+
+/**
+ * A name set holds the names of one directory in a hash table whose chains are linked by index, so names can be
+ * checked against the directory while it is being filled without reading it again
+ */
+struct NameSet {
+    wchar_t *characters;                // The characters of every name one after another
+    long numberOfCharacters;
+    long characterCapacity;
+    long *nameStarts;                   // Where each name starts in characters
+    int *nameLengths;
+    int *nameNext;                      // The next name in the same bucket, -1 at the end
+    int numberOfNames;
+    int capacity;
+    int *buckets;                       // First name in each bucket, -1 when empty
+    int numberOfBuckets;                // A power of 2, twice the capacity
+
+}; typedef struct NameSet NameSet;
+
+/**
+ * Gets the bucket of a name in a name set
+ */
+int getNameBucket(NameSet *paramNameSet, const wchar_t *paramName, int paramNameLength) {
+    uint32_t hash = 2166136261u;
+    for(int index = 0; index < paramNameLength; index++) {
+        hash = (hash ^ (uint32_t) paramName[index]) * 16777619u;
+    }
+    return (int) (hash & (paramNameSet->numberOfBuckets - 1));
+}
+
+/**
+ * Creates an empty name set
+ * @param paramCapacity - The number of names expected, the set grows past it
+ * @return              - The new name set
+ */
+NameSet *createNameSet(int paramCapacity) {
+
+    NameSet *nameSet = (NameSet *) calloc(1, sizeof(NameSet));
+    nameSet->capacity = 16;
+    while(nameSet->capacity < paramCapacity) {
+        nameSet->capacity *= 2;
+    }
+    nameSet->characterCapacity = (long) nameSet->capacity * 16;
+    nameSet->characters = (wchar_t *) malloc(sizeof(wchar_t) * nameSet->characterCapacity);
+    nameSet->nameStarts = (long *) malloc(sizeof(long) * nameSet->capacity);
+    nameSet->nameLengths = (int *) malloc(sizeof(int) * nameSet->capacity);
+    nameSet->nameNext = (int *) malloc(sizeof(int) * nameSet->capacity);
+    nameSet->numberOfBuckets = nameSet->capacity * 2;
+    nameSet->buckets = (int *) malloc(sizeof(int) * nameSet->numberOfBuckets);
+    for(int bucket = 0; bucket < nameSet->numberOfBuckets; bucket++) {
+        nameSet->buckets[bucket] = -1;
+    }
+
+    return nameSet;
+}
+
+/**
+ * Frees a name set and every name in it
+ */
+void freeNameSet(NameSet *paramNameSet) {
+    free(paramNameSet->characters);
+    free(paramNameSet->nameStarts);
+    free(paramNameSet->nameLengths);
+    free(paramNameSet->nameNext);
+    free(paramNameSet->buckets);
+    free(paramNameSet);
+}
+
+/**
+ * Checks whether a name set holds a name
+ * @param paramNameSet    - The name set
+ * @param paramName       - The name
+ * @param paramNameLength - The length of the name
+ * @return                - 1 if the set holds the name
+ */
+uint8_t isNameInSet(NameSet *paramNameSet, const wchar_t *paramName, int paramNameLength) {
+    int bucket = getNameBucket(paramNameSet, paramName, paramNameLength);
+    for(int index = paramNameSet->buckets[bucket]; index >= 0; index = paramNameSet->nameNext[index]) {
+        if(paramNameSet->nameLengths[index] == paramNameLength &&
+           memcmp(paramNameSet->characters + paramNameSet->nameStarts[index], paramName, sizeof(wchar_t) * paramNameLength) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Adds a name to a name set, doubling the set when it is full
+ * @param paramNameSet    - The name set
+ * @param paramName       - The name, copied into the set
+ * @param paramNameLength - The length of the name
+ */
+void addNameToSet(NameSet *paramNameSet, const wchar_t *paramName, int paramNameLength) {
+
+    if(paramNameSet->numberOfNames == paramNameSet->capacity) {
+        paramNameSet->capacity *= 2;
+        paramNameSet->nameStarts = (long *) realloc(paramNameSet->nameStarts, sizeof(long) * paramNameSet->capacity);
+        paramNameSet->nameLengths = (int *) realloc(paramNameSet->nameLengths, sizeof(int) * paramNameSet->capacity);
+        paramNameSet->nameNext = (int *) realloc(paramNameSet->nameNext, sizeof(int) * paramNameSet->capacity);
+        paramNameSet->numberOfBuckets = paramNameSet->capacity * 2;
+        paramNameSet->buckets = (int *) realloc(paramNameSet->buckets, sizeof(int) * paramNameSet->numberOfBuckets);
+        for(int bucket = 0; bucket < paramNameSet->numberOfBuckets; bucket++) {
+            paramNameSet->buckets[bucket] = -1;
+        }
+        for(int index = 0; index < paramNameSet->numberOfNames; index++) {
+            int bucket = getNameBucket(paramNameSet, paramNameSet->characters + paramNameSet->nameStarts[index], paramNameSet->nameLengths[index]);
+            paramNameSet->nameNext[index] = paramNameSet->buckets[bucket];
+            paramNameSet->buckets[bucket] = index;
+        }
+    }
+    while(paramNameSet->numberOfCharacters + paramNameLength > paramNameSet->characterCapacity) {
+        paramNameSet->characterCapacity *= 2;
+        paramNameSet->characters = (wchar_t *) realloc(paramNameSet->characters, sizeof(wchar_t) * paramNameSet->characterCapacity);
+    }
+
+    int index = paramNameSet->numberOfNames++;
+    memcpy(paramNameSet->characters + paramNameSet->numberOfCharacters, paramName, sizeof(wchar_t) * paramNameLength);
+    paramNameSet->nameStarts[index] = paramNameSet->numberOfCharacters;
+    paramNameSet->nameLengths[index] = paramNameLength;
+    paramNameSet->numberOfCharacters += paramNameLength;
+
+    int bucket = getNameBucket(paramNameSet, paramName, paramNameLength);
+    paramNameSet->nameNext[index] = paramNameSet->buckets[bucket];
+    paramNameSet->buckets[bucket] = index;
+}
+
+/**
+ * Converts an 11 byte short name into the characters a name set holds it as
+ */
+void getShortNameCharacters(const uint8_t *paramShortName, wchar_t *paramCharacters) {
+    for(int index = 0; index < 11; index++) {
+        paramCharacters[index] = (wchar_t) paramShortName[index];
+    }
+}
+
+/**
+ * Creates the basis of the short name of a long name, the upper case 8.3 name before any "~N" tail is added
+ * @param paramName           - The long name
+ * @param paramNameLength     - The length of the long name
+ * @param paramShortName      - Where the 11 byte short name is written
+ * @param paramBaseName       - Where up to 8 characters of the base name are written, for adding a tail
+ * @param paramBaseNameLength - Set to the number of characters in the base name
+ * @return                    - 1 if the long name does not fit in 8.3 so the short name needs a tail
+ */
+uint8_t createBasisName(wchar_t *paramName, int paramNameLength, uint8_t *paramShortName, uint8_t *paramBaseName, int *paramBaseNameLength) {
+
+    int extensionStart = paramNameLength;
+    for(int index = paramNameLength - 1; index > 0; index--) {
+        if(paramName[index] == '.') {
+            extensionStart = index;
+            break;
+        }
+    }
+
+    uint8_t is_lossy = 0;
+    int baseNameLength = 0;
+    for(int index = 0; index < extensionStart; index++) {
+        if(paramName[index] == ' ' || paramName[index] == '.') {
+            is_lossy = 1;
+            continue;
+        }
+        uint8_t character = getShortNameCharacter(paramName[index], &is_lossy);
+        if(baseNameLength == 8) {
+            is_lossy = 1;
+            break;
+        }
+        paramBaseName[baseNameLength++] = character;
+    }
+    if(baseNameLength == 0) {
+        paramBaseName[baseNameLength++] = '_';
+    }
+
+    memset(paramShortName, ' ', 11);
+    int extensionLength = 0;
+    for(int index = extensionStart + 1; index < paramNameLength; index++) {
+        if(paramName[index] == ' ') {
+            is_lossy = 1;
+            continue;
+        }
+        if(extensionLength == 3) {
+            is_lossy = 1;
+            break;
+        }
+        paramShortName[8 + extensionLength++] = getShortNameCharacter(paramName[index], &is_lossy);
+    }
+
+    memcpy(paramShortName, paramBaseName, baseNameLength);
+    *paramBaseNameLength = baseNameLength;
+    return is_lossy;
+}
+
+/**
+ * Replaces the base of a short name with its basis followed by a "~N" tail
+ * @param paramBaseName       - The base name of the basis
+ * @param paramBaseNameLength - The number of characters in the base name
+ * @param paramTail           - The number of the tail, less than 1000000
+ * @param paramShortName      - The 11 byte short name being changed
+ */
+void addNumericTail(const uint8_t *paramBaseName, int paramBaseNameLength, int paramTail, uint8_t *paramShortName) {
+
+    char tailText[8];
+    int tailLength = snprintf(tailText, sizeof(tailText), "~%d", paramTail);
+    int keptLength = paramBaseNameLength < 8 - tailLength ? paramBaseNameLength : 8 - tailLength;
+
+    memset(paramShortName, ' ', 8);
+    memcpy(paramShortName, paramBaseName, keptLength);
+    memcpy(paramShortName + keptLength, tailText, tailLength);
+}
+
+/**
+ * Creates a short name for a long name that no name of a directory has and adds it to the directory's short names,
+ * adding a "~N" tail when the long name does not fit in 8.3 or its short name is already taken. Tails 1 to 4 are
+ * tried first as other implementations do, then the directory's counter carries on from the last tail handed out so
+ * a directory of many similar long names does not try the same tails again for every name.
+ * @param paramShortNames   - The short names of the directory
+ * @param paramNextTail     - The tail tried after 4, starting at 5 for each directory
+ * @param paramName         - The long name
+ * @param paramNameLength   - The length of the long name
+ * @param paramShortName    - Where the 11 byte short name is written
+ * @return                  - EXCEPTION_NONE or EXCEPTION_DIRECTORY_FULL
+ */
+int createShortName(NameSet *paramShortNames, int *paramNextTail, wchar_t *paramName, int paramNameLength, uint8_t *paramShortName) {
+
+    uint8_t baseName[8];
+    int baseNameLength;
+    uint8_t is_lossy = createBasisName(paramName, paramNameLength, paramShortName, baseName, &baseNameLength);
+
+    for(int tail = is_lossy ? 1 : 0; tail < 1000000; tail = tail == 4 ? *paramNextTail : tail + 1) {
+        if(tail > 0) {
+            addNumericTail(baseName, baseNameLength, tail, paramShortName);
+        }
+
+        wchar_t shortNameCharacters[11];
+        getShortNameCharacters(paramShortName, shortNameCharacters);
+        if(!isNameInSet(paramShortNames, shortNameCharacters, 11)) {
+            addNameToSet(paramShortNames, shortNameCharacters, 11);
+            *paramNextTail = tail >= *paramNextTail ? tail + 1 : *paramNextTail;
+            return EXCEPTION_NONE;
+        }
+    }
+
+    return EXCEPTION_DIRECTORY_FULL;
+}
+
+/**
+ * Fills in the long file name entry holding one part of a long name
+ * @param paramLongFileNameEntry - The entry being filled in
+ * @param paramName              - The long name
+ * @param paramNameLength        - The length of the long name
+ * @param paramOrder             - The 1 based position of the entry, the last entry being marked with 0x40
+ * @param paramIsLast            - 1 if this entry holds the end of the name
+ * @param paramChecksum          - Checksum of the short name
+ */
+void fillLongFileNameEntry(LongFileNameEntry *paramLongFileNameEntry, wchar_t *paramName, int paramNameLength, int paramOrder, uint8_t paramIsLast, uint8_t paramChecksum) {
+
+    uint8_t *characterBytes[13];
+    for(int index = 0; index < 5; index++) {
+        characterBytes[index] = paramLongFileNameEntry->LDIR_Name1 + index * 2;
+    }
+    for(int index = 0; index < 6; index++) {
+        characterBytes[5 + index] = paramLongFileNameEntry->LDIR_Name2 + index * 2;
+    }
+    for(int index = 0; index < 2; index++) {
+        characterBytes[11 + index] = paramLongFileNameEntry->LDIR_Name3 + index * 2;
+    }
+
+    for(int index = 0; index < 13; index++) {
+        int nameIndex = (paramOrder - 1) * 13 + index;
+        uint16_t character = 0xFFFF;
+        if(nameIndex < paramNameLength) {
+            character = paramName[nameIndex] > 0xFFFF ? '_' : (uint16_t) paramName[nameIndex];
+        } else if(nameIndex == paramNameLength) {
+            character = 0x0000;
+        }
+        characterBytes[index][0] = character & 0xFF;
+        characterBytes[index][1] = character >> 8;
+    }
+
+    paramLongFileNameEntry->LDIR_Ord = paramOrder | (paramIsLast ? 0x40 : 0);
+    paramLongFileNameEntry->LDIR_Attr = 0x0F;
+    paramLongFileNameEntry->LDIR_Type = 0;
+    paramLongFileNameEntry->LDIR_Chksum = paramChecksum;
+    paramLongFileNameEntry->LDIR_FstClusLO = 0;
+}
+
+/**
+ * Gets a time as a local FAT date and time
+ * @param paramSeconds - The time in seconds since the epoch
+ * @param paramDate    - Set to the date
+ * @param paramTime    - Set to the time, in 2 second intervals
+ */
+void getFatDateTime(time_t paramSeconds, uint16_t *paramDate, uint16_t *paramTime) {
+
+    struct tm localTime;
+    localtime_r(&paramSeconds, &localTime);
+
+    int year = localTime.tm_year + 1900 < 1980 ? 0 : localTime.tm_year + 1900 - 1980;
+    *paramDate = (uint16_t) ((year << 9) | ((localTime.tm_mon + 1) << 5) | localTime.tm_mday);
+    *paramTime = (uint16_t) ((localTime.tm_hour << 11) | (localTime.tm_min << 5) | (localTime.tm_sec / 2));
+}
+
+/**
+ * Gets the current local time as a FAT date and time
+ * @param paramDate - Set to the date
+ * @param paramTime - Set to the time, in 2 second intervals
+ */
+void getCurrentFatDateTime(uint16_t *paramDate, uint16_t *paramTime) {
+    getFatDateTime(time(NULL), paramDate, paramTime);
+}
+
+/**
+ * The names of a directory being filled, read once and kept up to date as entries are added
+ */
+struct DirectoryNames {
+    NameSet *names;                     // The name of each entry as isDirectoryEntryNamed compares it
+    NameSet *shortNames;                // The short name of each entry, 11 characters
+    int nextTail;                       // The short name tail tried after 4
+
+}; typedef struct DirectoryNames DirectoryNames;
+
+/**
+ * Reads the names of every entry of a directory
+ * @param paramVolume       - The volume of the directory
+ * @param paramFirstCluster - The first cluster of the directory, 0 for the root directory
+ * @return                  - The names of the directory
+ */
+DirectoryNames *readDirectoryNames(Volume *paramVolume, int paramFirstCluster) {
+
+    Buffer *directoryBuffer = readDirectory(paramVolume, paramFirstCluster);
+    LinkedList *entries = getAllEntriesFromDirectory(directoryBuffer, 0);
+
+    int numberOfEntries = 0;
+    for(LinkedList *entry = entries->next; entry != NULL; entry = entry->next) {
+        numberOfEntries++;
+    }
+
+    DirectoryNames *directoryNames = (DirectoryNames *) malloc(sizeof(DirectoryNames));
+    directoryNames->names = createNameSet(numberOfEntries);
+    directoryNames->shortNames = createNameSet(numberOfEntries);
+    directoryNames->nextTail = 5;
+
+    for(LinkedList *entry = entries->next; entry != NULL; entry = entry->next) {
+        DirectoryEntry *directoryEntry = (DirectoryEntry *) entry->pointer;
+        wchar_t *name = getDirectoryEntryName(directoryEntry);
+        addNameToSet(directoryNames->names, name, directoryEntry->fileNameSize);
+
+        wchar_t shortNameCharacters[11];
+        getShortNameCharacters(directoryEntry->entry->DIR_Name, shortNameCharacters);
+        addNameToSet(directoryNames->shortNames, shortNameCharacters, 11);
+    }
+
+    freeDirectoryEntries(entries);
+    freeBuffer(directoryBuffer);
+    return directoryNames;
+}
+
+/**
+ * Frees the names of a directory
+ */
+void freeDirectoryNames(DirectoryNames *paramDirectoryNames) {
+    freeNameSet(paramDirectoryNames->names);
+    freeNameSet(paramDirectoryNames->shortNames);
+    free(paramDirectoryNames);
+}
+
+/**
+ * Adds a file to a directory of a volume, the file reaches the image when the volume is flushed
+ * @param paramVolume         - The volume being written to, it must have a write cache
+ * @param paramFirstCluster   - The first cluster of the directory, 0 for the root directory
+ * @param paramDirectoryNames - The names of the directory, the new file's names are added to them
+ * @param paramName           - The name of the new file
+ * @param paramNameLength     - The length of the name, at most 255 characters
+ * @param paramContents       - The contents of the new file
+ * @return                    - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int addFileToDirectory(Volume *paramVolume, int paramFirstCluster, DirectoryNames *paramDirectoryNames, wchar_t *paramName, int paramNameLength,
+                       Buffer *paramContents) {
+
+    if(paramNameLength == 0 || paramNameLength > 255) {
+        return EXCEPTION_PROGRAM_ARGUMENTS;
+    }
+
+    if(isNameInSet(paramDirectoryNames->names, paramName, paramNameLength)) {
+        return EXCEPTION_FILE_ALREADY_EXISTS;
+    }
+
+    Entry entry;
+    memset(&entry, 0, sizeof(Entry));
+
+    int exception = createShortName(paramDirectoryNames->shortNames, &paramDirectoryNames->nextTail, paramName, paramNameLength, entry.DIR_Name);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    int numberOfLongFileNameEntries = (paramNameLength + 12) / 13;
+    long slotOffsets[numberOfLongFileNameEntries + 1];
+
+    exception = findFreeDirectorySlots(paramVolume, paramFirstCluster, numberOfLongFileNameEntries + 1, slotOffsets);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    int firstCluster = 0;
+    if(paramContents->size > 0) {
+        int numberOfClusters = (paramContents->size + paramVolume->bytesPerCluster - 1) / paramVolume->bytesPerCluster;
+        exception = allocateClusterChain(paramVolume, numberOfClusters, &firstCluster);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+
+        writeClusterChain(paramVolume, firstCluster, paramContents->bufferPtr, paramContents->size, WRITE_KIND_DATA);
+    }
+
+    uint16_t currentDate, currentTime;
+    getCurrentFatDateTime(&currentDate, &currentTime);
+
+    entry.DIR_Attr = 0x20;
+    entry.DIR_CrtDate = currentDate;
+    entry.DIR_CrtTime = currentTime;
+    entry.DIR_WrtDate = currentDate;
+    entry.DIR_WrtTime = currentTime;
+    entry.DIR_LstAccDate = currentDate;
+    entry.DIR_FstClusHI = (uint16_t) (firstCluster >> 16);
+    entry.DIR_FstClusLO = (uint16_t) (firstCluster & 0xFFFF);
+    entry.DIR_FileSize = paramContents->size;
+
+    uint8_t checksum = getShortNameChecksum(entry.DIR_Name);
+    for(int slot = 0; slot < numberOfLongFileNameEntries; slot++) {
+        int order = numberOfLongFileNameEntries - slot;
+
+        LongFileNameEntry longFileNameEntry;
+        fillLongFileNameEntry(&longFileNameEntry, paramName, paramNameLength, order, order == numberOfLongFileNameEntries, checksum);
+        writeVolumeBytes(paramVolume, slotOffsets[slot], &longFileNameEntry, sizeof(LongFileNameEntry), WRITE_KIND_DIRECTORY);
+    }
+    writeVolumeBytes(paramVolume, slotOffsets[numberOfLongFileNameEntries], &entry, sizeof(Entry), WRITE_KIND_DIRECTORY);
+    addNameToSet(paramDirectoryNames->names, paramName, paramNameLength);
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Finds the first cluster of a directory from its path, names being separated by '/'
+ * @param paramVolume       - The volume being searched
+ * @param paramPath         - The path of the directory, "/" being the root directory
+ * @param paramPathLength   - The length of the path
+ * @param paramFirstCluster - Set to the first cluster of the directory, 0 for the root directory
+ * @return                  - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int findDirectoryCluster(Volume *paramVolume, wchar_t *paramPath, int paramPathLength, int *paramFirstCluster) {
+
+    Entry entry;
+    int exception = findPathEntry(paramVolume, paramPath, paramPathLength, &entry);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    int firstCluster = getFirstClusterOfEntry(&entry);
+    if(!(entry.DIR_Attr & 0x10) || (firstCluster != 0 && !isValidCluster(paramVolume, firstCluster))) {
+        return EXCEPTION_FILE_DOES_NOT_EXIST;
+    }
+
+    *paramFirstCluster = firstCluster;
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Adds host files to a directory of a volume then flushes the volume once
+ * @param paramVolume         - The volume being written to, it must have a write cache
+ * @param paramDirectory      - The path of the directory in the volume
+ * @param paramHostFiles      - The locations of the files on the host
+ * @param paramNumberOfFiles  - The number of host files
+ * @return                    - The exception that stopped the files being added, EXCEPTION_NONE when there was none
+ */
+int addHostFiles(Volume *paramVolume, char *paramDirectory, char **paramHostFiles, int paramNumberOfFiles) {
+
+    int directoryLength;
+    wchar_t *directory = createWideString(paramDirectory, &directoryLength);
+
+    int firstCluster;
+    int exception = findDirectoryCluster(paramVolume, directory, directoryLength, &firstCluster);
+    free(directory);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    int numberOfFilesAdded = 0;
+    DirectoryNames *directoryNames = readDirectoryNames(paramVolume, firstCluster);
+
+    for(int fileIndex = 0; fileIndex < paramNumberOfFiles && exception == EXCEPTION_NONE; fileIndex++) {
+
+        FILE *file;
+        exception = openFile(paramHostFiles[fileIndex], &file);
+        if(exception != EXCEPTION_NONE) {
+            break;
+        }
+
+        Buffer *contents = convertFileToBuffer(file);
+        closeFile(file);
+        if(contents == NULL) {
+            exception = EXCEPTION_UNABLE_TO_OPEN_FILE;
+            break;
+        }
+
+        const char *baseName = strrchr(paramHostFiles[fileIndex], '/');
+        baseName = baseName == NULL ? paramHostFiles[fileIndex] : baseName + 1;
+
+        int nameLength;
+        wchar_t *name = createWideString(baseName, &nameLength);
+
+        exception = addFileToDirectory(paramVolume, firstCluster, directoryNames, name, nameLength, contents);
+        if(exception == EXCEPTION_NONE) {
+            numberOfFilesAdded++;
+        }
+
+        free(name);
+        freeBuffer(contents);
+    }
+    freeDirectoryNames(directoryNames);
+
+    int flushException = flushVolume(paramVolume);
+    if(flushException != EXCEPTION_NONE) {
+        return flushException;
+    }
+
+    printOutput("Added %d files, wrote %ld sectors in %ld writes\n", numberOfFilesAdded,
+                paramVolume->writeCache->numberOfSectorsWritten, paramVolume->writeCache->numberOfWrites);
+
+    return exception;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                          Defragmentation                                         |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Defragmenting makes the chain of every file and directory one run of clusters. The plan first tries to move only
+ * the fragmented chains, placing the largest first into runs made of free clusters and the clusters the fragmented
+ * chains are leaving. When those runs are too short every chain is packed from the start of the data region in the
+ * order of the walk instead. Clusters that are allocated but not reached by the walk, bad clusters and the root
+ * directory of a FAT32 volume are never moved and chains are packed around them.
+ *
+ * The moves are made to the image held in memory. Each cluster whose destination is free is moved first, freeing
+ * its source for the cluster moving into it, so only clusters that move in a cycle need the one cluster of scratch
+ * memory. The entries pointing at a chain are rewritten before any cluster moves so a moved directory carries its
+ * new entries with it, then the flush writes the moved clusters as a few long runs. A crash part way through the
+ * flush can leave the image damaged, so --defrag-to is safer as it defragments a copy and leaves the original as
+ * it was.
+ */
+
+#define DEFRAG_SEEK_MILLISECONDS 8.0                // Time of one seek on a rotating disk, for the dry run estimate
+#define DEFRAG_TRANSFER_MEGABYTES_PER_SECOND 150.0  // Sequential transfer rate of the same disk
+#define DEFRAG_COPY_SIZE (1024 * 1024)
+
+#define DEFRAG_CLUSTER_FREE -1
+#define DEFRAG_CLUSTER_PINNED -2
+
+/**
+ * A defrag chain is the chain of one file or directory that the walk reached
+ */
+struct DefragChain {
+    int firstCluster;
+    int numberOfClusters;
+    int numberOfFragments;              // Runs of clusters that follow each other
+    long fileSize;                      // Bytes read from the chain, the size of its clusters for a directory
+    uint8_t is_directory;
+    int clusterStart;                   // Index of its first cluster in the clusters of the plan
+    int targetCluster;                  // Where the chain starts once defragmented, 0 when it is not moved
+
+}; typedef struct DefragChain DefragChain;
+
+/**
+ * A defrag reference is a directory slot holding the first cluster of a chain, "." and ".." included
+ */
+struct DefragReference {
+    long slotOffset;                    // First byte of the slot within the image
+    int chainIndex;
+
+}; typedef struct DefragReference DefragReference;
+
+/**
+ * A defrag plan holds every chain of a volume and where each is moved to
+ */
+struct DefragPlan {
+    DefragChain *chains;
+    int numberOfChains;
+    int chainCapacity;
+
+    DefragReference *references;
+    int numberOfReferences;
+    int referenceCapacity;
+
+    int *clusters;                      // The clusters of every chain, in chain order
+    int numberOfClusters;
+    int *owners;                        // Chain holding each cluster, DEFRAG_CLUSTER_FREE or DEFRAG_CLUSTER_PINNED
+
+    uint8_t is_packed;                  // Every chain is packed from the start, the free runs were too short
+    int numberOfChainsMoved;
+    long numberOfClustersMoved;
+
+}; typedef struct DefragPlan DefragPlan;
+
+/**
+ * Creates an empty plan for a volume
+ * @param paramVolume - The volume being defragmented
+ * @return            - The plan with every cluster free
+ */
+DefragPlan *createDefragPlan(Volume *paramVolume) {
+
+    DefragPlan *defragPlan = (DefragPlan *) calloc(1, sizeof(DefragPlan));
+    defragPlan->clusters = (int *) malloc(sizeof(int) * paramVolume->numberOfClusters);
+    defragPlan->owners = (int *) malloc(sizeof(int) * (paramVolume->numberOfClusters + 2));
+
+    for(int cluster = 0; cluster < paramVolume->numberOfClusters + 2; cluster++) {
+        defragPlan->owners[cluster] = DEFRAG_CLUSTER_FREE;
+    }
+
+    return defragPlan;
+}
+
+/**
+ * Frees a plan
+ * @param paramDefragPlan - The plan being freed
+ */
+void freeDefragPlan(DefragPlan *paramDefragPlan) {
+    free(paramDefragPlan->chains);
+    free(paramDefragPlan->references);
+    free(paramDefragPlan->clusters);
+    free(paramDefragPlan->owners);
+    free(paramDefragPlan);
+}
+
+/**
+ * Adds the chain of an entry to a plan, claiming each of its clusters
+ * @param paramVolume       - The volume being defragmented
+ * @param paramDefragPlan   - The plan
+ * @param paramFirstCluster - The first cluster of the chain
+ * @param paramFileSize     - The size of the file, ignored for a directory
+ * @param paramIsDirectory  - 1 if the chain holds a directory
+ * @return                  - The index of the chain, -1 when it shares a cluster with another chain or loops
+ */
+int addDefragChain(Volume *paramVolume, DefragPlan *paramDefragPlan, int paramFirstCluster, long paramFileSize, uint8_t paramIsDirectory) {
+
+    int chainIndex = paramDefragPlan->numberOfChains;
+    int clusterStart = paramDefragPlan->numberOfClusters;
+    int numberOfFragments = 1;
+
+    int currentCluster = paramFirstCluster;
+    while(isValidCluster(paramVolume, currentCluster)) {
+
+        if(paramDefragPlan->owners[currentCluster] != DEFRAG_CLUSTER_FREE) {
+            // Cross linked or looping chains are left where they are, their clusters end up pinned
+            for(int index = clusterStart; index < paramDefragPlan->numberOfClusters; index++) {
+                paramDefragPlan->owners[paramDefragPlan->clusters[index]] = DEFRAG_CLUSTER_FREE;
+            }
+            paramDefragPlan->numberOfClusters = clusterStart;
+            return -1;
+        }
+
+        paramDefragPlan->owners[currentCluster] = chainIndex;
+        paramDefragPlan->clusters[paramDefragPlan->numberOfClusters++] = currentCluster;
+
+        int nextCluster = (int) getFatEntry(paramVolume, currentCluster);
+        if(isValidCluster(paramVolume, nextCluster) && nextCluster != currentCluster + 1) {
+            numberOfFragments++;
+        }
+        currentCluster = nextCluster;
+    }
+
+    if(paramDefragPlan->numberOfChains == paramDefragPlan->chainCapacity) {
+        paramDefragPlan->chainCapacity = paramDefragPlan->chainCapacity == 0 ? 64 : paramDefragPlan->chainCapacity * 2;
+        paramDefragPlan->chains = (DefragChain *) realloc(paramDefragPlan->chains, sizeof(DefragChain) * paramDefragPlan->chainCapacity);
+    }
+
+    DefragChain *defragChain = paramDefragPlan->chains + paramDefragPlan->numberOfChains++;
+    defragChain->firstCluster = paramFirstCluster;
+    defragChain->numberOfClusters = paramDefragPlan->numberOfClusters - clusterStart;
+    defragChain->numberOfFragments = numberOfFragments;
+    defragChain->is_directory = paramIsDirectory;
+    defragChain->fileSize = paramIsDirectory ? (long) defragChain->numberOfClusters * paramVolume->bytesPerCluster : paramFileSize;
+    defragChain->clusterStart = clusterStart;
+    defragChain->targetCluster = 0;
+
+    return chainIndex;
+}
+
+/**
+ * Records a slot that holds the first cluster of a chain
+ * @param paramDefragPlan - The plan
+ * @param paramSlotOffset - The first byte of the slot within the image
+ * @param paramChainIndex - The chain it points at
+ */
+void addDefragReference(DefragPlan *paramDefragPlan, long paramSlotOffset, int paramChainIndex) {
+
+    if(paramDefragPlan->numberOfReferences == paramDefragPlan->referenceCapacity) {
+        paramDefragPlan->referenceCapacity = paramDefragPlan->referenceCapacity == 0 ? 64 : paramDefragPlan->referenceCapacity * 2;
+        paramDefragPlan->references = (DefragReference *) realloc(paramDefragPlan->references, sizeof(DefragReference) * paramDefragPlan->referenceCapacity);
+    }
+
+    paramDefragPlan->references[paramDefragPlan->numberOfReferences].slotOffset = paramSlotOffset;
+    paramDefragPlan->references[paramDefragPlan->numberOfReferences].chainIndex = paramChainIndex;
+    paramDefragPlan->numberOfReferences++;
+}
+
+/**
+ * Adds the chain of every entry in a directory to a plan, walking into each sub directory
+ * @param paramVolume         - The volume being defragmented
+ * @param paramDefragPlan     - The plan
+ * @param paramFirstCluster   - The first cluster of the directory, 0 for the root directory
+ * @param paramChainIndex     - The chain of the directory, -1 for the root directory
+ * @param paramParentIndex    - The chain of the parent directory, -1 when it is the root directory
+ * @param paramDepth          - The depth of the directory, the root is 0
+ */
+void collectDefragChains(Volume *paramVolume, DefragPlan *paramDefragPlan, int paramFirstCluster, int paramChainIndex, int paramParentIndex, int paramDepth) {
+
+    int numberOfSlots;
+    long *slotOffsets = getDirectorySlotOffsets(paramVolume, paramFirstCluster, &numberOfSlots);
+
+    for(int slot = 0; slot < numberOfSlots; slot++) {
+
+        Entry entry;
+        readVolumeBytes(paramVolume, slotOffsets[slot], (unsigned char *) &entry, sizeof(Entry));
+
+        if(entry.DIR_Name[0] == 0x00) {
+            break;
+        }
+        if(entry.DIR_Name[0] == 0xe5 || entry.DIR_Attr == 0x0f || (entry.DIR_Attr & 0x08)) {
+            continue;
+        }
+
+        if(entry.DIR_Name[0] == 0x2e) {                                         // "." and ".."
+            int chainIndex = entry.DIR_Name[1] == 0x2e ? paramParentIndex : paramChainIndex;
+            if(chainIndex >= 0) {
+                addDefragReference(paramDefragPlan, slotOffsets[slot], chainIndex);
+            }
+            continue;
+        }
+
+        int firstCluster = getFirstClusterOfEntry(&entry);
+        if(!isValidCluster(paramVolume, firstCluster)) {
+            continue;
+        }
+
+        uint8_t is_directory = (entry.DIR_Attr & 0x10) != 0;
+        int chainIndex = addDefragChain(paramVolume, paramDefragPlan, firstCluster, entry.DIR_FileSize, is_directory);
+        if(chainIndex < 0) {
+            continue;
+        }
+        addDefragReference(paramDefragPlan, slotOffsets[slot], chainIndex);
+
+        if(is_directory && paramDepth < MAX_DIRECTORY_DEPTH) {
+            collectDefragChains(paramVolume, paramDefragPlan, firstCluster, chainIndex, paramChainIndex, paramDepth + 1);
+        }
+    }
+
+    free(slotOffsets);
+}
+
+/**
+ * Walks a volume into a plan with no chains moved, pinning every allocated cluster the walk did not reach
+ * @param paramVolume - The volume being defragmented
+ * @return            - The plan
+ */
+DefragPlan *collectDefragPlan(Volume *paramVolume) {
+
+    DefragPlan *defragPlan = createDefragPlan(paramVolume);
+    collectDefragChains(paramVolume, defragPlan, 0, -1, -1, 0);
+
+    for(int cluster = 2; cluster < paramVolume->numberOfClusters + 2; cluster++) {
+        if(defragPlan->owners[cluster] == DEFRAG_CLUSTER_FREE && getFatEntry(paramVolume, cluster) != 0) {
+            defragPlan->owners[cluster] = DEFRAG_CLUSTER_PINNED;
+        }
+    }
+
+    return defragPlan;
+}
+
+/**
+ * Compares two chains by their number of clusters, largest first
+ */
+int compareDefragChainLengths(const void *paramFirst, const void *paramSecond) {
+    const DefragChain *first = *(DefragChain * const *) paramFirst;
+    const DefragChain *second = *(DefragChain * const *) paramSecond;
+    return second->numberOfClusters - first->numberOfClusters;
+}
+
+/**
+ * Finds the first run of clusters that are all available
+ * @param paramIsAvailable      - Whether each cluster may be moved into
+ * @param paramStartCluster     - The cluster the search starts at
+ * @param paramEndCluster       - The cluster after the last one searched
+ * @param paramNumberOfClusters - The length of the run
+ * @return                      - The first cluster of the run, 0 when there is none
+ */
+int findAvailableRun(const uint8_t *paramIsAvailable, int paramStartCluster, int paramEndCluster, int paramNumberOfClusters) {
+    int runLength = 0;
+    for(int cluster = paramStartCluster; cluster < paramEndCluster; cluster++) {
+        runLength = paramIsAvailable[cluster] ? runLength + 1 : 0;
+        if(runLength == paramNumberOfClusters) {
+            return cluster - runLength + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Decides where every chain that needs it is moved, trying to move only the fragmented chains before packing them all
+ * @param paramVolume     - The volume being defragmented
+ * @param paramDefragPlan - The plan, targetCluster is set on each chain that moves
+ * @return                - EXCEPTION_NONE or EXCEPTION_VOLUME_FULL when the chains cannot fit around the pinned clusters
+ */
+int planDefragmentation(Volume *paramVolume, DefragPlan *paramDefragPlan) {
+
+    int endCluster = paramVolume->numberOfClusters + 2;
+    uint8_t *isAvailable = (uint8_t *) malloc(endCluster);
+
+    DefragChain **fragmentedChains = (DefragChain **) malloc(sizeof(DefragChain *) * (paramDefragPlan->numberOfChains + 1));
+    int numberOfFragmentedChains = 0;
+    for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains; chainIndex++) {
+        if(paramDefragPlan->chains[chainIndex].numberOfFragments > 1) {
+            fragmentedChains[numberOfFragmentedChains++] = paramDefragPlan->chains + chainIndex;
+        }
+    }
+    qsort(fragmentedChains, numberOfFragmentedChains, sizeof(DefragChain *), compareDefragChainLengths);
+
+    for(int cluster = 0; cluster < endCluster; cluster++) {
+        int owner = paramDefragPlan->owners[cluster];
+        isAvailable[cluster] = cluster >= 2 && (owner == DEFRAG_CLUSTER_FREE || (owner >= 0 && paramDefragPlan->chains[owner].numberOfFragments > 1));
+    }
+
+    int numberOfPlaced = 0;
+    while(numberOfPlaced < numberOfFragmentedChains) {
+        DefragChain *defragChain = fragmentedChains[numberOfPlaced];
+        int targetCluster = findAvailableRun(isAvailable, 2, endCluster, defragChain->numberOfClusters);
+        if(targetCluster == 0) {
+            break;
+        }
+        memset(isAvailable + targetCluster, 0, defragChain->numberOfClusters);
+        defragChain->targetCluster = targetCluster;
+        numberOfPlaced++;
+    }
+
+    free(fragmentedChains);
+    int exception = EXCEPTION_NONE;
+
+    if(numberOfPlaced < numberOfFragmentedChains) {
+        paramDefragPlan->is_packed = 1;
+
+        for(int cluster = 0; cluster < endCluster; cluster++) {
+            isAvailable[cluster] = cluster >= 2 && paramDefragPlan->owners[cluster] != DEFRAG_CLUSTER_PINNED;
+        }
+
+        int nextCluster = 2;
+        for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains && exception == EXCEPTION_NONE; chainIndex++) {
+            DefragChain *defragChain = paramDefragPlan->chains + chainIndex;
+            int targetCluster = findAvailableRun(isAvailable, nextCluster, endCluster, defragChain->numberOfClusters);
+            if(targetCluster == 0) {
+                exception = EXCEPTION_VOLUME_FULL;
+                break;
+            }
+            defragChain->targetCluster = targetCluster;
+            nextCluster = targetCluster + defragChain->numberOfClusters;
+        }
+    }
+
+    free(isAvailable);
+
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    // A chain already in one run at its target stays where it is
+    for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains; chainIndex++) {
+        DefragChain *defragChain = paramDefragPlan->chains + chainIndex;
+        if(defragChain->targetCluster == defragChain->firstCluster && defragChain->numberOfFragments == 1) {
+            defragChain->targetCluster = 0;
+        }
+        if(defragChain->targetCluster == 0) {
+            continue;
+        }
+
+        paramDefragPlan->numberOfChainsMoved++;
+        for(int index = 0; index < defragChain->numberOfClusters; index++) {
+            if(paramDefragPlan->clusters[defragChain->clusterStart + index] != defragChain->targetCluster + index) {
+                paramDefragPlan->numberOfClustersMoved++;
+            }
+        }
+    }
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Copies one cluster of a volume over another
+ * @param paramVolume             - The volume being defragmented, it must have a write cache
+ * @param paramSourceCluster      - The cluster copied
+ * @param paramDestinationCluster - The cluster written
+ */
+void copyCluster(Volume *paramVolume, int paramSourceCluster, int paramDestinationCluster) {
+    writeVolumeBytes(paramVolume, getClusterOffset(paramVolume, paramDestinationCluster), paramVolume->buffer->bufferPtr + getClusterOffset(paramVolume, paramSourceCluster),
+                     paramVolume->bytesPerCluster, WRITE_KIND_DATA);
+}
+
+/**
+ * Carries out a plan on a volume held in memory, nothing reaches the image until it is flushed
+ * @param paramVolume     - The volume being defragmented, it must have a write cache
+ * @param paramDefragPlan - The plan
+ * @return                - The number of cycles of moves that needed the scratch cluster
+ */
+int applyDefragPlan(Volume *paramVolume, DefragPlan *paramDefragPlan) {
+
+    int endCluster = paramVolume->numberOfClusters + 2;
+
+    for(int index = 0; index < paramDefragPlan->numberOfReferences; index++) {
+        DefragReference *reference = paramDefragPlan->references + index;
+        int targetCluster = paramDefragPlan->chains[reference->chainIndex].targetCluster;
+        if(targetCluster == 0) {
+            continue;
+        }
+        uint16_t high = (uint16_t) (targetCluster >> 16);
+        uint16_t low = (uint16_t) (targetCluster & 0xFFFF);
+        writeVolumeBytes(paramVolume, reference->slotOffset + offsetof(Entry, DIR_FstClusHI), &high, sizeof(high), WRITE_KIND_DIRECTORY);
+        writeVolumeBytes(paramVolume, reference->slotOffset + offsetof(Entry, DIR_FstClusLO), &low, sizeof(low), WRITE_KIND_DIRECTORY);
+    }
+
+    // The cluster moving into each cluster, and whether each cluster still holds bytes that have to move
+    int *sources = (int *) calloc(endCluster, sizeof(int));
+    uint8_t *isPending = (uint8_t *) calloc(endCluster, 1);
+
+    for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains; chainIndex++) {
+        DefragChain *defragChain = paramDefragPlan->chains + chainIndex;
+        if(defragChain->targetCluster == 0) {
+            continue;
+        }
+        for(int index = 0; index < defragChain->numberOfClusters; index++) {
+            int sourceCluster = paramDefragPlan->clusters[defragChain->clusterStart + index];
+            if(sourceCluster != defragChain->targetCluster + index) {
+                sources[defragChain->targetCluster + index] = sourceCluster;
+                isPending[sourceCluster] = 1;
+            }
+        }
+    }
+
+    // Paths end at a cluster whose bytes are not needed, each move frees the cluster the next move writes
+    for(int cluster = 2; cluster < endCluster; cluster++) {
+        if(sources[cluster] == 0 || isPending[cluster]) {
+            continue;
+        }
+        int destinationCluster = cluster;
+        while(sources[destinationCluster] != 0) {
+            int sourceCluster = sources[destinationCluster];
+            copyCluster(paramVolume, sourceCluster, destinationCluster);
+            sources[destinationCluster] = 0;
+            isPending[sourceCluster] = 0;
+            destinationCluster = sourceCluster;
+        }
+    }
+
+    // What is left are cycles, the first cluster of each is kept in scratch until the last move of the cycle
+    int numberOfCycles = 0;
+    unsigned char *scratch = (unsigned char *) malloc(paramVolume->bytesPerCluster);
+
+    for(int cluster = 2; cluster < endCluster; cluster++) {
+        if(sources[cluster] == 0) {
+            continue;
+        }
+        numberOfCycles++;
+        memcpy(scratch, paramVolume->buffer->bufferPtr + getClusterOffset(paramVolume, cluster), paramVolume->bytesPerCluster);
+
+        int destinationCluster = cluster;
+        while(sources[destinationCluster] != cluster) {
+            int sourceCluster = sources[destinationCluster];
+            copyCluster(paramVolume, sourceCluster, destinationCluster);
+            sources[destinationCluster] = 0;
+            destinationCluster = sourceCluster;
+        }
+        writeVolumeBytes(paramVolume, getClusterOffset(paramVolume, destinationCluster), scratch, paramVolume->bytesPerCluster, WRITE_KIND_DATA);
+        sources[destinationCluster] = 0;
+    }
+
+    free(scratch);
+    free(isPending);
+    free(sources);
+
+    // Every old cluster is freed before the new runs are linked, as a run can reuse clusters another chain left
+    for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains; chainIndex++) {
+        DefragChain *defragChain = paramDefragPlan->chains + chainIndex;
+        if(defragChain->targetCluster == 0) {
+            continue;
+        }
+        for(int index = 0; index < defragChain->numberOfClusters; index++) {
+            setFatEntry(paramVolume, paramDefragPlan->clusters[defragChain->clusterStart + index], 0);
+        }
+    }
+    for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains; chainIndex++) {
+        DefragChain *defragChain = paramDefragPlan->chains + chainIndex;
+        if(defragChain->targetCluster == 0) {
+            continue;
+        }
+        int lastCluster = defragChain->targetCluster + defragChain->numberOfClusters - 1;
+        for(int cluster = defragChain->targetCluster; cluster < lastCluster; cluster++) {
+            setFatEntry(paramVolume, cluster, cluster + 1);
+        }
+        setFatEntry(paramVolume, lastCluster, FAT_END_OF_CHAIN);
+    }
+
+    return numberOfCycles;
+}
+
+/**
+ * Counts the fragments of every chain in a plan
+ * @param paramDefragPlan  - The plan
+ * @param paramIsPlanned   - 1 to count the chains as they will be once the plan is carried out
+ * @param paramFiles       - Set to the number of files, may be NULL
+ * @param paramFragmented  - Set to the number of chains in more than one fragment
+ * @return                 - The number of fragments
+ */
+long countDefragFragments(DefragPlan *paramDefragPlan, uint8_t paramIsPlanned, int *paramFiles, int *paramFragmented) {
+
+    long numberOfFragments = 0;
+    int numberOfFiles = 0;
+    int numberOfFragmented = 0;
+
+    for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains; chainIndex++) {
+        DefragChain *defragChain = paramDefragPlan->chains + chainIndex;
+        int fragments = paramIsPlanned && defragChain->targetCluster != 0 ? 1 : defragChain->numberOfFragments;
+        numberOfFragments += fragments;
+        numberOfFragmented += fragments > 1;
+        numberOfFiles += !defragChain->is_directory;
+    }
+
+    if(paramFiles != NULL) {
+        *paramFiles = numberOfFiles;
+    }
+    *paramFragmented = numberOfFragmented;
+    return numberOfFragments;
+}
+
+/**
+ * Estimates the rate every chain can be read at in order on a rotating disk, each fragment costing one seek
+ * @param paramDefragPlan - The plan
+ * @param paramIsPlanned  - 1 to estimate the chains as they will be once the plan is carried out
+ * @return                - Megabytes per second
+ */
+double estimateSequentialReadRate(DefragPlan *paramDefragPlan, uint8_t paramIsPlanned) {
+
+    int numberOfFragmented;
+    long numberOfFragments = countDefragFragments(paramDefragPlan, paramIsPlanned, NULL, &numberOfFragmented);
+
+    double megabytes = 0;
+    for(int chainIndex = 0; chainIndex < paramDefragPlan->numberOfChains; chainIndex++) {
+        megabytes += paramDefragPlan->chains[chainIndex].fileSize / (1024.0 * 1024.0);
+    }
+
+    double seconds = numberOfFragments * DEFRAG_SEEK_MILLISECONDS / 1000.0 + megabytes / DEFRAG_TRANSFER_MEGABYTES_PER_SECOND;
+    return seconds == 0 ? 0 : megabytes / seconds;
+}
+
+/**
+ * Plans the defragmentation of a volume and prints it, then carries it out and flushes the volume unless it is a dry run
+ * @param paramVolume   - The volume being defragmented, it must have a write cache unless it is a dry run
+ * @param paramIsDryRun - 1 to only print the plan and the expected gain in sequential read rate
+ * @return              - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int defragmentVolume(Volume *paramVolume, uint8_t paramIsDryRun) {
+
+    DefragPlan *defragPlan = collectDefragPlan(paramVolume);
+
+    int exception = planDefragmentation(paramVolume, defragPlan);
+    if(exception != EXCEPTION_NONE) {
+        freeDefragPlan(defragPlan);
+        return exception;
+    }
+
+    int numberOfFiles, numberOfFragmented, numberOfPlannedFragmented;
+    long fragmentsBefore = countDefragFragments(defragPlan, 0, &numberOfFiles, &numberOfFragmented);
+    long fragmentsPlanned = countDefragFragments(defragPlan, 1, NULL, &numberOfPlannedFragmented);
+
+    printOutput("Chains: %d files and %d directories, %d fragmented\n", numberOfFiles, defragPlan->numberOfChains - numberOfFiles, numberOfFragmented);
+    printOutput("Plan: move %ld clusters of %d chains, %s\n", defragPlan->numberOfClustersMoved, defragPlan->numberOfChainsMoved,
+                defragPlan->is_packed ? "packing every chain from the start of the data region" : "moving the fragmented chains into free runs");
+
+    if(paramIsDryRun) {
+        double rateBefore = estimateSequentialReadRate(defragPlan, 0);
+        double rateAfter = estimateSequentialReadRate(defragPlan, 1);
+        printOutput("Fragments: %ld before, %ld after\n", fragmentsBefore, fragmentsPlanned);
+        printOutput("Expected sequential read: %.1f MB/s before, %.1f MB/s after (%.2fx) at %.0f ms per seek and %.0f MB/s\n",
+                    rateBefore, rateAfter, rateBefore == 0 ? 1.0 : rateAfter / rateBefore, DEFRAG_SEEK_MILLISECONDS, DEFRAG_TRANSFER_MEGABYTES_PER_SECOND);
+        freeDefragPlan(defragPlan);
+        return EXCEPTION_NONE;
+    }
+
+    int numberOfCycles = applyDefragPlan(paramVolume, defragPlan);
+    freeDefragPlan(defragPlan);
+
+    exception = flushVolume(paramVolume);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    // The fragments after are counted from the image as written rather than trusted from the plan
+    DefragPlan *writtenPlan = collectDefragPlan(paramVolume);
+    long fragmentsAfter = countDefragFragments(writtenPlan, 0, NULL, &numberOfFragmented);
+    freeDefragPlan(writtenPlan);
+
+    printOutput("Fragments: %ld before, %ld after\n", fragmentsBefore, fragmentsAfter);
+    printOutput("Defragmented, %d cycles of moves went through the scratch cluster, wrote %ld sectors in %ld writes\n", numberOfCycles,
+                paramVolume->writeCache->numberOfSectorsWritten, paramVolume->writeCache->numberOfWrites);
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Copies an image so it can be defragmented without changing the original
+ * @param paramSourceLocation      - The image being copied
+ * @param paramDestinationLocation - Where the copy is written, replacing any file there
+ * @return                         - EXCEPTION_NONE, EXCEPTION_UNABLE_TO_OPEN_FILE or EXCEPTION_UNABLE_TO_WRITE_FILE
+ */
+int copyImage(char *paramSourceLocation, char *paramDestinationLocation) {
+
+    int source = open(paramSourceLocation, O_RDONLY);
+    if(source < 0) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+    int destination = open(paramDestinationLocation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(destination < 0) {
+        close(source);
+        return EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+
+    unsigned char *bytes = (unsigned char *) malloc(DEFRAG_COPY_SIZE);
+    int exception = EXCEPTION_NONE;
+
+    while(exception == EXCEPTION_NONE) {
+        ssize_t bytesRead = read(source, bytes, DEFRAG_COPY_SIZE);
+        if(bytesRead <= 0) {
+            exception = bytesRead == 0 ? EXCEPTION_NONE : EXCEPTION_UNABLE_TO_OPEN_FILE;
+            break;
+        }
+        for(ssize_t written = 0; written < bytesRead; ) {
+            ssize_t result = write(destination, bytes + written, bytesRead - written);
+            if(result <= 0) {
+                exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+                break;
+            }
+            written += result;
+        }
+    }
+
+    free(bytes);
+    close(source);
+    if(close(destination) != 0 && exception == EXCEPTION_NONE) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+    return exception;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                          Sparse Images                                           |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * A mostly empty image does not need its free clusters stored. A sparse export copies the reserved sectors, the
+ * FATs, the root directory region and every allocated run of clusters into a file that is sized to match the image,
+ * leaving each free run as a hole that is never written. Holes in the image itself are found with SEEK_DATA and
+ * SEEK_HOLE so they stay holes in the copy. Punching holes does the same to an image in place by deallocating every
+ * free run with fallocate. Either way the time taken and the disk used follow the clusters in use rather than the
+ * size of the image.
+ *
+ * Zeroing slack first clears what could still be read from the allocated clusters: the bytes past the end of each
+ * file in its last cluster, deleted directory slots, which keep only their 0xe5 mark, and every slot after the end
+ * of a directory.
+ */
+
+#define SPARSE_CACHE_BYTES (16L * 1024 * 1024)     // Budget of the block cache used to read the FAT and directories
+#define SPARSE_COPY_SIZE (1024 * 1024)
+
+/**
+ * Counts of what a sparse export or hole punch did
+ */
+struct SparseStatistics {
+    long allocatedClusters;
+    long holeClusters;                  // Free clusters left as or made into holes
+    long numberOfHoles;                 // Runs of free clusters
+    long bytesCopied;
+    long slackBytesZeroed;
+    long slotsZeroed;
+
+}; typedef struct SparseStatistics SparseStatistics;
+
+/**
+ * Zeros bytes of an image that are not already 0, so zeroing never fills a hole
+ * @param paramFileDescriptor - The image opened for reading and writing
+ * @param paramOffset         - The first byte being zeroed
+ * @param paramLength         - The number of bytes, at most SPARSE_COPY_SIZE
+ * @param paramScratch        - SPARSE_COPY_SIZE bytes
+ * @return                    - The number of bytes written, -1 when the image cannot be written
+ */
+long zeroImageBytes(int paramFileDescriptor, long paramOffset, long paramLength, unsigned char *paramScratch) {
+
+    ssize_t bytesRead = pread(paramFileDescriptor, paramScratch, paramLength, paramOffset);
+    if(bytesRead <= 0 || isZeroBytes(paramScratch, bytesRead)) {
+        return 0;
+    }
+
+    memset(paramScratch, 0, bytesRead);
+    return pwrite(paramFileDescriptor, paramScratch, bytesRead, paramOffset) == bytesRead ? bytesRead : -1;
+}
+
+/**
+ * Zeros the file slack and the deleted and unused slots of a directory, walking into each sub directory
+ * @param paramVolume         - The volume, read through its buffer or block cache
+ * @param paramFileDescriptor - The image being zeroed, opened for reading and writing
+ * @param paramFirstCluster   - The first cluster of the directory, 0 for the root directory
+ * @param paramDepth          - The depth of the directory, the root is 0
+ * @param paramScratch        - SPARSE_COPY_SIZE bytes
+ * @param paramStatistics     - Counts the bytes and slots zeroed
+ * @return                    - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_WRITE_FILE
+ */
+int zeroDirectorySlack(Volume *paramVolume, int paramFileDescriptor, int paramFirstCluster, int paramDepth, unsigned char *paramScratch, SparseStatistics *paramStatistics) {
+
+    int numberOfSlots;
+    long *slotOffsets = getDirectorySlotOffsets(paramVolume, paramFirstCluster, &numberOfSlots);
+
+    int exception = EXCEPTION_NONE;
+    uint8_t is_ended = 0;
+
+    for(int slot = 0; slot < numberOfSlots && exception == EXCEPTION_NONE; slot++) {
+
+        Entry entry;
+        readVolumeBytes(paramVolume, slotOffsets[slot], (unsigned char *) &entry, sizeof(Entry));
+
+        is_ended = is_ended || entry.DIR_Name[0] == 0x00;
+
+        // A deleted slot keeps its mark so the slots after it are still read
+        if(is_ended || entry.DIR_Name[0] == 0xe5) {
+            long offset = slotOffsets[slot] + (is_ended ? 0 : 1);
+            long written = zeroImageBytes(paramFileDescriptor, offset, sizeof(Entry) - (offset - slotOffsets[slot]), paramScratch);
+            if(written < 0) {
+                exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+            }
+            paramStatistics->slotsZeroed += written > 0;
+            continue;
+        }
+
+        if(entry.DIR_Attr == 0x0f || (entry.DIR_Attr & 0x08) || entry.DIR_Name[0] == 0x2e) {
+            continue;
+        }
+
+        int firstCluster = getFirstClusterOfEntry(&entry);
+        if(!isValidCluster(paramVolume, firstCluster)) {
+            continue;
+        }
+
+        if(entry.DIR_Attr & 0x10) {
+            if(paramDepth < MAX_DIRECTORY_DEPTH) {
+                exception = zeroDirectorySlack(paramVolume, paramFileDescriptor, firstCluster, paramDepth + 1, paramScratch, paramStatistics);
+            }
+            continue;
+        }
+
+        long usedBytes = entry.DIR_FileSize % paramVolume->bytesPerCluster;
+        if(entry.DIR_FileSize == 0 || usedBytes == 0) {
+            continue;
+        }
+
+        int lastCluster = firstCluster;
+        for(long clusterIndex = 0; clusterIndex < entry.DIR_FileSize / paramVolume->bytesPerCluster && isValidCluster(paramVolume, lastCluster); clusterIndex++) {
+            lastCluster = (int) getFatEntry(paramVolume, lastCluster);
+        }
+        if(!isValidCluster(paramVolume, lastCluster)) {
+            continue;
+        }
+
+        long written = zeroImageBytes(paramFileDescriptor, getClusterOffset(paramVolume, lastCluster) + usedBytes, paramVolume->bytesPerCluster - usedBytes, paramScratch);
+        if(written < 0) {
+            exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+        }
+        paramStatistics->slackBytesZeroed += written > 0 ? written : 0;
+    }
+
+    free(slotOffsets);
+    return exception;
+}
+
+/**
+ * Copies a range of an image, skipping the holes it already has so they stay holes in the copy
+ * @param paramSource      - The image
+ * @param paramDestination - The copy, already sized to match the image
+ * @param paramOffset      - The first byte copied
+ * @param paramLength      - The number of bytes
+ * @param paramScratch     - SPARSE_COPY_SIZE bytes
+ * @return                 - The number of bytes written, -1 when the copy cannot be written
+ */
+long copySparseRange(int paramSource, int paramDestination, long paramOffset, long paramLength, unsigned char *paramScratch) {
+
+    long end = paramOffset + paramLength;
+    long position = paramOffset;
+    long bytesCopied = 0;
+
+    while(position < end) {
+        long dataStart = position;
+        long dataEnd = end;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+        dataStart = lseek(paramSource, position, SEEK_DATA);
+        if(dataStart < 0 || dataStart >= end) {
+            break;                                                  // The rest of the range is a hole
+        }
+        dataEnd = lseek(paramSource, dataStart, SEEK_HOLE);
+        dataEnd = dataEnd < 0 || dataEnd > end ? end : dataEnd;
+#endif
+
+        for(long offset = dataStart; offset < dataEnd; ) {
+            long length = dataEnd - offset < SPARSE_COPY_SIZE ? dataEnd - offset : SPARSE_COPY_SIZE;
+            ssize_t bytesRead = pread(paramSource, paramScratch, length, offset);
+            if(bytesRead <= 0) {
+                return bytesCopied;
+            }
+            if(pwrite(paramDestination, paramScratch, bytesRead, offset) != bytesRead) {
+                return -1;
+            }
+            bytesCopied += bytesRead;
+            offset += bytesRead;
+        }
+
+        position = dataEnd;
+    }
+
+    return bytesCopied;
+}
+
+/**
+ * Calls a function with each run of clusters that are all allocated or all free, in order
+ * @param paramVolume  - The volume
+ * @param paramRun     - Called with the first cluster of a run, its length and whether it is free, stops the runs
+ *                       when it returns an exception
+ * @param paramContext - Passed to paramRun
+ * @return             - The exception paramRun returned, EXCEPTION_NONE when there was none
+ */
+int forEachClusterRun(Volume *paramVolume, int (*paramRun)(Volume *, int, int, uint8_t, void *), void *paramContext) {
+
+    int endCluster = paramVolume->numberOfClusters + 2;
+    int runStart = 2;
+    uint8_t is_run_free = getFatEntry(paramVolume, 2) == 0;
+
+    for(int cluster = 3; cluster <= endCluster; cluster++) {
+        uint8_t is_free = cluster < endCluster && getFatEntry(paramVolume, cluster) == 0;
+        if(cluster < endCluster && is_free == is_run_free) {
+            continue;
+        }
+
+        int exception = paramRun(paramVolume, runStart, cluster - runStart, is_run_free, paramContext);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+        runStart = cluster;
+        is_run_free = is_free;
+    }
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * The state of a sparse export or hole punch passed along the runs of clusters
+ */
+struct SparseContext {
+    int source;                         // The image
+    int destination;                    // The copy, or the image again when punching holes in place
+    long imageSize;
+    unsigned char *scratch;
+    SparseStatistics statistics;
+
+}; typedef struct SparseContext SparseContext;
+
+/**
+ * Gets the length of a run of clusters that lies within the image, as the last clusters can run past its end
+ */
+long getRunLengthInImage(Volume *paramVolume, int paramFirstCluster, int paramNumberOfClusters, long paramImageSize) {
+    long offset = getClusterOffset(paramVolume, paramFirstCluster);
+    long length = (long) paramNumberOfClusters * paramVolume->bytesPerCluster;
+    if(offset >= paramImageSize) {
+        return 0;
+    }
+    return offset + length > paramImageSize ? paramImageSize - offset : length;
+}
+
+/**
+ * Copies a run of allocated clusters into the copy and counts a run of free ones, which are left as a hole
+ */
+int exportClusterRun(Volume *paramVolume, int paramFirstCluster, int paramNumberOfClusters, uint8_t paramIsFree, void *paramSparseContext) {
+
+    SparseContext *sparseContext = (SparseContext *) paramSparseContext;
+
+    if(paramIsFree) {
+        sparseContext->statistics.holeClusters += paramNumberOfClusters;
+        sparseContext->statistics.numberOfHoles++;
+        return EXCEPTION_NONE;
+    }
+
+    sparseContext->statistics.allocatedClusters += paramNumberOfClusters;
+    long bytesCopied = copySparseRange(sparseContext->source, sparseContext->destination, getClusterOffset(paramVolume, paramFirstCluster),
+                                       getRunLengthInImage(paramVolume, paramFirstCluster, paramNumberOfClusters, sparseContext->imageSize), sparseContext->scratch);
+    if(bytesCopied < 0) {
+        return EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+    sparseContext->statistics.bytesCopied += bytesCopied;
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Deallocates the blocks of a run of free clusters in place
+ */
+int punchClusterRun(Volume *paramVolume, int paramFirstCluster, int paramNumberOfClusters, uint8_t paramIsFree, void *paramSparseContext) {
+
+    SparseContext *sparseContext = (SparseContext *) paramSparseContext;
+
+    if(!paramIsFree) {
+        sparseContext->statistics.allocatedClusters += paramNumberOfClusters;
+        return EXCEPTION_NONE;
+    }
+
+    long length = getRunLengthInImage(paramVolume, paramFirstCluster, paramNumberOfClusters, sparseContext->imageSize);
+#if defined(FALLOC_FL_PUNCH_HOLE)
+    if(length > 0 && fallocate(sparseContext->destination, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, getClusterOffset(paramVolume, paramFirstCluster), length) != 0) {
+        return EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+#else
+    if(length > 0) {
+        return EXCEPTION_UNABLE_TO_WRITE_FILE;                      // Holes cannot be punched without fallocate
+    }
+#endif
+    sparseContext->statistics.holeClusters += paramNumberOfClusters;
+    sparseContext->statistics.numberOfHoles++;
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Gets the bytes a file takes on disk
+ */
+long getDiskUsage(int paramFileDescriptor) {
+    struct stat fileStatus;
+    return fstat(paramFileDescriptor, &fileStatus) == 0 ? (long) fileStatus.st_blocks * 512 : 0;
+}
+
+/**
+ * Prints what a sparse export or hole punch did
+ */
+void printSparseStatistics(SparseContext *paramSparseContext, long paramDiskUsageBefore, long paramDiskUsageAfter) {
+
+    SparseStatistics *statistics = &paramSparseContext->statistics;
+    long totalClusters = statistics->allocatedClusters + statistics->holeClusters;
+
+    printOutput("Clusters: %ld allocated, %ld free in %ld holes (%.2f%% allocated)\n", statistics->allocatedClusters, statistics->holeClusters,
+                statistics->numberOfHoles, totalClusters == 0 ? 0.0 : (100.0 * statistics->allocatedClusters) / totalClusters);
+    if(statistics->slackBytesZeroed > 0 || statistics->slotsZeroed > 0) {
+        printOutput("Zeroed %ld bytes of file slack and %ld directory slots\n", statistics->slackBytesZeroed, statistics->slotsZeroed);
+    }
+    printOutput("Disk usage: %ld bytes before, %ld bytes after, of %ld byte image\n", paramDiskUsageBefore, paramDiskUsageAfter, paramSparseContext->imageSize);
+}
+
+/**
+ * Opens an image for a sparse export or hole punch
+ * @param paramVolume        - The volume of the image
+ * @param paramFlags         - O_RDONLY or O_RDWR
+ * @param paramSparseContext - Set up with the image and its size
+ * @return                   - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
+ */
+int openSparseContext(Volume *paramVolume, int paramFlags, SparseContext *paramSparseContext) {
+
+    memset(paramSparseContext, 0, sizeof(SparseContext));
+
+    paramSparseContext->source = open(paramVolume->imageLocation, paramFlags);
+    if(paramSparseContext->source < 0) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    struct stat fileStatus;
+    fstat(paramSparseContext->source, &fileStatus);
+    paramSparseContext->imageSize = fileStatus.st_size;
+    paramSparseContext->destination = paramSparseContext->source;
+    paramSparseContext->scratch = (unsigned char *) malloc(SPARSE_COPY_SIZE);
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Writes a copy of an image with every free cluster left as a hole
+ * @param paramVolume              - The volume being exported
+ * @param paramDestinationLocation - Where the copy is written, replacing any file there
+ * @param paramIsZeroSlack         - 1 to zero the file slack and deleted directory slots of the copy
+ * @return                         - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int exportSparseImage(Volume *paramVolume, char *paramDestinationLocation, uint8_t paramIsZeroSlack) {
+
+    SparseContext sparseContext;
+    int exception = openSparseContext(paramVolume, O_RDONLY, &sparseContext);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    sparseContext.destination = open(paramDestinationLocation, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(sparseContext.destination < 0 || ftruncate(sparseContext.destination, sparseContext.imageSize) != 0) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+
+    // Everything before the data region and after its last cluster is copied as it is
+    long dataStart = (long) paramVolume->sectorDataStart * paramVolume->bootSector->BPB_BytsPerSec;
+    long dataEnd = getClusterOffset(paramVolume, paramVolume->numberOfClusters + 2);
+
+    if(exception == EXCEPTION_NONE) {
+        long bytesCopied = copySparseRange(sparseContext.source, sparseContext.destination, 0, dataStart, sparseContext.scratch);
+        exception = bytesCopied < 0 ? EXCEPTION_UNABLE_TO_WRITE_FILE : EXCEPTION_NONE;
+        sparseContext.statistics.bytesCopied += bytesCopied;
+    }
+    if(exception == EXCEPTION_NONE) {
+        exception = forEachClusterRun(paramVolume, exportClusterRun, &sparseContext);
+    }
+    if(exception == EXCEPTION_NONE && dataEnd < sparseContext.imageSize) {
+        long bytesCopied = copySparseRange(sparseContext.source, sparseContext.destination, dataEnd, sparseContext.imageSize - dataEnd, sparseContext.scratch);
+        exception = bytesCopied < 0 ? EXCEPTION_UNABLE_TO_WRITE_FILE : EXCEPTION_NONE;
+        sparseContext.statistics.bytesCopied += bytesCopied;
+    }
+    if(exception == EXCEPTION_NONE && paramIsZeroSlack) {
+        exception = zeroDirectorySlack(paramVolume, sparseContext.destination, 0, 0, sparseContext.scratch, &sparseContext.statistics);
+    }
+    if(exception == EXCEPTION_NONE && fdatasync(sparseContext.destination) != 0) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+
+    if(exception == EXCEPTION_NONE) {
+        printSparseStatistics(&sparseContext, getDiskUsage(sparseContext.source), getDiskUsage(sparseContext.destination));
+        printOutput("Copied %ld bytes\n", sparseContext.statistics.bytesCopied);
+    }
+
+    if(sparseContext.destination >= 0) {
+        close(sparseContext.destination);
+    }
+    close(sparseContext.source);
+    free(sparseContext.scratch);
+    return exception;
+}
+
+/**
+ * Deallocates every free cluster of an image in place, leaving its size and contents as they read
+ * @param paramVolume      - The volume whose image is punched
+ * @param paramIsZeroSlack - 1 to zero the file slack and deleted directory slots first
+ * @return                 - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int punchImageHoles(Volume *paramVolume, uint8_t paramIsZeroSlack) {
+
+    SparseContext sparseContext;
+    int exception = openSparseContext(paramVolume, O_RDWR, &sparseContext);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
+
+    long diskUsageBefore = getDiskUsage(sparseContext.source);
+
+    if(paramIsZeroSlack) {
+        exception = zeroDirectorySlack(paramVolume, sparseContext.source, 0, 0, sparseContext.scratch, &sparseContext.statistics);
+    }
+    if(exception == EXCEPTION_NONE) {
+        exception = forEachClusterRun(paramVolume, punchClusterRun, &sparseContext);
+    }
+    if(exception == EXCEPTION_NONE && fdatasync(sparseContext.source) != 0) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+
+    if(exception == EXCEPTION_NONE) {
+        printSparseStatistics(&sparseContext, diskUsageBefore, getDiskUsage(sparseContext.source));
+    }
+
+    close(sparseContext.source);
+    free(sparseContext.scratch);
+    return exception;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                         Creating Images                                          |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Creating an image formats a new FAT16 volume and imports a host directory tree into it in one pass. The whole
+ * tree is scanned and planned before anything is written. Every directory gets its short names and slot count,
+ * then clusters are handed out in the order the image is written, each directory followed by its files and then
+ * its sub directories, so every chain is one contiguous run. Nothing is read back. The boot sector, both FATs,
+ * the root directory and the data are written in increasing order through one staging buffer, so whole FATs,
+ * directories and runs of small files each take a few large writes. The image is sized with ftruncate first,
+ * which leaves the free clusters as holes.
+ */
+
+#define CREATE_WRITE_SIZE (1024 * 1024)             // Bytes staged before they are written to the image
+#define CREATE_BYTES_PER_SECTOR 512
+#define CREATE_RESERVED_SECTORS 1
+#define CREATE_NUMBER_OF_FATS 2
+#define CREATE_ROOT_ENTRIES 512
+#define CREATE_MINIMUM_SECTORS 8401                 // The smallest volume with enough clusters to be FAT16
+#define CREATE_MAXIMUM_SECTORS 4194304              // 2GB, the largest FAT16 volume with 32KB clusters
+#define CREATE_MINIMUM_CLUSTERS 4085
+#define CREATE_MAXIMUM_CLUSTERS 65524
+#define CREATE_MAXIMUM_DIRECTORY_SLOTS 65536
+
+/**
+ * A create node is one file or directory of the host tree being imported
+ */
+struct CreateNode {
+    char *hostPath;
+    wchar_t *name;
+    int nameLength;
+    uint8_t is_directory;
+    uint32_t size;
+    uint16_t date;                      // Last modification of the host file as a FAT date and time
+    uint16_t time;
+    int depth;                          // The host directory being imported is 0
+
+    int firstChild;                     // The children of a directory are next to each other, sorted by name
+    int numberOfChildren;
+    int numberOfSlots;                  // Directory slots a directory needs, "." and ".." included
+
+    int firstCluster;                   // 0 for empty files and the root directory
+    int numberOfClusters;
+    uint8_t shortName[11];
+
+}; typedef struct CreateNode CreateNode;
+
+/**
+ * A create tree holds every node of the host tree, a directory before its children
+ */
+struct CreateTree {
+    CreateNode *nodes;
+    int numberOfNodes;
+    int capacity;
+    int numberOfFiles;
+    int numberOfDirectories;
+    int numberOfSkipped;                // Host entries that are not files or directories, or cannot be stored
+
+}; typedef struct CreateTree CreateTree;
+
+/**
+ * An image writer stages bytes written at increasing offsets so that neighbouring writes reach the image as one
+ */
+struct ImageWriter {
+    int fileDescriptor;
+    unsigned char *bytes;               // CREATE_WRITE_SIZE staged bytes
+    long offset;                        // Offset in the image of the first staged byte
+    long length;                        // Number of staged bytes
+    long numberOfWrites;
+    long bytesWritten;
+    uint8_t is_failed;
+
+}; typedef struct ImageWriter ImageWriter;
+
+/**
+ * Adds a node to a create tree
+ * @param paramCreateTree - The tree
+ * @param paramHostPath   - The location of the file or directory on the host, owned by the node from now on
+ * @param paramName       - The name of the node, owned by the node from now on
+ * @param paramNameLength - The length of the name
+ * @param paramFileStatus - The status of the host file
+ * @param paramDepth      - The depth of the node
+ * @return                - The index of the node
+ */
+int addCreateNode(CreateTree *paramCreateTree, char *paramHostPath, wchar_t *paramName, int paramNameLength, struct stat *paramFileStatus, int paramDepth) {
+
+    if(paramCreateTree->numberOfNodes == paramCreateTree->capacity) {
+        paramCreateTree->capacity = paramCreateTree->capacity == 0 ? 256 : paramCreateTree->capacity * 2;
+        paramCreateTree->nodes = (CreateNode *) realloc(paramCreateTree->nodes, sizeof(CreateNode) * paramCreateTree->capacity);
+    }
+
+    CreateNode *createNode = paramCreateTree->nodes + paramCreateTree->numberOfNodes;
+    memset(createNode, 0, sizeof(CreateNode));
+
+    createNode->hostPath = paramHostPath;
+    createNode->name = paramName;
+    createNode->nameLength = paramNameLength;
+    createNode->is_directory = S_ISDIR(paramFileStatus->st_mode);
+    createNode->size = createNode->is_directory ? 0 : (uint32_t) paramFileStatus->st_size;
+    createNode->depth = paramDepth;
+    getFatDateTime(paramFileStatus->st_mtime, &createNode->date, &createNode->time);
+
+    paramCreateTree->numberOfFiles += !createNode->is_directory;
+    paramCreateTree->numberOfDirectories += createNode->is_directory;
+    return paramCreateTree->numberOfNodes++;
+}
+
+/**
+ * Compares two create nodes by their host path, which orders siblings by name
+ */
+int compareCreateNodes(const void *paramFirst, const void *paramSecond) {
+    return strcmp(((const CreateNode *) paramFirst)->hostPath, ((const CreateNode *) paramSecond)->hostPath);
+}
+
+/**
+ * Scans a host directory tree breadth first, so the children of each directory are added next to each other.
+ * Symbolic links, devices, files of 4GB or more, names longer than 255 characters and directories deeper than
+ * MAX_DIRECTORY_DEPTH are skipped.
+ * @param paramCreateTree    - The empty tree being filled in
+ * @param paramHostDirectory - The host directory being imported
+ * @return                   - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
+ */
+int scanHostTree(CreateTree *paramCreateTree, char *paramHostDirectory) {
+
+    struct stat fileStatus;
+    if(stat(paramHostDirectory, &fileStatus) != 0 || !S_ISDIR(fileStatus.st_mode)) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+
+    int rootNameLength;
+    char *rootPath = (char *) malloc(strlen(paramHostDirectory) + 1);
+    strcpy(rootPath, paramHostDirectory);
+    addCreateNode(paramCreateTree, rootPath, createWideString("", &rootNameLength), 0, &fileStatus, 0);
+
+    for(int index = 0; index < paramCreateTree->numberOfNodes; index++) {
+
+        if(!paramCreateTree->nodes[index].is_directory) {
+            continue;
+        }
+
+        DIR *directory = opendir(paramCreateTree->nodes[index].hostPath);
+        if(directory == NULL) {
+            return EXCEPTION_UNABLE_TO_OPEN_FILE;
+        }
+
+        int firstChild = paramCreateTree->numberOfNodes;
+        int depth = paramCreateTree->nodes[index].depth + 1;
+        size_t parentLength = strlen(paramCreateTree->nodes[index].hostPath);
+
+        for(struct dirent *directoryEntry = readdir(directory); directoryEntry != NULL; directoryEntry = readdir(directory)) {
+            if(strcmp(directoryEntry->d_name, ".") == 0 || strcmp(directoryEntry->d_name, "..") == 0) {
+                continue;
+            }
+
+            char *hostPath = (char *) malloc(parentLength + strlen(directoryEntry->d_name) + 2);
+            sprintf(hostPath, "%s/%s", paramCreateTree->nodes[index].hostPath, directoryEntry->d_name);
+
+            int nameLength;
+            wchar_t *name = createWideString(directoryEntry->d_name, &nameLength);
+
+            uint8_t is_stored = lstat(hostPath, &fileStatus) == 0 && nameLength <= 255 &&
+                    ((S_ISDIR(fileStatus.st_mode) && depth < MAX_DIRECTORY_DEPTH) || (S_ISREG(fileStatus.st_mode) && fileStatus.st_size <= 0xFFFFFFFFL));
+            if(!is_stored) {
+                paramCreateTree->numberOfSkipped++;
+                free(hostPath);
+                free(name);
+                continue;
+            }
+
+            addCreateNode(paramCreateTree, hostPath, name, nameLength, &fileStatus, depth);
+        }
+        closedir(directory);
+
+        paramCreateTree->nodes[index].firstChild = firstChild;
+        paramCreateTree->nodes[index].numberOfChildren = paramCreateTree->numberOfNodes - firstChild;
+        qsort(paramCreateTree->nodes + firstChild, paramCreateTree->numberOfNodes - firstChild, sizeof(CreateNode), compareCreateNodes);
+    }
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Frees a create tree and every node in it
+ */
+void freeCreateTree(CreateTree *paramCreateTree) {
+    for(int index = 0; index < paramCreateTree->numberOfNodes; index++) {
+        free(paramCreateTree->nodes[index].hostPath);
+        free(paramCreateTree->nodes[index].name);
+    }
+    free(paramCreateTree->nodes);
+}
+
+/**
+ * Gives each child of a directory a short name no sibling has and counts the slots the directory needs
+ * @param paramCreateTree - The tree
+ * @param paramDirectory  - The index of the directory
+ * @return                - EXCEPTION_NONE or EXCEPTION_DIRECTORY_FULL
+ */
+int planCreateDirectory(CreateTree *paramCreateTree, int paramDirectory) {
+
+    CreateNode *directory = paramCreateTree->nodes + paramDirectory;
+    CreateNode *children = paramCreateTree->nodes + directory->firstChild;
+
+    NameSet *shortNames = createNameSet(directory->numberOfChildren);
+    int nextTail = 5;
+
+    directory->numberOfSlots = paramDirectory == 0 ? 0 : 2;
+    int exception = EXCEPTION_NONE;
+
+    for(int child = 0; child < directory->numberOfChildren && exception == EXCEPTION_NONE; child++) {
+        exception = createShortName(shortNames, &nextTail, children[child].name, children[child].nameLength, children[child].shortName);
+        directory->numberOfSlots += (children[child].nameLength + 12) / 13 + 1;
+    }
+
+    freeNameSet(shortNames);
+
+    int maximumSlots = paramDirectory == 0 ? CREATE_ROOT_ENTRIES : CREATE_MAXIMUM_DIRECTORY_SLOTS;
+    return exception == EXCEPTION_NONE && directory->numberOfSlots > maximumSlots ? EXCEPTION_DIRECTORY_FULL : exception;
+}
+
+/**
+ * Counts the clusters a tree needs with a cluster size
+ * @param paramCreateTree     - The tree, its directories already planned
+ * @param paramBytesPerCluster - The size of each cluster
+ * @return                    - The number of clusters of every file and sub directory
+ */
+long countCreateClusters(CreateTree *paramCreateTree, long paramBytesPerCluster) {
+
+    long numberOfClusters = 0;
+    for(int index = 1; index < paramCreateTree->numberOfNodes; index++) {
+        CreateNode *createNode = paramCreateTree->nodes + index;
+        long length = createNode->is_directory ? (long) createNode->numberOfSlots * sizeof(Entry) : (long) createNode->size;
+        numberOfClusters += (length + paramBytesPerCluster - 1) / paramBytesPerCluster;
+    }
+    return numberOfClusters;
+}
+
+/**
+ * Gets the sectors per cluster a FAT16 volume of a size gets by default, from the table of the FAT specification
+ */
+int getDefaultSectorsPerCluster(long paramTotalSectors) {
+    if(paramTotalSectors <= 32680) {
+        return 2;
+    }
+    if(paramTotalSectors <= 262144) {
+        return 4;
+    }
+    if(paramTotalSectors <= 524288) {
+        return 8;
+    }
+    if(paramTotalSectors <= 1048576) {
+        return 16;
+    }
+    return paramTotalSectors <= 2097152 ? 32 : 64;
+}
+
+/**
+ * Fills in the boot sector of a new FAT16 volume that holds a tree. Without a size the volume is grown from the
+ * smallest FAT16 volume until the tree fills no more than eight ninths of its clusters.
+ * @param paramCreateTree   - The tree, its directories already planned
+ * @param paramSizeBytes    - The size of the volume, 0 to fit it to the tree
+ * @param paramClusterBytes - The size of each cluster, 0 for the default of the volume size
+ * @param paramLabel        - The volume label, NULL for "NO NAME"
+ * @param paramBootSector   - The boot sector being filled in
+ * @return                  - EXCEPTION_NONE, EXCEPTION_INVALID_GEOMETRY or EXCEPTION_VOLUME_FULL
+ */
+int planCreateGeometry(CreateTree *paramCreateTree, long paramSizeBytes, long paramClusterBytes, char *paramLabel, BootSector *paramBootSector) {
+
+    if(paramClusterBytes != 0 && (paramClusterBytes < CREATE_BYTES_PER_SECTOR || paramClusterBytes > 65536 || (paramClusterBytes & (paramClusterBytes - 1)) != 0)) {
+        return EXCEPTION_INVALID_GEOMETRY;
+    }
+
+    long totalSectors = paramSizeBytes > 0 ? paramSizeBytes / CREATE_BYTES_PER_SECTOR : CREATE_MINIMUM_SECTORS;
+    int rootDirectorySectors = CREATE_ROOT_ENTRIES * sizeof(Entry) / CREATE_BYTES_PER_SECTOR;
+    int sectorsPerCluster, sectorsPerFat;
+
+    while(1) {
+        sectorsPerCluster = paramClusterBytes > 0 ? (int) (paramClusterBytes / CREATE_BYTES_PER_SECTOR) : getDefaultSectorsPerCluster(totalSectors);
+
+        // The FAT size calculation of the FAT specification, which can round up by a sector or two but never down
+        long fatDivisor = 256L * sectorsPerCluster + CREATE_NUMBER_OF_FATS;
+        sectorsPerFat = (int) ((totalSectors - CREATE_RESERVED_SECTORS - rootDirectorySectors + fatDivisor - 1) / fatDivisor);
+
+        long dataSectors = totalSectors - CREATE_RESERVED_SECTORS - CREATE_NUMBER_OF_FATS * sectorsPerFat - rootDirectorySectors;
+        long numberOfClusters = dataSectors / sectorsPerCluster;
+        long neededClusters = countCreateClusters(paramCreateTree, (long) sectorsPerCluster * CREATE_BYTES_PER_SECTOR);
+        uint8_t is_fat16 = numberOfClusters >= CREATE_MINIMUM_CLUSTERS && numberOfClusters <= CREATE_MAXIMUM_CLUSTERS;
+
+        if(paramSizeBytes > 0) {
+            if(!is_fat16 || totalSectors > 0xFFFFFFFFL) {
+                return EXCEPTION_INVALID_GEOMETRY;
+            }
+            if(numberOfClusters < neededClusters) {
+                return EXCEPTION_VOLUME_FULL;
+            }
+            break;
+        }
+        if(is_fat16 && numberOfClusters >= neededClusters + neededClusters / 8) {
+            break;
+        }
+        if(totalSectors >= CREATE_MAXIMUM_SECTORS || numberOfClusters > CREATE_MAXIMUM_CLUSTERS) {
+            return paramClusterBytes > 0 && neededClusters < CREATE_MAXIMUM_CLUSTERS ? EXCEPTION_INVALID_GEOMETRY : EXCEPTION_VOLUME_FULL;
+        }
+        totalSectors += totalSectors / 8;
+        totalSectors = totalSectors < CREATE_MAXIMUM_SECTORS ? totalSectors : CREATE_MAXIMUM_SECTORS;
+    }
+
+    memset(paramBootSector, 0, sizeof(BootSector));
+    memcpy(paramBootSector->BS_jmpBoot, "\xEB\x3C\x90", 3);
+    memcpy(paramBootSector->BS_OEMName, "MSWIN4.1", 8);
+    paramBootSector->BPB_BytsPerSec = CREATE_BYTES_PER_SECTOR;
+    paramBootSector->BPB_SecPerClus = (uint8_t) sectorsPerCluster;
+    paramBootSector->BPB_RsvdSecCnt = CREATE_RESERVED_SECTORS;
+    paramBootSector->BPB_NumFATs = CREATE_NUMBER_OF_FATS;
+    paramBootSector->BPB_RootEntCnt = CREATE_ROOT_ENTRIES;
+    paramBootSector->BPB_TotSec16 = totalSectors < 65536 ? (uint16_t) totalSectors : 0;
+    paramBootSector->BPB_Media = 0xF8;
+    paramBootSector->BPB_FATSz16 = (uint16_t) sectorsPerFat;
+    paramBootSector->BPB_SecPerTrk = 32;
+    paramBootSector->BPB_NumHeads = 64;
+    paramBootSector->BPB_TotSec32 = totalSectors < 65536 ? 0 : (uint32_t) totalSectors;
+    paramBootSector->BS_DrvNum = 0x80;
+    paramBootSector->BS_BootSig = 0x29;
+    paramBootSector->BS_VolID = (uint32_t) time(NULL);
+    memcpy(paramBootSector->BS_FilSysType, "FAT16   ", 8);
+
+    memcpy(paramBootSector->BS_VolLab, "NO NAME    ", 11);
+    if(paramLabel != NULL) {
+        memset(paramBootSector->BS_VolLab, ' ', 11);
+        for(int index = 0; index < 11 && paramLabel[index] != '\0'; index++) {
+            uint8_t is_lossy = 0;
+            paramBootSector->BS_VolLab[index] = paramLabel[index] == ' ' ? ' ' : getShortNameCharacter((unsigned char) paramLabel[index], &is_lossy);
+        }
+    }
+
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Hands out clusters to a directory, then its files, then each of its sub directories in turn, in the order the
+ * image is written
+ * @param paramCreateTree  - The tree, its directories already planned
+ * @param paramDirectory   - The index of the directory
+ * @param paramBytesPerCluster - The size of each cluster
+ * @param paramNextCluster - The next free cluster, moved past the clusters handed out
+ */
+void allocateCreateDirectory(CreateTree *paramCreateTree, int paramDirectory, int paramBytesPerCluster, int *paramNextCluster) {
+
+    CreateNode *directory = paramCreateTree->nodes + paramDirectory;
+
+    if(paramDirectory != 0) {
+        directory->numberOfClusters = (int) (((long) directory->numberOfSlots * sizeof(Entry) + paramBytesPerCluster - 1) / paramBytesPerCluster);
+        directory->firstCluster = *paramNextCluster;
+        *paramNextCluster += directory->numberOfClusters;
+    }
+
+    for(int pass = 0; pass < 2; pass++) {
+        for(int child = directory->firstChild; child < directory->firstChild + directory->numberOfChildren; child++) {
+            CreateNode *createNode = paramCreateTree->nodes + child;
+            if(pass == 0 && !createNode->is_directory && createNode->size > 0) {
+                createNode->numberOfClusters = (int) (((long) createNode->size + paramBytesPerCluster - 1) / paramBytesPerCluster);
+                createNode->firstCluster = *paramNextCluster;
+                *paramNextCluster += createNode->numberOfClusters;
+            } else if(pass == 1 && createNode->is_directory) {
+                allocateCreateDirectory(paramCreateTree, child, paramBytesPerCluster, paramNextCluster);
+            }
+        }
+    }
+}
+
+/**
+ * Writes every staged byte to the image
+ */
+void flushImageWriter(ImageWriter *paramImageWriter) {
+
+    for(long written = 0; written < paramImageWriter->length && !paramImageWriter->is_failed; ) {
+        ssize_t result = pwrite(paramImageWriter->fileDescriptor, paramImageWriter->bytes + written, paramImageWriter->length - written,
+                                paramImageWriter->offset + written);
+        paramImageWriter->is_failed = result <= 0;
+        written += result;
+    }
+
+    paramImageWriter->numberOfWrites += paramImageWriter->length > 0;
+    paramImageWriter->bytesWritten += paramImageWriter->length;
+    paramImageWriter->offset += paramImageWriter->length;
+    paramImageWriter->length = 0;
+}
+
+/**
+ * Makes room in the staging buffer for bytes at an offset of the image, writing the staged bytes when the new bytes
+ * do not follow them or do not fit
+ * @param paramImageWriter - The writer
+ * @param paramOffset      - The offset of the next bytes, never before the end of the staged bytes
+ * @return                 - The number of bytes that can be staged at the offset
+ */
+long reserveImageBytes(ImageWriter *paramImageWriter, long paramOffset) {
+
+    if(paramImageWriter->offset + paramImageWriter->length != paramOffset || paramImageWriter->length == CREATE_WRITE_SIZE) {
+        flushImageWriter(paramImageWriter);
+        paramImageWriter->offset = paramOffset;
+    }
+    return CREATE_WRITE_SIZE - paramImageWriter->length;
+}
+
+/**
+ * Stages bytes to be written at an offset of the image, NULL bytes being zeros
+ * @param paramImageWriter - The writer
+ * @param paramOffset      - The offset of the bytes, never before the end of the staged bytes
+ * @param paramBytes       - The bytes, NULL for zeros
+ * @param paramLength      - The number of bytes
+ */
+void writeImageBytes(ImageWriter *paramImageWriter, long paramOffset, const unsigned char *paramBytes, long paramLength) {
+
+    for(long written = 0; written < paramLength; ) {
+        long available = reserveImageBytes(paramImageWriter, paramOffset + written);
+        long length = paramLength - written < available ? paramLength - written : available;
+
+        if(paramBytes == NULL) {
+            memset(paramImageWriter->bytes + paramImageWriter->length, 0, length);
+        } else {
+            memcpy(paramImageWriter->bytes + paramImageWriter->length, paramBytes + written, length);
+        }
+        paramImageWriter->length += length;
+        written += length;
+    }
+}
+
+/**
+ * Stages the contents of a host file, read straight into the staging buffer with large sequential reads. The file is
+ * padded with zeros to the end of its last cluster, so a run of small files is written as one.
+ * @param paramImageWriter - The writer
+ * @param paramVolume      - The layout of the new volume
+ * @param paramCreateNode  - The file
+ * @return                 - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
+ */
+int writeCreateFile(ImageWriter *paramImageWriter, Volume *paramVolume, CreateNode *paramCreateNode) {
+
+    int fileDescriptor = open(paramCreateNode->hostPath, O_RDONLY);
+    if(fileDescriptor < 0) {
+        return EXCEPTION_UNABLE_TO_OPEN_FILE;
+    }
+    posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    long offset = getClusterOffset(paramVolume, paramCreateNode->firstCluster);
+    long length = (long) paramCreateNode->numberOfClusters * paramVolume->bytesPerCluster;
+    long bytesRead = 0;
+
+    while(bytesRead < paramCreateNode->size) {
+        long available = reserveImageBytes(paramImageWriter, offset + bytesRead);
+        long wanted = paramCreateNode->size - bytesRead < available ? paramCreateNode->size - bytesRead : available;
+
+        ssize_t result = read(fileDescriptor, paramImageWriter->bytes + paramImageWriter->length, wanted);
+        if(result <= 0) {
+            break;                                                  // The file shrank, the rest is left as zeros
+        }
+        paramImageWriter->length += result;
+        bytesRead += result;
+    }
+    close(fileDescriptor);
+
+    writeImageBytes(paramImageWriter, offset + bytesRead, NULL, length - bytesRead);
+    return EXCEPTION_NONE;
+}
+
+/**
+ * Fills in the short entry of a create node
+ */
+void fillCreateEntry(Entry *paramEntry, const uint8_t *paramShortName, uint8_t paramAttributes, CreateNode *paramCreateNode, int paramFirstCluster) {
+
+    memset(paramEntry, 0, sizeof(Entry));
+    memcpy(paramEntry->DIR_Name, paramShortName, 11);
+    paramEntry->DIR_Attr = paramAttributes;
+    paramEntry->DIR_CrtDate = paramCreateNode->date;
+    paramEntry->DIR_CrtTime = paramCreateNode->time;
+    paramEntry->DIR_WrtDate = paramCreateNode->date;
+    paramEntry->DIR_WrtTime = paramCreateNode->time;
+    paramEntry->DIR_LstAccDate = paramCreateNode->date;
+    paramEntry->DIR_FstClusHI = (uint16_t) (paramFirstCluster >> 16);
+    paramEntry->DIR_FstClusLO = (uint16_t) (paramFirstCluster & 0xFFFF);
+    paramEntry->DIR_FileSize = paramCreateNode->is_directory ? 0 : paramCreateNode->size;
+}
+
+/**
+ * Stages a directory, then the files in it, then each of its sub directories in turn
+ * @param paramImageWriter - The writer
+ * @param paramVolume      - The layout of the new volume
+ * @param paramCreateTree  - The tree, already allocated
+ * @param paramDirectory   - The index of the directory
+ * @param paramParent      - The index of the parent directory, -1 for the root directory
+ * @return                 - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_OPEN_FILE
+ */
+int writeCreateDirectory(ImageWriter *paramImageWriter, Volume *paramVolume, CreateTree *paramCreateTree, int paramDirectory, int paramParent) {
+
+    CreateNode *directory = paramCreateTree->nodes + paramDirectory;
+
+    long length = paramDirectory == 0 ? CREATE_ROOT_ENTRIES * (long) sizeof(Entry) : (long) directory->numberOfClusters * paramVolume->bytesPerCluster;
+    long offset = paramDirectory == 0 ? (long) paramVolume->sectorRootDirectoryStart * CREATE_BYTES_PER_SECTOR : getClusterOffset(paramVolume, directory->firstCluster);
+    unsigned char *bytes = (unsigned char *) calloc(length, 1);
+    int slot = 0;
+
+    if(paramDirectory == 0 && memcmp(paramVolume->bootSector->BS_VolLab, "NO NAME    ", 11) != 0) {
+        fillCreateEntry((Entry *) bytes + slot++, paramVolume->bootSector->BS_VolLab, 0x08, directory, 0);
+    }
+    if(paramDirectory != 0) {
+        fillCreateEntry((Entry *) bytes + slot++, (const uint8_t *) ".          ", 0x10, directory, directory->firstCluster);
+        fillCreateEntry((Entry *) bytes + slot++, (const uint8_t *) "..         ", 0x10, directory, paramCreateTree->nodes[paramParent].firstCluster);
+    }
+
+    for(int child = directory->firstChild; child < directory->firstChild + directory->numberOfChildren; child++) {
+        CreateNode *createNode = paramCreateTree->nodes + child;
+
+        int numberOfLongFileNameEntries = (createNode->nameLength + 12) / 13;
+        uint8_t checksum = getShortNameChecksum(createNode->shortName);
+        for(int order = numberOfLongFileNameEntries; order > 0; order--) {
+            fillLongFileNameEntry((LongFileNameEntry *) ((Entry *) bytes + slot++), createNode->name, createNode->nameLength, order,
+                                  order == numberOfLongFileNameEntries, checksum);
+        }
+        fillCreateEntry((Entry *) bytes + slot++, createNode->shortName, createNode->is_directory ? 0x10 : 0x20, createNode, createNode->firstCluster);
+    }
+
+    writeImageBytes(paramImageWriter, offset, bytes, length);
+    free(bytes);
+
+    int exception = EXCEPTION_NONE;
+    for(int pass = 0; pass < 2 && exception == EXCEPTION_NONE; pass++) {
+        for(int child = directory->firstChild; child < directory->firstChild + directory->numberOfChildren && exception == EXCEPTION_NONE; child++) {
+            CreateNode *createNode = paramCreateTree->nodes + child;
+            if(pass == 0 && !createNode->is_directory && createNode->size > 0) {
+                exception = writeCreateFile(paramImageWriter, paramVolume, createNode);
+            } else if(pass == 1 && createNode->is_directory) {
+                exception = writeCreateDirectory(paramImageWriter, paramVolume, paramCreateTree, child, paramDirectory);
+            }
+        }
+    }
+
+    return exception;
+}
+
+/**
+ * Formats a new FAT16 image and imports a host directory tree into it
+ * @param paramImageLocation - Where the image is written, replacing any file there
+ * @param paramHostDirectory - The host directory whose contents become the root directory
+ * @param paramSizeBytes     - The size of the image, 0 to fit it to the tree
+ * @param paramClusterBytes  - The size of each cluster, 0 for the default of the image size
+ * @param paramLabel         - The volume label, NULL for none
+ * @return                   - The exception that occurred, EXCEPTION_NONE when there was none
+ */
+int createImage(char *paramImageLocation, char *paramHostDirectory, long paramSizeBytes, long paramClusterBytes, char *paramLabel) {
+
+    CreateTree createTree;
+    memset(&createTree, 0, sizeof(CreateTree));
+
+    int exception = scanHostTree(&createTree, paramHostDirectory);
+    for(int index = 0; index < createTree.numberOfNodes && exception == EXCEPTION_NONE; index++) {
+        if(createTree.nodes[index].is_directory) {
+            exception = planCreateDirectory(&createTree, index);
+        }
+    }
+
+    BootSector *bootSector = (BootSector *) malloc(sizeof(BootSector));
+    if(exception == EXCEPTION_NONE) {
+        exception = planCreateGeometry(&createTree, paramSizeBytes, paramClusterBytes, paramLabel, bootSector);
+    }
+    if(exception == EXCEPTION_NONE && paramLabel != NULL && createTree.nodes[0].numberOfSlots + 1 > CREATE_ROOT_ENTRIES) {
+        exception = EXCEPTION_DIRECTORY_FULL;
+    }
+    if(exception != EXCEPTION_NONE) {
+        free(bootSector);
+        freeCreateTree(&createTree);
+        return exception;
+    }
+
+    // The volume is only used for its layout, it has no buffer and is never read
+    Volume *volume = createVolume(paramImageLocation, NULL, bootSector, NULL);
+    int nextCluster = 2;
+    allocateCreateDirectory(&createTree, 0, volume->bytesPerCluster, &nextCluster);
+
+    long fatLength = (long) volume->sectorsPerFat * CREATE_BYTES_PER_SECTOR;
+    uint16_t *fat = (uint16_t *) calloc(fatLength / sizeof(uint16_t), sizeof(uint16_t));
+    fat[0] = 0xFF00 | bootSector->BPB_Media;
+    fat[1] = 0xFFFF;
+    for(int index = 1; index < createTree.numberOfNodes; index++) {
+        CreateNode *createNode = createTree.nodes + index;
+        for(int cluster = createNode->firstCluster; cluster < createNode->firstCluster + createNode->numberOfClusters; cluster++) {
+            fat[cluster] = cluster + 1 == createNode->firstCluster + createNode->numberOfClusters ? 0xFFFF : (uint16_t) (cluster + 1);
+        }
+    }
+
+    ImageWriter imageWriter;
+    memset(&imageWriter, 0, sizeof(ImageWriter));
+    imageWriter.fileDescriptor = open(paramImageLocation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    imageWriter.bytes = (unsigned char *) malloc(CREATE_WRITE_SIZE);
+
+    long imageSize = (long) getTotalSectors(bootSector) * CREATE_BYTES_PER_SECTOR;
+    if(imageWriter.fileDescriptor < 0 || ftruncate(imageWriter.fileDescriptor, imageSize) != 0) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+
+    if(exception == EXCEPTION_NONE) {
+        unsigned char bootSectorBytes[CREATE_BYTES_PER_SECTOR];
+        memset(bootSectorBytes, 0, sizeof(bootSectorBytes));
+        memcpy(bootSectorBytes, bootSector, sizeof(BootSector));
+        bootSectorBytes[510] = 0x55;
+        bootSectorBytes[511] = 0xAA;
+        writeImageBytes(&imageWriter, 0, bootSectorBytes, sizeof(bootSectorBytes));
+
+        for(int fatIndex = 0; fatIndex < CREATE_NUMBER_OF_FATS; fatIndex++) {
+            writeImageBytes(&imageWriter, ((long) volume->sectorFatStart + (long) fatIndex * volume->sectorsPerFat) * CREATE_BYTES_PER_SECTOR,
+                            (const unsigned char *) fat, fatLength);
+        }
+
+        exception = writeCreateDirectory(&imageWriter, volume, &createTree, 0, -1);
+        flushImageWriter(&imageWriter);
+    }
+
+    if(exception == EXCEPTION_NONE && (imageWriter.is_failed || fsync(imageWriter.fileDescriptor) != 0)) {
+        exception = EXCEPTION_UNABLE_TO_WRITE_FILE;
+    }
+
+    if(exception == EXCEPTION_NONE) {
+        printOutput("Created %s: %d files and %d directories, %d skipped\n", paramImageLocation, createTree.numberOfFiles,
+                    createTree.numberOfDirectories - 1, createTree.numberOfSkipped);
+        printOutput("Volume: %ld bytes, %d byte clusters, %d of %d clusters used\n", imageSize, volume->bytesPerCluster,
+                    nextCluster - 2, volume->numberOfClusters);
+        printOutput("Wrote %ld bytes in %ld writes\n", imageWriter.bytesWritten, imageWriter.numberOfWrites);
+    }
+
+    if(imageWriter.fileDescriptor >= 0) {
+        close(imageWriter.fileDescriptor);
+    }
+    free(imageWriter.bytes);
+    free(fat);
+    freeVolume(volume);
+    freeCreateTree(&createTree);
+    return exception;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                            Long Listing                                          |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The long listing prints the entries of a directory one line each with their attributes, size, a timestamp and
+ * name, sorted by name, size, creation time or write time. With --recursive every directory below it is listed
+ * after it the way ls -lR does, each in the order of the listing above it. The ls command without -l prints only the
+ * names of one directory, in the order of their slots as each is read.
+ *
+ * Entries are sorted by integer keys rather than by comparing them. The keys are put in order by a least significant
+ * digit radix sort a byte per pass, skipping the bytes every key shares, so sorting a directory costs a few linear
+ * passes over its keys. FAT dates and times hold the year, month and day then the hours, minutes and seconds from the
+ * high bit down, so the raw date and time words joined together already sort as a timestamp and nothing is decoded
+ * until a line is printed. Names are keyed four UCS-2 characters at a time, or eight when no name in the directory
+ * has a character above 0xFF, and only the runs of entries that share those characters are sorted again on the ones
+ * after them, short runs by insertion. The radix sort is stable, so sorting by name first leaves entries with the
+ * same size or time in name order.
+ */
+
+#define LIST_SORT_NAME 0
+#define LIST_SORT_SIZE 1
+#define LIST_SORT_CREATED 2
+#define LIST_SORT_WRITTEN 3
+
+#define RADIX_DIGIT_BITS 8
+#define RADIX_NUMBER_OF_DIGITS (64 / RADIX_DIGIT_BITS)
+#define RADIX_NUMBER_OF_BUCKETS (1 << RADIX_DIGIT_BITS)
+
+#define LIST_INSERTION_SORT_ENTRIES 32          // Runs of names this short are sorted by insertion instead
+#define LIST_CACHE_BYTES (16L * 1024 * 1024)    // Block cache budget of a listing, which reads directories and not files
+
+/**
+ * A listing entry is the short entry of a file or directory along with where its name is held
+ */
+struct ListingEntry {
+    Entry entry;
+    long nameOffset;                            // Start of the name within the names of the listing
+    int nameLength;
+}; typedef struct ListingEntry ListingEntry;
+
+/**
+ * A listing holds the entries of one directory and the order they are printed in
+ */
+struct Listing {
+    ListingEntry *entries;
+    int numberOfEntries;
+    int entriesCapacity;
+
+    wchar_t *names;                             // The names of every entry one after the other
+    long namesLength;
+    long namesCapacity;
+    uint8_t is_wide_names;                      // A name has a character above 0xFF
+
+    uint32_t *order;                            // Index of each entry in sorted order, set by sortListing
+}; typedef struct Listing Listing;
+
+/**
+ * Sorts keys along with a value carried by each key using a least significant digit radix sort. The sort is stable,
+ * and only the digits that differ between keys are given a pass, so 32 bit keys take at most four passes.
+ * @param paramKeys          - The keys, sorted in place
+ * @param paramValues        - The value of each key, moved along with it
+ * @param paramNumberOfKeys  - The number of keys
+ * @param paramScratchKeys   - Room for paramNumberOfKeys keys
+ * @param paramScratchValues - Room for paramNumberOfKeys values
+ */
+void radixSortKeys(uint64_t *paramKeys, uint32_t *paramValues, int paramNumberOfKeys, uint64_t *paramScratchKeys, uint32_t *paramScratchValues) {
+
+    if(paramNumberOfKeys < 2) {
+        return;
+    }
+
+    uint64_t changedBits = 0;                                                // Bits that are not the same in every key
+    for(int index = 1; index < paramNumberOfKeys; index++) {
+        changedBits |= paramKeys[index] ^ paramKeys[0];
+    }
+
+    int digits[RADIX_NUMBER_OF_DIGITS];
+    int numberOfDigits = 0;
+    for(int digit = 0; digit < RADIX_NUMBER_OF_DIGITS; digit++) {
+        if((changedBits >> (digit * RADIX_DIGIT_BITS)) & (RADIX_NUMBER_OF_BUCKETS - 1)) {
+            digits[numberOfDigits++] = digit;
+        }
+    }
+    if(numberOfDigits == 0) {
+        return;
+    }
+
+    int counts[RADIX_NUMBER_OF_DIGITS][RADIX_NUMBER_OF_BUCKETS];
+    memset(counts, 0, sizeof(int) * RADIX_NUMBER_OF_BUCKETS * numberOfDigits);
+
+    for(int index = 0; index < paramNumberOfKeys; index++) {                 // Every histogram in one read of the keys
+        uint64_t key = paramKeys[index];
+        for(int digitIndex = 0; digitIndex < numberOfDigits; digitIndex++) {
+            counts[digitIndex][(key >> (digits[digitIndex] * RADIX_DIGIT_BITS)) & (RADIX_NUMBER_OF_BUCKETS - 1)]++;
+        }
+    }
+
+    uint64_t *keys = paramKeys;
+    uint32_t *values = paramValues;
+    uint64_t *sortedKeys = paramScratchKeys;
+    uint32_t *sortedValues = paramScratchValues;
+
+    for(int digitIndex = 0; digitIndex < numberOfDigits; digitIndex++) {
+
+        int shift = digits[digitIndex] * RADIX_DIGIT_BITS;
+
+        int offsets[RADIX_NUMBER_OF_BUCKETS];
+        int offset = 0;
+        for(int bucket = 0; bucket < RADIX_NUMBER_OF_BUCKETS; bucket++) {
+            offsets[bucket] = offset;
+            offset += counts[digitIndex][bucket];
+        }
+
+        for(int index = 0; index < paramNumberOfKeys; index++) {
+            int position = offsets[(keys[index] >> shift) & (RADIX_NUMBER_OF_BUCKETS - 1)]++;
+            sortedKeys[position] = keys[index];
+            sortedValues[position] = values[index];
+        }
+
+        uint64_t *swapKeys = keys;
+        keys = sortedKeys;
+        sortedKeys = swapKeys;
+        uint32_t *swapValues = values;
+        values = sortedValues;
+        sortedValues = swapValues;
+    }
+
+    if(keys != paramKeys) {
+        memcpy(paramKeys, keys, sizeof(uint64_t) * paramNumberOfKeys);
+        memcpy(paramValues, values, sizeof(uint32_t) * paramNumberOfKeys);
+    }
+}
+
+/**
+ * Adds an entry and its name to a listing
+ * @param paramListing    - The listing
+ * @param paramEntry      - The short entry
+ * @param paramName       - The name of the entry
+ * @param paramNameLength - The length of the name
+ */
+void addListingEntry(Listing *paramListing, Entry *paramEntry, wchar_t *paramName, int paramNameLength) {
+
+    if(paramListing->numberOfEntries == paramListing->entriesCapacity) {
+        paramListing->entriesCapacity = paramListing->entriesCapacity == 0 ? 64 : paramListing->entriesCapacity * 2;
+        paramListing->entries = (ListingEntry *) realloc(paramListing->entries, sizeof(ListingEntry) * paramListing->entriesCapacity);
+    }
+    if(paramListing->namesLength + paramNameLength > paramListing->namesCapacity) {
+        paramListing->namesCapacity = (paramListing->namesLength + paramNameLength) * 2;
+        paramListing->names = (wchar_t *) realloc(paramListing->names, sizeof(wchar_t) * paramListing->namesCapacity);
+    }
+
+    ListingEntry *listingEntry = paramListing->entries + paramListing->numberOfEntries++;
+    memcpy(&listingEntry->entry, paramEntry, sizeof(Entry));
+    listingEntry->nameOffset = paramListing->namesLength;
+    listingEntry->nameLength = paramNameLength;
+
+    memcpy(paramListing->names + paramListing->namesLength, paramName, sizeof(wchar_t) * paramNameLength);
+    paramListing->namesLength += paramNameLength;
+
+    for(int index = 0; index < paramNameLength && !paramListing->is_wide_names; index++) {
+        paramListing->is_wide_names = (uint32_t) paramName[index] > 0xFF;
+    }
+}
+
+/**
+ * Adds every entry other than the volume name to the listing passed as the context
+ */
+uint8_t visitEntryForListing(Volume *paramVolume, Entry *paramEntry, wchar_t *paramName, int paramNameLength, void *paramContext) {
+    (void) paramVolume;
+    if((paramEntry->DIR_Attr & 0x18) != 0x08) {
+        addListingEntry((Listing *) paramContext, paramEntry, paramName, paramNameLength);
+    }
+    return 0;
+}
+
+/**
+ * Reads the entries of a directory into a listing, leaving out the volume name
+ * @param paramVolume       - The volume of the directory
+ * @param paramFirstCluster - The first cluster of the directory, 0 for the root directory
+ * @param paramListing      - The listing the entries are added to
+ */
+void readListing(Volume *paramVolume, int paramFirstCluster, Listing *paramListing) {
+    streamDirectory(paramVolume, paramFirstCluster, visitEntryForListing, paramListing);
+}
+
+/**
+ * Gets the number of characters of a name packed into each key of a listing
+ */
+int getListingKeyCharacters(Listing *paramListing) {
+    return paramListing->is_wide_names ? 4 : 8;
+}
+
+/**
+ * Packs the next characters of a name into a key, 16 or 8 bits each, characters past the end of the name being 0 so
+ * a name sorts before every longer name it is the start of
+ */
+uint64_t getListingNameKey(Listing *paramListing, ListingEntry *paramListingEntry, int paramCharacterStart) {
+
+    wchar_t *name = paramListing->names + paramListingEntry->nameOffset;
+    int keyCharacters = getListingKeyCharacters(paramListing);
+    int characterBits = 64 / keyCharacters;
+    uint64_t key = 0;
+
+    for(int index = paramCharacterStart; index < paramCharacterStart + keyCharacters; index++) {
+        key = (key << characterBits) | (index < paramListingEntry->nameLength ? (uint16_t) name[index] : 0);
+    }
+    return key;
+}
+
+/**
+ * Sorts part of the order of a listing by name, sorting each run of names that share the characters of the key
+ * again on the characters after them
+ * @param paramListing         - The listing
+ * @param paramOrder           - The part of the order being sorted
+ * @param paramNumberOfEntries - The number of entries in the part
+ * @param paramCharacterStart  - The first character of the names put in the keys
+ * @param paramKeys            - Room for the keys of the part
+ * @param paramScratchKeys     - Room for the keys of the part
+ * @param paramScratchOrder    - Room for the order of the part
+ */
+void sortListingNames(Listing *paramListing, uint32_t *paramOrder, int paramNumberOfEntries, int paramCharacterStart,
+                      uint64_t *paramKeys, uint64_t *paramScratchKeys, uint32_t *paramScratchOrder) {
+
+    if(paramNumberOfEntries <= LIST_INSERTION_SORT_ENTRIES) {                      // Cheaper than the histograms of a pass
+        for(int index = 1; index < paramNumberOfEntries; index++) {
+            uint32_t entryIndex = paramOrder[index];
+            ListingEntry *listingEntry = paramListing->entries + entryIndex;
+            int position = index;
+            while(position > 0) {
+                ListingEntry *other = paramListing->entries + paramOrder[position - 1];
+                if(compareWideStrings(paramListing->names + other->nameOffset + paramCharacterStart, other->nameLength - paramCharacterStart,
+                                      paramListing->names + listingEntry->nameOffset + paramCharacterStart, listingEntry->nameLength - paramCharacterStart) <= 0) {
+                    break;
+                }
+                paramOrder[position] = paramOrder[position - 1];
+                position--;
+            }
+            paramOrder[position] = entryIndex;
+        }
+        return;
+    }
+
+    for(int index = 0; index < paramNumberOfEntries; index++) {
+        paramKeys[index] = getListingNameKey(paramListing, paramListing->entries + paramOrder[index], paramCharacterStart);
+    }
+    radixSortKeys(paramKeys, paramOrder, paramNumberOfEntries, paramScratchKeys, paramScratchOrder);
+
+    int keyCharacters = getListingKeyCharacters(paramListing);
+    uint64_t lastCharacterMask = (1ULL << (64 / keyCharacters)) - 1;
+
+    int runStart = 0;
+    for(int index = 1; index <= paramNumberOfEntries; index++) {
+        if(index < paramNumberOfEntries && paramKeys[index] == paramKeys[runStart]) {
+            continue;
+        }
+        if(index - runStart > 1 && (paramKeys[runStart] & lastCharacterMask) != 0) {  // The names may go on past the key
+            sortListingNames(paramListing, paramOrder + runStart, index - runStart, paramCharacterStart + keyCharacters,
+                             paramKeys + runStart, paramScratchKeys + runStart, paramScratchOrder + runStart);
+        }
+        runStart = index;
+    }
+}
+
+/**
+ * Gets the key an entry is sorted by, inverted for sizes and times so the largest and newest come first
+ * @param paramEntry - The short entry
+ * @param paramSort  - LIST_SORT_SIZE, LIST_SORT_CREATED or LIST_SORT_WRITTEN
+ * @return           - The key
+ */
+uint64_t getListingKey(Entry *paramEntry, int paramSort) {
+    switch(paramSort) {
+        case LIST_SORT_SIZE:
+            return (uint32_t) ~paramEntry->DIR_FileSize;
+        case LIST_SORT_CREATED:
+            return ((((uint64_t) paramEntry->DIR_CrtDate << 16 | paramEntry->DIR_CrtTime) << 8) | paramEntry->DIR_CrtTimeTenth) ^ 0xFFFFFFFFFFULL;
+        default:
+            return (uint32_t) ~((uint32_t) paramEntry->DIR_WrtDate << 16 | paramEntry->DIR_WrtTime);
+    }
+}
+
+/**
+ * Sets the order of a listing, sorting it by name and then by the key of paramSort
+ * @param paramListing - The listing
+ * @param paramSort    - One of the LIST_SORT values
+ */
+void sortListing(Listing *paramListing, int paramSort) {
+
+    int numberOfEntries = paramListing->numberOfEntries;
+
+    paramListing->order = (uint32_t *) malloc(sizeof(uint32_t) * (numberOfEntries + 1));
+    for(int index = 0; index < numberOfEntries; index++) {
+        paramListing->order[index] = (uint32_t) index;
+    }
+
+    uint64_t *keys = (uint64_t *) malloc(sizeof(uint64_t) * (numberOfEntries + 1) * 2);
+    uint64_t *scratchKeys = keys + numberOfEntries + 1;
+    uint32_t *scratchOrder = (uint32_t *) malloc(sizeof(uint32_t) * (numberOfEntries + 1));
+
+    sortListingNames(paramListing, paramListing->order, numberOfEntries, 0, keys, scratchKeys, scratchOrder);
+
+    if(paramSort != LIST_SORT_NAME) {
+        for(int index = 0; index < numberOfEntries; index++) {
+            keys[index] = getListingKey(&paramListing->entries[paramListing->order[index]].entry, paramSort);
+        }
+        radixSortKeys(keys, paramListing->order, numberOfEntries, scratchKeys, scratchOrder);
+    }
+
+    free(scratchOrder);
+    free(keys);
+}
+
+/**
+ * Frees what a listing holds
+ * @param paramListing - The listing
+ */
+void freeListing(Listing *paramListing) {
+    free(paramListing->entries);
+    free(paramListing->names);
+    free(paramListing->order);
+}
+
+/**
+ * Prints one line of a long listing: attributes, size, the creation time when sorting by it or otherwise the write
+ * time, and the name, with a '/' after directories
+ * @param paramListing      - The listing
+ * @param paramListingEntry - The entry being printed
+ * @param paramSort         - One of the LIST_SORT values
+ */
+void printListingEntry(Listing *paramListing, ListingEntry *paramListingEntry, int paramSort) {
+
+    Entry *entry = &paramListingEntry->entry;
+
+    char attributes[6] = "-----";
+    if(entry->DIR_Attr & 0x10) attributes[0] = 'd';
+    if(entry->DIR_Attr & 0x01) attributes[1] = 'r';
+    if(entry->DIR_Attr & 0x02) attributes[2] = 'h';
+    if(entry->DIR_Attr & 0x04) attributes[3] = 's';
+    if(entry->DIR_Attr & 0x20) attributes[4] = 'a';
+
+    uint16_t date = paramSort == LIST_SORT_CREATED ? entry->DIR_CrtDate : entry->DIR_WrtDate;
+    uint16_t time = paramSort == LIST_SORT_CREATED ? entry->DIR_CrtTime : entry->DIR_WrtTime;
+
+    printOutput("%s %10u %04d-%02d-%02d %02d:%02d:%02d ", attributes, entry->DIR_FileSize, 1980 + (date >> 9), (date >> 5) & 0x0F,
+                date & 0x1F, time >> 11, (time >> 5) & 0x3F, (time & 0x1F) * 2);
+    printPath(paramListing->names + paramListingEntry->nameOffset, paramListingEntry->nameLength);
+    printOutput((entry->DIR_Attr & 0x10) ? "/\n" : "\n");
+}
+
+/**
+ * Prints the long listing of a directory, then of each directory below it in the same order when recursive
+ * @param paramVolume       - The volume of the directory
+ * @param paramFirstCluster - The first cluster of the directory, 0 for the root directory
+ * @param paramPath         - The path of the directory, starting with '/' unless it is the root directory
+ * @param paramPathLength   - The length of the path
+ * @param paramSort         - One of the LIST_SORT values
+ * @param paramIsReverse    - Print the entries in the reverse of the sorted order
+ * @param paramIsRecursive  - List every directory below this one as well
+ * @param paramDepth        - Depth of the directory below the one first listed
+ */
+void printDirectoryListing(Volume *paramVolume, int paramFirstCluster, wchar_t *paramPath, int paramPathLength, int paramSort,
+                           uint8_t paramIsReverse, uint8_t paramIsRecursive, int paramDepth) {
+
+    Listing listing;
+    memset(&listing, 0, sizeof(Listing));
+
+    readListing(paramVolume, paramFirstCluster, &listing);
+    sortListing(&listing, paramSort);
+
+    if(paramIsRecursive) {
+        if(paramDepth > 0) {
+            printOutput("\n");
+        }
+        if(paramPathLength == 0) {
+            printOutput("/");
+        }
+        printPath(paramPath, paramPathLength);
+        printOutput(":\n");
+    }
+
+    for(int index = 0; index < listing.numberOfEntries; index++) {
+        uint32_t entryIndex = listing.order[paramIsReverse ? listing.numberOfEntries - 1 - index : index];
+        printListingEntry(&listing, listing.entries + entryIndex, paramSort);
+    }
+
+    if(paramIsRecursive) {                                                  // The sub directories in the order they are listed
+        int *clusters = (int *) malloc(sizeof(int) * (listing.numberOfEntries + 1));
+        int numberOfClusters = 0;
+        for(int index = 0; index < listing.numberOfEntries; index++) {
+            ListingEntry *listingEntry = listing.entries + listing.order[paramIsReverse ? listing.numberOfEntries - 1 - index : index];
+            int firstCluster = getFirstClusterOfEntry(&listingEntry->entry);
+            if((listingEntry->entry.DIR_Attr & 0x10) && isValidCluster(paramVolume, firstCluster)) {
+                clusters[numberOfClusters++] = firstCluster;
+            }
+        }
+        prefetchClusters(paramVolume, clusters, numberOfClusters);
+        free(clusters);
+    }
+
+    for(int index = 0; paramIsRecursive && index < listing.numberOfEntries; index++) {
+
+        ListingEntry *listingEntry = listing.entries + listing.order[paramIsReverse ? listing.numberOfEntries - 1 - index : index];
+        int firstCluster = getFirstClusterOfEntry(&listingEntry->entry);
+        if(!(listingEntry->entry.DIR_Attr & 0x10) || !isValidCluster(paramVolume, firstCluster) || paramDepth >= MAX_DIRECTORY_DEPTH) {
+            continue;
+        }
+
+        wchar_t *path = createChildPath(paramPath, paramPathLength, listing.names + listingEntry->nameOffset, listingEntry->nameLength);
+        printDirectoryListing(paramVolume, firstCluster, path, paramPathLength + 1 + listingEntry->nameLength, paramSort, paramIsReverse, paramIsRecursive, paramDepth + 1);
+        free(path);
+    }
+
+    freeListing(&listing);
+}
+
+/**
+ * Creates a path from program arguments with a single '/' before each name, so the root directory is empty
+ * @param paramString     - The path as UTF-8, names separated by one or more '/'
+ * @param paramPathLength - Set to the length of the path
+ * @return                - The path
+ */
+wchar_t *createListingPath(char *paramString, int *paramPathLength) {
+
+    int stringLength;
+    wchar_t *string = createWideString(paramString, &stringLength);
+
+    int pathLength = 0;
+    wchar_t *path = (wchar_t *) malloc(sizeof(wchar_t) * (stringLength + 1));
+    for(int index = 0; index < stringLength; index++) {
+        if(string[index] == '/') {
+            continue;
+        }
+        if(index == 0 || string[index - 1] == '/') {
+            path[pathLength++] = '/';
+        }
+        path[pathLength++] = string[index];
+    }
+    free(string);
+
+    *paramPathLength = pathLength;
+    return path;
+}
+
+/**
+ * Prints the long listing of a directory of a volume, or the one line of a file
+ * @param paramVolume      - The volume
+ * @param paramDirectory   - The path of the directory, "/" being the root directory
+ * @param paramSort        - One of the LIST_SORT values
+ * @param paramIsReverse   - Print the entries in the reverse of the sorted order
+ * @param paramIsRecursive - List every directory below it as well
+ * @return                 - EXCEPTION_NONE or EXCEPTION_FILE_DOES_NOT_EXIST
+ */
+int printListing(Volume *paramVolume, char *paramDirectory, int paramSort, uint8_t paramIsReverse, uint8_t paramIsRecursive) {
+
+    int pathLength;
+    wchar_t *path = createListingPath(paramDirectory, &pathLength);
+
+    Entry entry;
+    int exception = findPathEntry(paramVolume, path, pathLength, &entry);
+    int firstCluster = getFirstClusterOfEntry(&entry);
+
+    if(exception == EXCEPTION_NONE && (entry.DIR_Attr & 0x10) && (firstCluster == 0 || isValidCluster(paramVolume, firstCluster))) {
+        printDirectoryListing(paramVolume, firstCluster, path, pathLength, paramSort, paramIsReverse, paramIsRecursive, 0);
+
+    } else if(exception == EXCEPTION_NONE && !(entry.DIR_Attr & 0x10)) {
+        int nameStart = pathLength;
+        while(path[nameStart - 1] != '/') {
+            nameStart--;
+        }
+        Listing listing;
+        memset(&listing, 0, sizeof(Listing));
+        addListingEntry(&listing, &entry, path + nameStart, pathLength - nameStart);
+        printListingEntry(&listing, listing.entries, paramSort);
+        freeListing(&listing);
+
+    } else {
+        exception = EXCEPTION_FILE_DOES_NOT_EXIST;
+    }
+
+    free(path);
+    return exception;
+}
+
+/**
+ * Prints the name of every entry other than the volume name as the scan of a directory reaches it
+ */
+uint8_t visitEntryForNames(Volume *paramVolume, Entry *paramEntry, wchar_t *paramName, int paramNameLength, void *paramContext) {
+    (void) paramVolume;
+    (void) paramContext;
+    if((paramEntry->DIR_Attr & 0x18) != 0x08) {
+        printPath(paramName, paramNameLength);
+        printOutput((paramEntry->DIR_Attr & 0x10) ? "/\n" : "\n");
+    }
+    return 0;
+}
+
+/**
+ * Prints the names in a directory in the order of their slots, '/' following those of directories, or the name of a
+ * file. Only the directories on the path are read, and the directory listed is not walked into.
+ * @param paramVolume - The volume
+ * @param paramPath   - The path of the directory or file, "/" being the root directory
+ * @return            - EXCEPTION_NONE or EXCEPTION_FILE_DOES_NOT_EXIST
+ */
+int printDirectoryNames(Volume *paramVolume, char *paramPath) {
+
+    int pathLength;
+    wchar_t *path = createListingPath(paramPath, &pathLength);
+
+    Entry entry;
+    int exception = findPathEntry(paramVolume, path, pathLength, &entry);
+    int firstCluster = getFirstClusterOfEntry(&entry);
+
+    if(exception == EXCEPTION_NONE && (entry.DIR_Attr & 0x10) && (firstCluster == 0 || isValidCluster(paramVolume, firstCluster))) {
+        streamDirectory(paramVolume, firstCluster, visitEntryForNames, NULL);
+
+    } else if(exception == EXCEPTION_NONE && !(entry.DIR_Attr & 0x10)) {
+        int nameStart = pathLength;
+        while(path[nameStart - 1] != '/') {
+            nameStart--;
+        }
+        visitEntryForNames(paramVolume, &entry, path + nameStart, pathLength - nameStart, NULL);
+
+    } else {
+        exception = EXCEPTION_FILE_DOES_NOT_EXIST;
+    }
+
+    free(path);
+    return exception;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                            Disk Usage                                            |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Disk usage totals, for every directory below a path, the sizes recorded in the entries of its files and the
+ * bytes allocated to them, the directories included. The FAT is decoded once and the length of the chain starting at
+ * every cluster is counted from it in one pass, so a file's allocation is looked up rather than found by following
+ * its chain.
+ *
+ * Each directory is scanned by its own task on the thread pool, which submits a task for each sub directory it finds.
+ * A directory's totals are added into its parent's when the last of its sub directories finishes, so they are summed
+ * bottom up while other directories are still being scanned and the root's totals are complete once the pool is idle.
+ */
+
+#define DISK_USAGE_CACHE_BYTES (16L * 1024 * 1024)  // Block cache budget of disk usage, which reads the FAT and directories
+#define CHAIN_LENGTH_COUNTING UINT32_MAX            // Marks a cluster whose chain is still being followed
+
+/**
+ * A disk usage node is one directory and the totals of everything below it
+ */
+struct DiskUsageNode {
+    struct DiskUsage *diskUsage;
+    struct DiskUsageNode *parent;       // NULL for the directory disk usage started at
+    struct DiskUsageNode *children;     // The sub directories in slot order
+    int numberOfChildren;
+    int childrenCapacity;
+
+    wchar_t *name;                      // The name, or the whole path of the directory disk usage started at
+    int nameLength;
+    int firstCluster;
+    int depth;                          // Directories below the one disk usage started at, which is 0
+
+    long long logicalBytes;             // DIR_FileSize of every file below the directory
+    long long allocatedClusters;        // Clusters of every file and directory below it, its own included
+    int unfinished;                     // Sub directories not yet added in, plus 1 until its own scan has finished
+    int order;                          // Position in the printed order, ties in the largest directories go by it
+
+}; typedef struct DiskUsageNode DiskUsageNode;
+
+/**
+ * Disk usage holds what every task shares
+ */
+struct DiskUsage {
+    Volume *volume;
+    ThreadPool *threadPool;
+    uint32_t *chainLengths;             // Clusters in the chain starting at each cluster
+
+}; typedef struct DiskUsage DiskUsage;
+
+/**
+ * Counts the clusters in the chain starting at every cluster. Each cluster is followed once, the chains that join
+ * another part way along reuse its count and a chain that loops ends where it meets itself.
+ * @param paramVolume     - The volume the FAT belongs to
+ * @param paramFatEntries - The decoded FAT
+ * @return                - The length of the chain starting at each cluster, indexed by cluster number
+ */
+uint32_t *countChainLengths(Volume *paramVolume, const uint32_t *paramFatEntries) {
+
+    int lastCluster = paramVolume->numberOfClusters + 2;
+    uint32_t *chainLengths = (uint32_t *) calloc(lastCluster, sizeof(uint32_t));
+    int *chain = (int *) malloc(sizeof(int) * paramVolume->numberOfClusters);
+
+    for(int cluster = 2; cluster < lastCluster; cluster++) {
+
+        int numberOfClusters = 0;
+        int currentCluster = cluster;
+        while(isValidCluster(paramVolume, currentCluster) && chainLengths[currentCluster] == 0) {
+            chainLengths[currentCluster] = CHAIN_LENGTH_COUNTING;
+            chain[numberOfClusters++] = currentCluster;
+            currentCluster = (int) paramFatEntries[currentCluster];
+        }
+
+        uint32_t chainLength = 0;
+        if(isValidCluster(paramVolume, currentCluster) && chainLengths[currentCluster] != CHAIN_LENGTH_COUNTING) {
+            chainLength = chainLengths[currentCluster];
+        }
+        while(numberOfClusters > 0) {
+            chainLengths[chain[--numberOfClusters]] = ++chainLength;
+        }
+    }
+
+    free(chain);
+    return chainLengths;
+}
+
+/**
+ * Adds an entry to the totals of the directory being scanned, or a sub directory to its children
+ */
+uint8_t visitEntryForDiskUsage(Volume *paramVolume, Entry *paramEntry, wchar_t *paramName, int paramNameLength, void *paramContext) {
+
+    DiskUsageNode *diskUsageNode = (DiskUsageNode *) paramContext;
+    if((paramEntry->DIR_Attr & 0x18) == 0x08) {
+        return 0;
+    }
+
+    int firstCluster = getFirstClusterOfEntry(paramEntry);
+    uint32_t numberOfClusters = isValidCluster(paramVolume, firstCluster) ? diskUsageNode->diskUsage->chainLengths[firstCluster] : 0;
+
+    if(!(paramEntry->DIR_Attr & 0x10)) {
+        diskUsageNode->logicalBytes += paramEntry->DIR_FileSize;
+        diskUsageNode->allocatedClusters += numberOfClusters;
+        return 0;
+    }
+    if(numberOfClusters == 0 || diskUsageNode->depth >= MAX_DIRECTORY_DEPTH) {
+        diskUsageNode->allocatedClusters += numberOfClusters;
+        return 0;
+    }
+
+    if(diskUsageNode->numberOfChildren == diskUsageNode->childrenCapacity) {
+        diskUsageNode->childrenCapacity = diskUsageNode->childrenCapacity == 0 ? 8 : diskUsageNode->childrenCapacity * 2;
+        diskUsageNode->children = (DiskUsageNode *) realloc(diskUsageNode->children, sizeof(DiskUsageNode) * diskUsageNode->childrenCapacity);
+    }
+
+    DiskUsageNode *child = diskUsageNode->children + diskUsageNode->numberOfChildren++;
+    memset(child, 0, sizeof(DiskUsageNode));
+    child->diskUsage = diskUsageNode->diskUsage;
+    child->parent = diskUsageNode;
+    child->name = (wchar_t *) malloc(sizeof(wchar_t) * paramNameLength);
+    memcpy(child->name, paramName, sizeof(wchar_t) * paramNameLength);
+    child->nameLength = paramNameLength;
+    child->firstCluster = firstCluster;
+    child->depth = diskUsageNode->depth + 1;
+    child->allocatedClusters = numberOfClusters;
+
+    return 0;
+}
+
+/**
+ * Marks one part of a directory as finished. The last part to finish adds the directory's totals into its parent,
+ * then finishes that part of the parent in turn.
+ * @param paramDiskUsageNode - The directory
+ */
+void finishDiskUsageNode(DiskUsageNode *paramDiskUsageNode) {
+
+    DiskUsageNode *diskUsageNode = paramDiskUsageNode;
+    while(diskUsageNode != NULL && __atomic_sub_fetch(&diskUsageNode->unfinished, 1, __ATOMIC_ACQ_REL) == 0) {
+
+        DiskUsageNode *parent = diskUsageNode->parent;
+        if(parent != NULL) {
+            __atomic_add_fetch(&parent->logicalBytes, diskUsageNode->logicalBytes, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&parent->allocatedClusters, diskUsageNode->allocatedClusters, __ATOMIC_RELAXED);
+        }
+        diskUsageNode = parent;
+    }
+}
+
+/**
+ * Scans one directory then submits a task for each of its sub directories
+ * @param paramDiskUsageNode - The directory
  */
+void runDiskUsageTask(void *paramDiskUsageNode) {
+
+    DiskUsageNode *diskUsageNode = (DiskUsageNode *) paramDiskUsageNode;
+    DiskUsage *diskUsage = diskUsageNode->diskUsage;
+
+    streamDirectory(diskUsage->volume, diskUsageNode->firstCluster, visitEntryForDiskUsage, diskUsageNode);
+
+    // The children are only submitted once the scan has stopped moving them
+    diskUsageNode->unfinished = diskUsageNode->numberOfChildren + 1;
+    for(int index = 0; index < diskUsageNode->numberOfChildren; index++) {
+        submitTaskToThreadPool(diskUsage->threadPool, runDiskUsageTask, diskUsageNode->children + index);
+    }
+
+    finishDiskUsageNode(diskUsageNode);
+}
+
+/**
+ * Frees the sub directories of a directory and their names
+ * @param paramDiskUsageNode - The directory
+ */
+void freeDiskUsageNode(DiskUsageNode *paramDiskUsageNode) {
+    for(int index = 0; index < paramDiskUsageNode->numberOfChildren; index++) {
+        freeDiskUsageNode(paramDiskUsageNode->children + index);
+    }
+    free(paramDiskUsageNode->children);
+    free(paramDiskUsageNode->name);
+}
+
+/**
+ * Collects the directories no deeper than a limit, each after the directories below it as du prints them
+ * @param paramDiskUsageNode  - The directory collected from
+ * @param paramMaxDepth       - The deepest directory collected, -1 for every directory
+ * @param paramNodes          - Filled with the directories
+ * @param paramNumberOfNodes  - The number of directories collected so far, increased by those collected
+ */
+void collectDiskUsageNodes(DiskUsageNode *paramDiskUsageNode, int paramMaxDepth, DiskUsageNode **paramNodes, int *paramNumberOfNodes) {
+
+    if(paramMaxDepth >= 0 && paramDiskUsageNode->depth > paramMaxDepth) {
+        return;
+    }
+    for(int index = 0; index < paramDiskUsageNode->numberOfChildren; index++) {
+        collectDiskUsageNodes(paramDiskUsageNode->children + index, paramMaxDepth, paramNodes, paramNumberOfNodes);
+    }
+
+    paramDiskUsageNode->order = *paramNumberOfNodes;
+    paramNodes[(*paramNumberOfNodes)++] = paramDiskUsageNode;
+}
+
+/**
+ * Counts a directory and every directory below it
+ */
+int countDiskUsageNodes(DiskUsageNode *paramDiskUsageNode) {
+    int numberOfNodes = 1;
+    for(int index = 0; index < paramDiskUsageNode->numberOfChildren; index++) {
+        numberOfNodes += countDiskUsageNodes(paramDiskUsageNode->children + index);
+    }
+    return numberOfNodes;
+}
+
+/**
+ * Compares two directories so the one with the most allocated clusters comes first, then the most logical bytes,
+ * then the one printed first
+ */
+int compareDiskUsageNodes(const void *paramFirst, const void *paramSecond) {
+
+    const DiskUsageNode *first = *(const DiskUsageNode **) paramFirst;
+    const DiskUsageNode *second = *(const DiskUsageNode **) paramSecond;
+
+    if(first->allocatedClusters != second->allocatedClusters) {
+        return first->allocatedClusters > second->allocatedClusters ? -1 : 1;
+    }
+    if(first->logicalBytes != second->logicalBytes) {
+        return first->logicalBytes > second->logicalBytes ? -1 : 1;
+    }
+    return first->order - second->order;
+}
+
+/**
+ * Prints the totals of a directory then its path, joined from the names of the directories above it
+ * @param paramVolume        - The volume
+ * @param paramDiskUsageNode - The directory
+ */
+void printDiskUsageNode(Volume *paramVolume, DiskUsageNode *paramDiskUsageNode) {
+
+    int pathLength = -1;
+    for(DiskUsageNode *diskUsageNode = paramDiskUsageNode; diskUsageNode != NULL; diskUsageNode = diskUsageNode->parent) {
+        pathLength += diskUsageNode->nameLength + 1;
+    }
+
+    wchar_t *path = (wchar_t *) malloc(sizeof(wchar_t) * (pathLength + 1));
+    int pathStart = pathLength;
+    for(DiskUsageNode *diskUsageNode = paramDiskUsageNode; diskUsageNode != NULL; diskUsageNode = diskUsageNode->parent) {
+        pathStart -= diskUsageNode->nameLength;
+        memcpy(path + pathStart, diskUsageNode->name, sizeof(wchar_t) * diskUsageNode->nameLength);
+        if(diskUsageNode->parent != NULL) {
+            path[--pathStart] = '/';
+        }
+    }
+
+    printOutput("%12lld %12lld  ", paramDiskUsageNode->logicalBytes, paramDiskUsageNode->allocatedClusters * paramVolume->bytesPerCluster);
+    if(pathLength == 0) {
+        printOutput("/");
+    }
+    printPath(path, pathLength);
+    printOutput("\n");
+
+    free(path);
+}
+
+/**
+ * Prints the bytes recorded in the entries of the files below every directory under a path, and the bytes allocated
+ * to them and the directories, each directory after those below it
+ * @param paramVolume          - The volume
+ * @param paramDirectory       - The path of the directory, "/" being the root directory
+ * @param paramMaxDepth        - The deepest directory printed, 0 for only the one given, -1 for every directory
+ * @param paramTop             - Print only this many directories, those allocated the most bytes first, 0 for all
+ * @param paramNumberOfThreads - The number of threads the directories are scanned on
+ * @return                     - EXCEPTION_NONE, EXCEPTION_FILE_DOES_NOT_EXIST or EXCEPTION_UNABLE_TO_CREATE_THREAD
+ */
+int printDiskUsage(Volume *paramVolume, char *paramDirectory, int paramMaxDepth, int paramTop, int paramNumberOfThreads) {
+
+    int pathLength;
+    wchar_t *path = createListingPath(paramDirectory, &pathLength);
+
+    Entry entry;
+    int exception = findPathEntry(paramVolume, path, pathLength, &entry);
+    int firstCluster = getFirstClusterOfEntry(&entry);
+
+    if(exception != EXCEPTION_NONE || !(entry.DIR_Attr & 0x10) || (firstCluster != 0 && !isValidCluster(paramVolume, firstCluster))) {
+        free(path);
+        return EXCEPTION_FILE_DOES_NOT_EXIST;
+    }
+
+    DiskUsage diskUsage;
+    diskUsage.volume = paramVolume;
+    exception = createThreadPool(paramNumberOfThreads, &diskUsage.threadPool);
+    if(exception != EXCEPTION_NONE) {
+        free(path);
+        return exception;
+    }
+
+    uint32_t *fatEntries = decodeFat(paramVolume);
+    diskUsage.chainLengths = countChainLengths(paramVolume, fatEntries);
+    free(fatEntries);
+
+    DiskUsageNode root;
+    memset(&root, 0, sizeof(DiskUsageNode));
+    root.diskUsage = &diskUsage;
+    root.name = path;
+    root.nameLength = pathLength;
+    root.firstCluster = firstCluster;
+    int chainStart = getDirectoryChainStart(paramVolume, firstCluster);
+    root.allocatedClusters = isValidCluster(paramVolume, chainStart) ? diskUsage.chainLengths[chainStart] : 0;
+
+    submitTaskToThreadPool(diskUsage.threadPool, runDiskUsageTask, &root);
+    waitForThreadPool(diskUsage.threadPool);
+    freeThreadPool(diskUsage.threadPool);
+
+    DiskUsageNode **nodes = (DiskUsageNode **) malloc(sizeof(DiskUsageNode *) * countDiskUsageNodes(&root));
+    int numberOfNodes = 0;
+    collectDiskUsageNodes(&root, paramMaxDepth, nodes, &numberOfNodes);
+
+    if(paramTop > 0) {
+        qsort(nodes, numberOfNodes, sizeof(DiskUsageNode *), compareDiskUsageNodes);
+        if(numberOfNodes > paramTop) {
+            numberOfNodes = paramTop;
+        }
+    }
+    for(int index = 0; index < numberOfNodes; index++) {
+        printDiskUsageNode(paramVolume, nodes[index]);
+    }
+
+    free(nodes);
+    freeDiskUsageNode(&root);
+    free(diskUsage.chainLengths);
+
+    return EXCEPTION_NONE;
+}
+
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                         Program Arguments                                        |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * The program arguments are read once at the start of the program and then used to run the selected operation
+ * on every image
+ */
+
+/**
+ * Program Arguments contain the value of the image being looked at and the file being found
+ */
+struct ProgramArguments {
+    char *fat16ImageLocation;
+    int fat16ImageLocationLength;
+
+    wchar_t *fileLocation;
+    int fileLocationLength;
+
+    uint8_t is_tree;
+    uint8_t is_usage;
+    uint8_t is_undelete;
+    uint8_t is_manifest;
+    uint8_t is_diff;
+
+    char *grepPattern;
+    char *diffImageLocation;
+
+    char *addDirectory;
+    char **addHostFiles;
+    int numberOfAddHostFiles;
+
+    uint8_t print_bootsector;
+    uint8_t print_complete_entry;
+
+    int numberOfThreads;
+    long cacheBytes;                // Budget of the block cache, 0 to read each image into memory
+    uint8_t is_defrag;
+    uint8_t is_dry_run;             // Only print the defragmentation plan
+    char *defragCopyLocation;       // Where a copy of the image is defragmented, NULL to defragment it in place
+    char *sparseCopyLocation;       // Where a sparse copy of the image is written
+    uint8_t is_punch_holes;         // Deallocate the free clusters of the image in place
+    uint8_t is_zero_slack;          // Zero file slack and deleted directory slots before leaving holes
+
+    uint8_t is_create;
+    char *createHostDirectory;      // The host directory imported into a new image
+    long createSizeBytes;           // Size of the new image, 0 to fit it to the host directory
+    long createClusterBytes;        // Cluster size of the new image, 0 for the default of its size
+    char *createLabel;
+
+    char *listDirectory;            // The directory given a long listing
+    uint8_t is_list_names;          // Only print the names in the directory, unsorted
+    int listSort;                   // How the listing is sorted, one of the LIST_SORT values
+    uint8_t is_list_reverse;
+    uint8_t is_list_recursive;
+
+    char *diskUsageDirectory;       // The directory whose disk usage is printed
+    int diskUsageMaxDepth;          // The deepest directory printed, -1 for every directory
+    int diskUsageTop;               // How many of the largest directories are printed, 0 to print them all
+
+    char *scanStateLocation;        // The state of the last scan of the image, rewritten after the changes are printed
+
+    uint8_t is_compress;
+    char *compressLocation;         // Where the compressed image is written
+    long chunkBytes;                // Bytes of the image in each compressed chunk, 0 for the default
+
+    int readEngineType;             // READ_ENGINE_NONE to read one block at a time, otherwise the engine asked for
+    int queueDepth;                 // The most reads each read engine keeps in flight
+    uint8_t is_direct;              // Read engines open the image with O_DIRECT
+    int outputFormat;               // How the tree and lookup are printed, one of the OUTPUT_FORMAT values
+
+}; typedef struct ProgramArguments ProgramArguments;
+
+/**
+ * Creates the arguments for the program
+ * @param argc  - The number of total arguments
+ * @param argv  - The arguments beginning at 1
+ * @param paramProgramArguments - Set to the program arguments
+ * @return      - EXCEPTION_NONE, EXCEPTION_PROGRAM_ARGUMENTS or EXCEPTION_EMPTY_PATTERN
+ */
+int createProgramArguments(int argc, char *argv[], ProgramArguments **paramProgramArguments) {
+
+    const char PRINT_TREE[] = "//";
+    const char PRINT_BOOTSECTOR[] = "-bs";
+    const char PRINT_COMPLETE_ENTRY[] = "-e";
+    const char PRINT_USAGE[] = "-u";
+    const char NUMBER_OF_THREADS[] = "-j";
+    const char UNDELETE[] = "--undelete";
+    const char GREP[] = "--grep";
+    const char MANIFEST[] = "--manifest";
+    const char ADD[] = "--add";
+    const char DEFRAG[] = "--defrag";
+    const char DEFRAG_TO[] = "--defrag-to";
+    const char DRY_RUN[] = "--dry-run";
+    const char SPARSE_TO[] = "--sparse-to";
+    const char PUNCH_HOLES[] = "--punch-holes";
+    const char ZERO_SLACK[] = "--zero-slack";
+    const char LONG_LISTING[] = "--long";
+    const char SORT[] = "--sort";
+    const char SORT_NAME[] = "name";
+    const char SORT_SIZE[] = "size";
+    const char SORT_CREATED[] = "created";
+    const char SORT_WRITTEN[] = "written";
+    const char REVERSE[] = "--reverse";
+    const char RECURSIVE[] = "--recursive";
+    const char CACHE_MB[] = "--cache-mb";
+    const char IO[] = "--io";
+    const char IO_PREAD[] = "pread";
+    const char IO_URING[] = "uring";
+    const char QUEUE_DEPTH[] = "--queue-depth";
+    const char DIRECT[] = "--direct";
+    const char FORMAT[] = "--format";
+    const char FORMAT_NDJSON[] = "ndjson";
+    const char FORMAT_CSV[] = "csv";
+
+    const char SIZE_MB[] = "--size-mb";
+    const char CLUSTER_KB[] = "--cluster-kb";
+    const char LABEL[] = "--label";
+    const char CHUNK_KB[] = "--chunk-kb";
+
+    const char DIFF_COMMAND[] = "diff";
+    const char CREATE_COMMAND[] = "create";
+    const char COMPRESS_COMMAND[] = "compress";
+    const char LIST_COMMAND[] = "ls";
+    const char LIST_LONG[] = "-l";
+    const char DISK_USAGE_COMMAND[] = "du";
+    const char MAX_DEPTH[] = "--max-depth";
+    const char TOP[] = "--top";
+    const char SCAN_COMMAND[] = "scan";
+
+    if(argc < 3) {
+        return EXCEPTION_PROGRAM_ARGUMENTS;
+    }
+
+    ProgramArguments *programArguments = (ProgramArguments *) calloc(1, sizeof(ProgramArguments));
+
+    int imageArgIndex = 1;
+
+    if(strcmp(argv[1], DIFF_COMMAND) == 0) {
+        if(argc < 4) {
+            return EXCEPTION_PROGRAM_ARGUMENTS;
+        }
+        programArguments->is_diff = 1;
+        programArguments->diffImageLocation = argv[3];
+        imageArgIndex = 2;
+    } else if(strcmp(argv[1], CREATE_COMMAND) == 0) {
+        if(argc < 4) {
+            return EXCEPTION_PROGRAM_ARGUMENTS;
+        }
+        programArguments->is_create = 1;
+        programArguments->createHostDirectory = argv[3];
+        imageArgIndex = 2;
+    } else if(strcmp(argv[1], COMPRESS_COMMAND) == 0) {
+        if(argc < 4) {
+            return EXCEPTION_PROGRAM_ARGUMENTS;
+        }
+        programArguments->is_compress = 1;
+        programArguments->compressLocation = argv[3];
+        imageArgIndex = 2;
+    } else if(strcmp(argv[1], LIST_COMMAND) == 0) {
+        if(argc < 4) {
+            return EXCEPTION_PROGRAM_ARGUMENTS;
+        }
+        programArguments->listDirectory = argv[3];
+        programArguments->is_list_names = 1;
+        imageArgIndex = 2;
+    } else if(strcmp(argv[1], DISK_USAGE_COMMAND) == 0) {
+        if(argc < 4) {
+            return EXCEPTION_PROGRAM_ARGUMENTS;
+        }
+        programArguments->diskUsageDirectory = argv[3];
+        imageArgIndex = 2;
+    } else if(strcmp(argv[1], SCAN_COMMAND) == 0) {
+        if(argc < 4) {
+            return EXCEPTION_PROGRAM_ARGUMENTS;
+        }
+        programArguments->scanStateLocation = argv[3];
+        imageArgIndex = 2;
+    }
+
+    char *fat16ImageLocation = (char *) malloc(sizeof(char) * (strlen(argv[imageArgIndex]) + 1));
+    memcpy(fat16ImageLocation, argv[imageArgIndex], strlen(argv[imageArgIndex]) + 1);
+
+    programArguments->fat16ImageLocation = fat16ImageLocation;
+    programArguments->fat16ImageLocationLength = strlen(fat16ImageLocation);
+    programArguments->numberOfThreads = getNumberOfProcessors();
+    programArguments->queueDepth = READ_ENGINE_DEFAULT_QUEUE_DEPTH;
+    programArguments->diskUsageMaxDepth = -1;
+
+    for(int otherArgsIndex = imageArgIndex == 2 ? 4 : 2; otherArgsIndex < argc; otherArgsIndex++) {
+        if(strcmp(argv[otherArgsIndex], PRINT_BOOTSECTOR) == 0) {
+            programArguments->print_bootsector = 1;
+
+        } else if(strcmp(argv[otherArgsIndex], PRINT_COMPLETE_ENTRY) == 0) {
+            programArguments->print_complete_entry = 1;
+
+        } else if(strcmp(argv[otherArgsIndex], PRINT_USAGE) == 0) {
+            programArguments->is_usage = 1;
+
+        } else if(strcmp(argv[otherArgsIndex], UNDELETE) == 0) {
+            programArguments->is_undelete = 1;
+
+        } else if(strcmp(argv[otherArgsIndex], MANIFEST) == 0) {
+            programArguments->is_manifest = 1;
+
+        } else if(strcmp(argv[otherArgsIndex], DEFRAG) == 0) {
+            programArguments->is_defrag = 1;
+
+        } else if(strcmp(argv[otherArgsIndex], DEFRAG_TO) == 0) {
+            if(otherArgsIndex + 1 >= argc) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->is_defrag = 1;
+            programArguments->defragCopyLocation = argv[++otherArgsIndex];
 
-/**
- * Gets all the entries from the root directory
- * @param paramBootSector   - The boot sector of the fat image
- * @param paramBuffer       - The buffer for the entire file
- * @return                  - A linked list containing all of the entries in the root directory
- */
-ReturnStack *getAllEntriesFromRootDirectory(BootSector *paramBootSector, Buffer *paramBuffer) {
+        } else if(strcmp(argv[otherArgsIndex], DRY_RUN) == 0) {
+            programArguments->is_dry_run = 1;
 
-    const int SECTOR_ROOT_DIRECTORY_START = paramBootSector->BPB_RsvdSecCnt + (paramBootSector->BPB_FATSz16 * paramBootSector->BPB_NumFATs);
-    unsigned int startingByte = SECTOR_ROOT_DIRECTORY_START; startingByte *= paramBootSector->BPB_BytsPerSec;
+        } else if(strcmp(argv[otherArgsIndex], SPARSE_TO) == 0) {
+            if(otherArgsIndex + 1 >= argc) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->sparseCopyLocation = argv[++otherArgsIndex];
 
-    return getAllEntriesFromDirectory(paramBuffer, startingByte);
+        } else if(strcmp(argv[otherArgsIndex], PUNCH_HOLES) == 0) {
+            programArguments->is_punch_holes = 1;
 
-}
+        } else if(strcmp(argv[otherArgsIndex], ZERO_SLACK) == 0) {
+            programArguments->is_zero_slack = 1;
 
+        } else if(strcmp(argv[otherArgsIndex], LONG_LISTING) == 0) {
+            if(otherArgsIndex + 1 >= argc) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->listDirectory = argv[++otherArgsIndex];
+
+        } else if(strcmp(argv[otherArgsIndex], LIST_LONG) == 0) {
+            programArguments->is_list_names = 0;
+
+        } else if(strcmp(argv[otherArgsIndex], SORT) == 0) {
+            if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], SORT_NAME) == 0) {
+                programArguments->listSort = LIST_SORT_NAME;
+            } else if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], SORT_SIZE) == 0) {
+                programArguments->listSort = LIST_SORT_SIZE;
+            } else if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], SORT_CREATED) == 0) {
+                programArguments->listSort = LIST_SORT_CREATED;
+            } else if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], SORT_WRITTEN) == 0) {
+                programArguments->listSort = LIST_SORT_WRITTEN;
+            } else {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            otherArgsIndex++;
 
-/// +--------------------------------------------------------------------------------------------------+
-/// |                                                                                                  |
-/// |                                              Search                                              |
-/// |                                                                                                  |
-/// +--------------------------------------------------------------------------------------------------+
+        } else if(strcmp(argv[otherArgsIndex], REVERSE) == 0) {
+            programArguments->is_list_reverse = 1;
 
-/*
- * Uses other functions to aid all methods in searching for a file within the FAT16 image
- */
+        } else if(strcmp(argv[otherArgsIndex], RECURSIVE) == 0) {
+            programArguments->is_list_recursive = 1;
 
-/**
- * A search result contains the result which is found in the buffer and the directory entry which it corresponds to
- */
-struct SearchResult {
-    DirectoryEntry *directoryEntryPtr;
-    Buffer *bufferPtr;
-}; typedef struct SearchResult SearchResult;
+        } else if(strcmp(argv[otherArgsIndex], MAX_DEPTH) == 0) {
+            if(otherArgsIndex + 1 >= argc || argv[otherArgsIndex + 1][0] < '0' || argv[otherArgsIndex + 1][0] > '9') {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->diskUsageMaxDepth = atoi(argv[++otherArgsIndex]);
 
-/**
- * Creates a search result struct
- * @param paramDirectoryEntry - The Directory Entry
- * @param paramBuffer         - The buffer containing the file found
- * @return                    - Returns a new search result with these values
- */
-SearchResult *createSearchResult(DirectoryEntry *paramDirectoryEntry, Buffer *paramBuffer) {
+        } else if(strcmp(argv[otherArgsIndex], TOP) == 0) {
+            if(otherArgsIndex + 1 >= argc || atoi(argv[otherArgsIndex + 1]) < 1) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->diskUsageTop = atoi(argv[++otherArgsIndex]);
 
-    SearchResult *searchResult = (SearchResult *) malloc(sizeof(SearchResult));
+        } else if(strcmp(argv[otherArgsIndex], SIZE_MB) == 0) {
+            if(otherArgsIndex + 1 >= argc || atol(argv[otherArgsIndex + 1]) < 1) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->createSizeBytes = atol(argv[++otherArgsIndex]) * 1024 * 1024;
 
-    searchResult->bufferPtr = paramBuffer;
-    searchResult->directoryEntryPtr = paramDirectoryEntry;
+        } else if(strcmp(argv[otherArgsIndex], CLUSTER_KB) == 0) {
+            if(otherArgsIndex + 1 >= argc || atol(argv[otherArgsIndex + 1]) < 1) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->createClusterBytes = atol(argv[++otherArgsIndex]) * 1024;
 
-    return searchResult;
-}
+        } else if(strcmp(argv[otherArgsIndex], LABEL) == 0) {
+            if(otherArgsIndex + 1 >= argc) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->createLabel = argv[++otherArgsIndex];
 
-/**
- * Recursively search through each directory then sub directory until the file is found
- * @param paramBootSector   - Boot Sector of the program
- * @param paramBuffer       - The bytes of the entire file
- * @param paramEntries      - The directory entries being searched through
- * @param paramFileLocation - The location of the file being found
- * @return                  - The return stack containing the search result
- */
-ReturnStack *recursiveSearch(BootSector *paramBootSector, Buffer *paramBuffer, LinkedList *paramEntries, wchar_t *paramFileLocation, int paramFileLocationLength) {
+        } else if(strcmp(argv[otherArgsIndex], CHUNK_KB) == 0) {
+            if(otherArgsIndex + 1 >= argc || atol(argv[otherArgsIndex + 1]) < 1) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->chunkBytes = atol(argv[++otherArgsIndex]) * 1024;
 
-    ReturnStack *returnStack = createReturnStack();
+        } else if(strcmp(argv[otherArgsIndex], GREP) == 0) {
+            if(otherArgsIndex + 1 >= argc) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            if(argv[otherArgsIndex + 1][0] == '\0') {
+                return EXCEPTION_EMPTY_PATTERN;
+            }
+            programArguments->grepPattern = argv[++otherArgsIndex];
 
-    /*
-     * Break down the file path
-     *
-     * searchEnquiry is the entry being searched for
-     * remainingFileLocation is the rest of the file location to be searched for
-     */
-    int searchEnquiryLength = 0;
-    for(; searchEnquiryLength < paramFileLocationLength; searchEnquiryLength++) {
-        if(paramFileLocation[searchEnquiryLength] == '/') {
+        } else if(strcmp(argv[otherArgsIndex], ADD) == 0) {
+            if(otherArgsIndex + 2 >= argc) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->addDirectory = argv[otherArgsIndex + 1];
+            programArguments->addHostFiles = argv + otherArgsIndex + 2;
+            programArguments->numberOfAddHostFiles = argc - otherArgsIndex - 2;
             break;
-        }
-    }
 
-    if(searchEnquiryLength == 0) {
-        addExceptionToReturnStack(returnStack, createException(EXCEPTION_FILE_DOES_NOT_EXIST));
-        return returnStack;
-    }
+        } else if(strcmp(argv[otherArgsIndex], CACHE_MB) == 0) {
+            if(otherArgsIndex + 1 >= argc || atol(argv[otherArgsIndex + 1]) < 1) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->cacheBytes = atol(argv[++otherArgsIndex]) * 1024 * 1024;
 
-    wchar_t searchEnquiry[searchEnquiryLength];
-    memcpy(&searchEnquiry, paramFileLocation, searchEnquiryLength * sizeof(wchar_t));
+        } else if(strcmp(argv[otherArgsIndex], IO) == 0) {
+            if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], IO_PREAD) == 0) {
+                programArguments->readEngineType = READ_ENGINE_PREAD;
+            } else if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], IO_URING) == 0) {
+                programArguments->readEngineType = READ_ENGINE_IO_URING;
+            } else {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            otherArgsIndex++;
 
-    int remainingFileLocationLength = paramFileLocationLength - searchEnquiryLength - 1;
+        } else if(strcmp(argv[otherArgsIndex], QUEUE_DEPTH) == 0) {
+            if(otherArgsIndex + 1 >= argc || atoi(argv[otherArgsIndex + 1]) < 1 || atoi(argv[otherArgsIndex + 1]) > READ_ENGINE_MAXIMUM_QUEUE_DEPTH) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->queueDepth = atoi(argv[++otherArgsIndex]);
 
-    const int SECTOR_DATA_START = paramBootSector->BPB_RsvdSecCnt + (paramBootSector->BPB_NumFATs * paramBootSector->BPB_FATSz16) + (paramBootSector->BPB_RootEntCnt * 32) / paramBootSector->BPB_BytsPerSec;
-    const int BYTES_PER_CLUSTER = paramBootSector->BPB_SecPerClus * paramBootSector->BPB_BytsPerSec;
+        } else if(strcmp(argv[otherArgsIndex], DIRECT) == 0) {
+            programArguments->is_direct = 1;
 
-    LinkedList *entry = paramEntries; // Loading in the first entry null entry at the start of linked list
+        } else if(strcmp(argv[otherArgsIndex], FORMAT) == 0) {
+            if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], FORMAT_NDJSON) == 0) {
+                programArguments->outputFormat = OUTPUT_FORMAT_NDJSON;
+            } else if(otherArgsIndex + 1 < argc && strcmp(argv[otherArgsIndex + 1], FORMAT_CSV) == 0) {
+                programArguments->outputFormat = OUTPUT_FORMAT_CSV;
+            } else {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            otherArgsIndex++;
 
-    while(entry->next != NULL) {
-        entry = entry->next; // loading in the first non-null entry
-        DirectoryEntry *directoryEntry = entry->pointer; // casting the pointer in the entry to a DirectoryEntry
+        } else if(strcmp(argv[otherArgsIndex], NUMBER_OF_THREADS) == 0) {
+            if(otherArgsIndex + 1 >= argc || atoi(argv[otherArgsIndex + 1]) < 1) {
+                return EXCEPTION_PROGRAM_ARGUMENTS;
+            }
+            programArguments->numberOfThreads = atoi(argv[++otherArgsIndex]);
 
-        uint8_t found = 0;
-        if(searchEnquiryLength == directoryEntry->fileNameSize) {
-            if (memcmp(&searchEnquiry, directoryEntry->longFileName, sizeof(wchar_t) * searchEnquiryLength) == 0) {
-                found = 1;
+        } else if(programArguments->fileLocation == NULL) {
+            programArguments->fileLocation = createWideString(argv[otherArgsIndex], &programArguments->fileLocationLength);
+
+            if(strcmp(argv[otherArgsIndex], PRINT_TREE) == 0) {
+                programArguments->is_tree = 1;
             }
         }
+    }
 
-        if(!found) {
-            continue;
-        }
+    if(programArguments->fileLocation == NULL && !programArguments->is_usage && !programArguments->is_undelete && !programArguments->is_diff &&
+       !programArguments->is_manifest && !programArguments->is_defrag && programArguments->grepPattern == NULL && programArguments->addDirectory == NULL &&
+       programArguments->sparseCopyLocation == NULL && !programArguments->is_punch_holes && !programArguments->is_create &&
+       !programArguments->is_compress && programArguments->listDirectory == NULL && programArguments->diskUsageDirectory == NULL &&
+       programArguments->scanStateLocation == NULL) {
+        return EXCEPTION_PROGRAM_ARGUMENTS;
+    }
 
-        if(directoryEntry->entryAttributes->volume_name && remainingFileLocationLength > 0) {
-            if(remainingFileLocationLength > 0) {
-                wchar_t remainingFileLocation[remainingFileLocationLength];
-                memcpy(&remainingFileLocation, paramFileLocation + searchEnquiryLength + 1,
-                       remainingFileLocationLength * sizeof(wchar_t));
+    *paramProgramArguments = programArguments;
+    return EXCEPTION_NONE;
+}
 
-                return recursiveSearch(paramBootSector, paramBuffer, paramEntries, remainingFileLocation, remainingFileLocationLength);
-            }
+/**
+ * Opens an image the way the program arguments need it, for writing when files are being added or it is being
+ * defragmented, through a block cache when there is a memory budget, a read engine, a compressed image or only the
+ * FAT and directories are read for a sparse export, a listing, disk usage or a scan, or the image is larger than
+ * MEMORY_IMAGE_MAXIMUM_SIZE, and otherwise read into memory. Compressed images are read only and never given read
+ * engines, which would read the compressed bytes.
+ * @param paramProgramArguments - The arguments of the program
+ * @param paramImageLocation    - The location of the image
+ * @param paramVolume           - Set to the volume
+ * @return                      - EXCEPTION_NONE, EXCEPTION_UNABLE_TO_OPEN_FILE or EXCEPTION_IMAGE_TOO_LARGE
+ */
+int openVolumeForProgramArguments(ProgramArguments *paramProgramArguments, char *paramImageLocation, Volume **paramVolume) {
+
+    struct stat imageStatus;
+
+    if(isChunkedImageLocation(paramImageLocation)) {
+        if(paramProgramArguments->addDirectory != NULL || (paramProgramArguments->is_defrag && !paramProgramArguments->is_dry_run) ||
+           paramProgramArguments->sparseCopyLocation != NULL || paramProgramArguments->is_punch_holes) {
+            return EXCEPTION_UNABLE_TO_WRITE_FILE;
+        }
+        long cacheBytes = paramProgramArguments->cacheBytes > 0 ? paramProgramArguments->cacheBytes : CHUNKED_IMAGE_DEFAULT_CACHE_BYTES;
+        return openCachedVolume(paramImageLocation, cacheBytes, paramVolume);
+    }
+    if(paramProgramArguments->addDirectory != NULL) {
+        return openVolumeForWriting(paramImageLocation, paramVolume);
+    }
+    if(paramProgramArguments->is_defrag && !paramProgramArguments->is_dry_run) {
+        if(paramProgramArguments->defragCopyLocation == NULL) {
+            return openVolumeForWriting(paramImageLocation, paramVolume);
+        }
+        if(stat(paramImageLocation, &imageStatus) == 0 && imageStatus.st_size > MEMORY_IMAGE_MAXIMUM_SIZE) {
+            return EXCEPTION_IMAGE_TOO_LARGE;                   // Checked before the copy is made, not after
         }
+        int exception = copyImage(paramImageLocation, paramProgramArguments->defragCopyLocation);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+        return openVolumeForWriting(paramProgramArguments->defragCopyLocation, paramVolume);
+    }
+    if(paramProgramArguments->sparseCopyLocation != NULL || paramProgramArguments->is_punch_holes) {
+        long cacheBytes = paramProgramArguments->cacheBytes > 0 ? paramProgramArguments->cacheBytes : SPARSE_CACHE_BYTES;
+        return openCachedVolume(paramImageLocation, cacheBytes, paramVolume);
+    }
 
-        int currentCluster = getClusterNFromDirectoryEntry(directoryEntry)->returnedValue;
-        int numberOfClusters = getNumberOfClustersInSequence(paramBootSector, paramBuffer, currentCluster)->returnedValue;
+    if(paramProgramArguments->readEngineType != READ_ENGINE_NONE) {
+        long cacheBytes = paramProgramArguments->cacheBytes > 0 ? paramProgramArguments->cacheBytes : READ_ENGINE_DEFAULT_CACHE_BYTES;
+        int exception = openCachedVolume(paramImageLocation, cacheBytes, paramVolume);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+        exception = createReadEnginePool(paramImageLocation, paramProgramArguments->readEngineType, paramProgramArguments->queueDepth,
+                                         paramProgramArguments->is_direct, &(*paramVolume)->readEngines);
+        if(exception != EXCEPTION_NONE) {
+            freeVolume(*paramVolume);
+        }
+        return exception;
+    }
+    if(paramProgramArguments->cacheBytes > 0) {
+        return openCachedVolume(paramImageLocation, paramProgramArguments->cacheBytes, paramVolume);
+    }
+    if(paramProgramArguments->listDirectory != NULL) {
+        return openCachedVolume(paramImageLocation, LIST_CACHE_BYTES, paramVolume);
+    }
+    if(paramProgramArguments->diskUsageDirectory != NULL) {
+        return openCachedVolume(paramImageLocation, DISK_USAGE_CACHE_BYTES, paramVolume);
+    }
+    if(paramProgramArguments->scanStateLocation != NULL) {
+        return openCachedVolume(paramImageLocation, SCAN_CACHE_BYTES, paramVolume);
+    }
+    if(stat(paramImageLocation, &imageStatus) == 0 && imageStatus.st_size > MEMORY_IMAGE_MAXIMUM_SIZE) {
+        return openCachedVolume(paramImageLocation, LARGE_IMAGE_CACHE_BYTES, paramVolume);
+    }
+    return openVolume(paramImageLocation, paramVolume);
+}
 
-        Buffer *clusterData[numberOfClusters];
-        for(int clusterIndex = 0; clusterIndex < numberOfClusters; clusterIndex++) {
+/**
+ * Runs the operations selected by the program arguments on a volume
+ * @param paramProgramArguments - The arguments of the program
+ * @param paramVolume           - The volume the operations are run on
+ * @return                      - The exception that stopped the operations, EXCEPTION_NONE when there was none
+ */
+int runOperation(ProgramArguments *paramProgramArguments, Volume *paramVolume) {
 
-            int startSector = ((currentCluster - 2) * paramBootSector->BPB_SecPerClus) + SECTOR_DATA_START;
-            int startSectorBytes = paramBootSector->BPB_BytsPerSec * startSector;
+    if(paramProgramArguments->addDirectory != NULL) {
+        int exception = addHostFiles(paramVolume, paramProgramArguments->addDirectory, paramProgramArguments->addHostFiles, paramProgramArguments->numberOfAddHostFiles);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
-            Buffer *buffer;
-            if(clusterIndex == numberOfClusters - 1 && directoryEntry->entryAttributes->is_file) {
-                buffer = getBytesFromByteStream(paramBuffer, startSectorBytes,(directoryEntry->entry->DIR_FileSize - (BYTES_PER_CLUSTER * (numberOfClusters - 1))))->returnedValue;
-            } else {
-                buffer = getBytesFromByteStream(paramBuffer, startSectorBytes, BYTES_PER_CLUSTER)->returnedValue;
-                currentCluster = getNextClusterFromFat(paramBootSector, paramBuffer, currentCluster)->returnedValue;
-            }
-            clusterData[clusterIndex] = buffer;
+    if(paramProgramArguments->is_defrag) {
+        int exception = defragmentVolume(paramVolume, paramProgramArguments->is_dry_run);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
+    if(paramProgramArguments->sparseCopyLocation != NULL) {
+        int exception = exportSparseImage(paramVolume, paramProgramArguments->sparseCopyLocation, paramProgramArguments->is_zero_slack);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
         }
+    }
 
-        if(paramFileLocationLength - searchEnquiryLength == 0 && directoryEntry->entryAttributes->is_file) {
-            Buffer *fileBuffer = createBuffer(directoryEntry->entry->DIR_FileSize);
+    if(paramProgramArguments->is_punch_holes) {
+        int exception = punchImageHoles(paramVolume, paramProgramArguments->is_zero_slack);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
-            for(int index = 0; index < numberOfClusters; index++) {
+    if(paramProgramArguments->print_bootsector) {
+        printBootSector(paramVolume->bootSector);
+        if(paramVolume->fat32BootSector != NULL) {
+            printFat32BootSector(paramVolume->fat32BootSector);
+        }
+    }
 
-                memcpy(fileBuffer->bufferPtr + (index * paramBootSector->BPB_BytsPerSec *paramBootSector->BPB_SecPerClus),
-                       clusterData[index]->bufferPtr,
-                       clusterData[index]->size);
+    if(paramProgramArguments->is_usage) {
+        printUsage(paramVolume);
+    }
 
-            }
-            SearchResult *searchResult = createSearchResult(directoryEntry, fileBuffer);
+    if(paramProgramArguments->is_undelete) {
+        int exception = printDeletedEntries(paramVolume, paramProgramArguments->numberOfThreads);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
-            setReturnValueToReturnStack(returnStack, searchResult);
-            return returnStack;
+    if(paramProgramArguments->grepPattern != NULL) {
+        int exception = grepVolume(paramVolume, paramProgramArguments->grepPattern, paramProgramArguments->numberOfThreads);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
         }
+    }
 
-        if(directoryEntry->entryAttributes->directory) {
-            if(remainingFileLocationLength > 0) {
-                wchar_t remainingFileLocation[remainingFileLocationLength];
-                memcpy(&remainingFileLocation, paramFileLocation + searchEnquiryLength + 1,
-                       remainingFileLocationLength * sizeof(wchar_t));
+    if(paramProgramArguments->is_manifest) {
+        int exception = printManifest(paramVolume, paramProgramArguments->numberOfThreads);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
-                Buffer *directoryBuffer = createBuffer(numberOfClusters * BYTES_PER_CLUSTER);
+    if(paramProgramArguments->listDirectory != NULL && paramProgramArguments->is_list_names) {
+        int exception = printDirectoryNames(paramVolume, paramProgramArguments->listDirectory);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    } else if(paramProgramArguments->listDirectory != NULL) {
+        int exception = printListing(paramVolume, paramProgramArguments->listDirectory, paramProgramArguments->listSort,
+                                     paramProgramArguments->is_list_reverse, paramProgramArguments->is_list_recursive);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
-                for(int index = 0; index < numberOfClusters; index++) {
+    if(paramProgramArguments->diskUsageDirectory != NULL) {
+        int exception = printDiskUsage(paramVolume, paramProgramArguments->diskUsageDirectory, paramProgramArguments->diskUsageMaxDepth,
+                                       paramProgramArguments->diskUsageTop, paramProgramArguments->numberOfThreads);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
-                    memcpy(directoryBuffer->bufferPtr + (index * paramBootSector->BPB_BytsPerSec *paramBootSector->BPB_SecPerClus),
-                           clusterData[index]->bufferPtr,
-                           clusterData[index]->size);
+    if(paramProgramArguments->scanStateLocation != NULL) {
+        int exception = rescanVolume(paramVolume, paramProgramArguments->scanStateLocation);
+        if(exception != EXCEPTION_NONE) {
+            return exception;
+        }
+    }
 
-                }
-                LinkedList *directory = getAllEntriesFromDirectory(directoryBuffer, 0)->returnedValue;
+    if(paramProgramArguments->fileLocation == NULL) {
+        return EXCEPTION_NONE;
+    }
 
-                return recursiveSearch(paramBootSector, paramBuffer, directory, remainingFileLocation,
-                                       remainingFileLocationLength);
-            }
+    if(paramProgramArguments->is_tree) {
+        if(paramProgramArguments->outputFormat != OUTPUT_FORMAT_TEXT) {
+            printRecords(paramVolume, paramProgramArguments->outputFormat);
+        } else {
+            beginTree(paramVolume);
         }
+        return EXCEPTION_NONE;
+    }
 
+    SearchResult *foundFile;
+    int exception = searchForFile(paramVolume, paramProgramArguments->fileLocation, paramProgramArguments->fileLocationLength, &foundFile);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
+    }
 
+    if(paramProgramArguments->outputFormat != OUTPUT_FORMAT_TEXT) {
+        printEntryRecord(foundFile->directoryEntryPtr, paramProgramArguments->fileLocation, paramProgramArguments->fileLocationLength,
+                         paramProgramArguments->outputFormat);
+        freeSearchResult(foundFile);
+        return EXCEPTION_NONE;
     }
 
-    addExceptionToReturnStack(returnStack, createException(EXCEPTION_FILE_DOES_NOT_EXIST));
-    return returnStack;
-}
+    if(paramProgramArguments->print_complete_entry) {
+        printEntry(foundFile->directoryEntryPtr->entry);
+    }
+    printDirectoryEntry(foundFile->directoryEntryPtr, 0);
+    printFileContents(paramVolume, foundFile->directoryEntryPtr);
 
-/**
- * Used to begin a search at the root directory, finding the firs LinkedList of entries
- * @param paramBootSector   - Boot Sector of the program
- * @param paramBuffer       - The bytes of the entire file
- * @param paramFileLocation - The location of the file being found
- * @return                  - The return stack containing the search result
- */
-ReturnStack *searchForFile(BootSector *paramBootSector, Buffer *paramBuffer, wchar_t *paramFileLocation, int paramFileLocationLength) {
-    LinkedList *rootDirectoryEntries = getAllEntriesFromRootDirectory(paramBootSector, paramBuffer)->returnedValue;
-    return recursiveSearch(paramBootSector, paramBuffer, rootDirectoryEntries, paramFileLocation, paramFileLocationLength);
+    freeSearchResult(foundFile);
+    return EXCEPTION_NONE;
 }
 
 
 /// +--------------------------------------------------------------------------------------------------+
 /// |                                                                                                  |
-/// |                                              TREE                                                |
+/// |                                               Batch                                              |
 /// |                                                                                                  |
 /// +--------------------------------------------------------------------------------------------------+
 
 /*
- * The tree is called when the input is for the file to be found is '//'
- * It recursively prints out every file and directory name
+ * A batch runs the same operation over many images on the thread pool. The image location given may be a directory,
+ * in which case every .img and .fatz file inside it is used, or a list file prefixed with '@' holding one image per line.
+ *
+ * Each image is opened into its own volume by the worker processing it, and its output is captured then written out
+ * with every line tagged by the image as soon as the image is finished.
  */
 
 /**
- * Recursively print out every sub directory of the directory
- * @param paramBootSector - The boot sector of the program
- * @param paramBuffer     - The byte stream of the program
- * @param paramEntries    - The entries in the directory currently processed
- * @param paramDepth      - The current depth of the entry
- * @return
+ * An image task stores everything a worker needs to process one image of the batch
  */
-void *tree(BootSector *paramBootSector, Buffer *paramBuffer, LinkedList *paramEntries, int paramDepth) {
+struct ImageTask {
+    char *imageLocation;
+    ProgramArguments *programArguments;
+    pthread_mutex_t *outputLock;
+}; typedef struct ImageTask ImageTask;
 
-    ReturnStack *returnStack = createReturnStack();
+/**
+ * Compares two image locations for sorting
+ * @param paramFirst  - Pointer to the first location
+ * @param paramSecond - Pointer to the second location
+ * @return            - strcmp of the two locations
+ */
+int compareImageLocations(const void *paramFirst, const void *paramSecond) {
+    return strcmp(*(char **) paramFirst, *(char **) paramSecond);
+}
 
-    const int SECTOR_DATA_START = paramBootSector->BPB_RsvdSecCnt + (paramBootSector->BPB_NumFATs * paramBootSector->BPB_FATSz16) + (paramBootSector->BPB_RootEntCnt * 32) / paramBootSector->BPB_BytsPerSec;
-    const int BYTES_PER_CLUSTER = paramBootSector->BPB_SecPerClus * paramBootSector->BPB_BytsPerSec;
+/**
+ * Checks whether a file name ends in .img, or .fatz for a compressed image
+ * @param paramFileName - The file name being checked
+ * @return              - 1 if the name ends in .img or .fatz
+ */
+uint8_t isImageFileName(char *paramFileName) {
+    size_t length = strlen(paramFileName);
+    return (length > 4 && strcasecmp(paramFileName + length - 4, ".img") == 0) || (length > 5 && strcasecmp(paramFileName + length - 5, ".fatz") == 0);
+}
 
-    LinkedList *entry = paramEntries;
+/**
+ * Gets the locations of every image in the batch
+ * @param paramLocation       - A directory, a list file prefixed with '@' or a single image
+ * @param paramImageLocations - Set to a linked list of image locations
+ * @return                    - EXCEPTION_NONE, EXCEPTION_UNABLE_TO_OPEN_FILE or EXCEPTION_NO_IMAGES_FOUND
+ */
+int getImageLocations(char *paramLocation, LinkedList **paramImageLocations) {
 
-    while(entry->next != NULL) {
-        entry = entry->next;
-        DirectoryEntry *directoryEntry = entry->pointer;
+    LinkedList *imageLocations = createLinkedList();
 
-        if(directoryEntry->entryAttributes->volume_name) {
-            printf("Volume: ");
-            printLongFileName(directoryEntry, 0);
-            continue;
+    if(paramLocation[0] == '@') {
+
+        FILE *listFile = fopen(paramLocation + 1, "r");
+        if(listFile == NULL) {
+            return EXCEPTION_UNABLE_TO_OPEN_FILE;
         }
 
-        printLongFileName(directoryEntry, paramDepth * 2);
+        char line[4096];
+        while(fgets(line, sizeof(line), listFile) != NULL) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if(line[0] == '\0') {
+                continue;
+            }
+            addNewLink(imageLocations, (unsigned int *) strdup(line));
+        }
+        fclose(listFile);
 
-        if(directoryEntry->entryAttributes->directory) {
+    } else {
 
-            int currentCluster = getClusterNFromDirectoryEntry(directoryEntry)->returnedValue;
-            int numberOfClusters = getNumberOfClustersInSequence(paramBootSector, paramBuffer, currentCluster)->returnedValue;
+        struct stat locationStat;
+        if(stat(paramLocation, &locationStat) == 0 && S_ISDIR(locationStat.st_mode)) {
 
-            for(int clusterIndex = 0; clusterIndex < numberOfClusters; clusterIndex++) {
+            DIR *directory = opendir(paramLocation);
+            if(directory == NULL) {
+                return EXCEPTION_UNABLE_TO_OPEN_FILE;
+            }
 
-                int startSector = ((currentCluster - 2) * paramBootSector->BPB_SecPerClus) + SECTOR_DATA_START;
-                int startSectorBytes = paramBootSector->BPB_BytsPerSec * startSector;
+            int numberOfImages = 0;
+            int capacity = 64;
+            char **locations = (char **) malloc(sizeof(char *) * capacity);
 
-                Buffer *buffer = getBytesFromByteStream(paramBuffer, startSectorBytes, BYTES_PER_CLUSTER)->returnedValue;
+            struct dirent *directoryEntry;
+            while((directoryEntry = readdir(directory)) != NULL) {
+                if(!isImageFileName(directoryEntry->d_name)) {
+                    continue;
+                }
+                if(numberOfImages == capacity) {
+                    capacity *= 2;
+                    locations = (char **) realloc(locations, sizeof(char *) * capacity);
+                }
+                char *location = (char *) malloc(strlen(paramLocation) + strlen(directoryEntry->d_name) + 2);
+                sprintf(location, "%s/%s", paramLocation, directoryEntry->d_name);
+                locations[numberOfImages++] = location;
+            }
+            closedir(directory);
 
-                LinkedList *directory = getAllEntriesFromDirectory(buffer, 0)->returnedValue;
-                tree(paramBootSector, paramBuffer, directory, paramDepth+1);
+            qsort(locations, numberOfImages, sizeof(char *), compareImageLocations);
 
-                currentCluster = getNextClusterFromFat(paramBootSector, paramBuffer, currentCluster)->returnedValue;
+            for(int index = 0; index < numberOfImages; index++) {
+                addNewLink(imageLocations, (unsigned int *) locations[index]);
             }
+            free(locations);
+
+        } else {
+            addNewLink(imageLocations, (unsigned int *) strdup(paramLocation));
         }
     }
+
+    if(imageLocations->next == NULL) {
+        return EXCEPTION_NO_IMAGES_FOUND;
+    }
+
+    *paramImageLocations = imageLocations;
+    return EXCEPTION_NONE;
 }
 
 /**
- * Begins the tree at the root directory
- * @param paramBootSector - The boot sector of the program
- * @param paramBuffer     - The byte stream of the program
- * @return
+ * Writes captured output to stdout with every line tagged by the image it came from
+ * @param paramImageLocation - The image the output belongs to
+ * @param paramOutput        - The captured output
+ * @param paramOutputSize    - The number of bytes of output
  */
-void *beginTree(BootSector *paramBootSector, Buffer *paramBuffer) {
-    LinkedList *rootDirectoryEntries = getAllEntriesFromRootDirectory(paramBootSector, paramBuffer)->returnedValue;
-    tree(paramBootSector, paramBuffer, rootDirectoryEntries, 1);
-}
+void printTaggedOutput(char *paramImageLocation, char *paramOutput, size_t paramOutputSize) {
 
+    size_t lineStart = 0;
 
+    while(lineStart < paramOutputSize) {
+        size_t lineEnd = lineStart;
+        while(lineEnd < paramOutputSize && paramOutput[lineEnd] != '\n') {
+            lineEnd++;
+        }
 
-/// +--------------------------------------------------------------------------------------------------+
-/// |                                                                                                  |
-/// |                                                Main                                              |
-/// |                                                                                                  |
-/// +--------------------------------------------------------------------------------------------------+
+        fprintf(stdout, "%s: ", paramImageLocation);
+        fwrite(paramOutput + lineStart, 1, lineEnd - lineStart, stdout);
+        fputc('\n', stdout);
 
-/*
- * Main methods start off the program and read the starting arguments of the program and the check for errors going along in the program
- */
+        lineStart = lineEnd + 1;
+    }
+    fflush(stdout);
+}
 
 /**
- * Program Arguments contain the value of the image being looked at and the file being found
+ * Processes one image of the batch, run by a worker of the thread pool
+ * @param paramImageTask - The image task being processed
  */
-struct ProgramArguments {
-    char *fat16ImageLocation;
-    int fat16ImageLocationLength;
+void processImageTask(void *paramImageTask) {
 
-    wchar_t *fileLocation;
-    int fileLocationLength;
-
-    uint8_t is_tree;
-    uint8_t print_bootsector;
-    uint8_t print_complete_entry;
-
-}; typedef struct ProgramArguments ProgramArguments;
+    ImageTask *imageTask = (ImageTask *) paramImageTask;
 
-/**
- * Creates the arguments for the program
- * @param argc  - The number of total arguments
- * @param argv  - The arguments beginning at 1
- * @return      - A return stack containing the program arguments
- */
-ReturnStack *createProgramArguments(int argc, char *argv[]) {
+    char *output = NULL;
+    size_t outputSize = 0;
+    FILE *outputStream = open_memstream(&output, &outputSize);
+    setOutputStream(outputStream);
 
-    const char PRINT_TREE[] = "//";
-    const char PRINT_BOOTSECTOR[] = "-bs";
-    const char PRINT_COMPLETE_ENTRY[] = "-e";
+    Volume *volume;
+    int exception = openVolumeForProgramArguments(imageTask->programArguments, imageTask->imageLocation, &volume);
+    if(exception != EXCEPTION_NONE) {
+        printException(exception);
+    } else {
+        printException(runOperation(imageTask->programArguments, volume));
 
-    ReturnStack *returnStack = createReturnStack();
+        if(volume->blockCache != NULL) {
+            printBlockCacheStatistics(volume->blockCache);
+        }
+        if(volume->readEngines != NULL) {
+            printReadEngineStatistics(volume->readEngines);
+        }
 
-    if(argc < 3) {
-        addExceptionToReturnStack(returnStack, createException(EXCEPTION_PROGRAM_ARGUMENTS));
-        return returnStack;
+        freeVolume(volume);
     }
 
-    ProgramArguments *programArguments = (ProgramArguments *) malloc(sizeof(ProgramArguments));
+    setOutputStream(NULL);
+    fclose(outputStream);
 
-    char *fat16ImageLocation = (char *) malloc(sizeof(char) * strlen(argv[1]));
-    memcpy(fat16ImageLocation, argv[1], strlen(argv[1]));
+    pthread_mutex_lock(imageTask->outputLock);
+    printTaggedOutput(imageTask->imageLocation, output, outputSize);
+    pthread_mutex_unlock(imageTask->outputLock);
 
-    programArguments->fat16ImageLocation = fat16ImageLocation;
-    programArguments->fat16ImageLocationLength = strlen(fat16ImageLocation);
+    free(output);
+    free(imageTask->imageLocation);
+    free(imageTask);
+}
 
-    wchar_t *fileLocation = (wchar_t *) malloc(sizeof(wchar_t) * strlen(argv[2]));
+/**
+ * Runs the operation selected by the program arguments on every image in the batch
+ * @param paramProgramArguments - The arguments of the program
+ * @param paramImageLocations   - Linked list of the image locations
+ * @return                      - EXCEPTION_NONE or EXCEPTION_UNABLE_TO_CREATE_THREAD
+ */
+int runBatch(ProgramArguments *paramProgramArguments, LinkedList *paramImageLocations) {
 
-    for(int index = 0; index < strlen(argv[2]); index++) {
-        memcpy(fileLocation + index, &argv[2][index], 1);
+    ThreadPool *threadPool;
+    int exception = createThreadPool(paramProgramArguments->numberOfThreads, &threadPool);
+    if(exception != EXCEPTION_NONE) {
+        return exception;
     }
 
-    programArguments->fileLocation = fileLocation;
-    programArguments->fileLocationLength = strlen(argv[2]);
+    pthread_mutex_t outputLock;
+    pthread_mutex_init(&outputLock, NULL);
 
-    if(strcmp(argv[2], PRINT_TREE) == 0) {
-        programArguments->is_tree = 1;
-    }
+    LinkedList *imageLocation = paramImageLocations;
+    while(imageLocation->next != NULL) {
+        imageLocation = imageLocation->next;
 
-    for(int otherArgsIndex = 3; otherArgsIndex < argc; otherArgsIndex++) {
-        if(strcmp(argv[otherArgsIndex], PRINT_BOOTSECTOR) == 0) {
-            programArguments->print_bootsector = 1;
-        }
+        ImageTask *imageTask = (ImageTask *) malloc(sizeof(ImageTask));
+        imageTask->imageLocation = (char *) imageLocation->pointer;
+        imageTask->programArguments = paramProgramArguments;
+        imageTask->outputLock = &outputLock;
 
-        if(strcmp(argv[otherArgsIndex], PRINT_COMPLETE_ENTRY) == 0) {
-            programArguments->print_complete_entry = 1;
-        }
+        submitTaskToThreadPool(threadPool, processImageTask, imageTask);
     }
 
-    setReturnValueToReturnStack(returnStack, programArguments);
-
-    return returnStack;
+    waitForThreadPool(threadPool);
+    freeThreadPool(threadPool);
+    pthread_mutex_destroy(&outputLock);
 
+    return EXCEPTION_NONE;
 }
 
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                                Main                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Main methods start off the program and read the starting arguments of the program and the check for errors going along in the program
+ * Defining FAT16_NO_MAIN leaves main out so another program, such as the microbenchmarks, can include this file.
+ */
+
+#ifndef FAT16_NO_MAIN
+
 /**
  * The projects main function
  * @param argc - The number of total arguments
@@ -1431,62 +12204,89 @@ int main(int argc, char *argv[]) {
     setlocale(LC_CTYPE, "");
 
 
-    ReturnStack *programArgumentsRS = createProgramArguments(argc, argv);
-    if(isExceptionOnReturnStack(programArgumentsRS)) {
-        printExceptionsOnReturnStack(programArgumentsRS);
+    ProgramArguments *programArguments;
+    int exception = createProgramArguments(argc, argv, &programArguments);
+    if(exception != EXCEPTION_NONE) {
+        printException(exception);
         return 0;
     }
-    ProgramArguments *programArguments = programArgumentsRS->returnedValue;
 
-    ReturnStack *fileRS = openFile(programArguments->fat16ImageLocation);
-    if(isExceptionOnReturnStack(fileRS)) {
-        printExceptionsOnReturnStack(fileRS);
+    if(programArguments->is_create) {
+        printException(createImage(programArguments->fat16ImageLocation, programArguments->createHostDirectory, programArguments->createSizeBytes,
+                                   programArguments->createClusterBytes, programArguments->createLabel));
         return 0;
     }
-    FILE *file = fileRS->returnedValue;
 
-    ReturnStack *bufferRS = convertFileToBuffer(file);
-    if(isExceptionOnReturnStack(bufferRS)) {
-        printExceptionsOnReturnStack(bufferRS);
+    if(programArguments->is_compress) {
+        printException(compressImage(programArguments->fat16ImageLocation, programArguments->compressLocation, programArguments->chunkBytes));
         return 0;
     }
-    Buffer *buffer = bufferRS->returnedValue;
 
-    closeFile(file);
+    if(programArguments->is_diff) {
+        Volume *oldVolume;
+        exception = openVolumeForProgramArguments(programArguments, programArguments->fat16ImageLocation, &oldVolume);
+        if(exception != EXCEPTION_NONE) {
+            printException(exception);
+            return 0;
+        }
+        Volume *newVolume;
+        exception = openVolumeForProgramArguments(programArguments, programArguments->diffImageLocation, &newVolume);
+        if(exception != EXCEPTION_NONE) {
+            printException(exception);
+            return 0;
+        }
 
-    ReturnStack *bootSectorRS = createBootSector(buffer);
-    if(isExceptionOnReturnStack(bootSectorRS)) {
-        printExceptionsOnReturnStack(bootSectorRS);
+        printException(diffVolumes(oldVolume, newVolume));
         return 0;
     }
-    BootSector *bootSector = bootSectorRS->returnedValue;
 
-    if(programArguments->print_bootsector) {
-        printBootSector(bootSector);
-    }
+    struct stat locationStat;
+    uint8_t is_batch = programArguments->fat16ImageLocation[0] == '@' ||
+            (stat(programArguments->fat16ImageLocation, &locationStat) == 0 && S_ISDIR(locationStat.st_mode));
 
-    if(programArguments->is_tree) {
-        beginTree(bootSector, buffer);
-    } else {
+    // Every image of a batch would be written to the same copy or state file
+    if(is_batch && (programArguments->defragCopyLocation != NULL || programArguments->sparseCopyLocation != NULL ||
+                    programArguments->scanStateLocation != NULL)) {
+        printException(EXCEPTION_PROGRAM_ARGUMENTS);
+        return 0;
+    }
 
-        ReturnStack *foundFileRS = searchForFile(bootSector, buffer, programArguments->fileLocation, programArguments->fileLocationLength);
-        if(isExceptionOnReturnStack(foundFileRS)) {
-            printExceptionsOnReturnStack(foundFileRS);
+    if(is_batch) {
+        LinkedList *imageLocations;
+        exception = getImageLocations(programArguments->fat16ImageLocation, &imageLocations);
+        if(exception != EXCEPTION_NONE) {
+            printException(exception);
             return 0;
         }
 
-        SearchResult *foundFile = foundFileRS->returnedValue;
+        printException(runBatch(programArguments, imageLocations));
+        return 0;
+    }
 
-        if(programArguments->print_complete_entry) {
-            printEntry(foundFile->directoryEntryPtr->entry);
-        }
-        printDirectoryEntry(foundFile->directoryEntryPtr, 0);
-        printBufferAsASCII(foundFile->bufferPtr, 0);
+    Volume *volume;
+    exception = openVolumeForProgramArguments(programArguments, programArguments->fat16ImageLocation, &volume);
+    if(exception != EXCEPTION_NONE) {
+        printException(exception);
+        return 0;
+    }
+
+    exception = runOperation(programArguments, volume);
+
+    if(volume->blockCache != NULL) {
+        printBlockCacheStatistics(volume->blockCache);
     }
+    if(volume->readEngines != NULL) {
+        printReadEngineStatistics(volume->readEngines);
+    }
+
+    printException(exception);
+    return 0;
 }
 
+#endif
+
 /// +--------------------------------------------------------------------------------------------------+
 /// |                                                                                                  |
 /// |                                            END FILE                                              |
 /// |                                                                                                  |
-/// +--------------------------------------------------------------------------------------------------+
\ No newline at end of file
+/// +--------------------------------------------------------------------------------------------------+
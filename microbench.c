@@ -0,0 +1,1041 @@
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                       FAT16 Microbenchmarks                                      |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Runs the parsing kernels of main.c one at a time on fixtures built in memory, so a regression shows up as one
+ * kernel slowing down rather than as a change in the time of a whole run. main.c is included with its main left
+ * out, after malloc, calloc and realloc have been replaced with versions that count what the kernels allocate.
+ *
+ * Each kernel is calibrated until one repeat takes at least BENCH_MINIMUM_REPEAT_NS, warmed up, then timed over a
+ * number of repeats. The median ns/op is reported along with the median absolute deviation as a percentage, and
+ * the bytes and allocations made per op. The peak resident set of the process is reported after each kernel. It only
+ * ever grows, so use --filter to see the peak of a single kernel.
+ *
+ * Usage: fat16_microbench [--filter Name] [--repeats N] [--json Output.json] [--baseline Baseline.json] [--threshold Percent]
+ *
+ * With --baseline the exit code is 1 when any kernel is slower than its baseline by more than the threshold and
+ * by more than its own spread.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <locale.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stddef.h>
+#include <sys/resource.h>
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                        Allocation Counting                                       |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+static long benchAllocations = 0;
+static long benchAllocatedBytes = 0;
+
+/**
+ * Counts an allocation then makes it with malloc
+ * @param paramSize - The number of bytes
+ * @return          - The allocated memory
+ */
+void *countMalloc(size_t paramSize) {
+    benchAllocations++;
+    benchAllocatedBytes += paramSize;
+    return malloc(paramSize);
+}
+
+/**
+ * Counts an allocation then makes it with calloc
+ * @param paramNumber - The number of elements
+ * @param paramSize   - The size of each element
+ * @return            - The allocated memory
+ */
+void *countCalloc(size_t paramNumber, size_t paramSize) {
+    benchAllocations++;
+    benchAllocatedBytes += paramNumber * paramSize;
+    return calloc(paramNumber, paramSize);
+}
+
+/**
+ * Counts an allocation then makes it with realloc
+ * @param paramPointer - The memory being resized
+ * @param paramSize    - The new number of bytes
+ * @return             - The allocated memory
+ */
+void *countRealloc(void *paramPointer, size_t paramSize) {
+    benchAllocations++;
+    benchAllocatedBytes += paramSize;
+    return realloc(paramPointer, paramSize);
+}
+
+#define malloc(size) countMalloc(size)
+#define calloc(number, size) countCalloc(number, size)
+#define realloc(pointer, size) countRealloc(pointer, size)
+
+#define FAT16_NO_MAIN
+#include "main.c"
+
+#undef malloc
+#undef calloc
+#undef realloc
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                             Fixtures                                             |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Fixtures are built once per kernel and are not part of the time. Pseudo random values come from a fixed seed so
+ * every run of the benchmarks looks at the same bytes.
+ */
+
+#define FIXTURE_SECTOR_SIZE 512
+#define FIXTURE_NUMBER_OF_NAMES 64
+
+volatile uint32_t benchSink;                // Kernels store a result here so their work is not optimised away
+
+static uint32_t fixtureSeed = 12345;
+
+/**
+ * Gets the next pseudo random number
+ * @return - A number from 0 to 2^31 - 1
+ */
+uint32_t getFixtureRandom() {
+    fixtureSeed = fixtureSeed * 1103515245 + 12345;
+    return (fixtureSeed >> 1) & 0x7FFFFFFF;
+}
+
+/**
+ * A FAT fixture is a volume in memory whose FAT links every cluster into one chain in a shuffled order
+ */
+struct FatFixture {
+    Volume *volume;
+    int cluster;                            // Where the next run continues along the chain
+
+}; typedef struct FatFixture FatFixture;
+
+/**
+ * Creates a volume in memory holding only the reserved sectors and FATs, with every cluster linked into one chain
+ * in a shuffled order so that following it jumps around the FAT
+ * @param paramTotalSectors - The number of sectors the boot sector claims, choosing the type of FAT
+ * @return                  - The FAT fixture
+ */
+FatFixture *createFatFixture(uint32_t paramTotalSectors) {
+
+    BootSector *bootSector = (BootSector *) calloc(1, sizeof(BootSector));
+    bootSector->BPB_BytsPerSec = FIXTURE_SECTOR_SIZE;
+    bootSector->BPB_SecPerClus = 1;
+    bootSector->BPB_RsvdSecCnt = 32;
+    bootSector->BPB_NumFATs = 2;
+    bootSector->BPB_Media = 0xF8;
+    if(paramTotalSectors < 65536) {
+        bootSector->BPB_TotSec16 = paramTotalSectors;
+    } else {
+        bootSector->BPB_TotSec32 = paramTotalSectors;
+    }
+
+    Fat32BootSector *fat32BootSector = NULL;
+    uint8_t is_fat32 = paramTotalSectors >= FAT16_MAXIMUM_CLUSTERS;
+    int bitsPerEntry = paramTotalSectors < FAT12_MAXIMUM_CLUSTERS ? 12 : is_fat32 ? 32 : 16;
+
+    uint32_t sectorsPerFat = 1;
+    while(((long) paramTotalSectors * bitsPerEntry / 8) / FIXTURE_SECTOR_SIZE + 1 > sectorsPerFat) {
+        sectorsPerFat++;
+    }
+
+    if(is_fat32) {
+        fat32BootSector = (Fat32BootSector *) calloc(1, sizeof(Fat32BootSector));
+        fat32BootSector->BPB_FATSz32 = sectorsPerFat;
+        fat32BootSector->BPB_RootClus = 2;
+    } else {
+        bootSector->BPB_RootEntCnt = 512;
+        bootSector->BPB_FATSz16 = sectorsPerFat;
+    }
+
+    long fixtureSize = (long) (bootSector->BPB_RsvdSecCnt + bootSector->BPB_NumFATs * sectorsPerFat) * FIXTURE_SECTOR_SIZE;
+    Buffer *buffer = createBuffer((int) fixtureSize);
+    memset(buffer->bufferPtr, 0, fixtureSize);
+
+    Volume *volume = createVolume("fixture", buffer, bootSector, fat32BootSector);
+
+    int numberOfClusters = volume->numberOfClusters;
+    int *order = (int *) malloc(sizeof(int) * numberOfClusters);
+    for(int index = 0; index < numberOfClusters; index++) {
+        order[index] = index + 2;
+    }
+    for(int index = numberOfClusters - 1; index > 0; index--) {
+        int other = (int) (getFixtureRandom() % (index + 1));
+        int swap = order[index];
+        order[index] = order[other];
+        order[other] = swap;
+    }
+
+    for(int index = 0; index < numberOfClusters; index++) {
+        int cluster = order[index];
+        int nextCluster = order[(index + 1) % numberOfClusters];
+        volume->fat->encodeEntry(buffer->bufferPtr + getFatEntryOffset(volume, 0, cluster), cluster, nextCluster);
+    }
+
+    FatFixture *fatFixture = (FatFixture *) malloc(sizeof(FatFixture));
+    fatFixture->volume = volume;
+    fatFixture->cluster = order[0];
+    free(order);
+
+    return fatFixture;
+}
+
+/**
+ * Creates a FAT12 fixture
+ */
+void *createFat12Fixture() {
+    return createFatFixture(4000);
+}
+
+/**
+ * Creates a FAT16 fixture
+ */
+void *createFat16Fixture() {
+    return createFatFixture(60000);
+}
+
+/**
+ * Creates a FAT32 fixture
+ */
+void *createFat32Fixture() {
+    return createFatFixture(1000000);
+}
+
+/**
+ * Frees a FAT fixture
+ */
+void freeFatFixture(void *paramFixture) {
+    freeVolume(((FatFixture *) paramFixture)->volume);
+    free(paramFixture);
+}
+
+/**
+ * Gets a name for a fixture entry, some short enough for one long file name entry and some needing several
+ * @param paramIndex - Which name
+ * @param paramName  - Set to the name, at least 64 characters long
+ * @return           - The length of the name
+ */
+int getFixtureName(int paramIndex, wchar_t *paramName) {
+    const wchar_t *STEMS[] = {L"report", L"holiday photo", L"naïve résumé", L"a much longer document name than most"};
+    const wchar_t *stem = STEMS[paramIndex % 4];
+    return swprintf(paramName, 64, L"%ls %d.txt", stem, paramIndex);
+}
+
+/**
+ * Fills the slots of a directory fixture with the long file name entries and short entry of a file
+ * @param paramSlots        - The first free slot
+ * @param paramIndex        - Which file
+ * @param paramAttributes   - DIR_Attr of the short entry
+ * @param paramFirstCluster - The first cluster of the file
+ * @return                  - The number of slots used
+ */
+int fillFixtureFile(unsigned char *paramSlots, int paramIndex, uint8_t paramAttributes, int paramFirstCluster) {
+
+    wchar_t name[64];
+    int nameLength = getFixtureName(paramIndex, name);
+    int numberOfLongEntries = (nameLength + 12) / 13;
+
+    Entry entry;
+    memset(&entry, 0, sizeof(Entry));
+    char shortName[12];
+    snprintf(shortName, sizeof(shortName), "FILE%04uTXT", (unsigned) paramIndex % 10000u);
+    memcpy(entry.DIR_Name, shortName, 11);
+    entry.DIR_Attr = paramAttributes;
+    entry.DIR_CrtDate = entry.DIR_WrtDate = entry.DIR_LstAccDate = 0x5A21;
+    entry.DIR_CrtTime = entry.DIR_WrtTime = 0x6C3E;
+    entry.DIR_FstClusHI = (uint16_t) (paramFirstCluster >> 16);
+    entry.DIR_FstClusLO = (uint16_t) paramFirstCluster;
+    entry.DIR_FileSize = (uint32_t) paramIndex * 1000;
+
+    uint8_t checksum = getShortNameChecksum(entry.DIR_Name);
+    for(int order = numberOfLongEntries; order >= 1; order--) {
+        fillLongFileNameEntry((LongFileNameEntry *) paramSlots, name, nameLength, order, order == numberOfLongEntries, checksum);
+        paramSlots += sizeof(Entry);
+    }
+    memcpy(paramSlots, &entry, sizeof(Entry));
+
+    return numberOfLongEntries + 1;
+}
+
+/**
+ * Creates a directory fixture of one 4KB cluster filled with files, a deleted slot and the end of directory
+ * @return - A buffer holding the directory
+ */
+void *createDirectoryFixture() {
+
+    Buffer *buffer = createBuffer(4096);
+    memset(buffer->bufferPtr, 0, buffer->size);
+
+    int slot = 0;
+    int maxSlots = buffer->size / sizeof(Entry) - 1;
+    for(int index = 0; slot + 5 < maxSlots; index++) {
+        slot += fillFixtureFile(buffer->bufferPtr + slot * sizeof(Entry), index, (index % 5 == 0) ? 0x10 : 0x20, index + 2);
+        if(index == 3) {
+            buffer->bufferPtr[slot * sizeof(Entry)] = DELETED_ENTRY;
+            slot++;
+        }
+    }
+
+    return buffer;
+}
+
+/**
+ * Frees a buffer fixture
+ */
+void freeBufferFixture(void *paramFixture) {
+    freeBuffer((Buffer *) paramFixture);
+}
+
+/**
+ * Creates a fixture of long file name entries
+ * @return - An array of FIXTURE_NUMBER_OF_NAMES long file name entries
+ */
+void *createLongFileNameFixture() {
+
+    LongFileNameEntry *longFileNameEntries = (LongFileNameEntry *) calloc(FIXTURE_NUMBER_OF_NAMES, sizeof(LongFileNameEntry));
+
+    for(int index = 0; index < FIXTURE_NUMBER_OF_NAMES; index++) {
+        wchar_t name[64];
+        int nameLength = getFixtureName(index, name);
+        fillLongFileNameEntry(longFileNameEntries + index, name, nameLength, 1, 1, 0);
+    }
+
+    return longFileNameEntries;
+}
+
+/**
+ * A name fixture holds the fixture names as wide strings
+ */
+struct NameFixture {
+    wchar_t names[FIXTURE_NUMBER_OF_NAMES][64];
+    int nameLengths[FIXTURE_NUMBER_OF_NAMES];
+}; typedef struct NameFixture NameFixture;
+
+/**
+ * Creates a fixture of names, a mix of ASCII only names and names with Latin-1 characters
+ * @return - The name fixture
+ */
+void *createNameFixture() {
+
+    NameFixture *nameFixture = (NameFixture *) calloc(1, sizeof(NameFixture));
+
+    for(int index = 0; index < FIXTURE_NUMBER_OF_NAMES; index++) {
+        nameFixture->nameLengths[index] = getFixtureName(index, nameFixture->names[index]);
+    }
+
+    return nameFixture;
+}
+
+/**
+ * Creates a fixture of short entries with every combination of attributes and a spread of dates and times
+ * @return - An array of FIXTURE_NUMBER_OF_NAMES entries
+ */
+void *createEntryFixture() {
+
+    Entry *entries = (Entry *) calloc(FIXTURE_NUMBER_OF_NAMES, sizeof(Entry));
+
+    for(int index = 0; index < FIXTURE_NUMBER_OF_NAMES; index++) {
+        entries[index].DIR_Attr = (uint8_t) index & 0x3F;
+        entries[index].DIR_CrtDate = (uint16_t) ((((getFixtureRandom() % 60) + 20) << 9) | (((getFixtureRandom() % 12) + 1) << 5) | ((getFixtureRandom() % 28) + 1));
+        entries[index].DIR_CrtTime = (uint16_t) (((getFixtureRandom() % 24) << 11) | ((getFixtureRandom() % 60) << 5) | (getFixtureRandom() % 30));
+        entries[index].DIR_CrtTimeTenth = (uint8_t) (getFixtureRandom() % 200);
+    }
+
+    return entries;
+}
+
+/**
+ * Frees a fixture made with a single allocation
+ */
+void freePlainFixture(void *paramFixture) {
+    free(paramFixture);
+}
+
+#define TREE_FIXTURE_DEPTH 32
+#define TREE_FIXTURE_FILES 40               // Files in each nested directory
+#define TREE_FIXTURE_WIDE_FILES 1500        // Files in the one wide directory under the root
+
+/**
+ * Copies the slots of a directory into the next free clusters of a volume fixture and links them in the FAT
+ * @param paramVolume      - The volume fixture
+ * @param paramNextCluster - The next free cluster, moved past the clusters used
+ * @param paramSlots       - The slots of the directory
+ * @param paramLength      - The number of bytes of slots
+ * @return                 - The first cluster of the directory
+ */
+int writeFixtureDirectory(Volume *paramVolume, int *paramNextCluster, unsigned char *paramSlots, int paramLength) {
+
+    int firstCluster = *paramNextCluster;
+    int numberOfClusters = paramLength / paramVolume->bytesPerCluster + 1;        // Always room for the end of directory
+
+    memcpy(paramVolume->buffer->bufferPtr + getClusterOffset(paramVolume, firstCluster), paramSlots, paramLength);
+
+    for(int cluster = firstCluster; cluster < firstCluster + numberOfClusters; cluster++) {
+        uint32_t nextCluster = cluster + 1 < firstCluster + numberOfClusters ? (uint32_t) cluster + 1 : FAT_END_OF_CHAIN;
+        paramVolume->fat->encodeEntry(paramVolume->buffer->bufferPtr + getFatEntryOffset(paramVolume, 0, cluster), cluster, nextCluster);
+    }
+
+    *paramNextCluster += numberOfClusters;
+    return firstCluster;
+}
+
+/**
+ * Creates a FAT16 volume in memory for walking a whole tree. The root holds a directory of TREE_FIXTURE_WIDE_FILES
+ * files, below which is a chain of TREE_FIXTURE_DEPTH nested directories of TREE_FIXTURE_FILES files each.
+ * @return - The volume
+ */
+void *createTreeFixture() {
+
+    BootSector *bootSector = (BootSector *) calloc(1, sizeof(BootSector));
+    bootSector->BPB_BytsPerSec = FIXTURE_SECTOR_SIZE;
+    bootSector->BPB_SecPerClus = 1;
+    bootSector->BPB_RsvdSecCnt = 1;
+    bootSector->BPB_NumFATs = 2;
+    bootSector->BPB_RootEntCnt = 512;
+    bootSector->BPB_TotSec16 = 8192;
+    bootSector->BPB_Media = 0xF8;
+    bootSector->BPB_FATSz16 = 32;
+
+    Buffer *buffer = createBuffer(bootSector->BPB_TotSec16 * FIXTURE_SECTOR_SIZE);
+    memset(buffer->bufferPtr, 0, buffer->size);
+    Volume *volume = createVolume("fixture", buffer, bootSector, NULL);
+
+    int nextCluster = 2;
+    int slotsLength = (TREE_FIXTURE_WIDE_FILES + 1) * (MAX_LONG_FILE_NAME_ENTRIES + 1) * sizeof(Entry);
+    unsigned char *slots = (unsigned char *) malloc(slotsLength);
+
+    int childCluster = 0;
+    for(int level = TREE_FIXTURE_DEPTH; level >= 0; level--) {
+
+        memset(slots, 0, slotsLength);
+        int slot = 0;
+        int numberOfFiles = level == 0 ? TREE_FIXTURE_WIDE_FILES : TREE_FIXTURE_FILES;
+        for(int index = 0; index < numberOfFiles; index++) {
+            slot += fillFixtureFile(slots + slot * sizeof(Entry), level * 10000 + index, 0x20, 0);
+        }
+        if(childCluster != 0) {
+            slot += fillFixtureFile(slots + slot * sizeof(Entry), level, 0x10, childCluster);
+        }
+
+        int firstCluster = writeFixtureDirectory(volume, &nextCluster, slots, slot * sizeof(Entry));
+
+        if(level == 0) {                                    // The root holds only the wide directory at the top of the chain
+            memset(slots, 0, slotsLength);
+            slot = fillFixtureFile(slots, 0, 0x10, firstCluster);
+            memcpy(buffer->bufferPtr + (long) volume->sectorRootDirectoryStart * FIXTURE_SECTOR_SIZE, slots, slot * sizeof(Entry));
+        }
+        childCluster = firstCluster;
+    }
+
+    free(slots);
+    return volume;
+}
+
+/**
+ * Frees a volume fixture
+ */
+void freeVolumeFixture(void *paramFixture) {
+    freeVolume((Volume *) paramFixture);
+}
+
+#define LISTING_FIXTURE_FILES 16384         // Files in the directory, filling most of its 65536 slots
+
+/**
+ * A listing fixture is a volume holding one wide directory, along with a listing already read from it
+ */
+struct ListingFixture {
+    Volume *volume;
+    int firstCluster;
+    Listing listing;
+}; typedef struct ListingFixture ListingFixture;
+
+/**
+ * Creates a FAT16 volume in memory with one directory of LISTING_FIXTURE_FILES files with a spread of sizes and write
+ * times, then reads its listing
+ * @return - The listing fixture
+ */
+void *createListingFixture() {
+
+    BootSector *bootSector = (BootSector *) calloc(1, sizeof(BootSector));
+    bootSector->BPB_BytsPerSec = FIXTURE_SECTOR_SIZE;
+    bootSector->BPB_SecPerClus = 1;
+    bootSector->BPB_RsvdSecCnt = 1;
+    bootSector->BPB_NumFATs = 2;
+    bootSector->BPB_RootEntCnt = 512;
+    bootSector->BPB_TotSec16 = 65535;
+    bootSector->BPB_Media = 0xF8;
+    bootSector->BPB_FATSz16 = 256;
+
+    Buffer *buffer = createBuffer(bootSector->BPB_TotSec16 * FIXTURE_SECTOR_SIZE);
+    memset(buffer->bufferPtr, 0, buffer->size);
+
+    ListingFixture *listingFixture = (ListingFixture *) calloc(1, sizeof(ListingFixture));
+    listingFixture->volume = createVolume("fixture", buffer, bootSector, NULL);
+
+    int slotsLength = LISTING_FIXTURE_FILES * (MAX_LONG_FILE_NAME_ENTRIES + 1) * sizeof(Entry);
+    unsigned char *slots = (unsigned char *) calloc(1, slotsLength);
+
+    int slot = 0;
+    for(int index = 0; index < LISTING_FIXTURE_FILES; index++) {
+        slot += fillFixtureFile(slots + slot * sizeof(Entry), (int) (getFixtureRandom() % 1000000), 0x20, 0);
+        Entry *entry = (Entry *) (slots + (slot - 1) * sizeof(Entry));
+        entry->DIR_FileSize = getFixtureRandom();
+        entry->DIR_WrtDate = (uint16_t) ((((getFixtureRandom() % 60) + 20) << 9) | (((getFixtureRandom() % 12) + 1) << 5) | ((getFixtureRandom() % 28) + 1));
+        entry->DIR_WrtTime = (uint16_t) (((getFixtureRandom() % 24) << 11) | ((getFixtureRandom() % 60) << 5) | (getFixtureRandom() % 30));
+    }
+
+    int nextCluster = 2;
+    listingFixture->firstCluster = writeFixtureDirectory(listingFixture->volume, &nextCluster, slots, slot * sizeof(Entry));
+    free(slots);
+
+    readListing(listingFixture->volume, listingFixture->firstCluster, &listingFixture->listing);
+    return listingFixture;
+}
+
+/**
+ * Frees a listing fixture
+ */
+void freeListingFixture(void *paramFixture) {
+    ListingFixture *listingFixture = (ListingFixture *) paramFixture;
+    freeListing(&listingFixture->listing);
+    freeVolume(listingFixture->volume);
+    free(listingFixture);
+}
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                              Kernels                                             |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * Each kernel runs a number of ops on its fixture. An op is one call of the function being measured, apart from
+ * the directory slot loop and name lookup where an op is one whole cluster of slots.
+ */
+
+/**
+ * Follows the chain of a FAT fixture one entry per op
+ */
+void runFatNextCluster(void *paramFixture, long paramIterations) {
+
+    FatFixture *fatFixture = (FatFixture *) paramFixture;
+    int cluster = fatFixture->cluster;
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        cluster = (int) getFatEntry(fatFixture->volume, cluster);
+    }
+
+    fatFixture->cluster = cluster;
+    benchSink = cluster;
+}
+
+/**
+ * Parses every slot of a directory fixture into directory entries and frees them
+ */
+void runDirectorySlotLoop(void *paramFixture, long paramIterations) {
+
+    Buffer *buffer = (Buffer *) paramFixture;
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        LinkedList *entries = getAllEntriesFromDirectory(buffer, 0);
+        benchSink = entries->next != NULL;
+        freeDirectoryEntries(entries);
+    }
+}
+
+/**
+ * Parses a directory fixture and looks up a name that is not in it, comparing against every entry without decoding
+ */
+void runDirectoryNameLookup(void *paramFixture, long paramIterations) {
+
+    Buffer *buffer = (Buffer *) paramFixture;
+    wchar_t name[] = L"holiday photo 9999.txt";
+    int nameLength = (int) wcslen(name);
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        LinkedList *entries = getAllEntriesFromDirectory(buffer, 0);
+        uint8_t is_found = 0;
+        for(LinkedList *entry = entries->next; entry != NULL && !is_found; entry = entry->next) {
+            is_found = isDirectoryEntryNamed((DirectoryEntry *) entry->pointer, name, nameLength);
+        }
+        benchSink = is_found;
+        freeDirectoryEntries(entries);
+    }
+}
+
+/**
+ * Decodes the 13 characters of one long file name entry per op
+ */
+void runLongFileNameDecode(void *paramFixture, long paramIterations) {
+
+    LongFileNameEntry *longFileNameEntries = (LongFileNameEntry *) paramFixture;
+    wchar_t characters[13];
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        getLongFileNameCharacters(longFileNameEntries + (iteration % FIXTURE_NUMBER_OF_NAMES), characters);
+        benchSink = characters[iteration % 13];
+    }
+}
+
+/**
+ * Transcodes one name to UTF-8 per op, as every printed name is
+ */
+void runNameTranscode(void *paramFixture, long paramIterations) {
+
+    NameFixture *nameFixture = (NameFixture *) paramFixture;
+    unsigned char bytes[64 * UTF8_MAXIMUM_CHARACTER_BYTES];
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        int index = (int) (iteration % FIXTURE_NUMBER_OF_NAMES);
+        benchSink = encodeUtf8(nameFixture->names[index], nameFixture->nameLengths[index], bytes);
+    }
+}
+
+/**
+ * Extracts the attributes of one entry per op
+ */
+void runEntryAttributes(void *paramFixture, long paramIterations) {
+
+    Entry *entries = (Entry *) paramFixture;
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        EntryAttributes *entryAttributes = createEntryAttributes(entries + (iteration % FIXTURE_NUMBER_OF_NAMES));
+        benchSink = entryAttributes->is_file;
+        free(entryAttributes);
+    }
+}
+
+/**
+ * Decodes and prints one creation date and time per op with the functions behind printDirectoryEntry
+ */
+void runDatePrint(void *paramFixture, long paramIterations) {
+
+    Entry *entries = (Entry *) paramFixture;
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        Entry *entry = entries + (iteration % FIXTURE_NUMBER_OF_NAMES);
+        print16BitDate(entry->DIR_CrtDate, 0);
+        print16BitTimeHour(entry->DIR_CrtTime, 0);
+        print16BitTimeMinute(entry->DIR_CrtTime, 0);
+        printTimeTenthSeconds(entry->DIR_CrtTime, entry->DIR_CrtTimeTenth, 0);
+    }
+}
+
+/**
+ * Decodes and writes one creation date and time per op with the table driven record writer
+ */
+void runDateRecord(void *paramFixture, long paramIterations) {
+
+    Entry *entries = (Entry *) paramFixture;
+    RecordWriter *recordWriter = createRecordWriter(OUTPUT_FORMAT_NDJSON);
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        Entry *entry = entries + (iteration % FIXTURE_NUMBER_OF_NAMES);
+        appendRecordTimestamp(recordWriter, entry->DIR_CrtDate, entry->DIR_CrtTime, entry->DIR_CrtTimeTenth);
+    }
+
+    freeRecordWriter(recordWriter);
+}
+
+/**
+ * Walks and prints the whole tree of a volume fixture per op
+ */
+void runTreeWalk(void *paramFixture, long paramIterations) {
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        beginTree((Volume *) paramFixture);
+    }
+}
+
+/**
+ * Reads the listing of the wide directory of a listing fixture per op
+ */
+void runListingRead(void *paramFixture, long paramIterations) {
+
+    ListingFixture *listingFixture = (ListingFixture *) paramFixture;
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        Listing listing;
+        memset(&listing, 0, sizeof(Listing));
+        readListing(listingFixture->volume, listingFixture->firstCluster, &listing);
+        benchSink = listing.numberOfEntries;
+        freeListing(&listing);
+    }
+}
+
+/**
+ * Sorts the listing of a listing fixture by write time, and so by name first, per op
+ */
+void runListingSort(void *paramFixture, long paramIterations) {
+
+    Listing *listing = &((ListingFixture *) paramFixture)->listing;
+
+    for(long iteration = 0; iteration < paramIterations; iteration++) {
+        sortListing(listing, LIST_SORT_WRITTEN);
+        benchSink = listing->order[0];
+        free(listing->order);
+        listing->order = NULL;
+    }
+}
+
+/**
+ * A kernel being benchmarked with the functions that build, run and free its fixture
+ */
+struct Kernel {
+    const char *name;
+    void *(*createFixture)();
+    void (*run)(void *paramFixture, long paramIterations);
+    void (*freeFixture)(void *paramFixture);
+
+}; typedef struct Kernel Kernel;
+
+static const Kernel KERNELS[] = {
+    {"fat_next_cluster_fat12", createFat12Fixture, runFatNextCluster, freeFatFixture},
+    {"fat_next_cluster_fat16", createFat16Fixture, runFatNextCluster, freeFatFixture},
+    {"fat_next_cluster_fat32", createFat32Fixture, runFatNextCluster, freeFatFixture},
+    {"directory_slot_loop", createDirectoryFixture, runDirectorySlotLoop, freeBufferFixture},
+    {"directory_name_lookup", createDirectoryFixture, runDirectoryNameLookup, freeBufferFixture},
+    {"long_file_name_decode", createLongFileNameFixture, runLongFileNameDecode, freePlainFixture},
+    {"name_transcode", createNameFixture, runNameTranscode, freePlainFixture},
+    {"entry_attributes", createEntryFixture, runEntryAttributes, freePlainFixture},
+    {"date_time_print", createEntryFixture, runDatePrint, freePlainFixture},
+    {"date_time_record", createEntryFixture, runDateRecord, freePlainFixture},
+    {"tree_walk", createTreeFixture, runTreeWalk, freeVolumeFixture},
+    {"listing_read", createListingFixture, runListingRead, freeListingFixture},
+    {"listing_sort", createListingFixture, runListingSort, freeListingFixture},
+};
+
+#define NUMBER_OF_KERNELS ((int) (sizeof(KERNELS) / sizeof(Kernel)))
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                            Measuring                                             |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+#define BENCH_MINIMUM_REPEAT_NS 20000000L   // 20ms
+#define BENCH_WARMUP_REPEATS 3
+#define BENCH_DEFAULT_REPEATS 11
+#define BENCH_MAXIMUM_REPEATS 101
+#define BENCH_DEFAULT_THRESHOLD 10.0
+
+/**
+ * The measurements of one kernel
+ */
+struct KernelResult {
+    const char *name;
+    long iterations;                // Ops in each repeat
+    int repeats;
+    double nsPerOp;                 // Median over the repeats
+    double spreadPercent;           // Median absolute deviation as a percentage of the median
+    double bytesPerOp;
+    double allocationsPerOp;
+    long peakRssKb;                 // Peak resident set of the process once the kernel has run
+
+    double baselineNsPerOp;         // 0 when the kernel is not in the baseline
+    uint8_t is_regression;
+
+}; typedef struct KernelResult KernelResult;
+
+/**
+ * Gets the time from a monotonic clock
+ * @return - Nanoseconds from an arbitrary start
+ */
+long getMonotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * Compares two doubles for qsort
+ */
+int compareDoubles(const void *paramFirst, const void *paramSecond) {
+    double first = *(const double *) paramFirst;
+    double second = *(const double *) paramSecond;
+    return (first > second) - (first < second);
+}
+
+/**
+ * Gets the median of an array, sorting it
+ * @param paramValues         - The values
+ * @param paramNumberOfValues - The number of values
+ * @return                    - The median
+ */
+double getMedian(double *paramValues, int paramNumberOfValues) {
+    qsort(paramValues, paramNumberOfValues, sizeof(double), compareDoubles);
+    if(paramNumberOfValues % 2 == 1) {
+        return paramValues[paramNumberOfValues / 2];
+    }
+    return (paramValues[paramNumberOfValues / 2 - 1] + paramValues[paramNumberOfValues / 2]) / 2;
+}
+
+/**
+ * Calibrates, warms up and times a kernel
+ * @param paramKernel  - The kernel being measured
+ * @param paramRepeats - The number of timed repeats
+ * @param paramResult  - Set to the measurements
+ */
+void measureKernel(const Kernel *paramKernel, int paramRepeats, KernelResult *paramResult) {
+
+    void *fixture = paramKernel->createFixture();
+
+    long iterations = 1;
+    while(1) {
+        long start = getMonotonicNs();
+        paramKernel->run(fixture, iterations);
+        if(getMonotonicNs() - start >= BENCH_MINIMUM_REPEAT_NS || iterations >= (1L << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    for(int repeat = 0; repeat < BENCH_WARMUP_REPEATS; repeat++) {
+        paramKernel->run(fixture, iterations);
+    }
+
+    double nsPerOp[BENCH_MAXIMUM_REPEATS];
+    long allocations = benchAllocations;
+    long allocatedBytes = benchAllocatedBytes;
+
+    for(int repeat = 0; repeat < paramRepeats; repeat++) {
+        long start = getMonotonicNs();
+        paramKernel->run(fixture, iterations);
+        nsPerOp[repeat] = (double) (getMonotonicNs() - start) / iterations;
+    }
+
+    double totalOps = (double) iterations * paramRepeats;
+    paramResult->allocationsPerOp = (benchAllocations - allocations) / totalOps;
+    paramResult->bytesPerOp = (benchAllocatedBytes - allocatedBytes) / totalOps;
+
+    paramResult->name = paramKernel->name;
+    paramResult->iterations = iterations;
+    paramResult->repeats = paramRepeats;
+    paramResult->nsPerOp = getMedian(nsPerOp, paramRepeats);
+
+    double deviations[BENCH_MAXIMUM_REPEATS];
+    for(int repeat = 0; repeat < paramRepeats; repeat++) {
+        deviations[repeat] = nsPerOp[repeat] > paramResult->nsPerOp ? nsPerOp[repeat] - paramResult->nsPerOp : paramResult->nsPerOp - nsPerOp[repeat];
+    }
+    paramResult->spreadPercent = paramResult->nsPerOp == 0 ? 0 : 100 * getMedian(deviations, paramRepeats) / paramResult->nsPerOp;
+
+    paramKernel->freeFixture(fixture);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    paramResult->peakRssKb = usage.ru_maxrss;
+}
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                             Baselines                                            |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/*
+ * A baseline is the JSON written by --json on an earlier run. It is read by looking for each "name" and the
+ * "ns_per_op" that follows it, which is all the comparison needs.
+ */
+
+/**
+ * Reads a whole file into a string
+ * @param paramFileName - The file being read
+ * @return              - The contents ending with a 0, NULL when the file cannot be read
+ */
+char *readWholeFile(const char *paramFileName) {
+
+    FILE *file = fopen(paramFileName, "rb");
+    if(file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *contents = (char *) malloc(size + 1);
+    size_t read = fread(contents, 1, size, file);
+    contents[read] = '\0';
+    fclose(file);
+
+    return contents;
+}
+
+/**
+ * Finds the ns/op a baseline records for a kernel
+ * @param paramBaseline - The contents of the baseline
+ * @param paramName     - The name of the kernel
+ * @return              - The ns/op, 0 when the kernel is not in the baseline
+ */
+double getBaselineNsPerOp(const char *paramBaseline, const char *paramName) {
+
+    char key[128];
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", paramName);
+
+    const char *found = strstr(paramBaseline, key);
+    if(found == NULL) {
+        return 0;
+    }
+
+    const char *value = strstr(found, "\"ns_per_op\":");
+    if(value == NULL) {
+        return 0;
+    }
+
+    return strtod(value + strlen("\"ns_per_op\":"), NULL);
+}
+
+/**
+ * Writes the results as JSON so they can be used as a baseline later
+ * @param paramFileName        - Where the JSON is written
+ * @param paramResults         - The results
+ * @param paramNumberOfResults - The number of results
+ * @return                     - 1 if the file was written
+ */
+uint8_t writeResultsAsJson(const char *paramFileName, KernelResult *paramResults, int paramNumberOfResults) {
+
+    FILE *file = fopen(paramFileName, "w");
+    if(file == NULL) {
+        return 0;
+    }
+
+    fprintf(file, "{\n  \"kernels\": [\n");
+    for(int index = 0; index < paramNumberOfResults; index++) {
+        KernelResult *result = paramResults + index;
+        fprintf(file, "    {\"name\": \"%s\", \"ns_per_op\": %.4f, \"spread_percent\": %.2f, \"bytes_per_op\": %.2f, "
+                      "\"allocations_per_op\": %.4f, \"peak_rss_kb\": %ld, \"iterations\": %ld, \"repeats\": %d}%s\n",
+                result->name, result->nsPerOp, result->spreadPercent, result->bytesPerOp,
+                result->allocationsPerOp, result->peakRssKb, result->iterations, result->repeats, index + 1 < paramNumberOfResults ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    fclose(file);
+    return 1;
+}
+
+/// +--------------------------------------------------------------------------------------------------+
+/// |                                                                                                  |
+/// |                                                Main                                              |
+/// |                                                                                                  |
+/// +--------------------------------------------------------------------------------------------------+
+
+/**
+ * Runs the selected kernels, prints a table of their results and compares them against a baseline
+ * @param argc - The number of total arguments
+ * @param argv - The arguments beginning at 1
+ * @return     - 0, 1 when a kernel regressed against the baseline, 2 for bad arguments
+ */
+int main(int argc, char *argv[]) {
+
+    setlocale(LC_CTYPE, "");
+
+    const char *filter = NULL;
+    const char *jsonFileName = NULL;
+    const char *baselineFileName = NULL;
+    int repeats = BENCH_DEFAULT_REPEATS;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+
+    for(int index = 1; index < argc; index++) {
+        if(strcmp(argv[index], "--filter") == 0 && index + 1 < argc) {
+            filter = argv[++index];
+        } else if(strcmp(argv[index], "--repeats") == 0 && index + 1 < argc) {
+            repeats = atoi(argv[++index]);
+        } else if(strcmp(argv[index], "--json") == 0 && index + 1 < argc) {
+            jsonFileName = argv[++index];
+        } else if(strcmp(argv[index], "--baseline") == 0 && index + 1 < argc) {
+            baselineFileName = argv[++index];
+        } else if(strcmp(argv[index], "--threshold") == 0 && index + 1 < argc) {
+            threshold = atof(argv[++index]);
+        } else {
+            fprintf(stderr, "Usage: %s [--filter Name] [--repeats N] [--json Output.json] [--baseline Baseline.json] [--threshold Percent]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(repeats < 1 || repeats > BENCH_MAXIMUM_REPEATS) {
+        fprintf(stderr, "The number of repeats must be from 1 to %d.\n", BENCH_MAXIMUM_REPEATS);
+        return 2;
+    }
+
+    char *baseline = NULL;
+    if(baselineFileName != NULL) {
+        baseline = readWholeFile(baselineFileName);
+        if(baseline == NULL) {
+            fprintf(stderr, "Unable to read baseline %s.\n", baselineFileName);
+            return 2;
+        }
+    }
+
+    FILE *nullStream = fopen("/dev/null", "w");
+    setOutputStream(nullStream);
+
+    KernelResult results[NUMBER_OF_KERNELS];
+    int numberOfResults = 0;
+    int numberOfRegressions = 0;
+
+    printf("%-24s %12s %8s %12s %12s %12s", "Kernel", "ns/op", "+/-", "bytes/op", "allocs/op", "peak RSS KB");
+    printf(baseline != NULL ? " %12s %9s\n" : "\n", "baseline", "change");
+
+    for(int index = 0; index < NUMBER_OF_KERNELS; index++) {
+
+        if(filter != NULL && strstr(KERNELS[index].name, filter) == NULL) {
+            continue;
+        }
+
+        KernelResult *result = results + numberOfResults++;
+        memset(result, 0, sizeof(KernelResult));
+        measureKernel(KERNELS + index, repeats, result);
+
+        printf("%-24s %12.2f %7.1f%% %12.1f %12.3f %12ld", result->name, result->nsPerOp, result->spreadPercent, result->bytesPerOp, result->allocationsPerOp, result->peakRssKb);
+
+        if(baseline != NULL) {
+            result->baselineNsPerOp = getBaselineNsPerOp(baseline, result->name);
+            if(result->baselineNsPerOp > 0) {
+                double changePercent = 100 * (result->nsPerOp - result->baselineNsPerOp) / result->baselineNsPerOp;
+                result->is_regression = changePercent > threshold && changePercent > result->spreadPercent;
+                numberOfRegressions += result->is_regression;
+                printf(" %12.2f %+8.1f%%%s", result->baselineNsPerOp, changePercent, result->is_regression ? "  REGRESSION" : "");
+            } else {
+                printf(" %12s %9s", "-", "new");
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    setOutputStream(stdout);
+    fclose(nullStream);
+
+    if(jsonFileName != NULL && !writeResultsAsJson(jsonFileName, results, numberOfResults)) {
+        fprintf(stderr, "Unable to write %s.\n", jsonFileName);
+        return 2;
+    }
+
+    free(baseline);
+
+    if(numberOfRegressions > 0) {
+        printf("%d kernel%s slower than the baseline by more than %.1f%%\n", numberOfRegressions, numberOfRegressions == 1 ? "" : "s", threshold);
+        return 1;
+    }
+
+    return 0;
+}